@@ -20,13 +20,35 @@ let package = Package(
     .executableTarget(
       name: "AppFaders",
       dependencies: [
+        "AppFadersIPC",
+        "AppFadersVolumeTable",
         .product(name: "CAAudioHardware", package: "CAAudioHardware")
       ]
     ),
     .executableTarget(
       name: "AppFadersHelper",
+      dependencies: ["AppFadersIPC", "AppFadersVolumeTable", "AppFadersVolumeFile"]
+    ),
+    .target(
+      name: "AppFadersIPC",
       dependencies: []
     ),
+    .target(
+      name: "AppFadersVolumeFile",
+      dependencies: [],
+      publicHeadersPath: "include",
+      cSettings: [
+        .headerSearchPath("include")
+      ]
+    ),
+    .target(
+      name: "AppFadersVolumeTable",
+      dependencies: [],
+      publicHeadersPath: "include",
+      cSettings: [
+        .headerSearchPath("include")
+      ]
+    ),
     .target(
       name: "AppFadersDriverBridge",
       dependencies: [],
@@ -41,7 +63,7 @@ let package = Package(
     ),
     .target(
       name: "AppFadersDriver",
-      dependencies: ["AppFadersDriverBridge"],
+      dependencies: ["AppFadersDriverBridge", "AppFadersIPC", "AppFadersVolumeTable"],
       linkerSettings: [
         .linkedFramework("CoreAudio"),
         .linkedFramework("AudioToolbox"),
@@ -55,13 +77,47 @@ let package = Package(
       name: "BundleAssembler",
       capability: .buildTool()
     ),
+    .target(
+      name: "AppFadersTestSupport",
+      dependencies: [],
+      path: "Tests/AppFadersTestSupport"
+    ),
     .testTarget(
       name: "AppFadersDriverTests",
-      dependencies: ["AppFadersDriver"]
+      dependencies: [
+        "AppFadersDriver",
+        "AppFadersIPC",
+        "AppFadersVolumeTable",
+        "AppFadersTestSupport"
+      ]
+    ),
+    .testTarget(
+      name: "AppFadersHelperTests",
+      dependencies: [
+        "AppFadersHelper",
+        "AppFadersVolumeTable",
+        "AppFadersVolumeFile",
+        "AppFadersTestSupport"
+      ]
+    ),
+    .testTarget(
+      name: "AppFadersIPCTests",
+      dependencies: ["AppFadersIPC", "AppFadersTestSupport"]
     ),
     .testTarget(
       name: "AppFadersTests",
-      dependencies: ["AppFaders"]
+      dependencies: ["AppFaders", "AppFadersIPC", "AppFadersVolumeTable", "AppFadersTestSupport"]
+    ),
+    .testTarget(
+      name: "AppFadersLatencyTests",
+      dependencies: [
+        "AppFaders",
+        "AppFadersHelper",
+        "AppFadersDriver",
+        "AppFadersIPC",
+        "AppFadersVolumeTable",
+        "AppFadersTestSupport"
+      ]
     )
   ]
 )
@@ -51,6 +51,12 @@ else
   warn "Helper binary not found"
 fi
 
+# saved per-app volumes live next to the helper
+if [[ -f "$HELPER_SUPPORT_DIR/volumes.db" || -f "$HELPER_SUPPORT_DIR/volumes.snapshot" ]]; then
+  info "Removing saved volumes..."
+  sudo rm -f "$HELPER_SUPPORT_DIR/volumes.db" "$HELPER_SUPPORT_DIR/volumes.snapshot"
+fi
+
 # step 6: remove support directory if empty
 if [[ -d "$HELPER_SUPPORT_DIR" ]]; then
   if [[ -z "$(ls -A "$HELPER_SUPPORT_DIR")" ]]; then
@@ -0,0 +1,58 @@
+import AppFadersIPC
+import AppFadersVolumeTable
+import Foundation
+import os.log
+
+private let log = OSLog(subsystem: "com.fbreidenbach.appfaders", category: "AudioActivityReader")
+
+/// one app's audio as the driver last reported it
+struct AppAudioActivity: Equatable, Sendable {
+  /// the app sent audio recently - the driver holds this over short gaps
+  let isProducing: Bool
+  /// recent peak before the app's fader, 0...1 (louder input is clipped)
+  let peak: Float
+}
+
+/// reads the driver's activity feed and names its apps
+/// the feed identifies apps by volume table key, so each read hashes the bundle IDs the host
+/// tracks and keeps the ones the driver knows; apps it doesn't mention have no clients
+final class AudioActivityReader: Sendable {
+  /// how often the orchestrator reads - a meter needs no more, and each read is one HAL call
+  static let pollInterval: Duration = .milliseconds(250)
+
+  /// raw feed bytes, nil when there is no driver to ask
+  typealias ReadFeed = @Sendable () -> Data?
+
+  private let readFeed: ReadFeed
+
+  init(readFeed: @escaping ReadFeed) {
+    self.readFeed = readFeed
+  }
+
+  /// activity of the given apps that have clients on the device
+  /// - Returns: nil if the feed couldn't be read or decoded - callers keep showing every app
+  func activity(of bundleIDs: some Sequence<String>) -> [String: AppAudioActivity]? {
+    guard let feed = readFeed() else { return nil }
+
+    let apps: [AppActivity]
+    do {
+      apps = try ActivityFeed.decode(feed)
+    } catch {
+      os_log(.error, log: log, "Unreadable activity feed: %{public}@", "\(error)")
+      return nil
+    }
+
+    var byKey: [UInt64: AppActivity] = [:]
+    byKey.reserveCapacity(apps.count)
+    for app in apps {
+      byKey[app.key] = app
+    }
+
+    var activity: [String: AppAudioActivity] = [:]
+    for bundleID in bundleIDs {
+      guard let app = byKey[AFVolumeTable_Key(bundleID)] else { continue }
+      activity[bundleID] = AppAudioActivity(isProducing: app.isProducing, peak: min(app.peak, 1))
+    }
+    return activity
+  }
+}
@@ -12,15 +12,26 @@ final class AudioOrchestrator {
   private(set) var trackedApps: [TrackedApp] = []
   private(set) var isDriverConnected: Bool = false
   private(set) var appVolumes: [String: Float] = [:] // bundleID -> volume
+  /// tracked apps with clients on the device - nil while the driver's feed can't be read
+  private(set) var appActivity: [String: AppAudioActivity]?
+
+  /// tracked apps that are playing - every tracked app while activity is unknown
+  var soundingApps: [TrackedApp] {
+    guard let appActivity else { return trackedApps }
+    return trackedApps.filter { appActivity[$0.bundleID]?.isProducing == true }
+  }
 
   private let deviceManager: DeviceManager
   private let appAudioMonitor: AppAudioMonitor
   private let driverBridge: DriverBridge
+  private let activityReader: AudioActivityReader
 
   init() {
-    deviceManager = DeviceManager()
+    let deviceManager = DeviceManager()
+    self.deviceManager = deviceManager
     appAudioMonitor = AppAudioMonitor()
     driverBridge = DriverBridge()
+    activityReader = AudioActivityReader { deviceManager.appActivityFeed() }
     os_log(.info, log: log, "AudioOrchestrator initialized")
   }
 
@@ -57,6 +68,15 @@ final class AudioOrchestrator {
           await self?.handleAppEvent(event)
         }
       }
+
+      // Driver Activity Feed
+      group.addTask { [weak self] in
+        while !Task.isCancelled {
+          guard let self else { return }
+          await pollActivity()
+          try? await Task.sleep(for: AudioActivityReader.pollInterval)
+        }
+      }
     }
   }
 
@@ -84,17 +104,22 @@ final class AudioOrchestrator {
   /// - Parameters:
   ///   - bundleID: The bundle identifier of the application
   ///   - volume: The volume level (0.0 - 1.0)
+  /// - Note: updates are coalesced per app, so a slider drag sends only the values the helper
+  ///   can keep up with - the last one always arrives
   func setVolume(for bundleID: String, volume: Float) async {
     let oldVolume = appVolumes[bundleID]
     appVolumes[bundleID] = volume
 
     do {
       if driverBridge.isConnected {
-        try await driverBridge.setAppVolume(bundleID: bundleID, volume: volume)
+        try await driverBridge.submitAppVolume(bundleID: bundleID, volume: volume)
       } else {
         os_log(.debug, log: log, "Helper not connected, volume cached for %{public}@", bundleID)
       }
     } catch {
+      // a newer value for the app has been set meanwhile - it owns the cached volume now
+      guard appVolumes[bundleID] == volume else { return }
+
       if let old = oldVolume {
         appVolumes[bundleID] = old
       } else {
@@ -111,6 +136,30 @@ final class AudioOrchestrator {
     }
   }
 
+  /// Saves the current volumes of every app as a named scene in the helper
+  /// - Parameter name: scene name, e.g. "meeting"
+  /// - Throws: Error if the helper communication fails
+  func saveScene(named name: String) async throws {
+    guard driverBridge.isConnected else {
+      throw DriverError.helperNotRunning
+    }
+    try await driverBridge.saveScene(name: name, volumes: appVolumes)
+  }
+
+  /// Recalls a named scene - every app moves to its scene volume in the same driver cycle
+  /// - Parameters:
+  ///   - name: scene name
+  ///   - rampMilliseconds: how long every app takes to get there, 0 for the driver's default
+  /// - Throws: Error if the scene doesn't exist or the helper communication fails
+  func recallScene(named name: String, rampMilliseconds: UInt32 = 0) async throws {
+    guard driverBridge.isConnected else {
+      throw DriverError.helperNotRunning
+    }
+    let volumes = try await driverBridge.recallScene(name: name, rampMilliseconds: rampMilliseconds)
+    appVolumes.merge(volumes) { _, scene in scene }
+    os_log(.info, log: log, "Recalled scene %{public}@: %d apps", name, volumes.count)
+  }
+
   // MARK: - Private Helpers
 
   /// Connects to the helper service
@@ -142,19 +191,32 @@ final class AudioOrchestrator {
     )
   }
 
+  /// reads the driver's feed off the main actor, publishes only when something changed so
+  /// observers aren't woken four times a second for nothing
+  private func pollActivity() async {
+    let bundleIDs = trackedApps.map(\.bundleID)
+    let reader = activityReader
+    let activity = await Task.detached(priority: .utility) {
+      reader.activity(of: bundleIDs)
+    }.value
+    if activity != appActivity {
+      appActivity = activity
+    }
+  }
+
+  /// one batch round trip for every app instead of one per app
   private func restoreVolumes() async {
-    for (bundleID, volume) in appVolumes {
-      do {
-        try await driverBridge.setAppVolume(bundleID: bundleID, volume: volume)
-      } catch {
-        os_log(
-          .error,
-          log: log,
-          "Failed to restore volume for %{public}@: %{public}@",
-          bundleID,
-          error.localizedDescription
-        )
-      }
+    do {
+      try await driverBridge.setAppVolumes(appVolumes)
+      os_log(.info, log: log, "Restored %d volumes", appVolumes.count)
+    } catch {
+      os_log(
+        .error,
+        log: log,
+        "Failed to restore %d volumes: %{public}@",
+        appVolumes.count,
+        error.localizedDescription
+      )
     }
   }
 
@@ -1,4 +1,6 @@
+import AppFadersIPC
 @preconcurrency import CAAudioHardware
+import CoreAudio
 import Foundation
 import os.log
 
@@ -36,6 +38,27 @@ final class DeviceManager: Sendable {
     }
   }
 
+  /// the driver's per-app activity feed (ActivityFeed bytes), nil if the device is missing or
+  /// didn't answer
+  func appActivityFeed() -> Data? {
+    guard let device = appFadersDevice else { return nil }
+
+    var address = AudioObjectPropertyAddress(
+      mSelector: ActivityFeed.propertySelector,
+      mScope: kAudioObjectPropertyScopeGlobal,
+      mElement: kAudioObjectPropertyElementMain
+    )
+    var feed: Unmanaged<CFData>?
+    var size = UInt32(MemoryLayout<Unmanaged<CFData>?>.size)
+    let status = AudioObjectGetPropertyData(device.objectID, &address, 0, nil, &size, &feed)
+    guard status == noErr, let feed else {
+      os_log(.debug, log: log, "Failed to read app activity: %d", status)
+      return nil
+    }
+    // custom property values arrive retained
+    return feed.takeRetainedValue() as Data
+  }
+
   /// an async stream of notifications for device list changes
   var deviceListUpdates: AsyncStream<Void> {
     AsyncStream { continuation in
@@ -1,70 +1,93 @@
+import AppFadersIPC
 import Foundation
 import os.log
 
 private let log = OSLog(subsystem: "com.fbreidenbach.appfaders", category: "DriverBridge")
-private let machServiceName = "com.fbreidenbach.appfaders.helper"
 
-/// handles communication with the AppFaders helper service via XPC
+/// handles communication with the AppFaders helper service - over XPC unless a test or
+/// benchmark hands it another transport
 final class DriverBridge: @unchecked Sendable {
   private let lock = NSLock()
-  private var connection: NSXPCConnection?
+  private let makeTransport: @Sendable () -> HelperTransport
+  private var transport: HelperTransport?
+
+  /// app IDs the helper assigned - the string is only sent once per app and connection
+  private var appIDs: [String: UInt32] = [:]
+  /// apps the helper had no app ID left for - their requests carry the bundle ID
+  private var unnumbered = Set<String>()
+
+  /// rate cap for coalesced updates - one per display frame is as fast as a fader can move
+  static let defaultVolumeUpdateInterval: Duration = .microseconds(16667)
+
+  private let volumeUpdateInterval: Duration?
+  private var volumeUpdates: VolumeUpdateCoalescer?
+
+  /// - Parameters:
+  ///   - volumeUpdateInterval: minimum time between coalesced updates for one app,
+  ///     nil to send as fast as the helper replies
+  ///   - transport: creates the connection on connect()
+  init(
+    volumeUpdateInterval: Duration? = DriverBridge.defaultVolumeUpdateInterval,
+    transport: @escaping @Sendable () -> HelperTransport = { XPCHelperTransport() }
+  ) {
+    self.volumeUpdateInterval = volumeUpdateInterval
+    makeTransport = transport
+  }
 
   /// returns true if currently connected to the helper service
   var isConnected: Bool {
-    lock.withLock { connection != nil }
+    lock.withLock { transport != nil }
   }
 
   // MARK: - Connection Management
 
-  /// establishes XPC connection to the helper service
+  /// establishes the connection to the helper service
   func connect() async throws {
-    try await withCheckedThrowingContinuation { (continuation: CheckedContinuation<Void, Error>) in
-      lock.lock()
-
-      if connection != nil {
-        lock.unlock()
-        continuation.resume()
-        return
-      }
-
-      os_log(.info, log: log, "Connecting to helper: %{public}@", machServiceName)
-
-      let conn = NSXPCConnection(machServiceName: machServiceName)
-      conn.remoteObjectInterface = NSXPCInterface(with: AppFadersHostProtocol.self)
-
-      conn.invalidationHandler = { [weak self] in
-        os_log(.info, log: log, "XPC connection invalidated")
-        self?.handleDisconnect()
-      }
+    try lock.withLock {
+      guard transport == nil else { return }
 
-      conn.interruptionHandler = { [weak self] in
-        os_log(.info, log: log, "XPC connection interrupted")
-        self?.handleDisconnect()
+      os_log(.info, log: log, "Connecting to helper")
+      let transport = makeTransport()
+      let transportID = ObjectIdentifier(transport)
+      do {
+        try transport.start(
+          // the host never subscribes - acknowledge anything pushed anyway
+          onChanges: { _, acknowledge in acknowledge() },
+          onDisconnect: { [weak self] in
+            os_log(.info, log: log, "Helper connection lost")
+            self?.handleDisconnect(transportID)
+          }
+        )
+      } catch {
+        throw DriverError.connectionFailed("\(error)")
       }
-
-      conn.resume()
-      connection = conn
-      lock.unlock()
-
-      os_log(.info, log: log, "XPC connection established")
-      continuation.resume()
+      self.transport = transport
+      os_log(.info, log: log, "Helper connection established")
     }
   }
 
   /// disconnects from the helper service
   func disconnect() {
-    lock.lock()
-    defer { lock.unlock() }
-
-    connection?.invalidate()
-    connection = nil
+    let closing = lock.withLock {
+      let closing = transport
+      transport = nil
+      appIDs.removeAll()
+      unnumbered.removeAll()
+      return closing
+    }
+    closing?.close()
     os_log(.info, log: log, "Disconnected from helper")
   }
 
-  private func handleDisconnect() {
-    lock.lock()
-    defer { lock.unlock() }
-    connection = nil
+  private func handleDisconnect(_ transportID: ObjectIdentifier) {
+    lock.withLock {
+      // a transport that was already replaced must not drop its successor
+      guard let transport, ObjectIdentifier(transport) == transportID else { return }
+      self.transport = nil
+      // a restarted helper without its volume table numbers apps from scratch
+      appIDs.removeAll()
+      unnumbered.removeAll()
+    }
   }
 
   // MARK: - Volume Commands
@@ -73,7 +96,7 @@ final class DriverBridge: @unchecked Sendable {
   /// - Parameters:
   ///   - bundleID: The target application's bundle identifier
   ///   - volume: The desired volume level (0.0 - 1.0)
-  /// - Throws: DriverError if validation fails or XPC call fails
+  /// - Throws: DriverError if validation fails or the helper call fails
   func setAppVolume(bundleID: String, volume: Float) async throws {
     guard volume >= 0.0, volume <= 1.0 else {
       throw DriverError.invalidVolumeRange(volume)
@@ -83,58 +106,250 @@ final class DriverBridge: @unchecked Sendable {
       throw DriverError.bundleIDTooLong(bundleID.utf8.count)
     }
 
-    let proxy = try getProxy()
+    if let appID = try await appID(for: bundleID) {
+      try await call(.setAppVolume(appID: appID, volume: volume))
+    } else {
+      try await call(.setVolume(bundleID: bundleID, volume: volume))
+    }
+  }
 
-    try await withCheckedThrowingContinuation { (continuation: CheckedContinuation<Void, Error>) in
-      proxy.setVolume(bundleID: bundleID, volume: volume) { error in
-        if let error {
-          continuation.resume(throwing: DriverError.remoteError(error.localizedDescription))
-        } else {
-          continuation.resume()
-        }
-      }
+  /// coalesced setAppVolume for continuous input such as a fader drag
+  /// at most one request per app is in flight; a newer value replaces one that hasn't been sent
+  /// - Parameters:
+  ///   - bundleID: The target application's bundle identifier
+  ///   - volume: The desired volume level (0.0 - 1.0)
+  /// - Returns: .sent once the helper has the value, .superseded if a newer value replaced it
+  /// - Throws: DriverError if validation fails or the value was sent and the helper call failed
+  @discardableResult
+  func submitAppVolume(
+    bundleID: String,
+    volume: Float
+  ) async throws -> VolumeUpdateCoalescer.Outcome {
+    // validate up front so a bad value can't replace a good pending one
+    guard volume >= 0.0, volume <= 1.0 else {
+      throw DriverError.invalidVolumeRange(volume)
     }
+
+    guard bundleID.utf8.count <= 255 else {
+      throw DriverError.bundleIDTooLong(bundleID.utf8.count)
+    }
+
+    return try await volumeCoalescer().submit(volume, for: bundleID)
   }
 
   /// retrieves the current volume for a specific application from the helper
   /// - Parameter bundleID: The target application's bundle identifier
   /// - Returns: The current volume level (0.0 - 1.0)
-  /// - Throws: DriverError if validation fails or XPC call fails
+  /// - Throws: DriverError if validation fails or the helper call fails
   func getAppVolume(bundleID: String) async throws -> Float {
     guard bundleID.utf8.count <= 255 else {
       throw DriverError.bundleIDTooLong(bundleID.utf8.count)
     }
 
-    let proxy = try getProxy()
+    guard case let .volume(volume) = try await call(.getVolume(bundleID: bundleID)) else {
+      throw DriverError.remoteError("Unexpected reply to getVolume")
+    }
+    return volume
+  }
+
+  /// sends many volumes to the helper as one batch - applied atomically, all or nothing
+  /// one round trip however many apps are new: apps without a cached app ID go by bundle ID and
+  /// the helper answers with the IDs it gave them, so a restore after a reconnect doesn't wait
+  /// on a registerApp per app
+  /// - Parameter volumes: bundle identifier to volume level (0.0 - 1.0)
+  /// - Throws: DriverError if any entry fails validation or the helper call fails
+  func setAppVolumes(_ volumes: [String: Float]) async throws {
+    for (bundleID, volume) in volumes {
+      guard volume >= 0.0, volume <= 1.0 else {
+        throw DriverError.invalidVolumeRange(volume)
+      }
+      guard bundleID.utf8.count <= 255 else {
+        throw DriverError.bundleIDTooLong(bundleID.utf8.count)
+      }
+    }
+    guard !volumes.isEmpty else { return }
 
-    return try await withCheckedThrowingContinuation { continuation in
-      proxy.getVolume(bundleID: bundleID) { volume, error in
-        if let error {
-          continuation.resume(throwing: DriverError.remoteError(error.localizedDescription))
+    var appVolumes: [UInt32: Float] = [:]
+    var named: [String: Float] = [:]
+    lock.withLock {
+      for (bundleID, volume) in volumes {
+        if let appID = appIDs[bundleID] {
+          appVolumes[appID] = volume
         } else {
-          continuation.resume(returning: volume)
+          named[bundleID] = volume
         }
       }
     }
+
+    let response = try await call(.setAppVolumes(appVolumes, named: named))
+    guard case let .registered(registered) = response else {
+      throw DriverError.remoteError("Unexpected reply to setAppVolumes")
+    }
+    guard !named.isEmpty else { return }
+    lock.withLock {
+      for (appID, bundleID) in registered {
+        appIDs[bundleID] = appID
+      }
+      // named apps the helper left out have no ID - its table is full
+      for bundleID in named.keys where appIDs[bundleID] == nil {
+        unnumbered.insert(bundleID)
+      }
+    }
+  }
+
+  /// retrieves the volumes for several applications in one round trip (after registering any
+  /// app without a cached app ID) - apps the helper has no app ID for are asked one by one
+  /// - Parameter bundleIDs: The target applications' bundle identifiers
+  /// - Returns: bundle identifier to volume level (1.0 for apps the helper doesn't know)
+  /// - Throws: DriverError if validation fails or the helper call fails
+  func getAppVolumes(bundleIDs: [String]) async throws -> [String: Float] {
+    for bundleID in bundleIDs where bundleID.utf8.count > 255 {
+      throw DriverError.bundleIDTooLong(bundleID.utf8.count)
+    }
+
+    var numbered: [(bundleID: String, appID: UInt32)] = []
+    var byBundleID: [String] = []
+    numbered.reserveCapacity(bundleIDs.count)
+    for bundleID in bundleIDs {
+      if let appID = try await appID(for: bundleID) {
+        numbered.append((bundleID, appID))
+      } else {
+        byBundleID.append(bundleID)
+      }
+    }
+
+    var volumes: [String: Float] = [:]
+    if !numbered.isEmpty {
+      let request = HelperRequest.getAppVolumes(appIDs: numbered.map { $0.appID })
+      guard case let .appVolumes(appVolumes) = try await call(request) else {
+        throw DriverError.remoteError("Unexpected reply to getAppVolumes")
+      }
+      for (bundleID, appID) in numbered {
+        volumes[bundleID] = appVolumes[appID] ?? 1.0
+      }
+    }
+    for bundleID in byBundleID {
+      volumes[bundleID] = try await getAppVolume(bundleID: bundleID)
+    }
+    return volumes
+  }
+
+  // MARK: - Scenes
+
+  /// saves (or replaces) a named scene in the helper
+  /// - Parameters:
+  ///   - name: scene name
+  ///   - volumes: bundle identifier to volume level (0.0 - 1.0)
+  /// - Throws: DriverError if any entry fails validation or the helper call fails
+  func saveScene(name: String, volumes: [String: Float]) async throws {
+    for (bundleID, volume) in volumes {
+      guard volume >= 0.0, volume <= 1.0 else {
+        throw DriverError.invalidVolumeRange(volume)
+      }
+      guard bundleID.utf8.count <= 255 else {
+        throw DriverError.bundleIDTooLong(bundleID.utf8.count)
+      }
+    }
+
+    try await call(.saveScene(name: name, volumes: volumes))
+  }
+
+  /// recalls a scene - every app switches in the same driver cycle
+  /// - Parameters:
+  ///   - name: scene name
+  ///   - rampMilliseconds: how long every app takes to reach its volume, 0 for the default
+  /// - Returns: the scene's volumes, bundle identifier to volume level
+  /// - Throws: DriverError if the scene doesn't exist or the helper call fails
+  func recallScene(name: String, rampMilliseconds: UInt32 = 0) async throws -> [String: Float] {
+    try await expectVolumes(call(.recallScene(name: name, rampMilliseconds: rampMilliseconds)))
+  }
+
+  /// removes a scene from the helper
+  /// - Throws: DriverError if the scene doesn't exist or the helper call fails
+  func removeScene(name: String) async throws {
+    try await call(.removeScene(name: name))
+  }
+
+  /// names of the scenes saved in the helper, sorted
+  /// - Throws: DriverError if the helper call fails
+  func getSceneNames() async throws -> [String] {
+    guard case let .names(names) = try await call(.getSceneNames) else {
+      throw DriverError.remoteError("Unexpected reply to getSceneNames")
+    }
+    return names
   }
 
   // MARK: - Private Helpers
 
-  private func getProxy() throws -> AppFadersHostProtocol {
-    lock.lock()
-    let conn = connection
-    lock.unlock()
+  /// cached app ID for a bundle ID, registering it with the helper on first use
+  /// - Returns: nil if the helper has no app ID left for the app - send it by bundle ID
+  private func appID(for bundleID: String) async throws -> UInt32? {
+    let (cached, isUnnumbered) = lock.withLock {
+      (appIDs[bundleID], unnumbered.contains(bundleID))
+    }
+    if let cached {
+      return cached
+    }
+    guard !isUnnumbered else { return nil }
+
+    let response: HelperResponse
+    do {
+      response = try await call(.registerApp(bundleID: bundleID))
+    } catch DriverError.appIDsExhausted {
+      // IDs are never freed while the helper runs - don't ask again on this connection
+      lock.withLock { _ = unnumbered.insert(bundleID) }
+      return nil
+    }
+    guard case let .appID(appID) = response else {
+      throw DriverError.remoteError("Unexpected reply to registerApp")
+    }
 
-    guard let conn else {
+    lock.withLock { appIDs[bundleID] = appID }
+    return appID
+  }
+
+  private func volumeCoalescer() -> VolumeUpdateCoalescer {
+    lock.withLock {
+      if let volumeUpdates {
+        return volumeUpdates
+      }
+      let send: VolumeUpdateCoalescer.Send = { [weak self] bundleID, volume in
+        guard let self else { throw DriverError.helperNotRunning }
+        try await setAppVolume(bundleID: bundleID, volume: volume)
+      }
+      let coalescer = VolumeUpdateCoalescer(minimumInterval: volumeUpdateInterval, send: send)
+      volumeUpdates = coalescer
+      return coalescer
+    }
+  }
+
+  /// send one request, mapping transport errors to DriverError
+  @discardableResult
+  private func call(_ request: HelperRequest) async throws -> HelperResponse {
+    guard let transport = lock.withLock({ transport }) else {
       throw DriverError.helperNotRunning
     }
 
-    guard let proxy = conn.remoteObjectProxyWithErrorHandler({ error in
-      os_log(.error, log: log, "XPC proxy error: %{public}@", error.localizedDescription)
-    }) as? AppFadersHostProtocol else {
-      throw DriverError.connectionFailed("Failed to get remote object proxy")
+    do {
+      return try await transport.send(request)
+    } catch let HelperTransportError.remote(code, message) {
+      throw code == HelperResponse.appIDsExhausted
+        ? DriverError.appIDsExhausted
+        : DriverError.remoteError(message)
+    } catch HelperTransportError.notConnected {
+      throw DriverError.helperNotRunning
+    } catch HelperTransportError.disconnected {
+      throw DriverError.connectionInterrupted
+    } catch {
+      os_log(.error, log: log, "Helper call failed: %{public}@", "\(error)")
+      throw DriverError.connectionFailed("\(error)")
     }
+  }
 
-    return proxy
+  private func expectVolumes(_ response: HelperResponse) throws -> [String: Float] {
+    guard case let .volumes(volumes) = response else {
+      throw DriverError.remoteError("Unexpected reply")
+    }
+    return volumes
   }
 }
@@ -14,6 +14,8 @@ enum DriverError: Error, LocalizedError, Equatable {
   case connectionFailed(String)
   case connectionInterrupted
   case remoteError(String)
+  /// registerApp only - the helper has no app ID left, the app goes by bundle ID
+  case appIDsExhausted
 
   var errorDescription: String? {
     switch self {
@@ -35,6 +37,8 @@ enum DriverError: Error, LocalizedError, Equatable {
       "Connection to helper service was interrupted."
     case let .remoteError(message):
       "Helper service error: \(message)"
+    case .appIDsExhausted:
+      "Helper service has no app ID left for this app."
     }
   }
 }
@@ -0,0 +1,132 @@
+import Foundation
+import os.log
+
+private let log = OSLog(subsystem: "com.fbreidenbach.appfaders", category: "VolumeUpdateCoalescer")
+
+/// latest-wins coalescing of per-app volume updates
+/// at most one send is in flight per app; values that arrive meanwhile overwrite each other, so a
+/// fader drag costs one message per round trip (or per interval) instead of one per input event
+final class VolumeUpdateCoalescer: @unchecked Sendable {
+  /// delivers one volume - the next value for the same app waits until this returns
+  typealias Send = @Sendable (String, Float) async throws -> Void
+
+  /// what happened to a submitted value
+  enum Outcome: Equatable {
+    /// the value reached the sender
+    case sent
+    /// a newer value for the same app replaced it before it was sent
+    case superseded
+  }
+
+  private struct Pending {
+    let volume: Float
+    let waiter: CheckedContinuation<Outcome, Error>?
+  }
+
+  private struct Lane {
+    var pending: Pending?
+    var inFlight = false
+    var lastSent: ContinuousClock.Instant?
+  }
+
+  private let lock = NSLock()
+  private let send: Send
+  private let minimumInterval: Duration?
+  private let clock = ContinuousClock()
+  private var lanes: [String: Lane] = [:]
+
+  // stats - values offered vs values actually sent
+  private var submitted = 0
+  private var delivered = 0
+
+  /// - Parameters:
+  ///   - minimumInterval: optional rate cap - minimum time between two sends for the same app
+  ///   - send: delivers a value, called from a background task
+  init(minimumInterval: Duration? = nil, send: @escaping Send) {
+    self.minimumInterval = minimumInterval
+    self.send = send
+  }
+
+  var submittedCount: Int {
+    lock.withLock { submitted }
+  }
+
+  var sentCount: Int {
+    lock.withLock { delivered }
+  }
+
+  /// offer a value without waiting for it
+  func enqueue(_ volume: Float, for bundleID: String) {
+    offer(Pending(volume: volume, waiter: nil), for: bundleID)
+  }
+
+  /// offer a value and wait until it was sent or replaced by a newer one
+  /// - Throws: the sender's error if this value was sent and failed
+  @discardableResult
+  func submit(_ volume: Float, for bundleID: String) async throws -> Outcome {
+    try await withCheckedThrowingContinuation { continuation in
+      offer(Pending(volume: volume, waiter: continuation), for: bundleID)
+    }
+  }
+
+  private func offer(_ pending: Pending, for bundleID: String) {
+    let (superseded, start) = lock.withLock {
+      submitted += 1
+      var lane = lanes[bundleID, default: Lane()]
+      let superseded = lane.pending?.waiter
+      let start = !lane.inFlight
+      lane.pending = pending
+      lane.inFlight = true
+      lanes[bundleID] = lane
+      return (superseded, start)
+    }
+
+    superseded?.resume(returning: .superseded)
+    if start {
+      Task { await self.drain(bundleID) }
+    }
+  }
+
+  /// sends the app's pending value until none is left - one drain per app at a time
+  private func drain(_ bundleID: String) async {
+    while true {
+      if let delay = lock.withLock({ delayBeforeSend(bundleID) }) {
+        try? await clock.sleep(for: delay)
+      }
+
+      // take the latest value after the wait so anything that arrived during it is included
+      let next: Pending? = lock.withLock {
+        guard let pending = lanes[bundleID]?.pending else {
+          lanes[bundleID]?.inFlight = false
+          return nil
+        }
+        lanes[bundleID]?.pending = nil
+        lanes[bundleID]?.lastSent = clock.now
+        delivered += 1
+        return pending
+      }
+      guard let next else { return }
+
+      do {
+        try await send(bundleID, next.volume)
+        next.waiter?.resume(returning: .sent)
+      } catch {
+        os_log(
+          .error,
+          log: log,
+          "Failed to send volume for %{public}@: %{public}@",
+          bundleID,
+          error.localizedDescription
+        )
+        next.waiter?.resume(throwing: error)
+      }
+    }
+  }
+
+  /// caller holds the lock - time left until the rate cap allows the next send
+  private func delayBeforeSend(_ bundleID: String) -> Duration? {
+    guard let minimumInterval, let lastSent = lanes[bundleID]?.lastSent else { return nil }
+    let elapsed = lastSent.duration(to: clock.now)
+    return elapsed < minimumInterval ? minimumInterval - elapsed : nil
+  }
+}
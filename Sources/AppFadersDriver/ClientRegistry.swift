@@ -0,0 +1,600 @@
+import AppFadersIPC
+import AppFadersVolumeTable
+import CoreAudio
+import Foundation
+import os.log
+import Synchronization
+
+// MARK: - Logging
+
+private let log = OSLog(subsystem: "com.fbreidenbach.appfaders.driver", category: "ClientRegistry")
+
+// MARK: - Client Processing
+
+/// what the IO thread does with a client's buffer this cycle
+enum ClientProcessing: Equatable {
+  /// buffer is all zeros - nothing downstream needs to look at it
+  case silent
+  /// unity gain - buffer is left untouched
+  case bypass
+  /// zero gain - buffer is cleared, no kernel runs
+  case mute
+  /// anything else - gain kernel runs
+  case process
+
+  /// classify a gain value
+  @inline(__always)
+  static func classify(gain: Float) -> ClientProcessing {
+    if gain == 1.0 {
+      return .bypass
+    }
+    if gain <= 0.0 {
+      return .mute
+    }
+    return .process
+  }
+}
+
+// MARK: - Client Slot
+
+/// one HAL client - identity is written off the IO thread, gain is read on it
+final class ClientSlot: @unchecked Sendable {
+  /// HAL client ID, 0 when the slot is free
+  let clientID = Atomic<UInt32>(0)
+
+  /// gain currently applied as Float bits - seeded at registration, then published by the IO thread
+  let gainBits = Atomic<UInt32>(Float(1.0).bitPattern)
+
+  /// latest requested gain as Float bits - the IO thread ramps toward it if a command was dropped
+  let targetBits = Atomic<UInt32>(Float(1.0).bitPattern)
+
+  /// scheduled ramps - IO thread only
+  let automation = GainAutomation()
+
+  /// IO cycle this client was last processed in - IO thread only
+  var lastProcessedCycle: UInt64 = 0
+
+  /// shared volume table key of bundleID, 0 when the slot is free
+  let volumeKey = Atomic<UInt64>(0)
+
+  /// table entry resolved for volumeKey, which is the helper's app ID - IO thread only
+  var volumeEntry: Int32 = -1
+  var volumeEntryKey: UInt64 = 0
+
+  /// value read from the table this cycle, NaN if none - IO thread only
+  var tableGain: Float = .nan
+
+  /// consecutive all-zero cycles, written by the IO thread only
+  let silentCycles = Atomic<UInt32>(ClientSlot.silenceHoldCycles)
+
+  /// recent input peak as Float bits, written by the IO thread only
+  let peakBits = Atomic<UInt32>(0)
+
+  /// peak and length of the window in progress - IO thread only
+  var windowPeak: Float = 0
+  var windowCycles: UInt32 = 0
+
+  /// cycles processed since the client joined - IO thread only
+  var processedCycles: UInt32 = 0
+  /// processed cycles since the last measurement - IO thread only
+  var unmeasuredCycles: UInt32 = 0
+  /// offset into the measurement interval, so bypassed clients don't all measure in one cycle
+  let measurePhase: UInt32
+
+  /// client the IO-thread-only measurement state belongs to - IO thread only
+  private var measuredClientID: UInt32 = 0
+
+  init(measurePhase: UInt32 = 0) {
+    self.measurePhase = measurePhase % Self.bypassMeasureInterval
+  }
+
+  // registration data - only touched under the registry lock
+  var processID: pid_t = 0
+  var bundleID: String = ""
+
+  var gain: Float {
+    Float(bitPattern: gainBits.load(ordering: .relaxed))
+  }
+
+  func setGain(_ gain: Float) {
+    gainBits.store(gain.bitPattern, ordering: .relaxed)
+  }
+
+  var targetGain: Float {
+    Float(bitPattern: targetBits.load(ordering: .relaxed))
+  }
+
+  func setTargetGain(_ gain: Float) {
+    targetBits.store(gain.bitPattern, ordering: .relaxed)
+  }
+
+  // MARK: - Silence Tracking
+
+  /// start the IO-thread-only measurement state over the first time the IO thread sees a new
+  /// client in the slot - a cycle still finishing the previous client can't race the reset
+  @inline(__always)
+  func claimMeasurement(clientID: UInt32) {
+    guard measuredClientID != clientID else { return }
+    measuredClientID = clientID
+    windowPeak = 0
+    windowCycles = 0
+    processedCycles = 0
+    unmeasuredCycles = 0
+  }
+
+  /// cycles of silence before a client stops counting as producing audio
+  /// ~340ms at 512 frames / 48kHz - long enough to ride over gaps between sounds
+  static let silenceHoldCycles: UInt32 = 32
+
+  /// cycles a recent peak covers - ~170ms at 512 frames / 48kHz, a meter's release
+  static let peakWindowCycles: UInt32 = 16
+
+  /// a bypassed client's samples are only read every this many cycles - divides both the hold
+  /// and the peak window, so activity timing stays the same as when measuring every cycle
+  static let bypassMeasureInterval: UInt32 = 8
+
+  /// record the silence result and input peak of one measurement (IO thread)
+  /// - Parameter cycles: IO cycles the measurement stands for, 1 unless earlier ones went unread
+  /// a louder peak shows at once; a quieter one only once the window it fell in is over
+  @inline(__always)
+  func recordCycle(silent: Bool, peak: Float = 0, cycles: UInt32 = 1) {
+    windowPeak = max(windowPeak, peak)
+    windowCycles += cycles
+    if windowCycles >= Self.peakWindowCycles {
+      peakBits.store(windowPeak.bitPattern, ordering: .relaxed)
+      windowPeak = 0
+      windowCycles = 0
+    } else if windowPeak > recentPeak {
+      peakBits.store(windowPeak.bitPattern, ordering: .relaxed)
+    }
+
+    if !silent {
+      silentCycles.store(0, ordering: .relaxed)
+      return
+    }
+    let held = silentCycles.load(ordering: .relaxed)
+    if held < Self.silenceHoldCycles {
+      silentCycles.store(min(held + cycles, Self.silenceHoldCycles), ordering: .relaxed)
+    }
+  }
+
+  /// hysteresis-filtered "is producing audio" flag
+  var isProducingAudio: Bool {
+    silentCycles.load(ordering: .relaxed) < Self.silenceHoldCycles
+  }
+
+  /// largest absolute input sample of the current or last peak window
+  var recentPeak: Float {
+    Float(bitPattern: peakBits.load(ordering: .relaxed))
+  }
+}
+
+// MARK: - ClientRegistry
+
+/// fixed table of HAL clients with per-client gain
+/// slots are preallocated so the IO thread never allocates or locks
+final class ClientRegistry: @unchecked Sendable {
+  static let shared = ClientRegistry()
+
+  /// maximum number of simultaneous HAL clients we apply gain to
+  static let capacity = 64
+
+  /// ramp length for volume changes that don't ask for one
+  static let defaultRampDuration: Float64 = 0.010
+
+  let slots: [ClientSlot]
+  private let lock = NSLock()
+
+  /// control plane -> IO thread gain commands
+  let commands = CommandQueue<GainCommand>(capacity: 256)
+
+  /// sample time of the cycle the IO thread is rendering, as Float64 bits
+  private let cycleSampleTimeBits = Atomic<UInt64>(0)
+
+  /// shared volume table generation the IO thread last applied - IO thread only
+  private var volumeTableGeneration: UInt64 = 0
+
+  /// mapping that generation and the slots' entries belong to - IO thread only
+  private var volumeTableMapping: OpaquePointer?
+
+  /// a client joined since the last table pass - it needs its entry looked up
+  private let volumeTableRescan = Atomic<Bool>(true)
+
+  init() {
+    slots = (0 ..< Self.capacity).map { ClientSlot(measurePhase: UInt32($0)) }
+  }
+
+  // MARK: - Registration
+
+  /// register a client - called from AddDeviceClient, not the IO thread
+  @discardableResult
+  func addClient(clientID: UInt32, processID: pid_t, bundleID: String, gain: Float) -> Bool {
+    lock.lock()
+    defer { lock.unlock() }
+
+    guard let slot = slots.first(where: { $0.clientID.load(ordering: .relaxed) == 0 }) else {
+      os_log(.error, log: log, "no free slot for client %u (%{public}@)", clientID, bundleID)
+      return false
+    }
+
+    slot.processID = processID
+    slot.bundleID = bundleID
+    slot.setGain(gain)
+    slot.setTargetGain(gain)
+    slot.silentCycles.store(ClientSlot.silenceHoldCycles, ordering: .relaxed)
+    slot.peakBits.store(0, ordering: .relaxed)
+    slot.volumeKey.store(AFVolumeTable_Key(bundleID), ordering: .relaxed)
+    // publish last so the IO thread never sees a half-filled slot
+    slot.clientID.store(clientID, ordering: .releasing)
+
+    volumeTableRescan.store(true, ordering: .releasing)
+    os_log(.info, log: log, "client %u added: pid=%d %{public}@", clientID, processID, bundleID)
+    return true
+  }
+
+  /// unregister a client - called from RemoveDeviceClient
+  func removeClient(clientID: UInt32) {
+    lock.lock()
+    defer { lock.unlock() }
+
+    guard let slot = activeSlot(for: clientID) else { return }
+    slot.clientID.store(0, ordering: .releasing)
+    slot.bundleID = ""
+    slot.processID = 0
+    slot.volumeKey.store(0, ordering: .relaxed)
+    slot.setGain(1.0)
+    slot.setTargetGain(1.0)
+
+    os_log(.info, log: log, "client %u removed", clientID)
+  }
+
+  /// move a client to the app that owns its process - its volume follows that app from the
+  /// IO thread's next table pass
+  /// called off the IO thread once ProcessResolver has an answer; a client that left
+  /// meanwhile is ignored
+  func setOwner(clientID: UInt32, bundleID: String) {
+    lock.lock()
+    defer { lock.unlock() }
+
+    guard let slot = activeSlot(for: clientID), slot.bundleID != bundleID else { return }
+    let reported = slot.bundleID
+    slot.bundleID = bundleID
+    slot.volumeKey.store(AFVolumeTable_Key(bundleID), ordering: .relaxed)
+    volumeTableRescan.store(true, ordering: .releasing)
+    os_log(
+      .info,
+      log: log,
+      "client %u (%{public}@) belongs to %{public}@",
+      clientID,
+      reported,
+      bundleID
+    )
+  }
+
+  /// push new volumes into every registered slot (bundleID -> gain, missing means unity)
+  /// changed gains ramp over defaultRampDuration starting at the next cycle
+  /// - Parameter volumeTable: once the helper's live table is mapped, apps it has an entry for
+  ///   are left to applyVolumeTable - the table carries a batch's ramp, a push of the same
+  ///   change would retarget the client first and the shared ramp would never run
+  func applyVolumes(
+    _ volumes: [String: Float],
+    sampleRate: Float64,
+    deferringTo volumeTable: SharedVolumeTable? = nil
+  ) {
+    let rampFrames = Int(Self.defaultRampDuration * sampleRate)
+    let table = volumeTable.flatMap { $0.isLive ? $0.table : nil }
+
+    lock.lock()
+    defer { lock.unlock() }
+
+    for (index, slot) in slots.enumerated() {
+      let clientID = slot.clientID.load(ordering: .relaxed)
+      let gain = volumes[slot.bundleID] ?? 1.0
+      guard clientID != 0, gain != slot.targetGain else { continue }
+      if let table, AFVolumeTable_Find(table, slot.volumeKey.load(ordering: .relaxed)) >= 0 {
+        continue
+      }
+      enqueue(
+        slot: slot,
+        index: index,
+        clientID: clientID,
+        gain: gain,
+        rampFrames: rampFrames,
+        at: GainCommand.immediate
+      )
+    }
+  }
+
+  /// schedule a ramp for every client of an app, starting at a device sample time
+  /// passing the same sample time for several apps gives fades that line up to the frame
+  /// returns the number of clients the ramp was queued for
+  @discardableResult
+  func scheduleRamp(
+    bundleID: String,
+    to gain: Float,
+    rampFrames: Int,
+    at sampleTime: Float64 = GainCommand.immediate
+  ) -> Int {
+    lock.lock()
+    defer { lock.unlock() }
+
+    var scheduled = 0
+    for (index, slot) in slots.enumerated() where slot.bundleID == bundleID {
+      let clientID = slot.clientID.load(ordering: .relaxed)
+      guard clientID != 0 else { continue }
+      let queued = enqueue(
+        slot: slot,
+        index: index,
+        clientID: clientID,
+        gain: gain,
+        rampFrames: rampFrames,
+        at: sampleTime
+      )
+      if queued {
+        scheduled += 1
+      }
+    }
+    return scheduled
+  }
+
+  /// caller holds the lock
+  @discardableResult
+  private func enqueue(
+    slot: ClientSlot,
+    index: Int,
+    clientID: UInt32,
+    gain: Float,
+    rampFrames: Int,
+    at sampleTime: Float64
+  ) -> Bool {
+    // the target is set even if the queue is full so the IO thread still converges on it
+    slot.setTargetGain(gain)
+    let command = GainCommand(
+      slotIndex: index,
+      clientID: clientID,
+      targetGain: gain,
+      rampFrames: max(rampFrames, 0),
+      startSampleTime: sampleTime
+    )
+    guard commands.enqueue(command) else {
+      os_log(.error, log: log, "gain command queue full, client %u will catch up", clientID)
+      return false
+    }
+    return true
+  }
+
+  /// sample time of the most recent IO cycle - base for scheduling ramps ahead of the IO thread
+  var currentSampleTime: Float64 {
+    Float64(bitPattern: cycleSampleTimeBits.load(ordering: .relaxed))
+  }
+
+  /// per-app activity for the host - clients are folded into the app that owns them, which is
+  /// producing if any of its clients is and peaks at the loudest one
+  /// clients without a bundle ID are left out, the host couldn't name them
+  func activity() -> [AppActivity] {
+    lock.lock()
+    defer { lock.unlock() }
+
+    var apps: [UInt64: AppActivity] = [:]
+    for slot in slots where slot.clientID.load(ordering: .relaxed) != 0 && !slot.bundleID.isEmpty {
+      let key = slot.volumeKey.load(ordering: .relaxed)
+      let known = apps[key]
+      apps[key] = AppActivity(
+        key: key,
+        isProducing: slot.isProducingAudio || known?.isProducing == true,
+        peak: max(slot.recentPeak, known?.peak ?? 0)
+      )
+    }
+    return apps.values.sorted { $0.key < $1.key }
+  }
+
+  // MARK: - IO Path
+
+  /// find the slot for a client - lock-free linear scan over preallocated slots
+  @inline(__always)
+  func activeSlot(for clientID: UInt32) -> ClientSlot? {
+    guard clientID != 0 else { return nil }
+    for slot in slots where slot.clientID.load(ordering: .acquiring) == clientID {
+      return slot
+    }
+    return nil
+  }
+
+  /// hand queued gain commands to their slots' schedules
+  /// called once per cycle from BeginIOOperation, before any client is processed
+  /// this must be real-time safe
+  func drainCommands(sampleTime: Float64) {
+    cycleSampleTimeBits.store(sampleTime.bitPattern, ordering: .relaxed)
+
+    while let command = commands.dequeue() {
+      let slot = slots[command.slotIndex]
+      // client left (or the slot was reused) since the command was queued
+      guard slot.clientID.load(ordering: .acquiring) == command.clientID else { continue }
+      slot.automation.claim(clientID: command.clientID, gain: slot.gain)
+      // a full schedule drops the command - targetBits still brings the gain in line
+      slot.automation.schedule(command)
+    }
+  }
+
+  /// pull volumes the helper published in shared memory into every registered slot
+  /// only runs when the table's generation moved (or a client joined); changed gains ramp from
+  /// the start of this cycle over the batch's own ramp if it set one, else over rampFrames -
+  /// every client of a batch gets the same ramp, so a scene moves all apps together
+  /// called once per cycle from BeginIOOperation, after drainCommands
+  /// this must be real-time safe
+  func applyVolumeTable(_ volumeTable: SharedVolumeTable, rampFrames: Int, sampleRate: Float64) {
+    guard let table = volumeTable.table else { return }
+
+    var rescan = volumeTableRescan.exchange(false, ordering: .acquiring)
+    // the snapshot gave way to the live region - entry indexes and generations start over
+    if table != volumeTableMapping {
+      volumeTableMapping = table
+      for slot in slots {
+        slot.volumeEntry = -1
+      }
+      rescan = true
+    }
+
+    let generation = AFVolumeTable_Generation(table)
+    guard rescan || generation != volumeTableGeneration else { return }
+
+    // read every client's value first, apply only if no batch was written meanwhile -
+    // a batch (scene recall, restore) lands in one cycle or not at all
+    let batch = AFVolumeTable_BatchSequence(table)
+    var complete = batch & 1 == 0
+    var rampMilliseconds: UInt32 = 0
+    if complete {
+      rampMilliseconds = AFVolumeTable_Ramp(table)
+      for slot in slots {
+        slot.tableGain = .nan
+        guard slot.clientID.load(ordering: .acquiring) != 0 else { continue }
+
+        let key = slot.volumeKey.load(ordering: .relaxed)
+        if slot.volumeEntryKey != key || slot.volumeEntry < 0 {
+          slot.volumeEntry = AFVolumeTable_Find(table, key)
+          slot.volumeEntryKey = key
+        }
+        // the helper hasn't seen this app - keep whatever gain it has
+        guard slot.volumeEntry >= 0 else { continue }
+
+        guard let gain = volumeTable.volume(at: slot.volumeEntry, in: table) else {
+          // writer kept the entry busy - pick it up next cycle
+          complete = false
+          break
+        }
+        slot.tableGain = gain
+      }
+      complete = complete && AFVolumeTable_BatchSequence(table) == batch
+    }
+
+    guard complete else {
+      volumeTableRescan.store(true, ordering: .relaxed)
+      return
+    }
+    volumeTableGeneration = generation
+
+    let frames = rampMilliseconds == 0
+      ? rampFrames
+      : Int(Float64(rampMilliseconds) * sampleRate / 1000)
+    for index in slots.indices {
+      let slot = slots[index]
+      let gain = slot.tableGain
+      let clientID = slot.clientID.load(ordering: .acquiring)
+      guard clientID != 0, !gain.isNaN, gain != slot.targetGain else { continue }
+
+      slot.setTargetGain(gain)
+      slot.automation.claim(clientID: clientID, gain: slot.gain)
+      slot.automation.schedule(GainCommand(
+        slotIndex: index,
+        clientID: clientID,
+        targetGain: gain,
+        rampFrames: max(frames, 0),
+        startSampleTime: GainCommand.immediate
+      ))
+    }
+  }
+
+  /// apply the client's gain to its buffer in place (ProcessOutput)
+  /// scheduled ramps start at their exact frame within the buffer
+  /// unknown clients are treated as unity gain
+  /// this must be real-time safe
+  @discardableResult
+  func process(
+    clientID: UInt32,
+    buffer: UnsafeMutablePointer<Float>,
+    frameCount: Int,
+    channelCount: Int,
+    sampleTime: Float64 = 0,
+    cycleCounter: UInt64 = 0
+  ) -> ClientProcessing {
+    guard let slot = activeSlot(for: clientID) else {
+      return .bypass
+    }
+    slot.lastProcessedCycle = cycleCounter
+
+    let automation = slot.automation
+    automation.claim(clientID: clientID, gain: slot.gain)
+    slot.claimMeasurement(clientID: clientID)
+
+    // nothing pending but the gain is off target - a command was dropped, catch up
+    let target = slot.targetGain
+    if automation.isIdle, automation.gain != target {
+      automation.beginRamp(to: target, frames: GainAutomation.fallbackRampFrames)
+    }
+
+    // a settled unity client reads no samples - its activity is measured every
+    // bypassMeasureInterval cycles, and that result stands for the cycles in between
+    // (the first cycle is always read, so a new client shows up at once)
+    let cycle = slot.processedCycles
+    slot.processedCycles &+= 1
+    if cycle > 0, automation.isIdle, automation.gain == 1.0,
+       cycle % ClientSlot.bypassMeasureInterval != slot.measurePhase
+    {
+      slot.unmeasuredCycles += 1
+      return .bypass
+    }
+
+    // zeros stay zeros whatever the gain - automation still advances, kernels are skipped
+    let sampleCount = frameCount * channelCount
+    let silent = DSPKernels.isSilent(buffer, sampleCount: sampleCount)
+    // measured before gain, so a muted app still shows it is playing
+    let peak = silent ? 0 : DSPKernels.peak(buffer, sampleCount: sampleCount)
+    slot.recordCycle(silent: silent, peak: peak, cycles: slot.unmeasuredCycles + 1)
+    slot.unmeasuredCycles = 0
+
+    let processing = automation.render(
+      buffer,
+      frameCount: frameCount,
+      channelCount: channelCount,
+      sampleTime: sampleTime,
+      silent: silent
+    )
+    slot.setGain(automation.gain)
+    return processing
+  }
+
+  /// end-of-cycle bookkeeping, once per cycle from the WriteMix EndIOOperation
+  /// clients that sent nothing this cycle count as silent so they age out of the producing set
+  /// this must be real-time safe
+  func finishCycle(counter: UInt64) {
+    for slot in slots {
+      let clientID = slot.clientID.load(ordering: .acquiring)
+      guard clientID != 0, slot.lastProcessedCycle != counter else { continue }
+      slot.claimMeasurement(clientID: clientID)
+      slot.recordCycle(silent: true)
+    }
+  }
+}
+
+// MARK: - C Interface Exports
+
+/// called from PlugInInterface.c AddDeviceClient()
+@_cdecl("AppFadersDriver_AddDeviceClient")
+public func driverAddDeviceClient(
+  deviceID: AudioObjectID,
+  clientID: UInt32,
+  processID: pid_t,
+  bundleID: CFString?
+) -> OSStatus {
+  let bundle = (bundleID as String?) ?? ""
+  ClientRegistry.shared.addClient(
+    clientID: clientID,
+    processID: processID,
+    bundleID: bundle,
+    gain: HelperBridge.shared.getVolume(for: bundle)
+  )
+  // browser and Electron helpers report their own bundle ID, or none - once the owning app is
+  // known the client follows that app's volume instead
+  ProcessResolver.shared.resolve(processID) { owner in
+    guard let owner else { return }
+    ClientRegistry.shared.setOwner(clientID: clientID, bundleID: owner)
+  }
+  return noErr
+}
+
+/// called from PlugInInterface.c RemoveDeviceClient()
+@_cdecl("AppFadersDriver_RemoveDeviceClient")
+public func driverRemoveDeviceClient(deviceID: AudioObjectID, clientID: UInt32) -> OSStatus {
+  ClientRegistry.shared.removeClient(clientID: clientID)
+  return noErr
+}
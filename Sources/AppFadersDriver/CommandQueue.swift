@@ -0,0 +1,91 @@
+import Synchronization
+
+// MARK: - Command Queue
+
+/// bounded lock-free multi-producer single-consumer queue
+/// producers are control-plane threads (XPC callbacks, HAL property calls), the consumer
+/// is the IO thread - cells are preallocated so neither side allocates after init
+///
+/// classic sequence-numbered ring: a cell is writable when its sequence equals the enqueue
+/// position and readable when it equals position + 1
+final class CommandQueue<Element>: @unchecked Sendable {
+  private final class Cell: @unchecked Sendable {
+    let sequence: Atomic<Int>
+    var element: Element?
+
+    init(sequence: Int) {
+      self.sequence = Atomic(sequence)
+    }
+  }
+
+  private let cells: [Cell]
+  private let mask: Int
+  private let enqueuePosition = Atomic<Int>(0)
+
+  // consumer-owned
+  private var dequeuePosition = 0
+
+  /// capacity is rounded up to a power of two
+  init(capacity: Int) {
+    var size = 1
+    while size < max(capacity, 2) {
+      size <<= 1
+    }
+    mask = size - 1
+    cells = (0 ..< size).map { Cell(sequence: $0) }
+  }
+
+  var capacity: Int {
+    mask + 1
+  }
+
+  /// enqueue from any thread - returns false if the queue is full
+  @discardableResult
+  func enqueue(_ element: Element) -> Bool {
+    var position = enqueuePosition.load(ordering: .relaxed)
+
+    while true {
+      let cell = cells[position & mask]
+      let sequence = cell.sequence.load(ordering: .acquiring)
+      let difference = sequence - position
+
+      if difference == 0 {
+        // cell is free for this position - try to claim it
+        let (exchanged, original) = enqueuePosition.compareExchange(
+          expected: position,
+          desired: position + 1,
+          ordering: .relaxed
+        )
+        if exchanged {
+          cell.element = element
+          cell.sequence.store(position + 1, ordering: .releasing)
+          return true
+        }
+        position = original
+      } else if difference < 0 {
+        // consumer hasn't freed this cell yet - full
+        return false
+      } else {
+        // another producer claimed it, reload
+        position = enqueuePosition.load(ordering: .relaxed)
+      }
+    }
+  }
+
+  /// dequeue on the consumer thread only - returns nil when empty
+  /// this must be real-time safe
+  func dequeue() -> Element? {
+    let cell = cells[dequeuePosition & mask]
+    let sequence = cell.sequence.load(ordering: .acquiring)
+
+    guard sequence == dequeuePosition + 1 else {
+      return nil
+    }
+
+    let element = cell.element
+    // hand the cell back to producers one lap ahead
+    cell.sequence.store(dequeuePosition + mask + 1, ordering: .releasing)
+    dequeuePosition += 1
+    return element
+  }
+}
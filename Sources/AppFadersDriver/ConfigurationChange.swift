@@ -0,0 +1,188 @@
+import AppFadersDriverBridge
+import CoreAudio
+import Foundation
+import os.log
+import Synchronization
+
+// MARK: - Logging
+
+private let log = OSLog(
+  subsystem: "com.fbreidenbach.appfaders.driver",
+  category: "ConfigurationChange"
+)
+
+// MARK: - Rate Change Timing
+
+/// host times of the last format change, 0 where a stage hasn't happened yet
+struct RateChangeTiming: Equatable {
+  var requested: UInt64
+  var applied: UInt64
+  var firstCycle: UInt64
+
+  /// request -> Perform, in milliseconds
+  var requestToApply: Double? {
+    applied >= requested && requested != 0 ? hostTicksToMilliseconds(applied - requested) : nil
+  }
+
+  /// request -> first IO cycle in the new format, in milliseconds
+  var requestToAudio: Double? {
+    firstCycle >= requested && requested != 0 && firstCycle != 0
+      ? hostTicksToMilliseconds(firstCycle - requested)
+      : nil
+  }
+}
+
+private let hostTimebase: mach_timebase_info_data_t = {
+  var info = mach_timebase_info_data_t()
+  mach_timebase_info(&info)
+  return info
+}()
+
+private func hostTicksToMilliseconds(_ ticks: UInt64) -> Double {
+  Double(ticks) * Double(hostTimebase.numer) / Double(hostTimebase.denom) / 1_000_000
+}
+
+// MARK: - Configuration Change
+
+/// stream format changes - rate, sample type, channels or layout - follow the HAL's
+/// configuration-change protocol:
+/// property set -> request (here) -> HAL stops IO -> Perform applies -> HAL restarts IO
+/// per-rate resources are preallocated in RateProfile and kernels are static, so applying is a
+/// pointer swap
+final class ConfigurationChange: @unchecked Sendable {
+  static let shared = ConfigurationChange()
+
+  private let lock = NSLock()
+  private var pendingFormat: AudioStreamBasicDescription?
+  /// action of the pending request - the host hands it back to Perform or Abort
+  private var pendingAction: UInt64 = 0
+  private var lastAction: UInt64 = 0
+
+  // timing for the last change - firstCycle is stamped on the IO thread
+  private let requestedHostTime = Atomic<UInt64>(0)
+  private let appliedHostTime = Atomic<UInt64>(0)
+  private let firstCycleHostTime = Atomic<UInt64>(0)
+  private let awaitingFirstCycle = Atomic<Bool>(false)
+
+  private init() {}
+
+  // MARK: - Request
+
+  /// queue a new stream format and ask the host to schedule the change
+  /// the format must already be validated; without a host (before Initialize) it applies directly
+  /// a newer request replaces one the host hasn't performed yet
+  func requestFormat(
+    _ format: AudioStreamBasicDescription,
+    deviceID: AudioObjectID = ObjectID.device
+  ) -> OSStatus {
+    lock.lock()
+    lastAction += 1
+    let action = lastAction
+    pendingFormat = format
+    pendingAction = action
+    lock.unlock()
+
+    requestedHostTime.store(mach_absolute_time(), ordering: .relaxed)
+    firstCycleHostTime.store(0, ordering: .relaxed)
+
+    let status = AppFadersDriver_RequestConfigurationChange(deviceID, action)
+    if status == kAudioHardwareNotRunningError {
+      return perform(action: action)
+    }
+    if status != noErr {
+      os_log(.error, log: log, "RequestDeviceConfigurationChange failed: %d", status)
+      abort(action: action)
+    } else {
+      os_log(.info, log: log, "requested format change to %f Hz, %u ch", format.mSampleRate,
+             format.mChannelsPerFrame)
+    }
+    return status
+  }
+
+  // MARK: - Perform / Abort
+
+  /// PerformDeviceConfigurationChange - IO is stopped, swap everything to the new format
+  func perform(action: UInt64) -> OSStatus {
+    lock.lock()
+    let format = pendingAction == action ? pendingFormat : nil
+    if format != nil {
+      pendingFormat = nil
+      pendingAction = 0
+    }
+    lock.unlock()
+
+    guard let format else {
+      os_log(.error, log: log, "perform for action %llu with no matching request", action)
+      return noErr
+    }
+
+    // every check that can fail runs before anything is swapped, so a rejected format leaves
+    // the engine and the stream on the old one
+    guard PassthroughEngine.shared.hasProfile(sampleRate: format.mSampleRate) else {
+      os_log(.error, log: log, "no profile for %f Hz", format.mSampleRate)
+      return kAudioDeviceUnsupportedFormatError
+    }
+    guard VirtualStream.shared.applyFormat(format) else {
+      os_log(.error, log: log, "no IO kernel for %u ch, %u bit, flags 0x%x",
+             format.mChannelsPerFrame, format.mBitsPerChannel, format.mFormatFlags)
+      return kAudioDeviceUnsupportedFormatError
+    }
+    _ = PassthroughEngine.shared.selectProfile(sampleRate: format.mSampleRate)
+    VirtualDevice.shared.setSampleRate(format.mSampleRate)
+
+    appliedHostTime.store(mach_absolute_time(), ordering: .relaxed)
+    awaitingFirstCycle.store(true, ordering: .releasing)
+
+    if let elapsed = lastChangeTiming.requestToApply {
+      os_log(.info, log: log, "format change to %f Hz applied %.2f ms after request",
+             format.mSampleRate, elapsed)
+    }
+    return noErr
+  }
+
+  /// AbortDeviceConfigurationChange - the host dropped the request
+  func abort(action: UInt64) {
+    lock.lock()
+    if pendingAction == action {
+      pendingFormat = nil
+      pendingAction = 0
+    }
+    lock.unlock()
+    os_log(.info, log: log, "format change %llu aborted", action)
+  }
+
+  // MARK: - Timing
+
+  /// stamp the first IO cycle after a change - called once per cycle
+  /// this must be real-time safe
+  @inline(__always)
+  func noteCycle(hostTime: UInt64) {
+    guard awaitingFirstCycle.load(ordering: .relaxed),
+          awaitingFirstCycle.exchange(false, ordering: .acquiring)
+    else { return }
+    firstCycleHostTime.store(hostTime, ordering: .relaxed)
+  }
+
+  var lastChangeTiming: RateChangeTiming {
+    RateChangeTiming(
+      requested: requestedHostTime.load(ordering: .relaxed),
+      applied: appliedHostTime.load(ordering: .relaxed),
+      firstCycle: firstCycleHostTime.load(ordering: .relaxed)
+    )
+  }
+}
+
+// MARK: - C Interface Exports
+
+/// called from PlugInInterface.c PerformDeviceConfigurationChange()
+@_cdecl("AppFadersDriver_PerformConfigurationChange")
+public func driverPerformConfigurationChange(deviceID: AudioObjectID, action: UInt64) -> OSStatus {
+  ConfigurationChange.shared.perform(action: action)
+}
+
+/// called from PlugInInterface.c AbortDeviceConfigurationChange()
+@_cdecl("AppFadersDriver_AbortConfigurationChange")
+public func driverAbortConfigurationChange(deviceID: AudioObjectID, action: UInt64) -> OSStatus {
+  ConfigurationChange.shared.abort(action: action)
+  return noErr
+}
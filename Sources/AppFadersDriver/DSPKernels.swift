@@ -0,0 +1,48 @@
+import AppFadersDriverBridge
+
+// MARK: - DSP Kernels
+
+/// swift front end for the runtime-dispatched kernels in DSPKernels.c
+/// the active table is bound once in AppFadersDriver_Create, so these are a single indirect call
+enum DSPKernels {
+  /// name of the ISA variant currently bound (scalar, sse2, avx2, avx512, neon)
+  static var activeVariant: String {
+    String(cString: AFKernels_Active().pointee.name)
+  }
+
+  /// buffer[i] *= gain
+  @inline(__always)
+  static func applyGain(_ buffer: UnsafeMutablePointer<Float>, sampleCount: Int, gain: Float) {
+    AFKernels_Active().pointee.applyGain!(buffer, UInt32(sampleCount), gain)
+  }
+
+  /// per-frame linear gain ramp starting at startGain and advancing gainStep per frame
+  @inline(__always)
+  static func applyGainRamp(
+    _ buffer: UnsafeMutablePointer<Float>,
+    frameCount: Int,
+    channelCount: Int,
+    startGain: Float,
+    gainStep: Float
+  ) {
+    AFKernels_Active().pointee.applyGainRamp!(
+      buffer,
+      UInt32(frameCount),
+      UInt32(channelCount),
+      startGain,
+      gainStep
+    )
+  }
+
+  /// max absolute sample value
+  @inline(__always)
+  static func peak(_ buffer: UnsafePointer<Float>, sampleCount: Int) -> Float {
+    AFKernels_Active().pointee.peak!(buffer, UInt32(sampleCount))
+  }
+
+  /// true if the buffer holds only zeros (either sign)
+  @inline(__always)
+  static func isSilent(_ buffer: UnsafePointer<Float>, sampleCount: Int) -> Bool {
+    AFKernels_Active().pointee.isSilent!(buffer, UInt32(sampleCount))
+  }
+}
@@ -0,0 +1,199 @@
+import Foundation
+
+// MARK: - Gain Command
+
+/// one scheduled gain change, sent from the control plane to the IO thread
+/// "ramp the client in slot S to targetGain over rampFrames starting at startSampleTime"
+struct GainCommand {
+  /// index into ClientRegistry.slots
+  var slotIndex: Int
+  /// client the command was issued for - stale commands for a reused slot are dropped
+  var clientID: UInt32
+  var targetGain: Float
+  /// 0 jumps straight to the target
+  var rampFrames: Int
+  /// device sample time of the first ramped frame, GainCommand.immediate for "next frame"
+  var startSampleTime: Float64
+
+  static let immediate = -Float64.infinity
+}
+
+// MARK: - Gain Automation
+
+/// per-slot automation state - owned by the IO thread, never touched off it
+/// pending commands live in a small preallocated array sorted by start time
+final class GainAutomation {
+  /// pending commands per client, enough for a fade out/in pair plus a few queued moves
+  static let scheduleCapacity = 8
+
+  /// ramp used to catch up when a command was dropped (queue or schedule full)
+  /// ~5ms at 48kHz - short enough to feel immediate, long enough not to click
+  static let fallbackRampFrames = 256
+
+  /// gain at the next frame to be rendered
+  private(set) var gain: Float = 1.0
+
+  private(set) var rampStep: Float = 0
+  private(set) var rampTarget: Float = 1.0
+  private(set) var rampFramesRemaining = 0
+
+  /// client this state belongs to - reset whenever the slot is reused
+  private(set) var ownerClientID: UInt32 = 0
+
+  private let pending: UnsafeMutablePointer<GainCommand>
+  private(set) var scheduledCount = 0
+
+  init() {
+    pending = .allocate(capacity: Self.scheduleCapacity)
+  }
+
+  deinit {
+    pending.deallocate()
+  }
+
+  /// nothing running and nothing scheduled
+  var isIdle: Bool {
+    rampFramesRemaining == 0 && scheduledCount == 0
+  }
+
+  /// earliest pending command
+  var nextCommand: GainCommand? {
+    scheduledCount > 0 ? pending[0] : nil
+  }
+
+  /// take ownership for a client, dropping state left over from a previous one
+  @inline(__always)
+  func claim(clientID: UInt32, gain: Float) {
+    guard ownerClientID != clientID else { return }
+    ownerClientID = clientID
+    self.gain = gain
+    rampFramesRemaining = 0
+    scheduledCount = 0
+  }
+
+  /// insert in start-time order, after any command with the same start
+  /// returns false when the schedule is full
+  @discardableResult
+  func schedule(_ command: GainCommand) -> Bool {
+    guard scheduledCount < Self.scheduleCapacity else { return false }
+
+    var index = scheduledCount
+    while index > 0, pending[index - 1].startSampleTime > command.startSampleTime {
+      pending[index] = pending[index - 1]
+      index -= 1
+    }
+    pending[index] = command
+    scheduledCount += 1
+    return true
+  }
+
+  /// drop the earliest pending command
+  @inline(__always)
+  func removeNextCommand() {
+    guard scheduledCount > 0 else { return }
+    scheduledCount -= 1
+    for index in 0 ..< scheduledCount {
+      pending[index] = pending[index + 1]
+    }
+  }
+
+  /// start a linear ramp from the current gain, interrupting any ramp in progress
+  @inline(__always)
+  func beginRamp(to target: Float, frames: Int) {
+    guard frames > 0, target != gain else {
+      gain = target
+      rampFramesRemaining = 0
+      return
+    }
+    rampTarget = target
+    rampStep = (target - gain) / Float(frames)
+    rampFramesRemaining = frames
+  }
+
+  /// move the ramp forward after rendering frames of it - lands exactly on the target
+  @inline(__always)
+  func advanceRamp(frames: Int) {
+    rampFramesRemaining -= frames
+    if rampFramesRemaining <= 0 {
+      rampFramesRemaining = 0
+      gain = rampTarget
+    } else {
+      gain += rampStep * Float(frames)
+    }
+  }
+
+  // MARK: - Rendering
+
+  /// apply this cycle's gain to the buffer, splitting at command start times and ramp ends
+  /// silent buffers advance the automation clock without touching samples
+  /// this must be real-time safe
+  func render(
+    _ buffer: UnsafeMutablePointer<Float>,
+    frameCount: Int,
+    channelCount: Int,
+    sampleTime: Float64,
+    silent: Bool
+  ) -> ClientProcessing {
+    var result: ClientProcessing?
+    var offset = 0
+
+    while offset < frameCount {
+      // start everything due at this frame - later starts override earlier ones
+      let frameTime = sampleTime + Float64(offset)
+      while let command = nextCommand, command.startSampleTime <= frameTime {
+        removeNextCommand()
+        beginRamp(to: command.targetGain, frames: command.rampFrames)
+      }
+
+      // segment runs to the next command start or the end of the ramp, whichever is first
+      var end = frameCount
+      if let command = nextCommand {
+        // start is strictly after frameTime, so this always moves forward
+        let startOffset = Int((command.startSampleTime - sampleTime).rounded(.up))
+        end = min(end, startOffset)
+      }
+      if rampFramesRemaining > 0 {
+        end = min(end, offset + rampFramesRemaining)
+      }
+
+      let segment = buffer + offset * channelCount
+      let frames = end - offset
+      let processing: ClientProcessing
+
+      if rampFramesRemaining > 0 {
+        processing = .process
+        if !silent {
+          DSPKernels.applyGainRamp(
+            segment,
+            frameCount: frames,
+            channelCount: channelCount,
+            startGain: gain,
+            gainStep: rampStep
+          )
+        }
+        advanceRamp(frames: frames)
+      } else {
+        processing = ClientProcessing.classify(gain: gain)
+        if !silent {
+          switch processing {
+          case .bypass, .silent:
+            break
+          case .mute:
+            segment.update(repeating: 0.0, count: frames * channelCount)
+          case .process:
+            DSPKernels.applyGain(segment, sampleCount: frames * channelCount, gain: gain)
+          }
+        }
+      }
+
+      // a split buffer that did different things per segment counts as processed
+      result = (result == nil || result == processing) ? processing : .process
+      offset = end
+    }
+
+    if silent {
+      return .silent
+    }
+    return result ?? ClientProcessing.classify(gain: gain)
+  }
+}
@@ -1,26 +1,36 @@
+import AppFadersIPC
 import Foundation
 import os.log
 
 private let log = OSLog(subsystem: "com.fbreidenbach.appfaders.driver", category: "HelperBridge")
-private let machServiceName = "com.fbreidenbach.appfaders.helper"
 
-/// Protocol for driver connections (read-only) - must match helper's definition
-@objc protocol AppFadersDriverProtocol {
-  func getVolume(bundleID: String, reply: @escaping (Float, NSError?) -> Void)
-  func getAllVolumes(reply: @escaping ([String: Float], NSError?) -> Void)
-}
-
-/// XPC client for driver-side communication with helper service
+/// client for driver-side communication with helper service
 /// Uses local cache for real-time audio safety - getVolume never blocks
 final class HelperBridge: @unchecked Sendable {
-  static let shared = HelperBridge()
+  static let shared = HelperBridge { XPCHelperTransport() }
+
+  /// first reconnect delay - doubles with every attempt the helper doesn't answer
+  static let initialReconnectDelay: TimeInterval = 0.25
+  static let maxReconnectDelay: TimeInterval = 30.0
 
   private let lock = NSLock()
-  private var connection: NSXPCConnection?
+  private let makeTransport: @Sendable () -> HelperTransport
+  private var transport: HelperTransport?
   private var volumeCache: [String: Float] = [:]
+  /// bundle IDs of the helper's app IDs - changes name each ID once, a snapshot names them all
+  private var appNames: [UInt32: String] = [:]
   private var isConnected = false
 
-  private init() {
+  // reconnect state - attempts reset once the helper answers
+  private var wantsConnection = false
+  private var reconnectScheduled = false
+  private var reconnectAttempts = 0
+
+  /// helper store generation volumeCache reflects - 0 asks for a full snapshot
+  private var syncedGeneration: UInt64 = 0
+
+  private init(transport: @escaping @Sendable () -> HelperTransport) {
+    makeTransport = transport
     os_log(.info, log: log, "HelperBridge initialized")
   }
 
@@ -29,71 +39,115 @@ final class HelperBridge: @unchecked Sendable {
   /// Establish connection to helper service
   func connect() {
     lock.lock()
-    defer { lock.unlock() }
 
-    guard connection == nil else {
+    wantsConnection = true
+    guard transport == nil else {
+      lock.unlock()
       os_log(.debug, log: log, "Already connected")
       return
     }
 
-    os_log(.info, log: log, "Connecting to helper: %{public}@", machServiceName)
-
-    let conn = NSXPCConnection(machServiceName: machServiceName)
-    conn.remoteObjectInterface = NSXPCInterface(with: AppFadersDriverProtocol.self)
+    os_log(.info, log: log, "Connecting to helper")
 
-    conn.invalidationHandler = { [weak self] in
-      os_log(.info, log: log, "XPC connection invalidated")
-      self?.handleDisconnect()
-    }
-
-    conn.interruptionHandler = { [weak self] in
-      os_log(.info, log: log, "XPC connection interrupted, will reconnect")
-      self?.handleDisconnect()
-      self?.scheduleReconnect()
+    // handlers of a transport that was already replaced must not tear down its successor
+    let transport = makeTransport()
+    let transportID = ObjectIdentifier(transport)
+    do {
+      // its first push is the initial cache fill, later pushes keep the cache current
+      try transport.start(
+        onChanges: { [weak self] changes, acknowledge in
+          self?.applyChanges(changes, since: nil)
+          // acknowledging releases the helper's next batch
+          acknowledge()
+        },
+        // lost also covers a helper that isn't installed or launched yet - keep trying
+        onDisconnect: { [weak self] in
+          os_log(.info, log: log, "Helper connection lost, will reconnect")
+          guard let self, handleDisconnect(transportID) else { return }
+          scheduleReconnect()
+        }
+      )
+    } catch {
+      lock.unlock()
+      os_log(.error, log: log, "Connecting failed: %{public}@", "\(error)")
+      scheduleReconnect()
+      return
     }
-
-    conn.resume()
-    connection = conn
+    self.transport = transport
     isConnected = true
+    lock.unlock()
+
+    os_log(.info, log: log, "Helper connection established")
 
-    os_log(.info, log: log, "XPC connection established")
+    // the helper creates the volume table at launch - once mapped, volumes bypass XPC entirely
+    // (until then the helper's on-disk snapshot stands in, so the first cycles are right)
+    SharedVolumeTable.shared.open()
 
-    // Defer initial cache refresh - XPC calls during driver init can block
+    // Defer the subscription - XPC calls during driver init can block
     DispatchQueue.global(qos: .utility).asyncAfter(deadline: .now() + 0.5) { [weak self] in
-      self?.refreshCacheAsync()
+      self?.subscribeAsync()
     }
   }
 
   /// Disconnect from helper service
   func disconnect() {
-    lock.lock()
-    defer { lock.unlock() }
-
-    connection?.invalidate()
-    connection = nil
-    isConnected = false
+    let closing = lock.withLock {
+      // cleared first so the disconnect handler doesn't reconnect
+      wantsConnection = false
+      let closing = transport
+      transport = nil
+      isConnected = false
+      return closing
+    }
+    closing?.close()
     os_log(.info, log: log, "Disconnected from helper")
   }
 
-  private func handleDisconnect() {
+  /// - Returns: false if the transport was already replaced or closed
+  private func handleDisconnect(_ transportID: ObjectIdentifier) -> Bool {
     lock.lock()
     defer { lock.unlock() }
-    connection = nil
+    guard let transport, ObjectIdentifier(transport) == transportID else { return false }
+    self.transport = nil
     isConnected = false
+    // a restarted helper numbers its changes from scratch - resync with a snapshot
+    syncedGeneration = 0
+    return true
+  }
+
+  /// delay before reconnect attempt n (0-based) - exponential, capped
+  static func reconnectDelay(attempt: Int) -> TimeInterval {
+    min(initialReconnectDelay * pow(2.0, Double(min(attempt, 16))), maxReconnectDelay)
   }
 
   private func scheduleReconnect() {
-    DispatchQueue.global().asyncAfter(deadline: .now() + 1.0) { [weak self] in
-      self?.connect()
+    lock.lock()
+    guard wantsConnection, !reconnectScheduled else {
+      lock.unlock()
+      return
+    }
+    reconnectScheduled = true
+    let delay = Self.reconnectDelay(attempt: reconnectAttempts)
+    reconnectAttempts += 1
+    lock.unlock()
+
+    os_log(.info, log: log, "Reconnecting in %.2f s", delay)
+    DispatchQueue.global().asyncAfter(deadline: .now() + delay) { [weak self] in
+      guard let self else { return }
+      lock.withLock { reconnectScheduled = false }
+      connect()
     }
   }
 
   // MARK: - Volume Access
 
-  /// Get volume for bundle ID - synchronous, returns from cache (never blocks)
+  /// Get volume for bundle ID - synchronous, returns from the shared table or cache (never blocks)
   /// - Parameter bundleID: application bundle identifier
   /// - Returns: volume level (defaults to 1.0 if not in cache)
   func getVolume(for bundleID: String) -> Float {
+    if let volume = SharedVolumeTable.shared.volume(for: bundleID) {
+      return volume
+    }
     lock.lock()
     let volume = volumeCache[bundleID] ?? 1.0
     lock.unlock()
@@ -105,39 +159,116 @@ final class HelperBridge: @unchecked Sendable {
     refreshCacheAsync()
   }
 
+  private func helperTransport(for operation: String) -> HelperTransport? {
+    guard let transport = lock.withLock({ transport }) else {
+      os_log(.debug, log: log, "Cannot %{public}@ - not connected", operation)
+      return nil
+    }
+    return transport
+  }
+
   private func refreshCacheAsync() {
-    lock.lock()
-    let conn = connection
-    lock.unlock()
+    guard let transport = helperTransport(for: "cache refresh") else { return }
 
-    guard let conn else {
-      os_log(.debug, log: log, "Cannot refresh cache - not connected")
-      return
+    let since = lock.withLock { syncedGeneration }
+    transport.send(.getVolumeChanges(since: since)) { [weak self] result in
+      switch result {
+      case let .success(.changes(changes)):
+        self?.applyChanges(changes, since: since)
+      case let .success(response):
+        os_log(.error, log: log, "getVolumeChanges failed: %{public}@", "\(response)")
+      case let .failure(error):
+        os_log(.error, log: log, "getVolumeChanges failed: %{public}@", "\(error)")
+      }
     }
+  }
 
-    guard let proxy = conn.remoteObjectProxyWithErrorHandler({ error in
-      os_log(
-        .error,
-        log: log,
-        "XPC error during cache refresh: %{public}@",
-        error.localizedDescription
-      )
-    }) as? AppFadersDriverProtocol else {
-      os_log(.error, log: log, "Failed to get remote object proxy")
-      return
-    }
+  /// ask the helper to push changes from here on - the first push carries what we missed
+  private func subscribeAsync() {
+    guard let transport = helperTransport(for: "subscribe") else { return }
 
-    proxy.getAllVolumes { [weak self] volumes, error in
-      if let error {
-        os_log(.error, log: log, "getAllVolumes failed: %{public}@", error.localizedDescription)
+    let since = lock.withLock { syncedGeneration }
+    transport.send(.subscribe(since: since)) { [weak self] result in
+      guard case .success(.done) = result else {
+        // a helper without push support - fall back to a one-off pull
+        os_log(.error, log: log, "subscribe failed: %{public}@", "\(result)")
+        self?.refreshCacheAsync()
         return
       }
+      self?.lock.withLock { self?.reconnectAttempts = 0 }
+      os_log(.info, log: log, "Subscribed to volume changes since generation %llu", since)
+    }
+  }
+
+  /// merge a pulled or pushed delta into the cache and hand it to the registry
+  /// - Parameter since: generation a pulled delta was computed from, nil for a push
+  private func applyChanges(_ changes: HelperChanges, since: UInt64?) {
+    let generation = changes.generation
+    let changed = changes.volumes
+    let removed = changes.removed
+    let isSnapshot = changes.isSnapshot
+    var unnamed = 0
+
+    // the helper answered, so its table exists even if connect() came too early to map it
+    SharedVolumeTable.shared.open()
+
+    lock.lock()
+    // pushes arrive in order; a pull that overlapped a newer push or pull is stale
+    let current = isSnapshot
+      ? generation >= syncedGeneration
+      : since.map { $0 == syncedGeneration } ?? (generation > syncedGeneration)
+    guard current else {
+      lock.unlock()
+      return
+    }
+    if isSnapshot {
+      appNames = changes.names
+      volumeCache.removeAll(keepingCapacity: true)
+    } else {
+      appNames.merge(changes.names) { _, new in new }
+    }
+    // app IDs only become bundle IDs here, where ClientRegistry's per-process clients are keyed
+    for (appID, volume) in changed {
+      guard let bundleID = appNames[appID] else {
+        unnamed += 1
+        continue
+      }
+      volumeCache[bundleID] = volume
+    }
+    for appID in removed {
+      guard let bundleID = appNames[appID] else {
+        unnamed += 1
+        continue
+      }
+      volumeCache.removeValue(forKey: bundleID)
+    }
+    // apps the helper couldn't number - they have no table entry, so this is their only path
+    volumeCache.merge(changes.volumesByBundleID) { _, new in new }
+    for bundleID in changes.removedBundleIDs {
+      volumeCache.removeValue(forKey: bundleID)
+    }
+    syncedGeneration = generation
+    reconnectAttempts = 0
+    let volumes = volumeCache
+    lock.unlock()
 
-      self?.lock.lock()
-      self?.volumeCache = volumes
-      self?.lock.unlock()
+    ClientRegistry.shared.applyVolumes(
+      volumes,
+      sampleRate: VirtualStream.shared.getSampleRate(),
+      deferringTo: SharedVolumeTable.shared
+    )
 
-      os_log(.debug, log: log, "Cache refreshed: %d entries", volumes.count)
+    os_log(
+      .debug,
+      log: log,
+      "Cache synced to generation %llu: %d changed, %d removed%{public}@",
+      generation,
+      changed.count,
+      removed.count,
+      isSnapshot ? " (snapshot)" : ""
+    )
+    if unnamed > 0 {
+      os_log(.error, log: log, "%d changes for app IDs the helper never named", unnamed)
     }
   }
 }
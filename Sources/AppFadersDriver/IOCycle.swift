@@ -0,0 +1,133 @@
+import AppFadersDriverBridge
+import CoreAudio
+import Foundation
+
+// MARK: - IO Cycle
+
+/// one HAL IO cycle - timing from AudioServerPlugInIOCycleInfo plus control state
+/// snapshotted once at the cycle's first BeginIOOperation
+struct IOCycle {
+  /// mIOCycleCounter - identical for every operation of one cycle
+  var counter: UInt64 = 0
+  var outputSampleTime: Float64 = 0
+  var outputHostTime: UInt64 = 0
+  var frameCount: Int = 0
+
+  // control state - every operation in the cycle sees the same values
+  /// channels of a ProcessOutput buffer - the virtual format's, which is always stereo
+  var channelCount: Int = IOCycle.virtualChannelCount
+  /// kernel for the physical format WriteMix delivers
+  var inputKernel: UnsafeRawPointer?
+
+  static let virtualChannelCount = Int(IOKernels.canonical.pointee.channelCount)
+}
+
+// MARK: - IO Cycle Coordinator
+
+/// runs per-cycle work once instead of once per client and operation
+/// the HAL brackets every operation with Begin/EndIOOperation; the first Begin of a new cycle
+/// counter opens the cycle, the WriteMix End closes it
+/// all state is owned by the IO thread
+final class IOCycleCoordinator: @unchecked Sendable {
+  static let shared = IOCycleCoordinator()
+
+  private let registry: ClientRegistry
+  private let engine: PassthroughEngine
+  private let volumeTable: SharedVolumeTable
+
+  /// cycle in progress - only meaningful while isInCycle
+  private(set) var current = IOCycle()
+  private(set) var isInCycle = false
+
+  init(
+    registry: ClientRegistry = .shared,
+    engine: PassthroughEngine = .shared,
+    volumeTable: SharedVolumeTable = .shared
+  ) {
+    self.registry = registry
+    self.engine = engine
+    self.volumeTable = volumeTable
+  }
+
+  /// BeginIOOperation - opens a cycle on the first operation with a new counter
+  /// this must be real-time safe
+  func beginOperation(
+    _ operationID: UInt32,
+    counter: UInt64,
+    outputSampleTime: Float64,
+    outputHostTime: UInt64,
+    frameCount: Int
+  ) {
+    if isInCycle {
+      guard counter != current.counter else { return }
+      // previous cycle never reached WriteMix (no client was mixing) - close it now
+      finishCycle()
+    }
+
+    current = IOCycle(
+      counter: counter,
+      outputSampleTime: outputSampleTime,
+      outputHostTime: outputHostTime,
+      frameCount: frameCount,
+      channelCount: IOCycle.virtualChannelCount,
+      inputKernel: engine.currentInputKernel
+    )
+    isInCycle = true
+
+    // control-plane commands land once, before any client of this cycle is processed
+    registry.drainCommands(sampleTime: outputSampleTime)
+    registry.applyVolumeTable(
+      volumeTable,
+      rampFrames: Int(ClientRegistry.defaultRampDuration * engine.profile.sampleRate),
+      sampleRate: engine.profile.sampleRate
+    )
+    ConfigurationChange.shared.noteCycle(hostTime: outputHostTime)
+  }
+
+  /// EndIOOperation - WriteMix is the last operation of a cycle
+  /// this must be real-time safe
+  func endOperation(_ operationID: UInt32) {
+    guard isInCycle, operationID == kAudioServerPlugInIOOperationWriteMix else { return }
+    finishCycle()
+  }
+
+  /// master-bus work that runs exactly once per cycle
+  private func finishCycle() {
+    registry.finishCycle(counter: current.counter)
+    isInCycle = false
+  }
+}
+
+// MARK: - C Interface Exports
+
+/// called from PlugInInterface.c BeginIOOperation()
+@_cdecl("AppFadersDriver_BeginIOOperation")
+public func driverBeginIOOperation(
+  deviceID: AudioObjectID,
+  clientID: UInt32,
+  operationID: UInt32,
+  ioBufferFrameSize: UInt32,
+  cycleCounter: UInt64,
+  outputSampleTime: Float64,
+  outputHostTime: UInt64
+) -> OSStatus {
+  IOCycleCoordinator.shared.beginOperation(
+    operationID,
+    counter: cycleCounter,
+    outputSampleTime: outputSampleTime,
+    outputHostTime: outputHostTime,
+    frameCount: Int(ioBufferFrameSize)
+  )
+  return noErr
+}
+
+/// called from PlugInInterface.c EndIOOperation()
+@_cdecl("AppFadersDriver_EndIOOperation")
+public func driverEndIOOperation(
+  deviceID: AudioObjectID,
+  clientID: UInt32,
+  operationID: UInt32
+) -> OSStatus {
+  IOCycleCoordinator.shared.endOperation(operationID)
+  return noErr
+}
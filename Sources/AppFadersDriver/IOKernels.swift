@@ -0,0 +1,81 @@
+import AppFadersDriverBridge
+import CoreAudio
+
+// MARK: - IO Kernels
+
+/// kAudioFormatFlagsNativeEndian - a conditional macro, not bridged to Swift
+private let nativeEndianFlag: AudioFormatFlags =
+  UInt16(1).bigEndian == 1 ? kAudioFormatFlagIsBigEndian : 0
+
+/// maps stream formats onto the specialized conversion kernels in IOKernels.c
+/// selection happens when the virtual format changes, never on the IO thread
+enum IOKernels {
+  /// specialized kernel for a stream format, nil if the format is outside the supported set
+  /// the whole description has to match: native-endian, packed, one frame per packet, and sizes
+  /// that agree with the kernel's - anything else would be read with the wrong stride
+  static func kernel(for format: AudioStreamBasicDescription) -> UnsafePointer<AFIOKernel>? {
+    guard format.mFormatID == kAudioFormatLinearPCM,
+          format.mFramesPerPacket == 1,
+          format.mFormatFlags & kAudioFormatFlagIsBigEndian == nativeEndianFlag,
+          format.mFormatFlags & kAudioFormatFlagIsPacked != 0
+    else {
+      return nil
+    }
+
+    let isFloat = format.mFormatFlags & kAudioFormatFlagIsFloat != 0
+    let isSignedInteger = format.mFormatFlags & kAudioFormatFlagIsSignedInteger != 0
+    let interleaved = format.mFormatFlags & kAudioFormatFlagIsNonInterleaved == 0
+
+    let sampleFormat: AFSampleFormat
+    switch (format.mBitsPerChannel, isFloat, isSignedInteger) {
+    case (32, true, false):
+      sampleFormat = AFSampleFormatFloat32
+    case (16, false, true):
+      sampleFormat = AFSampleFormatInt16
+    default:
+      return nil
+    }
+
+    guard let kernel = AFIOKernels_Select(sampleFormat, format.mChannelsPerFrame, interleaved),
+          format.mBytesPerFrame == kernel.pointee.bytesPerFrame,
+          format.mBytesPerPacket == kernel.pointee.bytesPerFrame
+    else {
+      return nil
+    }
+    return kernel
+  }
+
+  /// the stream description a kernel reads, at a sample rate - the inverse of kernel(for:)
+  static func format(of kernel: AFIOKernel, sampleRate: Float64) -> AudioStreamBasicDescription {
+    var flags = nativeEndianFlag | kAudioFormatFlagIsPacked
+    flags |= kernel.sampleFormat == AFSampleFormatFloat32
+      ? kAudioFormatFlagIsFloat
+      : kAudioFormatFlagIsSignedInteger
+    if !kernel.interleaved {
+      flags |= kAudioFormatFlagIsNonInterleaved
+    }
+    return AudioStreamBasicDescription(
+      mSampleRate: sampleRate,
+      mFormatID: kAudioFormatLinearPCM,
+      mFormatFlags: flags,
+      mBytesPerPacket: kernel.bytesPerFrame,
+      mFramesPerPacket: 1,
+      mBytesPerFrame: kernel.bytesPerFrame,
+      mChannelsPerFrame: kernel.channelCount,
+      mBitsPerChannel: kernel.sampleFormat == AFSampleFormatFloat32 ? 32 : 16,
+      mReserved: 0
+    )
+  }
+
+  /// every format a kernel is compiled for, at a sample rate
+  static func supportedFormats(sampleRate: Float64) -> [AudioStreamBasicDescription] {
+    (0 ..< AFIOKernels_Count()).map { index in
+      format(of: AFIOKernels_At(index).pointee, sampleRate: sampleRate)
+    }
+  }
+
+  /// kernel for the canonical ring layout (interleaved stereo float)
+  static var canonical: UnsafePointer<AFIOKernel> {
+    AFIOKernels_Select(AFSampleFormatFloat32, 2, true)
+  }
+}
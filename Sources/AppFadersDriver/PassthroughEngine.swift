@@ -1,3 +1,4 @@
+import AppFadersDriverBridge
 import AudioToolbox
 import CoreAudio
 import Foundation
@@ -13,18 +14,19 @@ private let log = OSLog(
 
 // MARK: - Missing CoreAudio Constants
 
-// HAL plug-in IO operation type - not bridged to Swift
-private let kAudioServerPlugInIOOperationWriteMix: UInt32 = 2
+// HAL plug-in IO operation types ('pout' and 'rite') - not bridged to Swift
+let kAudioServerPlugInIOOperationProcessOutput: UInt32 = 0x706F_7574
+let kAudioServerPlugInIOOperationWriteMix: UInt32 = 0x7269_7465
 
 // MARK: - Ring Buffer
 
 /// lock-free single-producer single-consumer ring buffer for audio samples
 /// pre-allocated to avoid runtime allocations
 final class AudioRingBuffer: @unchecked Sendable {
-  // buffer size in frames - must be power of 2 for efficient modulo
+  // buffer size in frames - fixed for the ring's lifetime, sized per sample rate by RateProfile
   // 8192 frames at 48kHz = ~170ms of buffer
-  private let capacity: Int = 8192
-  private let channelCount: Int = 2
+  let capacity: Int
+  let channelCount: Int = 2
 
   // pre-allocated buffer storage
   private var buffer: UnsafeMutablePointer<Float>
@@ -34,13 +36,29 @@ final class AudioRingBuffer: @unchecked Sendable {
   private let writeIndex: Atomic<Int>
   private let readIndex: Atomic<Int>
 
-  init() {
+  // write index the reader should jump to, -1 when no resync is pending
+  private let resyncIndex = Atomic<Int>(-1)
+
+  /// backlog above this is trimmed by the reader so clock drift can't build up latency
+  /// 4096 frames at 48kHz = ~85ms
+  let maxLatencyFrames: Int
+
+  let counters: IOPathCounters
+
+  init(
+    capacity: Int = 8192,
+    maxLatencyFrames: Int = 4096,
+    counters: IOPathCounters = IOPathCounters()
+  ) {
+    self.capacity = capacity
     bufferSampleCount = capacity * channelCount
     buffer = .allocate(capacity: bufferSampleCount)
     buffer.initialize(repeating: 0.0, count: bufferSampleCount)
 
     writeIndex = Atomic(0)
     readIndex = Atomic(0)
+    self.maxLatencyFrames = maxLatencyFrames
+    self.counters = counters
   }
 
   deinit {
@@ -51,52 +69,125 @@ final class AudioRingBuffer: @unchecked Sendable {
   /// write frames to buffer (called from virtual device IO thread)
   /// returns number of frames actually written
   func write(frames: UnsafePointer<Float>, frameCount: Int) -> Int {
-    let samplesToWrite = frameCount * channelCount
+    write(from: UnsafeRawPointer(frames), frameCount: frameCount, kernel: IOKernels.canonical)
+  }
+
+  /// convert frames from the client format straight into the ring
+  /// kernel is chosen when the stream format changes, so there is no format branching here
+  /// the first skipping frames of the source are left out (overlap with the previous cycle)
+  /// returns number of frames actually written
+  func write(
+    from source: UnsafeRawPointer,
+    frameCount: Int,
+    kernel: UnsafePointer<AFIOKernel>,
+    skipping skippedFrames: Int = 0
+  ) -> Int {
     let currentWrite = writeIndex.load(ordering: .relaxed)
-    let currentRead = readIndex.load(ordering: .acquiring)
+    let actualFrames = min(frameCount - skippedFrames, availableWriteFrames(at: currentWrite))
+    guard actualFrames > 0 else { return 0 }
+
+    // at most two contiguous runs: up to the end of storage, then from the start
+    let convert = kernel.pointee.toCanonical!
+    let startFrame = currentWrite / channelCount
+    let firstFrames = min(actualFrames, capacity - startFrame)
+    convert(
+      source,
+      UInt32(frameCount),
+      UInt32(skippedFrames),
+      buffer + currentWrite,
+      UInt32(firstFrames)
+    )
+    if firstFrames < actualFrames {
+      convert(
+        source,
+        UInt32(frameCount),
+        UInt32(skippedFrames + firstFrames),
+        buffer,
+        UInt32(actualFrames - firstFrames)
+      )
+    }
 
-    // calculate available space
-    let used = (currentWrite - currentRead + bufferSampleCount) % bufferSampleCount
-    let available = bufferSampleCount - used - 1
+    // update write index atomically
+    let newWrite = (currentWrite + actualFrames * channelCount) % bufferSampleCount
+    writeIndex.store(newWrite, ordering: .releasing)
 
-    let actualSamples = min(samplesToWrite, available)
-    let actualFrames = actualSamples / channelCount
+    return actualFrames
+  }
 
-    // copy samples to buffer
-    for i in 0 ..< actualSamples {
-      let idx = (currentWrite + i) % bufferSampleCount
-      buffer[idx] = frames[i]
+  /// write frameCount frames of silence (gap fill)
+  /// returns number of frames actually written
+  func writeSilence(frameCount: Int) -> Int {
+    let currentWrite = writeIndex.load(ordering: .relaxed)
+    let actualFrames = min(frameCount, availableWriteFrames(at: currentWrite))
+    guard actualFrames > 0 else { return 0 }
+
+    let actualSamples = actualFrames * channelCount
+    let firstSamples = min(actualSamples, bufferSampleCount - currentWrite)
+    (buffer + currentWrite).update(repeating: 0.0, count: firstSamples)
+    if firstSamples < actualSamples {
+      buffer.update(repeating: 0.0, count: actualSamples - firstSamples)
     }
 
-    // update write index atomically
     writeIndex.store((currentWrite + actualSamples) % bufferSampleCount, ordering: .releasing)
-
     return actualFrames
   }
 
+  /// producer side of a resync - everything written so far is stale and the reader skips it
+  /// the reader applies this on its next read, so neither thread touches the other's index
+  func resync() {
+    resyncIndex.store(writeIndex.load(ordering: .relaxed), ordering: .releasing)
+  }
+
+  /// free frames - one frame stays free so full and empty differ
+  @inline(__always)
+  private func availableWriteFrames(at currentWrite: Int) -> Int {
+    let currentRead = readIndex.load(ordering: .acquiring)
+    let used = (currentWrite - currentRead + bufferSampleCount) % bufferSampleCount
+    return (bufferSampleCount - used) / channelCount - 1
+  }
+
   /// read frames from buffer (called from output device IO thread)
   /// returns number of frames actually read, fills remainder with silence
   func read(into frames: UnsafeMutablePointer<Float>, frameCount: Int) -> Int {
     let samplesToRead = frameCount * channelCount
+    // take a pending resync before loading the write index, so the mark is never ahead of it
+    let target = resyncIndex.exchange(-1, ordering: .acquiring)
     let currentWrite = writeIndex.load(ordering: .acquiring)
-    let currentRead = readIndex.load(ordering: .relaxed)
+    var currentRead = readIndex.load(ordering: .relaxed)
 
     // calculate available data
-    let available = (currentWrite - currentRead + bufferSampleCount) % bufferSampleCount
-    let actualSamples = min(samplesToRead, available)
-    let actualFrames = actualSamples / channelCount
-
-    // copy samples from buffer
-    for i in 0 ..< actualSamples {
-      let idx = (currentRead + i) % bufferSampleCount
-      frames[i] = buffer[idx]
+    var available = (currentWrite - currentRead + bufferSampleCount) % bufferSampleCount
+
+    // producer asked for a resync - skip to the point it marked, unless a read already passed it
+    if target >= 0 {
+      let distance = (target - currentRead + bufferSampleCount) % bufferSampleCount
+      if distance <= available {
+        currentRead = target
+        available -= distance
+      }
+    }
+
+    // backlog left after this read grew past the limit (clock drift) - drop the oldest audio
+    // so half the limit remains
+    if available / channelCount - frameCount > maxLatencyFrames {
+      let keep = (frameCount + maxLatencyFrames / 2) * channelCount
+      currentRead = (currentRead + available - keep) % bufferSampleCount
+      available = keep
+      counters.increment(counters.latencyTrims)
+    }
+    let actualFrames = min(frameCount, available / channelCount)
+    let actualSamples = actualFrames * channelCount
+
+    // copy samples from buffer in at most two contiguous runs
+    let firstSamples = min(actualSamples, bufferSampleCount - currentRead)
+    frames.update(from: buffer + currentRead, count: firstSamples)
+    if firstSamples < actualSamples {
+      (frames + firstSamples).update(from: buffer, count: actualSamples - firstSamples)
     }
 
     // fill remainder with silence
     if actualSamples < samplesToRead {
-      for i in actualSamples ..< samplesToRead {
-        frames[i] = 0.0
-      }
+      (frames + actualSamples).update(repeating: 0.0, count: samplesToRead - actualSamples)
     }
 
     // update read index atomically
@@ -109,10 +200,49 @@ final class AudioRingBuffer: @unchecked Sendable {
   func reset() {
     writeIndex.store(0, ordering: .relaxed)
     readIndex.store(0, ordering: .relaxed)
+    resyncIndex.store(-1, ordering: .relaxed)
     // zero out buffer
-    for i in 0 ..< bufferSampleCount {
-      buffer[i] = 0.0
+    buffer.update(repeating: 0.0, count: bufferSampleCount)
+  }
+}
+
+// MARK: - Rate Profile
+
+/// every per-rate resource of the passthrough path, built once at startup for each supported rate
+/// a rate change swaps the active profile pointer - nothing is allocated or resized on the way
+final class RateProfile: @unchecked Sendable {
+  /// buffered time the ring holds at any rate
+  static let ringDuration: Float64 = 0.17
+
+  /// longest gap zero-filled instead of resynced
+  static let maxFillDuration: Float64 = 0.04
+
+  /// IO buffers the ring must hold - the reader trims above half the ring, and each side can
+  /// be a whole buffer ahead of the other
+  static let minimumBuffers = 4
+
+  let sampleRate: Float64
+  let ringBuffer: ResizableRingBuffer
+  let maxFillFrames: Int
+
+  init(sampleRate: Float64, counters: IOPathCounters) {
+    self.sampleRate = sampleRate
+    ringBuffer = ResizableRingBuffer(
+      capacity: Self.ringCapacity(sampleRate: sampleRate),
+      counters: counters
+    )
+    maxFillFrames = Int(sampleRate * Self.maxFillDuration)
+  }
+
+  /// next power of two at or above the target duration and minimumBuffers IO buffers
+  /// 8192 at 44.1/48kHz, 16384 at 96kHz - more once the output's buffers get large
+  static func ringCapacity(sampleRate: Float64, bufferFrames: Int = 0) -> Int {
+    let frames = max(sampleRate * ringDuration, Float64(bufferFrames * minimumBuffers))
+    var capacity = 1
+    while Float64(capacity) < frames {
+      capacity <<= 1
     }
+    return capacity
   }
 }
 
@@ -126,13 +256,110 @@ final class PassthroughEngine: @unchecked Sendable {
   private var ioProcID: AudioDeviceIOProcID?
   private var isRunning = false
 
-  private let ringBuffer = AudioRingBuffer()
+  /// output device's IO buffer size, 0 until known - guarded by lock
+  private var outputBufferFrames = 0
+  private var bufferSizeListener: AudioObjectPropertyListenerBlock?
+
   private let lock = NSLock()
 
+  /// discontinuity and latency counters for the passthrough path, shared by every profile
+  let counters: IOPathCounters
+
+  // one profile per supported rate, kept alive for the engine's lifetime
+  private let profiles: [RateProfile]
+  // unretained RateProfile from profiles, swapped by selectProfile
+  private let activeProfile: Atomic<UnsafeRawPointer>
+
+  // virtual device timeline - IO thread only, re-anchored on the first cycle after start
+  private var sampleTimeTracker = SampleTimeTracker()
+  private let trackerResetPending = Atomic<Bool>(true)
+
+  // conversion kernel for the current physical format (AFIOKernel)
+  // swapped by setInputFormat, snapshotted once per IO cycle
+  private let inputKernel = Atomic<UnsafeRawPointer?>(UnsafeRawPointer(IOKernels.canonical))
+
   private init() {
+    let counters = IOPathCounters()
+    self.counters = counters
+    profiles = AudioDeviceConfiguration.default.sampleRates.map { rate in
+      RateProfile(sampleRate: rate, counters: counters)
+    }
+    let initial = profiles.first { $0.sampleRate == StreamFormat.default.sampleRate } ?? profiles[0]
+    activeProfile = Atomic(UnsafeRawPointer(Unmanaged.passUnretained(initial).toOpaque()))
     os_log(.info, log: log, "PassthroughEngine created")
   }
 
+  // MARK: - Rate Profiles
+
+  /// profile in use (lock-free, safe on both IO threads)
+  var profile: RateProfile {
+    Unmanaged<RateProfile>.fromOpaque(activeProfile.load(ordering: .acquiring))
+      .takeUnretainedValue()
+  }
+
+  private var ringBuffer: ResizableRingBuffer {
+    profile.ringBuffer
+  }
+
+  /// size the active profile's ring for the output's IO buffer without stopping IO
+  /// the producer switches at its next cycle, the consumer drains the old ring first
+  /// caller holds the lock
+  private func fitRing(_ profile: RateProfile) {
+    let capacity = RateProfile.ringCapacity(
+      sampleRate: profile.sampleRate,
+      bufferFrames: outputBufferFrames
+    )
+    guard capacity != profile.ringBuffer.capacity else { return }
+    profile.ringBuffer.resize(capacity: capacity)
+    os_log(
+      .info,
+      log: log,
+      "ring resize requested: %d frames for %d-frame output buffers",
+      capacity,
+      outputBufferFrames
+    )
+  }
+
+  /// the output device's buffer size changed while running - called from its property listener
+  func outputBufferSizeChanged(_ frames: Int) {
+    lock.lock()
+    defer { lock.unlock() }
+
+    guard isRunning, frames != outputBufferFrames else { return }
+    outputBufferFrames = frames
+    fitRing(profile)
+  }
+
+  /// a profile was built for the rate - selectProfile(sampleRate:) will succeed
+  func hasProfile(sampleRate: Float64) -> Bool {
+    profiles.contains { $0.sampleRate == sampleRate }
+  }
+
+  /// switch every per-rate resource at once - called from PerformDeviceConfigurationChange,
+  /// while the HAL has IO stopped. returns false for a rate without a profile
+  func selectProfile(sampleRate: Float64) -> Bool {
+    guard let next = profiles.first(where: { $0.sampleRate == sampleRate }) else {
+      return false
+    }
+
+    // the new ring starts empty, the timeline re-anchors on the next cycle
+    next.ringBuffer.reset()
+    lock.withLock { fitRing(next) }
+    activeProfile.store(
+      UnsafeRawPointer(Unmanaged.passUnretained(next).toOpaque()),
+      ordering: .releasing
+    )
+    trackerResetPending.store(true, ordering: .releasing)
+    os_log(
+      .info,
+      log: log,
+      "rate profile: %f Hz, ring %d frames",
+      sampleRate,
+      next.ringBuffer.capacity
+    )
+    return true
+  }
+
   // MARK: - Lifecycle
 
   /// start audio passthrough - finds default output and sets up IOProc
@@ -171,8 +398,13 @@ final class PassthroughEngine: @unchecked Sendable {
     outputDeviceID = deviceID
     os_log(.info, log: log, "found default output device: %u", deviceID)
 
-    // reset ring buffer before starting
+    // reset ring buffer before starting, the next cycle starts a fresh timeline
     ringBuffer.reset()
+    trackerResetPending.store(true, ordering: .releasing)
+
+    // large output buffers need a deeper ring
+    outputBufferFrames = Self.bufferFrameSize(of: deviceID) ?? 0
+    fitRing(profile)
 
     // create IOProc on output device
     var procID: AudioDeviceIOProcID?
@@ -200,6 +432,18 @@ final class PassthroughEngine: @unchecked Sendable {
       return status
     }
 
+    // resized while IO runs if the user changes it
+    let listener: AudioObjectPropertyListenerBlock = { [weak self] _, _ in
+      guard let self, let frames = Self.bufferFrameSize(of: deviceID) else { return }
+      outputBufferSizeChanged(frames)
+    }
+    var bufferSizeAddress = Self.bufferFrameSizeAddress
+    if AudioObjectAddPropertyListenerBlock(deviceID, &bufferSizeAddress, .global(), listener)
+      == noErr
+    {
+      bufferSizeListener = listener
+    }
+
     isRunning = true
     os_log(.info, log: log, "passthrough started")
 
@@ -234,23 +478,89 @@ final class PassthroughEngine: @unchecked Sendable {
       os_log(.error, log: log, "failed to destroy IOProc: %d", status)
     }
 
+    if let listener = bufferSizeListener {
+      var bufferSizeAddress = Self.bufferFrameSizeAddress
+      AudioObjectRemovePropertyListenerBlock(
+        outputDeviceID,
+        &bufferSizeAddress,
+        .global(),
+        listener
+      )
+      bufferSizeListener = nil
+    }
+
     ioProcID = nil
     outputDeviceID = kAudioObjectUnknown
     isRunning = false
 
-    os_log(.info, log: log, "passthrough stopped")
+    // both IO threads are quiet - release any ring left over from a resize
+    ringBuffer.collect()
+    os_log(.info, log: log, "passthrough stopped: %{public}@", counters.summary)
 
     return noErr
   }
 
+  // MARK: - Output Buffer Size
+
+  private static let bufferFrameSizeAddress = AudioObjectPropertyAddress(
+    mSelector: kAudioDevicePropertyBufferFrameSize,
+    mScope: kAudioObjectPropertyScopeGlobal,
+    mElement: kAudioObjectPropertyElementMain
+  )
+
+  /// a device's IO buffer size in frames, nil if it can't be read
+  private static func bufferFrameSize(of deviceID: AudioDeviceID) -> Int? {
+    var address = bufferFrameSizeAddress
+    var frames: UInt32 = 0
+    var size = UInt32(MemoryLayout<UInt32>.size)
+    let status = AudioObjectGetPropertyData(deviceID, &address, 0, nil, &size, &frames)
+    guard status == noErr else {
+      os_log(.error, log: log, "failed to get output buffer size: %d", status)
+      return nil
+    }
+    return Int(frames)
+  }
+
   // MARK: - Audio Processing
 
+  /// select the conversion kernel for a new physical stream format
+  /// returns false if the format has no specialized kernel
+  func setInputFormat(_ format: AudioStreamBasicDescription) -> Bool {
+    guard let kernel = IOKernels.kernel(for: format) else {
+      return false
+    }
+
+    inputKernel.store(UnsafeRawPointer(kernel), ordering: .releasing)
+    os_log(.info, log: log, "input kernel: %{public}@", String(cString: kernel.pointee.name))
+    return true
+  }
+
+  /// conversion kernel for the current physical format (lock-free, safe on the IO thread)
+  var currentInputKernel: UnsafeRawPointer? {
+    inputKernel.load(ordering: .acquiring)
+  }
+
   /// called from virtual device DoIOOperation - writes audio to ring buffer
+  /// kernel and sampleTime come from the IO cycle; jumps in sample time are repaired here
   /// this must be real-time safe
-  func processBuffer(_ buffer: UnsafeRawPointer, frameCount: UInt32) {
-    // convert to float pointer (we use 32-bit float, stereo)
-    let floatBuffer = buffer.assumingMemoryBound(to: Float.self)
-    _ = ringBuffer.write(frames: floatBuffer, frameCount: Int(frameCount))
+  func processBuffer(
+    _ buffer: UnsafeRawPointer,
+    frameCount: UInt32,
+    sampleTime: Float64,
+    kernel: UnsafeRawPointer?
+  ) {
+    guard let kernel else { return }
+    let profile = self.profile
+    if trackerResetPending.exchange(false, ordering: .acquiring) {
+      sampleTimeTracker = SampleTimeTracker(maxFillFrames: profile.maxFillFrames)
+    }
+    profile.ringBuffer.write(
+      from: buffer,
+      frameCount: Int(frameCount),
+      sampleTime: sampleTime,
+      kernel: kernel.assumingMemoryBound(to: AFIOKernel.self),
+      tracker: &sampleTimeTracker
+    )
   }
 
   /// returns true if passthrough is active
@@ -282,6 +592,10 @@ private func outputIOProc(
 ) -> OSStatus {
   guard let clientData else { return noErr }
 
+  // flush subnormals for the duration of the callback, restore the host thread's mode after
+  let fpState = AFDenormals_Disable()
+  defer { AFDenormals_Restore(fpState) }
+
   let engine = Unmanaged<PassthroughEngine>.fromOpaque(clientData).takeUnretainedValue()
 
   // get the output buffer
@@ -314,8 +628,11 @@ public func driverDoIOOperation(
   ioMainBuffer: UnsafeMutableRawPointer?,
   ioSecondaryBuffer: UnsafeMutableRawPointer?
 ) -> OSStatus {
-  // we only handle WriteMix operation (apps writing audio to our device)
-  guard operationID == kAudioServerPlugInIOOperationWriteMix else {
+  // ProcessOutput: one client's buffer before the mix, in the virtual format - apply its gain
+  // WriteMix: the mix converted to the physical format - decode it into the passthrough
+  guard operationID == kAudioServerPlugInIOOperationProcessOutput ||
+    operationID == kAudioServerPlugInIOOperationWriteMix
+  else {
     return noErr
   }
 
@@ -323,7 +640,31 @@ public func driverDoIOOperation(
     return noErr
   }
 
-  PassthroughEngine.shared.processBuffer(buffer, frameCount: ioBufferFrameSize)
+  // coreaudiod owns this thread - flush subnormals only while we run
+  let fpState = AFDenormals_Disable()
+  defer { AFDenormals_Restore(fpState) }
+
+  // timing and control state were captured once in BeginIOOperation
+  let cycle = IOCycleCoordinator.shared.current
+
+  if operationID == kAudioServerPlugInIOOperationProcessOutput {
+    // the virtual format is always interleaved float - only WriteMix sees the physical one
+    ClientRegistry.shared.process(
+      clientID: clientID,
+      buffer: buffer.assumingMemoryBound(to: Float.self),
+      frameCount: Int(ioBufferFrameSize),
+      channelCount: cycle.channelCount,
+      sampleTime: cycle.outputSampleTime,
+      cycleCounter: cycle.counter
+    )
+  } else {
+    PassthroughEngine.shared.processBuffer(
+      buffer,
+      frameCount: ioBufferFrameSize,
+      sampleTime: cycle.outputSampleTime,
+      kernel: cycle.inputKernel
+    )
+  }
 
   return noErr
 }
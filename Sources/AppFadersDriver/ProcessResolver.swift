@@ -0,0 +1,283 @@
+import Dispatch
+import Foundation
+import os.log
+
+// MARK: - Logging
+
+private let log = OSLog(subsystem: "com.fbreidenbach.appfaders.driver", category: "ProcessResolver")
+
+// MARK: - Process Table
+
+/// what the resolver needs of a process without touching its executable
+struct ProcessIdentity: Equatable, Sendable {
+  let parent: pid_t
+  /// tells a reused pid from the process that had it before
+  let startTime: UInt64
+}
+
+/// source of process information - libproc on macOS, a /proc layout in tests
+protocol ProcessTable: Sendable {
+  /// nil if the process is gone
+  func identity(of pid: pid_t) -> ProcessIdentity?
+  /// nil if it can't be read - gone, or not ours to inspect
+  func executablePath(of pid: pid_t) -> String?
+}
+
+#if canImport(Darwin)
+  /// the running system's processes through libproc
+  struct DarwinProcessTable: ProcessTable {
+    func identity(of pid: pid_t) -> ProcessIdentity? {
+      var info = proc_bsdinfo()
+      let size = Int32(MemoryLayout<proc_bsdinfo>.size)
+      guard proc_pidinfo(pid, PROC_PIDTBSDINFO, 0, &info, size) == size else { return nil }
+      return ProcessIdentity(
+        parent: pid_t(info.pbi_ppid),
+        startTime: info.pbi_start_tvsec * 1_000_000 + info.pbi_start_tvusec
+      )
+    }
+
+    func executablePath(of pid: pid_t) -> String? {
+      var path = [UInt8](repeating: 0, count: Int(MAXPATHLEN) * 4)
+      let length = proc_pidpath(pid, &path, UInt32(path.count))
+      guard length > 0 else { return nil }
+      return String(decoding: path[..<Int(length)], as: UTF8.self)
+    }
+  }
+#endif
+
+/// processes as /proc lays them out - the fallback where libproc is missing, and over a fake
+/// root in tests
+struct ProcFSProcessTable: ProcessTable {
+  let root: String
+
+  init(root: String = "/proc") {
+    self.root = root
+  }
+
+  func identity(of pid: pid_t) -> ProcessIdentity? {
+    // "pid (comm) state ppid ..." - comm may contain spaces and parentheses, so fields are
+    // counted from the last ")"; ppid is the 2nd field after it, starttime the 20th
+    guard let stat = try? String(contentsOfFile: "\(root)/\(pid)/stat", encoding: .utf8),
+          let close = stat.lastIndex(of: ")") else { return nil }
+    let fields = stat[stat.index(after: close)...].split(whereSeparator: \.isWhitespace)
+    guard fields.count > 19,
+          let parent = pid_t(fields[1]),
+          let startTime = UInt64(fields[19]) else { return nil }
+    return ProcessIdentity(parent: parent, startTime: startTime)
+  }
+
+  func executablePath(of pid: pid_t) -> String? {
+    try? FileManager.default.destinationOfSymbolicLink(atPath: "\(root)/\(pid)/exe")
+  }
+}
+
+// MARK: - LRU Cache
+
+/// fixed-capacity map that evicts the least recently used key - not thread-safe
+struct LRUCache<Key: Hashable, Value> {
+  private struct Node {
+    var key: Key
+    var value: Value
+    var newer: Int
+    var older: Int
+  }
+
+  let capacity: Int
+  // nodes are linked newest to oldest by index; a full cache reuses the oldest node
+  private var nodes: [Node] = []
+  private var slots: [Key: Int] = [:]
+  private var newest = -1
+  private var oldest = -1
+
+  init(capacity: Int) {
+    self.capacity = max(capacity, 1)
+    nodes.reserveCapacity(self.capacity)
+    slots.reserveCapacity(self.capacity)
+  }
+
+  var count: Int {
+    slots.count
+  }
+
+  /// the value, now most recently used - nil if absent
+  mutating func value(for key: Key) -> Value? {
+    guard let slot = slots[key] else { return nil }
+    moveToNewest(slot)
+    return nodes[slot].value
+  }
+
+  mutating func set(_ value: Value, for key: Key) {
+    if let slot = slots[key] {
+      nodes[slot].value = value
+      moveToNewest(slot)
+      return
+    }
+
+    let slot: Int
+    if nodes.count < capacity {
+      slot = nodes.count
+      nodes.append(Node(key: key, value: value, newer: -1, older: -1))
+    } else {
+      slot = oldest
+      unlink(slot)
+      slots.removeValue(forKey: nodes[slot].key)
+      nodes[slot] = Node(key: key, value: value, newer: -1, older: -1)
+    }
+    slots[key] = slot
+    pushNewest(slot)
+  }
+
+  private mutating func moveToNewest(_ slot: Int) {
+    guard slot != newest else { return }
+    unlink(slot)
+    pushNewest(slot)
+  }
+
+  private mutating func unlink(_ slot: Int) {
+    let newer = nodes[slot].newer
+    let older = nodes[slot].older
+    if newer >= 0 { nodes[newer].older = older } else { newest = older }
+    if older >= 0 { nodes[older].newer = newer } else { oldest = newer }
+  }
+
+  private mutating func pushNewest(_ slot: Int) {
+    nodes[slot].newer = -1
+    nodes[slot].older = newest
+    if newest >= 0 { nodes[newest].newer = slot } else { oldest = slot }
+    newest = slot
+  }
+}
+
+// MARK: - Process Resolver
+
+/// finds the app a HAL client's process belongs to
+/// browsers and Electron apps play audio from helper processes with bundle IDs of their own;
+/// the owner is the outermost .app around the executable (helpers are apps nested inside the
+/// one the user launched), or for a process outside any bundle, the nearest ancestor inside one
+/// answers are cached per pid in an LRU and checked against the start time, so a reused pid
+/// never inherits one; "no owner" is cached too, for negativeLifetime, so a bundle-less process
+/// isn't walked again on every lookup
+/// never used on the IO thread - ClientRegistry hands the IO side the owner's table key
+final class ProcessResolver: @unchecked Sendable {
+  static let shared = ProcessResolver(table: defaultTable)
+
+  #if canImport(Darwin)
+    static let defaultTable: ProcessTable = DarwinProcessTable()
+  #else
+    static let defaultTable: ProcessTable = ProcFSProcessTable()
+  #endif
+
+  /// ancestors looked at before giving up - launchd and init end every chain long before
+  static let maxDepth = 16
+
+  private struct Entry {
+    let startTime: UInt64
+    let owner: String?
+    /// uptime nanoseconds after which a negative entry is looked up again
+    let expires: UInt64
+  }
+
+  private let table: ProcessTable
+  private let bundleIDOfApp: @Sendable (String) -> String?
+  private let negativeLifetime: UInt64
+  private let queue = DispatchQueue(
+    label: "com.fbreidenbach.appfaders.driver.resolver",
+    qos: .utility
+  )
+
+  private let lock = NSLock()
+  private var owners: LRUCache<pid_t, Entry>
+  private var apps: LRUCache<String, String?>
+
+  /// - Parameters:
+  ///   - capacity: processes remembered
+  ///   - negativeLifetime: how long "no owner" stands before the process is looked at again
+  ///   - bundleIDOfApp: bundle ID of an .app directory - reads its Info.plist unless replaced
+  init(
+    table: ProcessTable,
+    capacity: Int = 512,
+    negativeLifetime: TimeInterval = 5.0,
+    bundleIDOfApp: @escaping @Sendable (String) -> String? = {
+      ProcessResolver.infoPlistBundleID(app: $0)
+    }
+  ) {
+    self.table = table
+    self.bundleIDOfApp = bundleIDOfApp
+    self.negativeLifetime = UInt64(negativeLifetime * 1e9)
+    owners = LRUCache(capacity: capacity)
+    apps = LRUCache(capacity: 64)
+  }
+
+  /// resolve on the resolver's queue - completion gets the owner's bundle ID, nil if the
+  /// process has no app above it (or is gone)
+  func resolve(_ pid: pid_t, completion: @escaping @Sendable (String?) -> Void) {
+    queue.async { [self] in
+      completion(owner(of: pid))
+    }
+  }
+
+  /// bundle ID of the app that owns pid, nil if there is none - blocks on process lookups
+  func owner(of pid: pid_t) -> String? {
+    let now = DispatchTime.now().uptimeNanoseconds
+    var walked: [(pid: pid_t, startTime: UInt64)] = []
+    var owner: String?
+    var current = pid
+
+    for _ in 0 ..< Self.maxDepth {
+      guard current > 1, let identity = table.identity(of: current) else { break }
+
+      let cached = lock.withLock { owners.value(for: current) }
+      if let cached, cached.startTime == identity.startTime, cached.expires > now {
+        owner = cached.owner
+        break
+      }
+
+      walked.append((current, identity.startTime))
+      if let path = table.executablePath(of: current), let found = appBundleID(containing: path) {
+        owner = found
+        break
+      }
+      current = identity.parent
+    }
+
+    // every process on the way shares the answer - sibling helpers stop at their parent
+    let expires = owner == nil ? now + negativeLifetime : UInt64.max
+    lock.withLock {
+      for process in walked {
+        owners.set(
+          Entry(startTime: process.startTime, owner: owner, expires: expires),
+          for: process.pid
+        )
+      }
+    }
+    if !walked.isEmpty {
+      os_log(.debug, log: log, "pid %d owned by %{public}@", pid, owner ?? "(none)")
+    }
+    return owner
+  }
+
+  /// bundle ID of the outermost .app in path, cached per app
+  private func appBundleID(containing path: String) -> String? {
+    guard let app = Self.outermostApp(in: path) else { return nil }
+    if let cached = lock.withLock({ apps.value(for: app) }) {
+      return cached
+    }
+    let bundleID = bundleIDOfApp(app)
+    lock.withLock { apps.set(bundleID, for: app) }
+    return bundleID
+  }
+
+  /// the outermost .app directory in an executable path, nil if it isn't in one
+  static func outermostApp(in path: String) -> String? {
+    guard let range = path.range(of: ".app/") else { return nil }
+    return String(path[..<path.index(before: range.upperBound)])
+  }
+
+  /// CFBundleIdentifier from an app's Info.plist
+  static func infoPlistBundleID(app: String) -> String? {
+    guard let data = FileManager.default.contents(atPath: app + "/Contents/Info.plist"),
+          let plist = try? PropertyListSerialization.propertyList(from: data, format: nil),
+          let info = plist as? [String: Any] else { return nil }
+    return info["CFBundleIdentifier"] as? String
+  }
+}
@@ -0,0 +1,215 @@
+import AppFadersDriverBridge
+import Synchronization
+
+// MARK: - Resizable Ring Buffer
+
+/// ring whose depth can change while both IO threads keep running
+/// a resize allocates a new AudioRingBuffer off the IO threads and parks it as pending; the
+/// producer switches to it at its next cycle boundary and the consumer drains the old ring
+/// before moving on, so no frame is lost or reordered and neither side takes a lock
+///
+/// ring ownership: each slot holds one +1 retain
+/// - current: the ring the producer writes
+/// - pending: allocated by resize, taken by the producer
+/// - draining: the previous current, read by the consumer until empty
+/// - retired, retiredSpare: drained, waiting for collect() to release them off the IO threads -
+///   two slots, so a drain that finishes after resize()'s collect() doesn't hold up the switch
+///   to the ring that resize() queued
+final class ResizableRingBuffer: @unchecked Sendable {
+  let counters: IOPathCounters
+
+  private let current: Atomic<UnsafeRawPointer>
+  private let pending = Atomic<UnsafeRawPointer?>(nil)
+  private let draining = Atomic<UnsafeRawPointer?>(nil)
+  private let retired = Atomic<UnsafeRawPointer?>(nil)
+  private let retiredSpare = Atomic<UnsafeRawPointer?>(nil)
+
+  // producer saw a discontinuity while the old ring was still draining - its audio is stale
+  private let dropDraining = Atomic<Bool>(false)
+
+  init(capacity: Int, counters: IOPathCounters = IOPathCounters()) {
+    self.counters = counters
+    current = Atomic(Self.retain(Self.makeRing(capacity: capacity, counters: counters)))
+  }
+
+  deinit {
+    Self.release(current.load(ordering: .acquiring))
+    if let ring = pending.load(ordering: .acquiring) {
+      Self.release(ring)
+    }
+    if let ring = draining.load(ordering: .acquiring) {
+      Self.release(ring)
+    }
+    if let ring = retired.load(ordering: .acquiring) {
+      Self.release(ring)
+    }
+    if let ring = retiredSpare.load(ordering: .acquiring) {
+      Self.release(ring)
+    }
+  }
+
+  // MARK: - Ring Ownership
+
+  private static func makeRing(capacity: Int, counters: IOPathCounters) -> AudioRingBuffer {
+    AudioRingBuffer(capacity: capacity, maxLatencyFrames: capacity / 2, counters: counters)
+  }
+
+  private static func retain(_ ring: AudioRingBuffer) -> UnsafeRawPointer {
+    UnsafeRawPointer(Unmanaged.passRetained(ring).toOpaque())
+  }
+
+  private static func release(_ pointer: UnsafeRawPointer) {
+    Unmanaged<AudioRingBuffer>.fromOpaque(pointer).release()
+  }
+
+  @inline(__always)
+  private static func ring(_ pointer: UnsafeRawPointer) -> AudioRingBuffer {
+    Unmanaged<AudioRingBuffer>.fromOpaque(pointer).takeUnretainedValue()
+  }
+
+  /// depth of the ring the producer is writing
+  var capacity: Int {
+    Self.ring(current.load(ordering: .acquiring)).capacity
+  }
+
+  var maxLatencyFrames: Int {
+    Self.ring(current.load(ordering: .acquiring)).maxLatencyFrames
+  }
+
+  /// a resize is waiting for the producer or the old ring is still draining
+  var isResizing: Bool {
+    pending.load(ordering: .acquiring) != nil || draining.load(ordering: .acquiring) != nil
+  }
+
+  // MARK: - Control
+
+  /// request a new depth - allocates here, the producer switches at its next cycle
+  /// a newer request replaces one the producer hasn't taken yet
+  func resize(capacity: Int) {
+    collect()
+    let next = Self.retain(Self.makeRing(capacity: capacity, counters: counters))
+    if let replaced = pending.exchange(next, ordering: .acquiringAndReleasing) {
+      Self.release(replaced)
+    }
+  }
+
+  /// release rings the consumer has finished with - call off the IO threads
+  func collect() {
+    if let ring = retired.exchange(nil, ordering: .acquiring) {
+      Self.release(ring)
+    }
+    if let ring = retiredSpare.exchange(nil, ordering: .acquiring) {
+      Self.release(ring)
+    }
+  }
+
+  /// empty every ring (call only when IO is stopped)
+  func reset() {
+    if let ring = draining.exchange(nil, ordering: .acquiring) {
+      Self.release(ring)
+    }
+    collect()
+    dropDraining.store(false, ordering: .relaxed)
+    Self.ring(current.load(ordering: .acquiring)).reset()
+  }
+
+  // MARK: - Producer
+
+  /// switch to a pending ring at a cycle boundary
+  /// waits (keeps writing the current ring) until the previous migration has fully drained
+  /// and a retired slot is free for it - resize() collects before queueing, so one always is
+  /// this must be real-time safe
+  @inline(__always)
+  private func producerRing() -> AudioRingBuffer {
+    let active = current.load(ordering: .relaxed)
+    guard pending.load(ordering: .relaxed) != nil,
+          draining.load(ordering: .acquiring) == nil,
+          retired.load(ordering: .acquiring) == nil
+          || retiredSpare.load(ordering: .acquiring) == nil,
+          let next = pending.exchange(nil, ordering: .acquiring)
+    else {
+      return Self.ring(active)
+    }
+
+    // draining first: a consumer that sees the new current also sees the old ring to finish
+    draining.store(active, ordering: .releasing)
+    current.store(next, ordering: .releasing)
+    counters.increment(counters.resizes)
+    return Self.ring(next)
+  }
+
+  /// write one IO cycle - see AudioRingBuffer.write(from:frameCount:sampleTime:kernel:tracker:)
+  /// this must be real-time safe
+  @discardableResult
+  func write(
+    from source: UnsafeRawPointer,
+    frameCount: Int,
+    sampleTime: Float64,
+    kernel: UnsafePointer<AFIOKernel>,
+    tracker: inout SampleTimeTracker
+  ) -> SampleTimeEvent {
+    let event = producerRing().write(
+      from: source,
+      frameCount: frameCount,
+      sampleTime: sampleTime,
+      kernel: kernel,
+      tracker: &tracker
+    )
+    if event == .discontinuity, draining.load(ordering: .relaxed) != nil {
+      dropDraining.store(true, ordering: .releasing)
+    }
+    return event
+  }
+
+  /// untimed write - returns number of frames actually written
+  /// this must be real-time safe
+  func write(
+    from source: UnsafeRawPointer,
+    frameCount: Int,
+    kernel: UnsafePointer<AFIOKernel>
+  ) -> Int {
+    producerRing().write(from: source, frameCount: frameCount, kernel: kernel)
+  }
+
+  // MARK: - Consumer
+
+  /// read frames, finishing the old ring before touching the new one
+  /// returns number of frames actually read, fills remainder with silence
+  /// this must be real-time safe
+  func read(into frames: UnsafeMutablePointer<Float>, frameCount: Int) -> Int {
+    let active = current.load(ordering: .acquiring)
+
+    // old == active means the switch is half-published - read current as usual this time
+    guard let old = draining.load(ordering: .acquiring), old != active else {
+      return Self.ring(active).read(into: frames, frameCount: frameCount)
+    }
+
+    let drop = dropDraining.exchange(false, ordering: .acquiring)
+    let oldRing = Self.ring(old)
+    let fromOld = drop ? 0 : oldRing.read(into: frames, frameCount: frameCount)
+    guard drop || fromOld < frameCount else {
+      return fromOld
+    }
+
+    // the producer never writes the old ring again, so running short means it's empty
+    // retired before draining clears, so the producer can't start another switch in between
+    // only this thread fills the slots and the switch waited for a free one, so if the first
+    // is taken the spare is free
+    if !retired.compareExchange(
+      expected: nil,
+      desired: old,
+      successOrdering: .releasing,
+      failureOrdering: .relaxed
+    ).exchanged {
+      retiredSpare.store(old, ordering: .releasing)
+    }
+    draining.store(nil, ordering: .releasing)
+
+    let activeRing = Self.ring(active)
+    let fromActive = activeRing.read(
+      into: frames + fromOld * activeRing.channelCount,
+      frameCount: frameCount - fromOld
+    )
+    return fromOld + fromActive
+  }
+}
@@ -0,0 +1,131 @@
+import AppFadersDriverBridge
+import Synchronization
+
+// MARK: - Sample Time Events
+
+/// how one IO cycle's sample time relates to the end of the previous cycle
+enum SampleTimeEvent: Equatable {
+  /// first cycle since start or reset - nothing to compare against
+  case first
+  /// exactly where the last cycle ended
+  case continuous
+  /// frames were skipped (HAL dropped a cycle, client stalled) - zero-filled
+  case gap(frames: Int)
+  /// frames were repeated (cycle restart, short seek back) - the repeated part is dropped
+  case overlap(frames: Int)
+  /// jump too large to patch (sleep/wake, device restart, long seek) - ring is resynced
+  case discontinuity
+}
+
+// MARK: - Sample Time Tracker
+
+/// classifies each cycle's sample time against the expected continuation
+/// owned by the virtual device IO thread
+struct SampleTimeTracker {
+  /// gaps up to this many frames are zero-filled, anything larger resyncs
+  /// ~40ms at 48kHz - a couple of dropped cycles, not a sleep
+  let maxFillFrames: Int
+
+  /// sample time the next cycle should start at, nil until the first cycle
+  private(set) var expectedSampleTime: Float64?
+
+  init(maxFillFrames: Int = 2048) {
+    self.maxFillFrames = maxFillFrames
+  }
+
+  /// classify a cycle and advance the expected time past it
+  mutating func classify(sampleTime: Float64, frameCount: Int) -> SampleTimeEvent {
+    defer { expectedSampleTime = sampleTime + Float64(frameCount) }
+
+    guard let expected = expectedSampleTime else {
+      return .first
+    }
+
+    // HAL sample times are whole frames in practice - round away float noise
+    let delta = (sampleTime - expected).rounded()
+    if delta == 0 {
+      return .continuous
+    }
+    if delta > 0 {
+      return delta <= Float64(maxFillFrames) ? .gap(frames: Int(delta)) : .discontinuity
+    }
+    // a repeat of at most this cycle's length can be trimmed off the front
+    return -delta <= Float64(frameCount) ? .overlap(frames: Int(-delta)) : .discontinuity
+  }
+
+  /// forget the timeline - the next cycle is treated as the first
+  mutating func reset() {
+    expectedSampleTime = nil
+  }
+}
+
+// MARK: - IO Path Counters
+
+/// discontinuity and latency counters - written on the IO threads, read anywhere
+final class IOPathCounters: @unchecked Sendable {
+  let cycles = Atomic<UInt64>(0)
+  let gaps = Atomic<UInt64>(0)
+  let gapFrames = Atomic<UInt64>(0)
+  let overlaps = Atomic<UInt64>(0)
+  let droppedFrames = Atomic<UInt64>(0)
+  let resyncs = Atomic<UInt64>(0)
+  let latencyTrims = Atomic<UInt64>(0)
+  let resizes = Atomic<UInt64>(0)
+
+  @inline(__always)
+  func increment(_ counter: Atomic<UInt64>, by amount: Int = 1) {
+    counter.add(UInt64(amount), ordering: .relaxed)
+  }
+
+  /// one-line summary for logging
+  var summary: String {
+    "cycles=\(cycles.load(ordering: .relaxed)) "
+      + "gaps=\(gaps.load(ordering: .relaxed))/\(gapFrames.load(ordering: .relaxed))f "
+      + "overlaps=\(overlaps.load(ordering: .relaxed))/\(droppedFrames.load(ordering: .relaxed))f "
+      + "resyncs=\(resyncs.load(ordering: .relaxed)) "
+      + "trims=\(latencyTrims.load(ordering: .relaxed)) "
+      + "resizes=\(resizes.load(ordering: .relaxed))"
+  }
+}
+
+// MARK: - Timed Ring Writes
+
+extension AudioRingBuffer {
+  /// write one IO cycle, repairing the timeline first
+  /// gaps are zero-filled, overlaps trimmed, large jumps drop the stale backlog on the reader side
+  /// this must be real-time safe
+  @discardableResult
+  func write(
+    from source: UnsafeRawPointer,
+    frameCount: Int,
+    sampleTime: Float64,
+    kernel: UnsafePointer<AFIOKernel>,
+    tracker: inout SampleTimeTracker
+  ) -> SampleTimeEvent {
+    let event = tracker.classify(sampleTime: sampleTime, frameCount: frameCount)
+    counters.increment(counters.cycles)
+
+    switch event {
+    case .first, .continuous:
+      _ = write(from: source, frameCount: frameCount, kernel: kernel)
+
+    case let .gap(frames):
+      counters.increment(counters.gaps)
+      counters.increment(counters.gapFrames, by: frames)
+      _ = writeSilence(frameCount: frames)
+      _ = write(from: source, frameCount: frameCount, kernel: kernel)
+
+    case let .overlap(frames):
+      counters.increment(counters.overlaps)
+      counters.increment(counters.droppedFrames, by: frames)
+      _ = write(from: source, frameCount: frameCount, kernel: kernel, skipping: frames)
+
+    case .discontinuity:
+      counters.increment(counters.resyncs)
+      resync()
+      _ = write(from: source, frameCount: frameCount, kernel: kernel)
+    }
+
+    return event
+  }
+}
@@ -0,0 +1,101 @@
+import AppFadersVolumeTable
+import Foundation
+import os.log
+import Synchronization
+
+// MARK: - Logging
+
+private let log = OSLog(
+  subsystem: "com.fbreidenbach.appfaders.driver",
+  category: "SharedVolumeTable"
+)
+
+// MARK: - Shared Volume Table
+
+/// read-only mapping of the helper's shared-memory volume table
+/// the helper creates the region; the driver maps it once the helper is up and keeps the
+/// mapping for its lifetime, so the IO thread can read it without checking for unmaps
+/// until then the driver maps the helper's on-disk snapshot instead, so gains are right from
+/// the first IO cycle - the live region replaces it as soon as it can be mapped
+final class SharedVolumeTable: @unchecked Sendable {
+  static let shared = SharedVolumeTable(snapshotPath: AF_VOLUME_TABLE_SNAPSHOT_PATH)
+
+  let name: String
+  let snapshotPath: String?
+  private let mapping = Atomic<OpaquePointer?>(nil)
+  private let lock = NSLock()
+  // the snapshot stays mapped once replaced - the IO thread may still be reading it
+  private var snapshot: OpaquePointer?
+  private var live = false
+
+  /// - Parameter snapshotPath: the helper's on-disk copy to use until the region exists
+  init(name: String = AF_VOLUME_TABLE_NAME, snapshotPath: String? = nil) {
+    self.name = name
+    self.snapshotPath = snapshotPath
+  }
+
+  deinit {
+    let current = mapping.load(ordering: .acquiring)
+    if current != snapshot {
+      AFVolumeTable_Close(current)
+    }
+    AFVolumeTable_Close(snapshot)
+  }
+
+  /// region for the IO thread, nil until open() succeeded
+  /// the pointer changes once, from the snapshot to the live region
+  @inline(__always)
+  var table: OpaquePointer? {
+    mapping.load(ordering: .acquiring)
+  }
+
+  var isMapped: Bool {
+    table != nil
+  }
+
+  /// the helper's live region is mapped (not just the snapshot)
+  var isLive: Bool {
+    lock.withLock { live }
+  }
+
+  /// map the region if the helper has created it, else the snapshot if there is one
+  /// safe to call repeatedly, not on the IO thread
+  /// - Returns: true once the live region is mapped
+  @discardableResult
+  func open() -> Bool {
+    lock.lock()
+    defer { lock.unlock() }
+
+    guard !live else { return true }
+    if let opened = AFVolumeTable_Open(name) {
+      mapping.store(opened, ordering: .releasing)
+      live = true
+      os_log(.info, log: log, "mapped volume table %{public}@: %u entries", name,
+             AFVolumeTable_Count(opened))
+      return true
+    }
+
+    os_log(.debug, log: log, "volume table %{public}@ not available yet", name)
+    if snapshot == nil, let snapshotPath, let opened = AFVolumeTable_OpenSnapshot(snapshotPath) {
+      snapshot = opened
+      mapping.store(opened, ordering: .releasing)
+      os_log(.info, log: log, "mapped volume snapshot %{public}@: %u entries", snapshotPath,
+             AFVolumeTable_Count(opened))
+    }
+    return false
+  }
+
+  /// effective gain for a bundle ID (0 when muted), nil if unmapped or unknown
+  func volume(for bundleID: String) -> Float? {
+    guard let table else { return nil }
+    return volume(at: AFVolumeTable_Find(table, AFVolumeTable_Key(bundleID)), in: table)
+  }
+
+  /// effective gain of one entry - this must be real-time safe
+  @inline(__always)
+  func volume(at index: Int32, in table: OpaquePointer) -> Float? {
+    var value = AFVolumeValue()
+    guard index >= 0, AFVolumeTable_Read(table, index, &value) else { return nil }
+    return value.muted ? 0.0 : max(0.0, min(1.0, value.gain))
+  }
+}
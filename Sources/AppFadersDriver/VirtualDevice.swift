@@ -1,3 +1,4 @@
+import AppFadersIPC
 import CoreAudio
 import Foundation
 import os.log
@@ -27,6 +28,23 @@ private let kAudioDevicePropertyControlList = AudioObjectPropertySelector(
 private let kAudioClockDevicePropertyClockDomain = AudioObjectPropertySelector(
   fourCharCode("clk#"))
 
+// HAL custom property data types (AudioServerPlugIn.h)
+private let kAudioServerPlugInCustomPropertyDataTypeCFPropertyList = fourCharCode("plst")
+private let kAudioServerPlugInCustomPropertyDataTypeNone: UInt32 = 0
+
+// MARK: - Custom Properties
+
+/// device property: CFData of per-app activity in ActivityFeed's format
+/// read by the host at a low rate - see ClientRegistry.activity
+let kAppFadersPropertyAppActivity = AudioObjectPropertySelector(ActivityFeed.propertySelector)
+
+/// layout of AudioServerPlugInCustomPropertyInfo - not bridged to Swift
+private struct CustomPropertyInfo {
+  var selector: AudioObjectPropertySelector
+  var propertyDataType: UInt32
+  var qualifierDataType: UInt32
+}
+
 private func fourCharCode(_ string: String) -> UInt32 {
   var result: UInt32 = 0
   for char in string.utf8.prefix(4) {
@@ -337,7 +355,8 @@ final class VirtualDevice: @unchecked Sendable {
          kAudioDevicePropertyZeroTimeStampPeriod,
          kAudioDevicePropertyClockDomain,
          kAudioDevicePropertyIsHidden,
-         kAudioDevicePropertyPreferredChannelsForStereo:
+         kAudioDevicePropertyPreferredChannelsForStereo,
+         kAppFadersPropertyAppActivity:
       true
     default:
       false
@@ -386,9 +405,14 @@ final class VirtualDevice: @unchecked Sendable {
         address.mScope == kAudioObjectPropertyScopeGlobal)
         ? UInt32(MemoryLayout<AudioObjectID>.size) : 0
 
-    case kAudioObjectPropertyCustomPropertyInfoList,
-         kAudioDevicePropertyControlList:
-      0 // empty lists - custom IPC removed, using XPC
+    case kAudioObjectPropertyCustomPropertyInfoList:
+      UInt32(MemoryLayout<CustomPropertyInfo>.size) // app activity
+
+    case kAudioDevicePropertyControlList:
+      0 // empty list - volume control goes through XPC
+
+    case kAppFadersPropertyAppActivity:
+      UInt32(MemoryLayout<UnsafeRawPointer>.size)
 
     case kAudioDevicePropertyNominalSampleRate:
       UInt32(MemoryLayout<Float64>.size)
@@ -470,11 +494,26 @@ final class VirtualDevice: @unchecked Sendable {
       }
       return (Data(), 0) // no input streams
 
-    case kAudioObjectPropertyCustomPropertyInfoList,
-         kAudioDevicePropertyControlList:
-      // empty lists - custom IPC removed, using XPC
+    case kAudioObjectPropertyCustomPropertyInfoList:
+      var info = CustomPropertyInfo(
+        selector: kAppFadersPropertyAppActivity,
+        propertyDataType: kAudioServerPlugInCustomPropertyDataTypeCFPropertyList,
+        qualifierDataType: kAudioServerPlugInCustomPropertyDataTypeNone
+      )
+      return (Data(bytes: &info, count: MemoryLayout<CustomPropertyInfo>.size),
+              UInt32(MemoryLayout<CustomPropertyInfo>.size))
+
+    case kAudioDevicePropertyControlList:
+      // empty list - volume control goes through XPC
       return (Data(), 0)
 
+    case kAppFadersPropertyAppActivity:
+      // CF property values are handed over retained - the caller releases
+      let feed = Data(ActivityFeed.encode(ClientRegistry.shared.activity())) as CFData
+      var ptr = Unmanaged.passRetained(feed).toOpaque()
+      return (Data(bytes: &ptr, count: MemoryLayout<UnsafeRawPointer>.size),
+              UInt32(MemoryLayout<UnsafeRawPointer>.size))
+
     case kAudioDevicePropertyNominalSampleRate:
       lock.lock()
       var rate = sampleRate
@@ -562,24 +601,16 @@ final class VirtualDevice: @unchecked Sendable {
       let newRate = data.load(as: Float64.self)
 
       // validate sample rate
-      let supported: [Float64] = [44100.0, 48000.0, 96000.0]
-      guard supported.contains(newRate) else {
+      guard VirtualStream.shared.supportedSampleRates.contains(newRate) else {
         os_log(.error, log: log, "unsupported device sample rate: %f", newRate)
         return kAudioDeviceUnsupportedFormatError
       }
 
-      setSampleRate(newRate)
-      // also update stream sample rate (ignore result - stream validates separately)
-      _ = VirtualStream.shared.setPropertyData(
-        address: AudioObjectPropertyAddress(
-          mSelector: kAudioStreamPropertyPhysicalFormat,
-          mScope: kAudioObjectPropertyScopeGlobal,
-          mElement: kAudioObjectPropertyElementMain
-        ),
-        data: data,
-        size: size
-      )
-      return noErr
+      // device and stream change together - the stream's current format at the new rate
+      var format = VirtualStream.shared.currentFormat()
+      guard format.mSampleRate != newRate else { return noErr }
+      format.mSampleRate = newRate
+      return ConfigurationChange.shared.requestFormat(format)
     }
 
     // delegate stream properties
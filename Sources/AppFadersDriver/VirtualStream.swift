@@ -24,7 +24,10 @@ final class VirtualStream: @unchecked Sendable {
 
   // mutable state
   private var isActive: Bool = false
-  private var sampleRate: Float64 = 48000.0
+  /// what WriteMix hands over - any format with an IO kernel
+  /// the virtual format, which clients and ProcessOutput see, is always canonical float at the
+  /// same rate: the HAL mixes in float and converts to this before WriteMix
+  private var format: AudioStreamBasicDescription = StreamFormat.default.toASBD()
 
   // supported sample rates
   let supportedSampleRates: [Float64] = [44100.0, 48000.0, 96000.0]
@@ -35,39 +38,39 @@ final class VirtualStream: @unchecked Sendable {
 
   // MARK: - Format Helpers
 
-  /// create AudioStreamBasicDescription for current sample rate
+  /// AudioStreamBasicDescription for the current physical format
   func currentFormat() -> AudioStreamBasicDescription {
     lock.lock()
-    let rate = sampleRate
-    lock.unlock()
-    return makeFormat(sampleRate: rate)
+    defer { lock.unlock() }
+    return format
   }
 
-  /// create format description for given sample rate
-  private func makeFormat(sampleRate: Float64) -> AudioStreamBasicDescription {
-    AudioStreamBasicDescription(
-      mSampleRate: sampleRate,
-      mFormatID: kAudioFormatLinearPCM,
-      mFormatFlags: kAudioFormatFlagsNativeFloatPacked,
-      mBytesPerPacket: 8, // 2 channels * 4 bytes
-      mFramesPerPacket: 1,
-      mBytesPerFrame: 8,
-      mChannelsPerFrame: 2,
-      mBitsPerChannel: 32,
-      mReserved: 0
-    )
+  /// the virtual format - interleaved stereo float at the current rate
+  func virtualFormat() -> AudioStreamBasicDescription {
+    IOKernels.format(of: IOKernels.canonical.pointee, sampleRate: getSampleRate())
   }
 
-  /// get all available formats as AudioStreamRangedDescription array
+  /// every physical format the stream takes, each at one fixed rate - one per IO kernel and rate
   func availableFormats() -> [AudioStreamRangedDescription] {
+    supportedSampleRates.flatMap { rate in
+      IOKernels.supportedFormats(sampleRate: rate).map { ranged($0) }
+    }
+  }
+
+  /// the virtual format at every rate - only the rate can change
+  func availableVirtualFormats() -> [AudioStreamRangedDescription] {
     supportedSampleRates.map { rate in
-      AudioStreamRangedDescription(
-        mFormat: makeFormat(sampleRate: rate),
-        mSampleRateRange: AudioValueRange(mMinimum: rate, mMaximum: rate)
-      )
+      ranged(IOKernels.format(of: IOKernels.canonical.pointee, sampleRate: rate))
     }
   }
 
+  private func ranged(_ format: AudioStreamBasicDescription) -> AudioStreamRangedDescription {
+    AudioStreamRangedDescription(
+      mFormat: format,
+      mSampleRateRange: AudioValueRange(mMinimum: format.mSampleRate, mMaximum: format.mSampleRate)
+    )
+  }
+
   // MARK: - Property Queries
 
   func hasProperty(address: AudioObjectPropertyAddress) -> Bool {
@@ -120,10 +123,12 @@ final class VirtualStream: @unchecked Sendable {
          kAudioStreamPropertyPhysicalFormat:
       UInt32(MemoryLayout<AudioStreamBasicDescription>.size)
 
-    case kAudioStreamPropertyAvailableVirtualFormats,
-         kAudioStreamPropertyAvailablePhysicalFormats:
+    case kAudioStreamPropertyAvailableVirtualFormats:
       UInt32(MemoryLayout<AudioStreamRangedDescription>.size * supportedSampleRates.count)
 
+    case kAudioStreamPropertyAvailablePhysicalFormats:
+      UInt32(MemoryLayout<AudioStreamRangedDescription>.size * availableFormats().count)
+
     default:
       nil
     }
@@ -178,13 +183,17 @@ final class VirtualStream: @unchecked Sendable {
 
     case kAudioStreamPropertyVirtualFormat,
          kAudioStreamPropertyPhysicalFormat:
-      var format = currentFormat()
+      var format = address.mSelector == kAudioStreamPropertyVirtualFormat
+        ? virtualFormat()
+        : currentFormat()
       return (Data(bytes: &format, count: MemoryLayout<AudioStreamBasicDescription>.size),
               UInt32(MemoryLayout<AudioStreamBasicDescription>.size))
 
     case kAudioStreamPropertyAvailableVirtualFormats,
          kAudioStreamPropertyAvailablePhysicalFormats:
-      var formats = availableFormats()
+      var formats = address.mSelector == kAudioStreamPropertyAvailableVirtualFormats
+        ? availableVirtualFormats()
+        : availableFormats()
       let size = MemoryLayout<AudioStreamRangedDescription>.size * formats.count
       return (Data(bytes: &formats, count: size), UInt32(size))
 
@@ -207,7 +216,17 @@ final class VirtualStream: @unchecked Sendable {
         return kAudioHardwareBadPropertySizeError
       }
 
-      let format = data.load(as: AudioStreamBasicDescription.self)
+      let requested = data.load(as: AudioStreamBasicDescription.self)
+      var format = requested
+      if address.mSelector == kAudioStreamPropertyVirtualFormat {
+        // the virtual format is fixed apart from its rate - ProcessOutput reads it as float
+        guard IOKernels.kernel(for: requested) == IOKernels.canonical else {
+          os_log(.error, log: log, "virtual format must be interleaved stereo float")
+          return kAudioDeviceUnsupportedFormatError
+        }
+        format = currentFormat()
+        format.mSampleRate = requested.mSampleRate
+      }
 
       // validate sample rate is supported
       guard supportedSampleRates.contains(format.mSampleRate) else {
@@ -215,27 +234,44 @@ final class VirtualStream: @unchecked Sendable {
         return kAudioDeviceUnsupportedFormatError
       }
 
-      // validate format matches our requirements
-      guard format.mFormatID == kAudioFormatLinearPCM,
-            format.mChannelsPerFrame == 2,
-            format.mBitsPerChannel == 32
-      else {
-        os_log(.error, log: log, "unsupported format")
+      // only what availableFormats advertises - kernel(for:) checks the whole description
+      guard IOKernels.kernel(for: format) != nil else {
+        os_log(.error, log: log, "unsupported format: flags 0x%x, %u bits, %u ch, %u bytes/frame",
+               format.mFormatFlags, format.mBitsPerChannel, format.mChannelsPerFrame,
+               format.mBytesPerFrame)
         return kAudioDeviceUnsupportedFormatError
       }
 
-      lock.lock()
-      sampleRate = format.mSampleRate
-      lock.unlock()
-
-      os_log(.info, log: log, "sample rate changed to %f", format.mSampleRate)
-      return noErr
+      let current = currentFormat()
+      if format.mSampleRate == current.mSampleRate,
+         IOKernels.kernel(for: format) == IOKernels.kernel(for: current) {
+        return noErr
+      }
+      // rate, sample type, channels or layout - any of them changes what the IO thread reads,
+      // so every change waits for the host to stop IO
+      return ConfigurationChange.shared.requestFormat(format)
 
     default:
       return kAudioHardwareUnknownPropertyError
     }
   }
 
+  /// switch to a validated format - swaps the engine's kernel, then publishes the format
+  /// only called from PerformDeviceConfigurationChange, while the host has IO stopped
+  func applyFormat(_ format: AudioStreamBasicDescription) -> Bool {
+    guard PassthroughEngine.shared.setInputFormat(format) else {
+      return false
+    }
+
+    lock.lock()
+    self.format = format
+    lock.unlock()
+
+    os_log(.info, log: log, "format changed: %f Hz, %u ch", format.mSampleRate,
+           format.mChannelsPerFrame)
+    return true
+  }
+
   // MARK: - IO State
 
   func setActive(_ active: Bool) {
@@ -254,7 +290,7 @@ final class VirtualStream: @unchecked Sendable {
   func getSampleRate() -> Float64 {
     lock.lock()
     defer { lock.unlock() }
-    return sampleRate
+    return format.mSampleRate
   }
 }
 
@@ -398,5 +434,9 @@ public func driverStopIO(deviceID: AudioObjectID, clientID: UInt32) -> OSStatus
     os_log(.error, log: log, "StopIO: PassthroughEngine.stop() failed: %d", status)
   }
 
+  if let elapsed = ConfigurationChange.shared.lastChangeTiming.requestToAudio {
+    os_log(.info, log: log, "StopIO: last rate change reached audio %.2f ms after request", elapsed)
+  }
+
   return noErr
 }
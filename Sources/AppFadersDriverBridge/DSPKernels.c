@@ -0,0 +1,651 @@
+// DSPKernels.c
+// scalar reference + SIMD variants for the IO path kernels
+// the registry picks one table at init time so the IO thread only does an indirect call
+
+#include "DSPKernels.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define AF_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(__ARM_NEON)
+#define AF_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(__APPLE__)
+#include <sys/sysctl.h>
+#endif
+
+// MARK: - Scalar Reference
+
+// raw bit pattern of a sample without breaking strict aliasing
+static inline uint32_t SampleBits(const float *sample)
+{
+  uint32_t bits;
+  memcpy(&bits, sample, sizeof(bits));
+  return bits;
+}
+
+static void Scalar_ApplyGain(float *buffer, uint32_t sampleCount, float gain)
+{
+  for (uint32_t i = 0; i < sampleCount; i++)
+  {
+    buffer[i] *= gain;
+  }
+}
+
+static void Scalar_ApplyGainRamp(float *buffer, uint32_t frameCount, uint32_t channelCount,
+                                 float startGain, float gainStep)
+{
+  for (uint32_t frame = 0; frame < frameCount; frame++)
+  {
+    float gain = startGain + gainStep * (float)frame;
+    float *samples = buffer + (size_t)frame * channelCount;
+    for (uint32_t ch = 0; ch < channelCount; ch++)
+    {
+      samples[ch] *= gain;
+    }
+  }
+}
+
+static float Scalar_Peak(const float *buffer, uint32_t sampleCount)
+{
+  float peak = 0.0f;
+  for (uint32_t i = 0; i < sampleCount; i++)
+  {
+    float value = fabsf(buffer[i]);
+    if (value > peak)
+    {
+      peak = value;
+    }
+  }
+  return peak;
+}
+
+static bool Scalar_IsSilent(const float *buffer, uint32_t sampleCount)
+{
+  uint32_t accumulated = 0;
+  for (uint32_t i = 0; i < sampleCount; i++)
+  {
+    accumulated |= SampleBits(buffer + i);
+  }
+  return (accumulated & 0x7FFFFFFF) == 0;
+}
+
+static const AFKernelTable sScalarTable = {
+    .isa = AFKernelISAScalar,
+    .name = "scalar",
+    .applyGain = Scalar_ApplyGain,
+    .applyGainRamp = Scalar_ApplyGainRamp,
+    .peak = Scalar_Peak,
+    .isSilent = Scalar_IsSilent};
+
+// MARK: - SSE2
+
+#if AF_KERNELS_X86
+
+static void SSE2_ApplyGain(float *buffer, uint32_t sampleCount, float gain)
+{
+  __m128 g = _mm_set1_ps(gain);
+  uint32_t i = 0;
+  for (; i + 4 <= sampleCount; i += 4)
+  {
+    _mm_storeu_ps(buffer + i, _mm_mul_ps(_mm_loadu_ps(buffer + i), g));
+  }
+  for (; i < sampleCount; i++)
+  {
+    buffer[i] *= gain;
+  }
+}
+
+static void SSE2_ApplyGainRamp(float *buffer, uint32_t frameCount, uint32_t channelCount,
+                               float startGain, float gainStep)
+{
+  // vector path covers stereo (2 frames per register), everything else goes scalar
+  if (channelCount != 2)
+  {
+    Scalar_ApplyGainRamp(buffer, frameCount, channelCount, startGain, gainStep);
+    return;
+  }
+
+  __m128 start = _mm_set1_ps(startGain);
+  __m128 step = _mm_set1_ps(gainStep);
+  __m128 lane = _mm_setr_ps(0.0f, 0.0f, 1.0f, 1.0f);
+  uint32_t frame = 0;
+  for (; frame + 2 <= frameCount; frame += 2)
+  {
+    __m128 index = _mm_add_ps(_mm_set1_ps((float)frame), lane);
+    __m128 gain = _mm_add_ps(start, _mm_mul_ps(step, index));
+    float *p = buffer + (size_t)frame * 2;
+    _mm_storeu_ps(p, _mm_mul_ps(_mm_loadu_ps(p), gain));
+  }
+  for (; frame < frameCount; frame++)
+  {
+    float gain = startGain + gainStep * (float)frame;
+    buffer[frame * 2] *= gain;
+    buffer[frame * 2 + 1] *= gain;
+  }
+}
+
+static float SSE2_Peak(const float *buffer, uint32_t sampleCount)
+{
+  __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+  __m128 peak = _mm_setzero_ps();
+  uint32_t i = 0;
+  for (; i + 4 <= sampleCount; i += 4)
+  {
+    peak = _mm_max_ps(peak, _mm_and_ps(_mm_loadu_ps(buffer + i), signMask));
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, peak);
+  float result = lanes[0];
+  for (int l = 1; l < 4; l++)
+  {
+    result = lanes[l] > result ? lanes[l] : result;
+  }
+  for (; i < sampleCount; i++)
+  {
+    float value = fabsf(buffer[i]);
+    result = value > result ? value : result;
+  }
+  return result;
+}
+
+static bool SSE2_IsSilent(const float *buffer, uint32_t sampleCount)
+{
+  __m128i accumulated = _mm_setzero_si128();
+  uint32_t i = 0;
+  for (; i + 4 <= sampleCount; i += 4)
+  {
+    accumulated = _mm_or_si128(accumulated, _mm_loadu_si128((const __m128i *)(buffer + i)));
+  }
+  uint32_t lanes[4];
+  _mm_storeu_si128((__m128i *)lanes, accumulated);
+  uint32_t result = lanes[0] | lanes[1] | lanes[2] | lanes[3];
+  for (; i < sampleCount; i++)
+  {
+    result |= SampleBits(buffer + i);
+  }
+  return (result & 0x7FFFFFFF) == 0;
+}
+
+static const AFKernelTable sSSE2Table = {
+    .isa = AFKernelISASSE2,
+    .name = "sse2",
+    .applyGain = SSE2_ApplyGain,
+    .applyGainRamp = SSE2_ApplyGainRamp,
+    .peak = SSE2_Peak,
+    .isSilent = SSE2_IsSilent};
+
+// MARK: - AVX2
+
+__attribute__((target("avx2"))) static void AVX2_ApplyGain(float *buffer, uint32_t sampleCount,
+                                                           float gain)
+{
+  __m256 g = _mm256_set1_ps(gain);
+  uint32_t i = 0;
+  for (; i + 8 <= sampleCount; i += 8)
+  {
+    _mm256_storeu_ps(buffer + i, _mm256_mul_ps(_mm256_loadu_ps(buffer + i), g));
+  }
+  for (; i < sampleCount; i++)
+  {
+    buffer[i] *= gain;
+  }
+}
+
+__attribute__((target("avx2"))) static void AVX2_ApplyGainRamp(
+    float *buffer, uint32_t frameCount, uint32_t channelCount, float startGain, float gainStep)
+{
+  if (channelCount != 2)
+  {
+    Scalar_ApplyGainRamp(buffer, frameCount, channelCount, startGain, gainStep);
+    return;
+  }
+
+  __m256 start = _mm256_set1_ps(startGain);
+  __m256 step = _mm256_set1_ps(gainStep);
+  __m256 lane = _mm256_setr_ps(0.0f, 0.0f, 1.0f, 1.0f, 2.0f, 2.0f, 3.0f, 3.0f);
+  uint32_t frame = 0;
+  for (; frame + 4 <= frameCount; frame += 4)
+  {
+    __m256 index = _mm256_add_ps(_mm256_set1_ps((float)frame), lane);
+    __m256 gain = _mm256_add_ps(start, _mm256_mul_ps(step, index));
+    float *p = buffer + (size_t)frame * 2;
+    _mm256_storeu_ps(p, _mm256_mul_ps(_mm256_loadu_ps(p), gain));
+  }
+  for (; frame < frameCount; frame++)
+  {
+    float gain = startGain + gainStep * (float)frame;
+    buffer[frame * 2] *= gain;
+    buffer[frame * 2 + 1] *= gain;
+  }
+}
+
+__attribute__((target("avx2"))) static float AVX2_Peak(const float *buffer, uint32_t sampleCount)
+{
+  __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+  __m256 peak = _mm256_setzero_ps();
+  uint32_t i = 0;
+  for (; i + 8 <= sampleCount; i += 8)
+  {
+    peak = _mm256_max_ps(peak, _mm256_and_ps(_mm256_loadu_ps(buffer + i), signMask));
+  }
+  __m128 half = _mm_max_ps(_mm256_castps256_ps128(peak), _mm256_extractf128_ps(peak, 1));
+  float lanes[4];
+  _mm_storeu_ps(lanes, half);
+  float result = lanes[0];
+  for (int l = 1; l < 4; l++)
+  {
+    result = lanes[l] > result ? lanes[l] : result;
+  }
+  for (; i < sampleCount; i++)
+  {
+    float value = fabsf(buffer[i]);
+    result = value > result ? value : result;
+  }
+  return result;
+}
+
+__attribute__((target("avx2"))) static bool AVX2_IsSilent(const float *buffer,
+                                                           uint32_t sampleCount)
+{
+  __m256i accumulated = _mm256_setzero_si256();
+  uint32_t i = 0;
+  for (; i + 8 <= sampleCount; i += 8)
+  {
+    accumulated =
+        _mm256_or_si256(accumulated, _mm256_loadu_si256((const __m256i *)(buffer + i)));
+  }
+  // drop sign bits, then a single test tells us whether anything is left
+  accumulated = _mm256_and_si256(accumulated, _mm256_set1_epi32(0x7FFFFFFF));
+  bool silent = _mm256_testz_si256(accumulated, accumulated);
+  for (; i < sampleCount && silent; i++)
+  {
+    silent = (SampleBits(buffer + i) & 0x7FFFFFFF) == 0;
+  }
+  return silent;
+}
+
+static const AFKernelTable sAVX2Table = {
+    .isa = AFKernelISAAVX2,
+    .name = "avx2",
+    .applyGain = AVX2_ApplyGain,
+    .applyGainRamp = AVX2_ApplyGainRamp,
+    .peak = AVX2_Peak,
+    .isSilent = AVX2_IsSilent};
+
+// MARK: - AVX-512
+
+__attribute__((target("avx512f"))) static void AVX512_ApplyGain(float *buffer,
+                                                                uint32_t sampleCount, float gain)
+{
+  __m512 g = _mm512_set1_ps(gain);
+  uint32_t i = 0;
+  for (; i + 16 <= sampleCount; i += 16)
+  {
+    _mm512_storeu_ps(buffer + i, _mm512_mul_ps(_mm512_loadu_ps(buffer + i), g));
+  }
+  for (; i < sampleCount; i++)
+  {
+    buffer[i] *= gain;
+  }
+}
+
+__attribute__((target("avx512f"))) static void AVX512_ApplyGainRamp(
+    float *buffer, uint32_t frameCount, uint32_t channelCount, float startGain, float gainStep)
+{
+  if (channelCount != 2)
+  {
+    Scalar_ApplyGainRamp(buffer, frameCount, channelCount, startGain, gainStep);
+    return;
+  }
+
+  __m512 start = _mm512_set1_ps(startGain);
+  __m512 step = _mm512_set1_ps(gainStep);
+  __m512 lane = _mm512_setr_ps(0.0f, 0.0f, 1.0f, 1.0f, 2.0f, 2.0f, 3.0f, 3.0f,
+                               4.0f, 4.0f, 5.0f, 5.0f, 6.0f, 6.0f, 7.0f, 7.0f);
+  uint32_t frame = 0;
+  for (; frame + 8 <= frameCount; frame += 8)
+  {
+    __m512 index = _mm512_add_ps(_mm512_set1_ps((float)frame), lane);
+    __m512 gain = _mm512_add_ps(start, _mm512_mul_ps(step, index));
+    float *p = buffer + (size_t)frame * 2;
+    _mm512_storeu_ps(p, _mm512_mul_ps(_mm512_loadu_ps(p), gain));
+  }
+  for (; frame < frameCount; frame++)
+  {
+    float gain = startGain + gainStep * (float)frame;
+    buffer[frame * 2] *= gain;
+    buffer[frame * 2 + 1] *= gain;
+  }
+}
+
+__attribute__((target("avx512f"))) static float AVX512_Peak(const float *buffer,
+                                                            uint32_t sampleCount)
+{
+  __m512 peak = _mm512_setzero_ps();
+  uint32_t i = 0;
+  for (; i + 16 <= sampleCount; i += 16)
+  {
+    peak = _mm512_max_ps(peak, _mm512_abs_ps(_mm512_loadu_ps(buffer + i)));
+  }
+  float result = _mm512_reduce_max_ps(peak);
+  for (; i < sampleCount; i++)
+  {
+    float value = fabsf(buffer[i]);
+    result = value > result ? value : result;
+  }
+  return result;
+}
+
+__attribute__((target("avx512f"))) static bool AVX512_IsSilent(const float *buffer,
+                                                                uint32_t sampleCount)
+{
+  __m512i accumulated = _mm512_setzero_si512();
+  uint32_t i = 0;
+  for (; i + 16 <= sampleCount; i += 16)
+  {
+    accumulated = _mm512_or_si512(accumulated, _mm512_loadu_si512(buffer + i));
+  }
+  bool silent = _mm512_test_epi32_mask(accumulated, _mm512_set1_epi32(0x7FFFFFFF)) == 0;
+  for (; i < sampleCount && silent; i++)
+  {
+    silent = (SampleBits(buffer + i) & 0x7FFFFFFF) == 0;
+  }
+  return silent;
+}
+
+static const AFKernelTable sAVX512Table = {
+    .isa = AFKernelISAAVX512,
+    .name = "avx512",
+    .applyGain = AVX512_ApplyGain,
+    .applyGainRamp = AVX512_ApplyGainRamp,
+    .peak = AVX512_Peak,
+    .isSilent = AVX512_IsSilent};
+
+#endif // AF_KERNELS_X86
+
+// MARK: - NEON
+
+#if AF_KERNELS_NEON
+
+static void NEON_ApplyGain(float *buffer, uint32_t sampleCount, float gain)
+{
+  float32x4_t g = vdupq_n_f32(gain);
+  uint32_t i = 0;
+  for (; i + 8 <= sampleCount; i += 8)
+  {
+    vst1q_f32(buffer + i, vmulq_f32(vld1q_f32(buffer + i), g));
+    vst1q_f32(buffer + i + 4, vmulq_f32(vld1q_f32(buffer + i + 4), g));
+  }
+  for (; i < sampleCount; i++)
+  {
+    buffer[i] *= gain;
+  }
+}
+
+static void NEON_ApplyGainRamp(float *buffer, uint32_t frameCount, uint32_t channelCount,
+                               float startGain, float gainStep)
+{
+  if (channelCount != 2)
+  {
+    Scalar_ApplyGainRamp(buffer, frameCount, channelCount, startGain, gainStep);
+    return;
+  }
+
+  static const float laneValues[4] = {0.0f, 0.0f, 1.0f, 1.0f};
+  float32x4_t start = vdupq_n_f32(startGain);
+  float32x4_t step = vdupq_n_f32(gainStep);
+  float32x4_t lane = vld1q_f32(laneValues);
+  uint32_t frame = 0;
+  for (; frame + 2 <= frameCount; frame += 2)
+  {
+    float32x4_t index = vaddq_f32(vdupq_n_f32((float)frame), lane);
+    float32x4_t gain = vaddq_f32(start, vmulq_f32(step, index));
+    float *p = buffer + (size_t)frame * 2;
+    vst1q_f32(p, vmulq_f32(vld1q_f32(p), gain));
+  }
+  for (; frame < frameCount; frame++)
+  {
+    float gain = startGain + gainStep * (float)frame;
+    buffer[frame * 2] *= gain;
+    buffer[frame * 2 + 1] *= gain;
+  }
+}
+
+static float NEON_Peak(const float *buffer, uint32_t sampleCount)
+{
+  float32x4_t peak = vdupq_n_f32(0.0f);
+  uint32_t i = 0;
+  for (; i + 4 <= sampleCount; i += 4)
+  {
+    peak = vmaxq_f32(peak, vabsq_f32(vld1q_f32(buffer + i)));
+  }
+  float result = vmaxvq_f32(peak);
+  for (; i < sampleCount; i++)
+  {
+    float value = fabsf(buffer[i]);
+    result = value > result ? value : result;
+  }
+  return result;
+}
+
+static bool NEON_IsSilent(const float *buffer, uint32_t sampleCount)
+{
+  uint32x4_t accumulated = vdupq_n_u32(0);
+  uint32_t i = 0;
+  for (; i + 4 <= sampleCount; i += 4)
+  {
+    accumulated = vorrq_u32(accumulated, vreinterpretq_u32_f32(vld1q_f32(buffer + i)));
+  }
+  uint32_t result = vmaxvq_u32(vandq_u32(accumulated, vdupq_n_u32(0x7FFFFFFF)));
+  for (; i < sampleCount; i++)
+  {
+    result |= SampleBits(buffer + i) & 0x7FFFFFFF;
+  }
+  return result == 0;
+}
+
+static const AFKernelTable sNEONTable = {
+    .isa = AFKernelISANEON,
+    .name = "neon",
+    .applyGain = NEON_ApplyGain,
+    .applyGainRamp = NEON_ApplyGainRamp,
+    .peak = NEON_Peak,
+    .isSilent = NEON_IsSilent};
+
+#endif // AF_KERNELS_NEON
+
+// MARK: - CPU Feature Probing
+
+static bool sSupported[AFKernelISACount];
+
+#if AF_KERNELS_X86 && defined(__APPLE__)
+static bool SysctlFlag(const char *name)
+{
+  int value = 0;
+  size_t size = sizeof(value);
+  if (sysctlbyname(name, &value, &size, NULL, 0) != 0)
+  {
+    return false;
+  }
+  return value != 0;
+}
+#endif
+
+static void ProbeFeatures(void)
+{
+  sSupported[AFKernelISAScalar] = true;
+
+#if AF_KERNELS_X86
+  // SSE2 is baseline on x86_64
+  sSupported[AFKernelISASSE2] = true;
+#if defined(__APPLE__)
+  // sysctl only reports features the OS saves state for
+  sSupported[AFKernelISAAVX2] = SysctlFlag("hw.optional.avx2_0");
+  sSupported[AFKernelISAAVX512] = SysctlFlag("hw.optional.avx512f");
+#else
+  __builtin_cpu_init();
+  sSupported[AFKernelISAAVX2] = __builtin_cpu_supports("avx2");
+  sSupported[AFKernelISAAVX512] = __builtin_cpu_supports("avx512f");
+#endif
+#endif
+
+#if AF_KERNELS_NEON
+  // NEON is mandatory on arm64
+  sSupported[AFKernelISANEON] = true;
+#endif
+}
+
+// MARK: - Registry
+
+static const AFKernelTable *const sTables[AFKernelISACount] = {
+    [AFKernelISAScalar] = &sScalarTable,
+#if AF_KERNELS_X86
+    [AFKernelISASSE2] = &sSSE2Table,
+    [AFKernelISAAVX2] = &sAVX2Table,
+    [AFKernelISAAVX512] = &sAVX512Table,
+#endif
+#if AF_KERNELS_NEON
+    [AFKernelISANEON] = &sNEONTable,
+#endif
+};
+
+// preference order, best first
+static const AFKernelISA sPreference[] = {
+    AFKernelISAAVX512,
+    AFKernelISAAVX2,
+    AFKernelISANEON,
+    AFKernelISASSE2,
+    AFKernelISAScalar};
+
+static pthread_once_t sProbeOnce = PTHREAD_ONCE_INIT;
+static _Atomic(const AFKernelTable *) sActive = &sScalarTable;
+
+static void BindBestVariant(void)
+{
+  ProbeFeatures();
+
+  for (size_t i = 0; i < sizeof(sPreference) / sizeof(sPreference[0]); i++)
+  {
+    AFKernelISA isa = sPreference[i];
+    if (sTables[isa] != NULL && sSupported[isa])
+    {
+      atomic_store(&sActive, sTables[isa]);
+      return;
+    }
+  }
+}
+
+void AFKernels_Initialize(void)
+{
+  pthread_once(&sProbeOnce, BindBestVariant);
+}
+
+const AFKernelTable *AFKernels_Active(void)
+{
+  return atomic_load_explicit(&sActive, memory_order_acquire);
+}
+
+const AFKernelTable *AFKernels_Reference(void)
+{
+  return &sScalarTable;
+}
+
+const AFKernelTable *AFKernels_Variant(AFKernelISA isa)
+{
+  if ((unsigned)isa >= AFKernelISACount)
+  {
+    return NULL;
+  }
+
+  // make sure feature flags are populated
+  AFKernels_Initialize();
+
+  if (sTables[isa] == NULL || !sSupported[isa])
+  {
+    return NULL;
+  }
+  return sTables[isa];
+}
+
+bool AFKernels_SetActive(AFKernelISA isa)
+{
+  const AFKernelTable *table = AFKernels_Variant(isa);
+  if (table == NULL)
+  {
+    return false;
+  }
+  atomic_store_explicit(&sActive, table, memory_order_release);
+  return true;
+}
+
+// MARK: - Denormal Protection
+
+#if AF_KERNELS_X86
+static const uint32_t kMXCSRFlushToZero = 0x8000;
+static const uint32_t kMXCSRDenormalsAreZero = 0x0040;
+#elif defined(__aarch64__)
+static const uint64_t kFPCRFlushToZero = 1ULL << 24;
+
+static inline uint64_t ReadFPCR(void)
+{
+  uint64_t value;
+  __asm__ volatile("mrs %0, fpcr" : "=r"(value));
+  return value;
+}
+
+static inline void WriteFPCR(uint64_t value)
+{
+  __asm__ volatile("msr fpcr, %0" : : "r"(value));
+}
+#endif
+
+AFFloatingPointState AFDenormals_Disable(void)
+{
+  AFFloatingPointState previous = {0};
+
+#if AF_KERNELS_X86
+  uint32_t csr = _mm_getcsr();
+  previous.control = csr;
+  uint32_t wanted = csr | kMXCSRFlushToZero | kMXCSRDenormalsAreZero;
+  if (wanted != csr)
+  {
+    _mm_setcsr(wanted);
+  }
+#elif defined(__aarch64__)
+  uint64_t fpcr = ReadFPCR();
+  previous.control = fpcr;
+  if ((fpcr & kFPCRFlushToZero) == 0)
+  {
+    WriteFPCR(fpcr | kFPCRFlushToZero);
+  }
+#endif
+
+  return previous;
+}
+
+void AFDenormals_Restore(AFFloatingPointState state)
+{
+#if AF_KERNELS_X86
+  if (_mm_getcsr() != (uint32_t)state.control)
+  {
+    _mm_setcsr((uint32_t)state.control);
+  }
+#elif defined(__aarch64__)
+  if (ReadFPCR() != state.control)
+  {
+    WriteFPCR(state.control);
+  }
+#else
+  (void)state;
+#endif
+}
@@ -0,0 +1,152 @@
+// IOKernels.c
+// per-format conversion kernels, stamped out by macro so each one sees its
+// sample type and channel count as compile-time constants
+
+#include "IOKernels.h"
+#include <stddef.h>
+#include <string.h>
+
+// MARK: - Sample Decoding
+
+static inline float DecodeFloat32(float sample)
+{
+  return sample;
+}
+
+static inline float DecodeInt16(int16_t sample)
+{
+  return (float)sample * (1.0f / 32768.0f);
+}
+
+// MARK: - Kernel Templates
+
+// interleaved source: frame f, channel c lives at source[f * CHANNELS + c]
+// mono is duplicated to both outputs, extra channels beyond two are dropped
+#define AF_DEFINE_INTERLEAVED_KERNEL(NAME, TYPE, DECODE, CHANNELS)                              \
+  static void NAME(const void *source, uint32_t planeFrameCount, uint32_t firstFrame,          \
+                   float *destination, uint32_t frameCount)                                    \
+  {                                                                                            \
+    (void)planeFrameCount;                                                                     \
+    const TYPE *in = (const TYPE *)source + (size_t)firstFrame * (CHANNELS);                   \
+    for (uint32_t f = 0; f < frameCount; f++)                                                  \
+    {                                                                                          \
+      destination[f * 2] = DECODE(in[f * (CHANNELS)]);                                         \
+      destination[f * 2 + 1] = DECODE(in[f * (CHANNELS) + ((CHANNELS) > 1 ? 1 : 0)]);          \
+    }                                                                                          \
+  }
+
+// planar source: channel c occupies source[c * planeFrameCount ..< (c + 1) * planeFrameCount]
+#define AF_DEFINE_PLANAR_KERNEL(NAME, TYPE, DECODE, CHANNELS)                                   \
+  static void NAME(const void *source, uint32_t planeFrameCount, uint32_t firstFrame,          \
+                   float *destination, uint32_t frameCount)                                    \
+  {                                                                                            \
+    const TYPE *left = (const TYPE *)source + firstFrame;                                      \
+    const TYPE *right = left + ((CHANNELS) > 1 ? (size_t)planeFrameCount : 0);                 \
+    for (uint32_t f = 0; f < frameCount; f++)                                                  \
+    {                                                                                          \
+      destination[f * 2] = DECODE(left[f]);                                                    \
+      destination[f * 2 + 1] = DECODE(right[f]);                                               \
+    }                                                                                          \
+  }
+
+// MARK: - Instantiations
+
+// canonical layout already - straight copy
+static void Float32Stereo_Interleaved(const void *source, uint32_t planeFrameCount,
+                                      uint32_t firstFrame, float *destination,
+                                      uint32_t frameCount)
+{
+  (void)planeFrameCount;
+  memcpy(destination, (const float *)source + (size_t)firstFrame * 2,
+         (size_t)frameCount * 2 * sizeof(float));
+}
+
+AF_DEFINE_INTERLEAVED_KERNEL(Float32Mono_Interleaved, float, DecodeFloat32, 1)
+AF_DEFINE_PLANAR_KERNEL(Float32Stereo_Planar, float, DecodeFloat32, 2)
+AF_DEFINE_INTERLEAVED_KERNEL(Int16Mono_Interleaved, int16_t, DecodeInt16, 1)
+AF_DEFINE_INTERLEAVED_KERNEL(Int16Stereo_Interleaved, int16_t, DecodeInt16, 2)
+AF_DEFINE_PLANAR_KERNEL(Int16Stereo_Planar, int16_t, DecodeInt16, 2)
+
+// MARK: - Kernel Table
+
+static const AFIOKernel sKernels[] = {
+    {AFSampleFormatFloat32, 2, true, 8, "f32.2ch.interleaved", Float32Stereo_Interleaved},
+    {AFSampleFormatFloat32, 1, true, 4, "f32.1ch.interleaved", Float32Mono_Interleaved},
+    {AFSampleFormatFloat32, 2, false, 4, "f32.2ch.planar", Float32Stereo_Planar},
+    {AFSampleFormatInt16, 2, true, 4, "i16.2ch.interleaved", Int16Stereo_Interleaved},
+    {AFSampleFormatInt16, 1, true, 2, "i16.1ch.interleaved", Int16Mono_Interleaved},
+    {AFSampleFormatInt16, 2, false, 2, "i16.2ch.planar", Int16Stereo_Planar},
+};
+
+static const uint32_t sKernelCount = sizeof(sKernels) / sizeof(sKernels[0]);
+
+const AFIOKernel *AFIOKernels_Select(AFSampleFormat sampleFormat, uint32_t channelCount,
+                                     bool interleaved)
+{
+  // mono has no layout distinction
+  if (channelCount == 1)
+  {
+    interleaved = true;
+  }
+
+  for (uint32_t i = 0; i < sKernelCount; i++)
+  {
+    const AFIOKernel *kernel = &sKernels[i];
+    if (kernel->sampleFormat == sampleFormat && kernel->channelCount == channelCount &&
+        kernel->interleaved == interleaved)
+    {
+      return kernel;
+    }
+  }
+  return NULL;
+}
+
+uint32_t AFIOKernels_Count(void)
+{
+  return sKernelCount;
+}
+
+const AFIOKernel *AFIOKernels_At(uint32_t index)
+{
+  return index < sKernelCount ? &sKernels[index] : NULL;
+}
+
+// MARK: - Generic Reference
+
+static float LoadSample(AFSampleFormat sampleFormat, const void *source, size_t index)
+{
+  switch (sampleFormat)
+  {
+  case AFSampleFormatFloat32:
+    return DecodeFloat32(((const float *)source)[index]);
+  case AFSampleFormatInt16:
+    return DecodeInt16(((const int16_t *)source)[index]);
+  }
+  return 0.0f;
+}
+
+void AFIOKernels_ConvertGeneric(AFSampleFormat sampleFormat, uint32_t channelCount,
+                                bool interleaved, const void *source, uint32_t planeFrameCount,
+                                uint32_t firstFrame, float *destination, uint32_t frameCount)
+{
+  uint32_t rightChannel = channelCount > 1 ? 1 : 0;
+
+  for (uint32_t f = 0; f < frameCount; f++)
+  {
+    size_t frame = (size_t)firstFrame + f;
+    size_t left;
+    size_t right;
+    if (interleaved || channelCount == 1)
+    {
+      left = frame * channelCount;
+      right = left + rightChannel;
+    }
+    else
+    {
+      left = frame;
+      right = frame + (size_t)rightChannel * planeFrameCount;
+    }
+    destination[f * 2] = LoadSample(sampleFormat, source, left);
+    destination[f * 2 + 1] = LoadSample(sampleFormat, source, right);
+  }
+}
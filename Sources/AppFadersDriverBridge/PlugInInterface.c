@@ -3,6 +3,7 @@
 // this is what coreaudiod actually calls into
 
 #include "PlugInInterface.h"
+#include "DSPKernels.h"
 #include <CoreAudio/AudioServerPlugIn.h>
 #include <os/log.h>
 #include <stdatomic.h>
@@ -77,6 +78,24 @@ extern OSStatus AppFadersDriver_SetPropertyData(
     UInt32 inDataSize,
     const void *inData);
 
+// clients - from ClientRegistry.swift
+extern OSStatus AppFadersDriver_AddDeviceClient(
+    AudioObjectID inDeviceObjectID,
+    UInt32 inClientID,
+    pid_t inProcessID,
+    CFStringRef inBundleID);
+extern OSStatus AppFadersDriver_RemoveDeviceClient(
+    AudioObjectID inDeviceObjectID,
+    UInt32 inClientID);
+
+// configuration changes - from ConfigurationChange.swift
+extern OSStatus AppFadersDriver_PerformConfigurationChange(
+    AudioObjectID inDeviceObjectID,
+    UInt64 inChangeAction);
+extern OSStatus AppFadersDriver_AbortConfigurationChange(
+    AudioObjectID inDeviceObjectID,
+    UInt64 inChangeAction);
+
 // IO operations - from VirtualStream.swift
 extern OSStatus AppFadersDriver_StartIO(AudioObjectID inDeviceObjectID, UInt32 inClientID);
 extern OSStatus AppFadersDriver_StopIO(AudioObjectID inDeviceObjectID, UInt32 inClientID);
@@ -91,6 +110,20 @@ extern OSStatus AppFadersDriver_DoIOOperation(
     void *ioMainBuffer,
     void *ioSecondaryBuffer);
 
+// IO cycle hooks - from IOCycle.swift
+extern OSStatus AppFadersDriver_BeginIOOperation(
+    AudioObjectID inDeviceObjectID,
+    UInt32 inClientID,
+    UInt32 inOperationID,
+    UInt32 inIOBufferFrameSize,
+    UInt64 inIOCycleCounter,
+    Float64 inOutputSampleTime,
+    UInt64 inOutputHostTime);
+extern OSStatus AppFadersDriver_EndIOOperation(
+    AudioObjectID inDeviceObjectID,
+    UInt32 inClientID,
+    UInt32 inOperationID);
+
 // MARK: - Reference Counting
 
 static _Atomic UInt32 sDriverRefCount = 0;
@@ -210,11 +243,19 @@ static OSStatus PlugIn_AddDeviceClient(
     AudioObjectID inDeviceObjectID,
     const AudioServerPlugInClientInfo *inClientInfo)
 {
+  if (inClientInfo == NULL)
+  {
+    return kAudioHardwareIllegalOperationError;
+  }
+
   LogInfo("AddDeviceClient: device=%u client=%u pid=%d",
           inDeviceObjectID, inClientInfo->mClientID, inClientInfo->mProcessID);
 
-  // TODO(task6): track clients for per-app volume
-  return kAudioHardwareNoError;
+  return AppFadersDriver_AddDeviceClient(
+      inDeviceObjectID,
+      inClientInfo->mClientID,
+      inClientInfo->mProcessID,
+      inClientInfo->mBundleID);
 }
 
 static OSStatus PlugIn_RemoveDeviceClient(
@@ -222,10 +263,14 @@ static OSStatus PlugIn_RemoveDeviceClient(
     AudioObjectID inDeviceObjectID,
     const AudioServerPlugInClientInfo *inClientInfo)
 {
+  if (inClientInfo == NULL)
+  {
+    return kAudioHardwareIllegalOperationError;
+  }
+
   LogInfo("RemoveDeviceClient: device=%u client=%u", inDeviceObjectID, inClientInfo->mClientID);
 
-  // TODO(task6): track clients
-  return kAudioHardwareNoError;
+  return AppFadersDriver_RemoveDeviceClient(inDeviceObjectID, inClientInfo->mClientID);
 }
 
 static OSStatus PlugIn_PerformDeviceConfigurationChange(
@@ -234,10 +279,10 @@ static OSStatus PlugIn_PerformDeviceConfigurationChange(
     UInt64 inChangeAction,
     void *inChangeInfo)
 {
-  // we don't need this - just logging and returning
+  // IO is stopped here - swap in the state prepared when the change was requested
   LogInfo("PerformDeviceConfigurationChange: device=%u action=%llu", inDeviceObjectID, inChangeAction);
 
-  return kAudioHardwareNoError;
+  return AppFadersDriver_PerformConfigurationChange(inDeviceObjectID, inChangeAction);
 }
 
 static OSStatus PlugIn_AbortDeviceConfigurationChange(
@@ -246,10 +291,22 @@ static OSStatus PlugIn_AbortDeviceConfigurationChange(
     UInt64 inChangeAction,
     void *inChangeInfo)
 {
-  // we don't need this - just logging and returning
   LogInfo("AbortDeviceConfigurationChange: device=%u action=%llu", inDeviceObjectID, inChangeAction);
 
-  return kAudioHardwareNoError;
+  return AppFadersDriver_AbortConfigurationChange(inDeviceObjectID, inChangeAction);
+}
+
+// MARK: - Host Requests
+
+OSStatus AppFadersDriver_RequestConfigurationChange(UInt32 inDeviceObjectID, UInt64 inChangeAction)
+{
+  AudioServerPlugInHostRef host = sHost;
+  if (host == NULL)
+  {
+    return kAudioHardwareNotRunningError;
+  }
+
+  return host->RequestDeviceConfigurationChange(host, inDeviceObjectID, inChangeAction, NULL);
 }
 
 // MARK: - Property Operations
@@ -416,9 +473,10 @@ static OSStatus PlugIn_WillDoIOOperation(
     Boolean *outWillDo,
     Boolean *outWillDoInPlace)
 {
-  // we support write operations (output device) and mixing
+  // per-client gain runs in ProcessOutput, the mixed result goes out in WriteMix
   Boolean willDo = false;
-  if (inOperationID == kAudioServerPlugInIOOperationWriteMix)
+  if (inOperationID == kAudioServerPlugInIOOperationProcessOutput ||
+      inOperationID == kAudioServerPlugInIOOperationWriteMix)
   {
     willDo = true;
   }
@@ -438,8 +496,20 @@ static OSStatus PlugIn_BeginIOOperation(
     UInt32 inIOBufferFrameSize,
     const AudioServerPlugInIOCycleInfo *inIOCycleInfo)
 {
-  // no-op - all work done in DoIOOperation
-  return kAudioHardwareNoError;
+  if (inIOCycleInfo == NULL)
+  {
+    return kAudioHardwareIllegalOperationError;
+  }
+
+  // per-cycle work (command drain, control snapshot) runs on the first call of each cycle
+  return AppFadersDriver_BeginIOOperation(
+      inDeviceObjectID,
+      inClientID,
+      inOperationID,
+      inIOBufferFrameSize,
+      inIOCycleInfo->mIOCycleCounter,
+      inIOCycleInfo->mOutputTime.mSampleTime,
+      inIOCycleInfo->mOutputTime.mHostTime);
 }
 
 static OSStatus PlugIn_DoIOOperation(
@@ -471,8 +541,8 @@ static OSStatus PlugIn_EndIOOperation(
     UInt32 inIOBufferFrameSize,
     const AudioServerPlugInIOCycleInfo *inIOCycleInfo)
 {
-  // no-op - all work done in DoIOOperation
-  return kAudioHardwareNoError;
+  // once-per-cycle master work runs after WriteMix
+  return AppFadersDriver_EndIOOperation(inDeviceObjectID, inClientID, inOperationID);
 }
 
 // MARK: - Driver Interface VTable
@@ -532,6 +602,10 @@ void *AppFadersDriver_Create(CFAllocatorRef allocator, CFUUIDRef requestedTypeUU
     return NULL;
   }
 
+  // bind SIMD kernels before any IO can happen
+  AFKernels_Initialize();
+  LogInfo("AppFadersDriver_Create: using %{public}s kernels", AFKernels_Active()->name);
+
   LogInfo("AppFadersDriver_Create: returning driver interface");
   atomic_store(&sDriverRefCount, 1);
   return &gDriverInterfacePtr;
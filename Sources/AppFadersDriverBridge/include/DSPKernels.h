@@ -0,0 +1,86 @@
+// DSPKernels.h
+// AppFadersDriver
+//
+// Runtime-dispatched DSP kernels for the IO path.
+// Every kernel has a scalar reference plus per-ISA variants; the registry probes the CPU
+// once and binds the active table to the best variant the machine supports.
+
+#ifndef DSPKernels_h
+#define DSPKernels_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  /// instruction set a kernel table was built for
+  typedef enum AFKernelISA
+  {
+    AFKernelISAScalar = 0,
+    AFKernelISASSE2 = 1,
+    AFKernelISAAVX2 = 2,
+    AFKernelISAAVX512 = 3,
+    AFKernelISANEON = 4,
+    AFKernelISACount = 5
+  } AFKernelISA;
+
+  /// function table for one ISA variant
+  /// all buffers are interleaved 32-bit float, counts are in samples unless noted
+  typedef struct AFKernelTable
+  {
+    AFKernelISA isa;
+    const char *name;
+
+    /// buffer[i] *= gain
+    void (*applyGain)(float *buffer, uint32_t sampleCount, float gain);
+
+    /// buffer[frame * channels + ch] *= startGain + gainStep * frame
+    void (*applyGainRamp)(float *buffer, uint32_t frameCount, uint32_t channelCount,
+                          float startGain, float gainStep);
+
+    /// max(|buffer[i]|), 0 for an empty buffer
+    float (*peak)(const float *buffer, uint32_t sampleCount);
+
+    /// true if every sample is +0 or -0 (OR-reduction of the bit patterns, sign ignored)
+    bool (*isSilent)(const float *buffer, uint32_t sampleCount);
+  } AFKernelTable;
+
+  /// probe CPU features and bind the active table - safe to call more than once
+  /// called from AppFadersDriver_Create so the IO path never probes
+  void AFKernels_Initialize(void);
+
+  /// best table for this CPU (scalar until AFKernels_Initialize has run)
+  const AFKernelTable *AFKernels_Active(void);
+
+  /// scalar reference implementation, always available
+  const AFKernelTable *AFKernels_Reference(void);
+
+  /// table for a specific ISA, or NULL if not compiled in or not supported by this CPU
+  const AFKernelTable *AFKernels_Variant(AFKernelISA isa);
+
+  /// force the active table to a specific ISA (for validation), returns false if unsupported
+  bool AFKernels_SetActive(AFKernelISA isa);
+
+  // MARK: - Denormal Protection
+
+  /// saved floating-point control register (MXCSR on x86, FPCR on arm64)
+  typedef struct AFFloatingPointState
+  {
+    uint64_t control;
+  } AFFloatingPointState;
+
+  /// turn on flush-to-zero (plus denormals-are-zero on x86) for the calling thread
+  /// returns the previous state so the caller can put it back on exit
+  AFFloatingPointState AFDenormals_Disable(void);
+
+  /// restore a state returned by AFDenormals_Disable - no register write if nothing changed
+  void AFDenormals_Restore(AFFloatingPointState state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DSPKernels_h */
@@ -0,0 +1,61 @@
+// IOKernels.h
+// AppFadersDriver
+//
+// Format-specialized conversion kernels for the IO path.
+// One kernel is instantiated per supported (sample format, channel count, layout) tuple and
+// converts client frames into the canonical ring layout: interleaved stereo 32-bit float.
+
+#ifndef IOKernels_h
+#define IOKernels_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  /// sample encodings the virtual stream can carry
+  typedef enum AFSampleFormat
+  {
+    AFSampleFormatFloat32 = 0,
+    AFSampleFormatInt16 = 1
+  } AFSampleFormat;
+
+  /// converts frameCount frames starting at firstFrame into canonical stereo float
+  /// planeFrameCount is the number of frames per plane (ignored for interleaved layouts)
+  typedef void (*AFIOConvertFunc)(const void *source, uint32_t planeFrameCount,
+                                  uint32_t firstFrame, float *destination, uint32_t frameCount);
+
+  /// one specialization of the conversion for a fixed format tuple
+  typedef struct AFIOKernel
+  {
+    AFSampleFormat sampleFormat;
+    uint32_t channelCount;
+    bool interleaved;
+    uint32_t bytesPerFrame;
+    const char *name;
+    AFIOConvertFunc toCanonical;
+  } AFIOKernel;
+
+  /// specialized kernel for the tuple, or NULL if the format is not supported
+  const AFIOKernel *AFIOKernels_Select(AFSampleFormat sampleFormat, uint32_t channelCount,
+                                       bool interleaved);
+
+  /// number of specialized kernels compiled in
+  uint32_t AFIOKernels_Count(void);
+
+  /// specialized kernel by index (0 ..< AFIOKernels_Count)
+  const AFIOKernel *AFIOKernels_At(uint32_t index);
+
+  /// generic loop that branches on the format at runtime - reference for the specializations
+  void AFIOKernels_ConvertGeneric(AFSampleFormat sampleFormat, uint32_t channelCount,
+                                  bool interleaved, const void *source, uint32_t planeFrameCount,
+                                  uint32_t firstFrame, float *destination, uint32_t frameCount);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOKernels_h */
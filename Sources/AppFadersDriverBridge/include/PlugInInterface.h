@@ -22,6 +22,14 @@ extern "C"
   /// @return Pointer to our AudioServerPlugInDriverInterface, or NULL on failure
   void *AppFadersDriver_Create(CFAllocatorRef allocator, CFUUIDRef requestedTypeUUID);
 
+  /// Ask the host to schedule a device configuration change.
+  /// The host stops IO, then calls PerformDeviceConfigurationChange with the same action.
+  ///
+  /// @param deviceObjectID The device to reconfigure
+  /// @param changeAction Driver-defined action, handed back unchanged in Perform/Abort
+  /// @return the host's status, or kAudioHardwareNotRunningError before Initialize
+  OSStatus AppFadersDriver_RequestConfigurationChange(UInt32 deviceObjectID, UInt64 changeAction);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,110 @@
+import AppFadersVolumeTable
+import Foundation
+import os.log
+
+private let log = OSLog(subsystem: "com.fbreidenbach.appfaders.helper", category: "AppIDRegistry")
+
+/// compact app identifier handed out by AppIDRegistry
+typealias AppID = UInt32
+
+/// interns bundle IDs into compact, stable app IDs
+/// a bundle ID is validated and assigned an ID once; after that every layer can index by the
+/// integer. With a shared volume table the ID is the table entry index, so IDs survive helper
+/// restarts and the driver indexes its gain table by the same number
+///
+/// the registry is the only allocator of IDs and table entries; IDs are handed out through
+/// VolumeStore.register, which gives a new entry the app's stored volume. Entries are never
+/// reused - the driver caches entry indexes - so once capacity IDs are out, new bundle IDs get
+/// none. They aren't refused: the store keeps their volumes, deltas carry them by bundle ID and
+/// drivers apply them through the push path instead of the table
+final class AppIDRegistry: @unchecked Sendable {
+  static let shared = AppIDRegistry(volumeTable: .shared)
+
+  /// longest bundle ID accepted, in UTF-8 bytes
+  static let maxBundleIDLength = 255
+
+  /// IDs available - one per volume table entry
+  static let capacity = Int(AF_VOLUME_TABLE_CAPACITY)
+
+  private let lock = NSLock()
+  private var ids: [String: AppID] = [:]
+  private var bundleIDs: [String] = []
+  private let volumeTable: SharedVolumeTable?
+  private let capacity: Int
+  private var exhaustionLogged = false
+
+  /// - Parameter capacity: IDs to hand out, at most AppIDRegistry.capacity with a volume table
+  init(volumeTable: SharedVolumeTable? = nil, capacity: Int = AppIDRegistry.capacity) {
+    self.volumeTable = volumeTable
+    self.capacity = volumeTable == nil ? capacity : min(capacity, Self.capacity)
+    // entries already in the table keep their IDs
+    for bundleID in volumeTable?.bundleIDs() ?? [] {
+      ids[bundleID] = AppID(bundleIDs.count)
+      bundleIDs.append(bundleID)
+    }
+    os_log(.info, log: log, "AppIDRegistry initialized with %d apps", bundleIDs.count)
+  }
+
+  /// true if a bundle ID could be interned
+  static func isValid(_ bundleID: String) -> Bool {
+    !bundleID.isEmpty && bundleID.utf8.count <= maxBundleIDLength
+  }
+
+  /// ID for a bundle ID, assigning the next one if it's new
+  /// - Returns: the app ID, or nil if the bundle ID is empty or too long, or the registry is full
+  func intern(_ bundleID: String) -> AppID? {
+    lock.lock()
+    defer { lock.unlock() }
+
+    if let id = ids[bundleID] {
+      return id
+    }
+    guard Self.isValid(bundleID) else { return nil }
+    guard bundleIDs.count < capacity else {
+      // every later bundle ID lands here too - once is enough to know the table is full
+      if !exhaustionLogged {
+        exhaustionLogged = true
+        os_log(.error, log: log, "all %d app IDs are assigned - %{public}@ goes by bundle ID",
+               capacity, bundleID)
+      }
+      return nil
+    }
+
+    let id = AppID(bundleIDs.count)
+    // the table entry is added at exactly this index or the ID isn't handed out
+    if let volumeTable, !volumeTable.add(bundleID, as: id) {
+      return nil
+    }
+    ids[bundleID] = id
+    bundleIDs.append(bundleID)
+    return id
+  }
+
+  /// ID of an already interned bundle ID
+  func appID(for bundleID: String) -> AppID? {
+    lock.lock()
+    defer { lock.unlock() }
+    return ids[bundleID]
+  }
+
+  /// bundle ID an app ID was assigned to
+  func bundleID(for appID: AppID) -> String? {
+    lock.lock()
+    defer { lock.unlock() }
+    return Int(appID) < bundleIDs.count ? bundleIDs[Int(appID)] : nil
+  }
+
+  /// number of interned bundle IDs
+  var count: Int {
+    lock.lock()
+    defer { lock.unlock() }
+    return bundleIDs.count
+  }
+
+  /// every ID is assigned - new bundle IDs get none and go by bundle ID
+  var isFull: Bool {
+    lock.lock()
+    defer { lock.unlock() }
+    return bundleIDs.count >= capacity
+  }
+}
@@ -0,0 +1,119 @@
+import AppFadersIPC
+import Foundation
+import os.log
+
+private let log = OSLog(
+  subsystem: "com.fbreidenbach.appfaders.helper",
+  category: "HelperMessageHandler"
+)
+
+/// answers helper requests from every transport - XPC and socket connections alike
+/// every call goes through HelperService, so validation and error codes don't depend on the path
+final class HelperMessageHandler: HelperRequestHandler {
+  private let service: HelperService
+  private let subscriptions: VolumeSubscriptions
+  private let store: VolumeStore
+
+  init(
+    service: HelperService = .shared,
+    subscriptions: VolumeSubscriptions = .shared,
+    store: VolumeStore = .shared
+  ) {
+    self.service = service
+    self.subscriptions = subscriptions
+    self.store = store
+  }
+
+  func handle(
+    _ request: HelperRequest,
+    from peer: HelperPeer,
+    reply: @escaping @Sendable (HelperResponse) -> Void
+  ) {
+    let done: (NSError?) -> Void = { error in reply(Self.response(error) { .done }) }
+    let volumes: ([String: Float], NSError?) -> Void = { volumes, error in
+      reply(Self.response(error) { .volumes(volumes) })
+    }
+
+    switch request {
+    case let .registerApp(bundleID):
+      service.registerApp(bundleID: bundleID) { appID, error in
+        reply(Self.response(error) { .appID(appID) })
+      }
+    case let .setVolume(bundleID, volume):
+      service.setVolume(bundleID: bundleID, volume: volume, reply: done)
+    case let .setAppVolume(appID, volume):
+      service.setVolume(appID: appID, volume: volume, reply: done)
+    case let .getVolume(bundleID):
+      service.getVolume(bundleID: bundleID) { volume, error in
+        reply(Self.response(error) { .volume(volume) })
+      }
+    case let .setAppVolumes(appVolumes, named):
+      service.setVolumes(appVolumes: appVolumes, named: named) { registered, error in
+        reply(Self.response(error) { .registered(registered) })
+      }
+    case let .getAppVolumes(appIDs):
+      service.getVolumes(appIDs: appIDs) { appVolumes, error in
+        reply(Self.response(error) { .appVolumes(appVolumes) })
+      }
+    case .getAllVolumes:
+      service.getAllVolumes(reply: volumes)
+    case let .getVolumeChanges(since):
+      service.getVolumeChanges(since: since) { delta, error in
+        reply(Self.response(error) { .changes(HelperChanges(delta)) })
+      }
+    case let .subscribe(since):
+      subscribe(peer, since: since)
+      reply(.done)
+    case let .saveScene(name, sceneVolumes):
+      service.saveScene(name: name, volumes: sceneVolumes, reply: done)
+    case let .recallScene(name, rampMilliseconds):
+      service.recallScene(name: name, rampMilliseconds: rampMilliseconds, reply: volumes)
+    case let .removeScene(name):
+      service.removeScene(name: name, reply: done)
+    case .getSceneNames:
+      service.getSceneNames { names, error in
+        reply(Self.response(error) { .names(names) })
+      }
+    }
+  }
+
+  func peerDisconnected(_ peer: HelperPeer) {
+    subscriptions.unsubscribe(ObjectIdentifier(peer))
+  }
+
+  /// the subscription lives until the peer disconnects
+  private func subscribe(_ peer: HelperPeer, since generation: UInt64) {
+    subscriptions.subscribe(
+      ObjectIdentifier(peer),
+      since: generation,
+      store: store
+    ) { [weak peer] batch, acknowledge in
+      guard let peer else { return }
+      peer.push(HelperChanges(batch), acknowledged: acknowledge)
+    }
+    os_log(.info, log: log, "peer subscribed since generation %llu", generation)
+  }
+
+  private static func response(
+    _ error: NSError?,
+    _ success: () -> HelperResponse
+  ) -> HelperResponse {
+    guard let error else { return success() }
+    return .failure(code: error.code, message: error.localizedDescription)
+  }
+}
+
+extension HelperChanges {
+  /// the wire form of a store delta
+  init(_ delta: VolumeDelta) {
+    self.init(
+      generation: delta.generation,
+      volumes: delta.volumes,
+      removed: delta.removed,
+      names: delta.names,
+      volumesByBundleID: delta.volumesByBundleID,
+      removedBundleIDs: delta.removedBundleIDs,
+      isSnapshot: delta.isSnapshot
+    )
+  }
+}
@@ -1,3 +1,4 @@
+import AppFadersIPC
 import Foundation
 import os.log
 
@@ -6,21 +7,35 @@ private let log = OSLog(subsystem: "com.fbreidenbach.appfaders.helper", category
 /// Error domain for helper service errors
 private let errorDomain = "com.fbreidenbach.appfaders.helper"
 
-/// XPC service implementation for both host and driver protocols
-final class HelperService: NSObject, AppFadersHostProtocol, AppFadersDriverProtocol,
-@unchecked Sendable {
+/// helper service implementation - HelperMessageHandler maps every transport's requests onto it
+/// subscriptions belong to the connection, so HelperMessageHandler keeps them
+final class HelperService: @unchecked Sendable {
   static let shared = HelperService()
 
-  override private init() {
-    super.init()
+  private let appIDs: AppIDRegistry
+  private let store: VolumeStore
+  private let scenes: SceneStore
+
+  init(
+    appIDs: AppIDRegistry = .shared,
+    store: VolumeStore = .shared,
+    scenes: SceneStore = .shared
+  ) {
+    self.appIDs = appIDs
+    self.store = store
+    self.scenes = scenes
     os_log(.info, log: log, "HelperService initialized")
   }
 
   // MARK: - Validation
 
+  /// interned bundle IDs were validated when they got their app ID
   private func validateBundleID(_ bundleID: String) -> NSError? {
-    guard bundleID.count <= 255 else {
-      os_log(.error, log: log, "Bundle ID too long: %d chars", bundleID.count)
+    if appIDs.appID(for: bundleID) != nil {
+      return nil
+    }
+    guard bundleID.utf8.count <= AppIDRegistry.maxBundleIDLength else {
+      os_log(.error, log: log, "Bundle ID too long: %d bytes", bundleID.utf8.count)
       return NSError(
         domain: errorDomain,
         code: 1,
@@ -50,7 +65,71 @@ final class HelperService: NSObject, AppFadersHostProtocol, AppFadersDriverProto
     return nil
   }
 
-  // MARK: - AppFadersHostProtocol
+  private func unknownAppID(_ appID: UInt32) -> NSError {
+    os_log(.error, log: log, "Unknown app ID: %u", appID)
+    return NSError(
+      domain: errorDomain,
+      code: 5,
+      userInfo: [NSLocalizedDescriptionKey: "App ID \(appID) was never registered"]
+    )
+  }
+
+  private func validateSceneName(_ name: String) -> NSError? {
+    guard !name.isEmpty else {
+      os_log(.error, log: log, "Scene name is empty")
+      return NSError(
+        domain: errorDomain,
+        code: 6,
+        userInfo: [NSLocalizedDescriptionKey: "Scene name cannot be empty"]
+      )
+    }
+    return nil
+  }
+
+  private func unknownScene(_ name: String) -> NSError {
+    NSError(
+      domain: errorDomain,
+      code: 7,
+      userInfo: [NSLocalizedDescriptionKey: "No scene named \(name)"]
+    )
+  }
+
+  private func registryFull() -> NSError {
+    NSError(
+      domain: errorDomain,
+      code: HelperResponse.appIDsExhausted,
+      userInfo: [
+        NSLocalizedDescriptionKey: "All \(AppIDRegistry.capacity) app IDs are assigned"
+      ]
+    )
+  }
+
+  // MARK: - Requests
+
+  /// once every ID is taken a valid bundle ID gets registryFull - the client then sends that
+  /// app by bundle ID, which the store and the drivers handle without an ID
+  func registerApp(bundleID: String, reply: @escaping (UInt32, NSError?) -> Void) {
+    guard let appID = store.register(bundleID) else {
+      reply(0, validateBundleID(bundleID) ?? registryFull())
+      return
+    }
+    os_log(.debug, log: log, "registerApp: %{public}@ = %u", bundleID, appID)
+    reply(appID, nil)
+  }
+
+  func setVolume(appID: UInt32, volume: Float, reply: @escaping (NSError?) -> Void) {
+    if let error = validateVolume(volume) {
+      reply(error)
+      return
+    }
+    guard let bundleID = appIDs.bundleID(for: appID) else {
+      reply(unknownAppID(appID))
+      return
+    }
+
+    store.setVolume(for: bundleID, volume: volume)
+    reply(nil)
+  }
 
   func setVolume(bundleID: String, volume: Float, reply: @escaping (NSError?) -> Void) {
     if let error = validateBundleID(bundleID) {
@@ -62,25 +141,150 @@ final class HelperService: NSObject, AppFadersHostProtocol, AppFadersDriverProto
       return
     }
 
-    VolumeStore.shared.setVolume(for: bundleID, volume: volume)
+    store.setVolume(for: bundleID, volume: volume)
     os_log(.info, log: log, "setVolume: %{public}@ = %.2f", bundleID, volume)
     reply(nil)
   }
 
+  /// - Parameter named: apps the client has no app ID for, by bundle ID - part of the same batch
+  ///   and numbered here; the reply names the IDs they got, apps left out have none
+  func setVolumes(
+    appVolumes: [UInt32: Float],
+    named: [String: Float] = [:],
+    reply: @escaping ([UInt32: String], NSError?) -> Void
+  ) {
+    // validate everything first so a bad entry rejects the whole batch
+    var volumes: [String: Float] = [:]
+    volumes.reserveCapacity(appVolumes.count + named.count)
+    for (appID, volume) in appVolumes {
+      if let error = validateVolume(volume) {
+        reply([:], error)
+        return
+      }
+      guard let bundleID = appIDs.bundleID(for: appID) else {
+        reply([:], unknownAppID(appID))
+        return
+      }
+      volumes[bundleID] = volume
+    }
+    for (bundleID, volume) in named {
+      if let error = validateBundleID(bundleID) ?? validateVolume(volume) {
+        reply([:], error)
+        return
+      }
+      volumes[bundleID] = volume
+    }
+
+    // numbered before the store records the batch, so its changes carry the IDs
+    var registered: [UInt32: String] = [:]
+    for bundleID in named.keys {
+      if let appID = store.register(bundleID) {
+        registered[appID] = bundleID
+      }
+    }
+
+    let changed = store.setVolumes(volumes)
+    os_log(.info, log: log, "setVolumes: %d apps, %d changed, %d registered", volumes.count,
+           changed, registered.count)
+    reply(registered, nil)
+  }
+
+  func getVolumes(
+    appIDs requested: [UInt32],
+    reply: @escaping ([UInt32: Float], NSError?) -> Void
+  ) {
+    var bundleIDs: [String] = []
+    bundleIDs.reserveCapacity(requested.count)
+    for appID in requested {
+      guard let bundleID = appIDs.bundleID(for: appID) else {
+        reply([:], unknownAppID(appID))
+        return
+      }
+      bundleIDs.append(bundleID)
+    }
+
+    // one store read, so the answer is consistent across apps
+    let stored = store.getVolumes(for: bundleIDs)
+    var volumes: [UInt32: Float] = [:]
+    volumes.reserveCapacity(requested.count)
+    for (appID, bundleID) in zip(requested, bundleIDs) {
+      volumes[appID] = stored[bundleID] ?? 1.0
+    }
+    os_log(.debug, log: log, "getVolumes: %d apps", volumes.count)
+    reply(volumes, nil)
+  }
+
   func getVolume(bundleID: String, reply: @escaping (Float, NSError?) -> Void) {
     if let error = validateBundleID(bundleID) {
       reply(0, error)
       return
     }
 
-    let volume = VolumeStore.shared.getVolume(for: bundleID)
+    let volume = store.getVolume(for: bundleID)
     os_log(.debug, log: log, "getVolume: %{public}@ = %.2f", bundleID, volume)
     reply(volume, nil)
   }
 
   func getAllVolumes(reply: @escaping ([String: Float], NSError?) -> Void) {
-    let volumes = VolumeStore.shared.getAllVolumes()
+    let volumes = store.getAllVolumes()
     os_log(.debug, log: log, "getAllVolumes: %d entries", volumes.count)
     reply(volumes, nil)
   }
+
+  func getVolumeChanges(
+    since generation: UInt64,
+    reply: @escaping (VolumeDelta, NSError?) -> Void
+  ) {
+    let delta = store.changes(since: generation)
+    os_log(
+      .debug,
+      log: log,
+      "getVolumeChanges since %llu: %d changed, %d removed%{public}@",
+      generation,
+      delta.volumes.count,
+      delta.removed.count,
+      delta.isSnapshot ? " (snapshot)" : ""
+    )
+    reply(delta, nil)
+  }
+
+  func saveScene(name: String, volumes: [String: Float], reply: @escaping (NSError?) -> Void) {
+    if let error = validateSceneName(name) {
+      reply(error)
+      return
+    }
+    // same rules as setVolumes - a scene with a bad entry could never be recalled whole
+    for (bundleID, volume) in volumes {
+      if let error = validateBundleID(bundleID) ?? validateVolume(volume) {
+        reply(error)
+        return
+      }
+    }
+
+    scenes.saveScene(named: name, volumes: volumes)
+    reply(nil)
+  }
+
+  func recallScene(
+    name: String,
+    rampMilliseconds: UInt32,
+    reply: @escaping ([String: Float], NSError?) -> Void
+  ) {
+    guard let volumes = scenes.recallScene(
+      named: name,
+      rampMilliseconds: rampMilliseconds
+    ) else {
+      reply([:], unknownScene(name))
+      return
+    }
+    reply(volumes, nil)
+  }
+
+  func removeScene(name: String, reply: @escaping (NSError?) -> Void) {
+    reply(scenes.removeScene(named: name) ? nil : unknownScene(name))
+  }
+
+  func getSceneNames(reply: @escaping ([String], NSError?) -> Void) {
+    reply(scenes.sceneNames, nil)
+  }
 }
@@ -0,0 +1,105 @@
+import Foundation
+import os.log
+
+private let log = OSLog(subsystem: "com.fbreidenbach.appfaders.helper", category: "SceneStore")
+
+/// a named set of per-app volumes, compiled once so recall is a single pass over it
+struct VolumeScene: Equatable {
+  struct Entry: Equatable {
+    /// interned app ID - nil if the bundle ID couldn't be interned
+    let appID: AppID?
+    let bundleID: String
+    /// already clamped to 0.0 - 1.0
+    let volume: Float
+  }
+
+  let name: String
+  /// sorted by bundle ID
+  let entries: [Entry]
+
+  var volumes: [String: Float] {
+    Dictionary(uniqueKeysWithValues: entries.map { ($0.bundleID, $0.volume) })
+  }
+}
+
+/// Thread-safe storage for named scenes ("meeting", "focus", "media")
+/// recall goes through VolumeStore as one batch, so the driver switches every app in the same
+/// IO cycle - optionally over one shared ramp
+final class SceneStore: @unchecked Sendable {
+  static let shared = SceneStore(volumeStore: .shared)
+
+  /// longest ramp a recall may ask for
+  static let maxRampMilliseconds: UInt32 = 10000
+
+  private let lock = NSLock()
+  private let volumeStore: VolumeStore
+  private var scenes: [String: VolumeScene] = [:]
+
+  init(volumeStore: VolumeStore) {
+    self.volumeStore = volumeStore
+    os_log(.info, log: log, "SceneStore initialized")
+  }
+
+  /// names of the saved scenes, sorted
+  var sceneNames: [String] {
+    lock.lock()
+    defer { lock.unlock() }
+    return scenes.keys.sorted()
+  }
+
+  /// Save (or replace) a scene
+  /// - Parameters:
+  ///   - name: scene name
+  ///   - volumes: bundleID to volume level (0.0 to 1.0)
+  func saveScene(named name: String, volumes: [String: Float]) {
+    // compile outside the lock - interning may touch the shared table
+    let scene = volumeStore.scene(named: name, from: volumes)
+
+    lock.lock()
+    scenes[name] = scene
+    lock.unlock()
+
+    os_log(.info, log: log, "Scene %{public}@ saved: %d apps", name, scene.entries.count)
+  }
+
+  /// Save the store's current volumes as a scene
+  func saveCurrentScene(named name: String) {
+    saveScene(named: name, volumes: volumeStore.getAllVolumes())
+  }
+
+  /// Get a saved scene
+  func scene(named name: String) -> VolumeScene? {
+    lock.lock()
+    defer { lock.unlock() }
+    return scenes[name]
+  }
+
+  /// Recall a scene as one atomic update
+  /// - Parameters:
+  ///   - name: scene name
+  ///   - rampMilliseconds: how long every app takes to reach its scene volume, 0 for the
+  ///     driver's default - capped at maxRampMilliseconds
+  /// - Returns: the scene's volumes, or nil if there's no scene with that name
+  @discardableResult
+  func recallScene(named name: String, rampMilliseconds: UInt32 = 0) -> [String: Float]? {
+    guard let scene = scene(named: name) else {
+      os_log(.error, log: log, "Scene %{public}@ not found", name)
+      return nil
+    }
+
+    volumeStore.recall(scene, rampMilliseconds: min(rampMilliseconds, Self.maxRampMilliseconds))
+    return scene.volumes
+  }
+
+  /// Remove a scene
+  /// - Returns: false if there was no scene with that name
+  @discardableResult
+  func removeScene(named name: String) -> Bool {
+    lock.lock()
+    let removed = scenes.removeValue(forKey: name) != nil
+    lock.unlock()
+
+    os_log(.info, log: log, "Scene %{public}@ removed", name)
+    return removed
+  }
+}
@@ -0,0 +1,144 @@
+import AppFadersVolumeTable
+import Foundation
+import os.log
+
+private let log = OSLog(
+  subsystem: "com.fbreidenbach.appfaders.helper",
+  category: "SharedVolumeTable"
+)
+
+/// writer side of the shared-memory volume table the driver maps read-only
+/// the region outlives the helper so a driver mapping stays valid across helper restarts;
+/// on launch the entries keep the last helper's values until VolumeStore restores the volumes
+/// it kept - stored and unity together, in one batch, so the driver never hears a jump to unity
+/// entry indexes are app IDs - AppIDRegistry allocates them and is the only caller of add
+/// a copy goes to disk shortly after each change, so a driver loaded before the helper runs
+/// (after a reboot) starts with the right volumes instead of unity
+final class SharedVolumeTable: @unchecked Sendable {
+  static let shared = SharedVolumeTable(snapshotPath: AF_VOLUME_TABLE_SNAPSHOT_PATH)
+
+  /// changes within this window share one snapshot write
+  static let snapshotDelay: TimeInterval = 1.0
+
+  private let lock = NSLock()
+  private let table: OpaquePointer?
+  private let snapshotPath: String?
+  private let snapshotQueue = DispatchQueue(
+    label: "com.fbreidenbach.appfaders.helper.snapshot",
+    qos: .utility
+  )
+  private var snapshotScheduled = false
+
+  /// - Parameter snapshotPath: where to keep the on-disk copy, nil for none
+  init(name: String = AF_VOLUME_TABLE_NAME, snapshotPath: String? = nil) {
+    self.snapshotPath = snapshotPath
+    table = AFVolumeTable_Create(name)
+    guard let table else {
+      os_log(.error, log: log, "cannot create volume table %{public}@: errno %d", name, errno)
+      return
+    }
+    os_log(.info, log: log, "volume table %{public}@ ready: %u entries", name,
+           AFVolumeTable_Count(table))
+  }
+
+  deinit {
+    AFVolumeTable_Close(table)
+  }
+
+  /// bundle IDs of the existing entries, in entry order
+  func bundleIDs() -> [String] {
+    guard let table else { return [] }
+
+    lock.lock()
+    defer { lock.unlock() }
+    return (0 ..< Int32(AFVolumeTable_Count(table))).compactMap { index in
+      AFVolumeTable_BundleID(table, index).map { String(cString: $0) }
+    }
+  }
+
+  /// append the entry for an app ID the registry just allocated - it must be the next index
+  /// - Returns: false if the entry couldn't be added at that index; true without a region
+  func add(_ bundleID: String, as appID: AppID) -> Bool {
+    guard let table else { return true }
+
+    lock.lock()
+    defer { lock.unlock() }
+    guard AFVolumeTable_Count(table) == appID,
+          AFVolumeTable_Intern(table, bundleID) == Int32(appID)
+    else {
+      os_log(.error, log: log, "no volume table entry %u for %{public}@ (%u entries)", appID,
+             bundleID, AFVolumeTable_Count(table))
+      return false
+    }
+    return true
+  }
+
+  /// publish one app's volume - visible to the driver's IO thread at its next cycle
+  func publish(appID: AppID, volume: Float, muted: Bool = false) {
+    guard let table else { return }
+
+    lock.lock()
+    defer { lock.unlock() }
+    AFVolumeTable_SetRamp(table, 0)
+    AFVolumeTable_Write(table, Int32(appID), volume, muted)
+    scheduleSnapshot()
+  }
+
+  /// publish several volumes as one batch - the driver applies all of them in the same cycle
+  /// - Parameter rampMilliseconds: how long every app of the batch takes to reach its new
+  ///   volume, 0 for the driver's default
+  func publish(_ volumes: [(appID: AppID, volume: Float)], rampMilliseconds: UInt32 = 0) {
+    guard let table, !volumes.isEmpty else { return }
+
+    lock.lock()
+    defer { lock.unlock() }
+    AFVolumeTable_BeginBatch(table)
+    AFVolumeTable_SetRamp(table, rampMilliseconds)
+    for (appID, volume) in volumes {
+      AFVolumeTable_Write(table, Int32(appID), volume, false)
+    }
+    AFVolumeTable_EndBatch(table)
+    scheduleSnapshot()
+  }
+
+  /// replace every entry in one batch - the given volumes, unity for the rest
+  /// for a writer starting up: the driver goes from the old values straight to these
+  func restore(_ volumes: [AppID: Float]) {
+    guard let table else { return }
+
+    lock.lock()
+    defer { lock.unlock() }
+    AFVolumeTable_BeginBatch(table)
+    AFVolumeTable_SetRamp(table, 0)
+    for index in 0 ..< AFVolumeTable_Count(table) {
+      AFVolumeTable_Write(table, Int32(index), volumes[AppID(index)] ?? 1.0, false)
+    }
+    AFVolumeTable_EndBatch(table)
+    scheduleSnapshot()
+  }
+
+  /// write the on-disk copy now - pending writes are folded in
+  @discardableResult
+  func writeSnapshot() -> Bool {
+    guard let table, let snapshotPath else { return false }
+
+    lock.lock()
+    defer { lock.unlock() }
+    snapshotScheduled = false
+    // under the lock no write is in flight, so the copy is consistent
+    guard AFVolumeTable_WriteSnapshot(table, snapshotPath) == 0 else {
+      os_log(.error, log: log, "cannot write snapshot %{public}@: errno %d", snapshotPath, errno)
+      return false
+    }
+    return true
+  }
+
+  /// caller holds the lock
+  private func scheduleSnapshot() {
+    guard snapshotPath != nil, !snapshotScheduled else { return }
+    snapshotScheduled = true
+    snapshotQueue.asyncAfter(deadline: .now() + Self.snapshotDelay) { [weak self] in
+      self?.writeSnapshot()
+    }
+  }
+}
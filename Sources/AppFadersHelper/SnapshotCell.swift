@@ -0,0 +1,79 @@
+import Foundation
+import Synchronization
+
+/// holds the current version of an immutable value - read-copy-update
+/// readers never block: load() is two counter updates around an atomic pointer load, so any
+/// number of XPC threads read in parallel. Writers build the next version and publish() it; the
+/// old version is released once every reader that might still be loading it has left (a grace
+/// period over two reader epochs). Writers are serialized and may wait briefly, readers never do
+final class SnapshotCell<Value: AnyObject & Sendable>: @unchecked Sendable {
+  private let current: Atomic<Unmanaged<Value>>
+
+  // readers announce themselves in the counter of the epoch they saw - a writer flips the epoch
+  // and waits for the old counter to drain
+  private let epoch = Atomic<Int>(0)
+  private let evenReaders = Atomic<Int>(0)
+  private let oddReaders = Atomic<Int>(0)
+
+  private let writeLock = NSLock()
+
+  init(_ value: Value) {
+    current = Atomic(Unmanaged.passRetained(value))
+  }
+
+  deinit {
+    current.load(ordering: .relaxed).release()
+  }
+
+  /// the current version - never blocks
+  func load() -> Value {
+    let odd = epoch.load(ordering: .sequentiallyConsistent) & 1 == 1
+    enter(odd)
+    // take our own reference before leaving, so a writer may release its reference right after
+    let value = current.load(ordering: .sequentiallyConsistent).retain()
+    leave(odd)
+    return value.takeRetainedValue()
+  }
+
+  /// make value the current version and release the one it replaces
+  func publish(_ value: Value) {
+    writeLock.withLock {
+      let old = current.exchange(Unmanaged.passRetained(value), ordering: .sequentiallyConsistent)
+      // two flips: a reader that saw the epoch just before the first flip may announce itself
+      // after it, in the counter the first wait doesn't cover
+      waitForReaders()
+      waitForReaders()
+      old.release()
+    }
+  }
+
+  private func enter(_ odd: Bool) {
+    if odd {
+      oddReaders.wrappingAdd(1, ordering: .sequentiallyConsistent)
+    } else {
+      evenReaders.wrappingAdd(1, ordering: .sequentiallyConsistent)
+    }
+  }
+
+  private func leave(_ odd: Bool) {
+    if odd {
+      oddReaders.wrappingSubtract(1, ordering: .sequentiallyConsistent)
+    } else {
+      evenReaders.wrappingSubtract(1, ordering: .sequentiallyConsistent)
+    }
+  }
+
+  /// caller holds writeLock - new readers go to the other epoch, so the wait is bounded
+  private func waitForReaders() {
+    let wasOdd = epoch.wrappingAdd(1, ordering: .sequentiallyConsistent).oldValue & 1 == 1
+    while readers(wasOdd) != 0 {
+      sched_yield()
+    }
+  }
+
+  private func readers(_ odd: Bool) -> Int {
+    odd
+      ? oddReaders.load(ordering: .sequentiallyConsistent)
+      : evenReaders.load(ordering: .sequentiallyConsistent)
+  }
+}
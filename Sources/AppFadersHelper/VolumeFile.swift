@@ -0,0 +1,108 @@
+import AppFadersVolumeFile
+import Foundation
+import os.log
+
+private let log = OSLog(subsystem: "com.fbreidenbach.appfaders.helper", category: "VolumeFile")
+
+/// volumes in a mapped file that outlives the helper
+/// opening maps the file and replays its short journal - volume(for:) reads straight from the
+/// mapping, so opening costs the same with ten volumes or ten thousand
+/// the mapping is not safe to read while a writer grows or compacts it; VolumeStore copies it
+/// once into its published snapshot and only reads the file under its lock
+final class VolumeFile: VolumeStorage {
+  /// next to the helper binary the LaunchDaemon runs
+  static let defaultPath = "/Library/Application Support/AppFaders/volumes.db"
+
+  /// record capacity of a new file - it grows as apps are added
+  static let defaultCapacity: UInt32 = 256
+
+  let path: String
+  private let file: OpaquePointer
+
+  /// - Returns: nil if the file can't be created or mapped
+  init?(path: String = VolumeFile.defaultPath, capacity: UInt32 = VolumeFile.defaultCapacity) {
+    let directory = (path as NSString).deletingLastPathComponent
+    try? FileManager.default.createDirectory(
+      atPath: directory,
+      withIntermediateDirectories: true
+    )
+
+    guard let file = AFVolumeFile_Open(path, capacity) else {
+      os_log(.error, log: log, "cannot open volume file %{public}@: errno %d", path, errno)
+      return nil
+    }
+    self.path = path
+    self.file = file
+    os_log(
+      .info,
+      log: log,
+      "volume file %{public}@ mapped: capacity %u, %u journal entries replayed",
+      path,
+      AFVolumeFile_Capacity(file),
+      AFVolumeFile_JournalLength(file)
+    )
+  }
+
+  deinit {
+    AFVolumeFile_Close(file)
+  }
+
+  func volume(for bundleID: String) -> Float? {
+    var volume: Float = 0
+    return AFVolumeFile_Get(file, bundleID, &volume) ? volume : nil
+  }
+
+  @discardableResult
+  func setVolume(_ volume: Float, for bundleID: String) -> Bool {
+    guard AFVolumeFile_Set(file, bundleID, volume) else {
+      os_log(.error, log: log, "cannot store volume for %{public}@: errno %d", bundleID, errno)
+      return false
+    }
+    return true
+  }
+
+  @discardableResult
+  func removeVolume(for bundleID: String) -> Bool {
+    AFVolumeFile_Remove(file, bundleID)
+  }
+
+  var allVolumes: [String: Float] {
+    var volumes: [String: Float] = [:]
+    volumes.reserveCapacity(count)
+    var bundleID: UnsafePointer<CChar>?
+    var volume: Float = 0
+    var index = AFVolumeFile_Next(file, 0, &bundleID, &volume)
+    while index >= 0, let bundleID {
+      volumes[String(cString: bundleID)] = volume
+      index = AFVolumeFile_Next(file, index + 1, &bundleID, &volume)
+    }
+    return volumes
+  }
+
+  /// number of stored volumes
+  var count: Int {
+    Int(AFVolumeFile_Count(file))
+  }
+
+  /// record capacity of the current table
+  var capacity: Int {
+    Int(AFVolumeFile_Capacity(file))
+  }
+
+  /// journal entries written since the table was last flushed
+  var journalLength: Int {
+    Int(AFVolumeFile_JournalLength(file))
+  }
+
+  /// flush the table and empty the journal
+  @discardableResult
+  func checkpoint() -> Bool {
+    AFVolumeFile_Checkpoint(file)
+  }
+
+  /// rewrite the table without removed entries
+  @discardableResult
+  func compact() -> Bool {
+    AFVolumeFile_Compact(file)
+  }
+}
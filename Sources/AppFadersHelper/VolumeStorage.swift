@@ -0,0 +1,42 @@
+import Foundation
+
+/// where VolumeStore keeps its volumes - calls are serialized by the store's lock
+protocol VolumeStorage: AnyObject {
+  /// stored volume, nil if there is none
+  func volume(for bundleID: String) -> Float?
+
+  /// - Returns: false if the volume couldn't be stored
+  @discardableResult
+  func setVolume(_ volume: Float, for bundleID: String) -> Bool
+
+  /// - Returns: false if there was no volume
+  @discardableResult
+  func removeVolume(for bundleID: String) -> Bool
+
+  /// every stored volume
+  var allVolumes: [String: Float] { get }
+}
+
+/// volumes that live as long as the process - for tests and when the store file can't be opened
+final class InMemoryVolumes: VolumeStorage {
+  private var volumes: [String: Float] = [:]
+
+  func volume(for bundleID: String) -> Float? {
+    volumes[bundleID]
+  }
+
+  @discardableResult
+  func setVolume(_ volume: Float, for bundleID: String) -> Bool {
+    volumes[bundleID] = volume
+    return true
+  }
+
+  @discardableResult
+  func removeVolume(for bundleID: String) -> Bool {
+    volumes.removeValue(forKey: bundleID) != nil
+  }
+
+  var allVolumes: [String: Float] {
+    volumes
+  }
+}
@@ -3,15 +3,274 @@ import os.log
 
 private let log = OSLog(subsystem: "com.fbreidenbach.appfaders.helper", category: "VolumeStore")
 
+/// one recorded store mutation
+struct VolumeChange: Equatable {
+  let generation: UInt64
+  let bundleID: String
+  /// interned when the change is recorded, nil only if the registry was full - the change then
+  /// reaches clients by bundle ID
+  let appID: AppID?
+  /// nil when the volume was removed
+  let volume: Float?
+}
+
+/// what changed since a client's generation - or the whole store if the log can't say
+/// keyed by app ID; apps the full registry had no ID for travel by bundle ID instead
+struct VolumeDelta: Equatable {
+  /// store generation the delta brings the client up to
+  let generation: UInt64
+  /// new or changed volumes (every volume for a snapshot)
+  let volumes: [AppID: Float]
+  /// app IDs whose volume was removed (always empty for a snapshot)
+  let removed: [AppID]
+  /// bundle ID of every app ID in volumes and removed
+  let names: [AppID: String]
+  /// volumes of apps without an app ID, like volumes
+  let volumesByBundleID: [String: Float]
+  /// apps without an app ID whose volume was removed, like removed
+  let removedBundleIDs: [String]
+  /// the client must replace its state instead of merging
+  let isSnapshot: Bool
+
+  init(
+    generation: UInt64,
+    volumes: [AppID: Float],
+    removed: [AppID],
+    names: [AppID: String],
+    volumesByBundleID: [String: Float] = [:],
+    removedBundleIDs: [String] = [],
+    isSnapshot: Bool
+  ) {
+    self.generation = generation
+    self.volumes = volumes
+    self.removed = removed
+    self.names = names
+    self.volumesByBundleID = volumesByBundleID
+    self.removedBundleIDs = removedBundleIDs
+    self.isSnapshot = isSnapshot
+  }
+}
+
+/// one published version of the store - immutable, so readers share it without copying
+/// volumes are spread over a fixed number of chunks by bundle ID hash, and the next version
+/// shares every chunk a write didn't touch: a write copies the chunk list and one chunk per app
+/// it changes, not the store. With 10k volumes that is 64 references and ~160 entries
+/// (VolumeStoreWriteBenchmarkTests)
+final class VolumeSnapshot: Sendable {
+  /// an immutable slice of the volumes, shared between versions
+  final class Chunk: Sendable {
+    let volumes: [String: Float]
+
+    init(_ volumes: [String: Float]) {
+      self.volumes = volumes
+    }
+  }
+
+  static let chunkCount = 64
+
+  /// generation of the last change this version includes
+  let generation: UInt64
+  /// number of volumes
+  let count: Int
+  let chunks: [Chunk]
+
+  init(generation: UInt64, volumes: [String: Float]) {
+    var split = Array(repeating: [String: Float](), count: Self.chunkCount)
+    for (bundleID, volume) in volumes {
+      split[Self.chunkIndex(bundleID)][bundleID] = volume
+    }
+    self.generation = generation
+    count = volumes.count
+    chunks = split.map(Chunk.init)
+  }
+
+  private init(generation: UInt64, count: Int, chunks: [Chunk]) {
+    self.generation = generation
+    self.count = count
+    self.chunks = chunks
+  }
+
+  /// hash values are only stable within a process - fine, snapshots never leave it
+  private static func chunkIndex(_ bundleID: String) -> Int {
+    Int(UInt(bitPattern: bundleID.hashValue) % UInt(chunkCount))
+  }
+
+  func volume(for bundleID: String) -> Float? {
+    chunks[Self.chunkIndex(bundleID)].volumes[bundleID]
+  }
+
+  /// every volume in one dictionary - O(n), a new dictionary per call
+  var volumes: [String: Float] {
+    var all: [String: Float] = [:]
+    all.reserveCapacity(count)
+    forEach { bundleID, volume in all[bundleID] = volume }
+    return all
+  }
+
+  func forEach(_ body: (String, Float) throws -> Void) rethrows {
+    for chunk in chunks {
+      for (bundleID, volume) in chunk.volumes {
+        try body(bundleID, volume)
+      }
+    }
+  }
+
+  /// the next version with changes applied - only the chunks they touch are copied
+  func applying(_ changes: [VolumeChange], generation: UInt64) -> VolumeSnapshot {
+    var next = chunks
+    var touched: [Int: [String: Float]] = [:]
+    var count = self.count
+    for change in changes {
+      let index = Self.chunkIndex(change.bundleID)
+      // taken out of touched so the copy is mutated in place after the first change
+      var volumes = touched.removeValue(forKey: index) ?? next[index].volumes
+      if let volume = change.volume {
+        if volumes.updateValue(volume, forKey: change.bundleID) == nil {
+          count += 1
+        }
+      } else if volumes.removeValue(forKey: change.bundleID) != nil {
+        count -= 1
+      }
+      touched[index] = volumes
+    }
+    for (index, volumes) in touched {
+      next[index] = Chunk(volumes)
+    }
+    return VolumeSnapshot(generation: generation, count: count, chunks: next)
+  }
+}
+
 /// Thread-safe storage for application-specific volumes
+/// every mutation bumps a generation counter and lands in a bounded change log, so clients can
+/// sync by asking for changes since the generation they last saw
+///
+/// reads don't take the lock: writers publish each new version as an immutable snapshot and
+/// getters read whichever snapshot is current, so XPC threads never wait on a setter
 final class VolumeStore: @unchecked Sendable {
-  static let shared = VolumeStore()
+  static let shared = VolumeStore(
+    appIDs: .shared,
+    volumeTable: .shared,
+    storage: VolumeFile() ?? InMemoryVolumes()
+  ) { changes in
+    VolumeSubscriptions.shared.publish(changes)
+  }
+
+  /// changes kept for delta sync - a client further behind gets a snapshot
+  static let defaultChangeLogCapacity = 1024
 
   private let lock = NSLock()
-  private var volumes: [String: Float] = [:]
+  private let volumes: VolumeStorage
+  private let appIDs: AppIDRegistry
+  private let volumeTable: SharedVolumeTable?
+  private let changeHandler: (@Sendable ([VolumeChange]) -> Void)?
+
+  // change log ring - the change with generation g lives at (g - 1) % capacity
+  private let changeLogCapacity: Int
+  private var changeLog: [VolumeChange?]
+  private var generation: UInt64 = 0
+
+  // readers load the published snapshot; writers start from latest, under the lock
+  private let published: SnapshotCell<VolumeSnapshot>
+  private var latest: VolumeSnapshot
+
+  /// - Parameters:
+  ///   - storage: where volumes are kept - a VolumeFile keeps them across helper restarts
+  ///   - changeHandler: called with the changes of every store update in generation order,
+  ///     under the store's lock - it must not call back into the store
+  init(
+    appIDs: AppIDRegistry = AppIDRegistry(),
+    volumeTable: SharedVolumeTable? = nil,
+    storage: VolumeStorage = InMemoryVolumes(),
+    changeLogCapacity: Int = VolumeStore.defaultChangeLogCapacity,
+    changeHandler: (@Sendable ([VolumeChange]) -> Void)? = nil
+  ) {
+    self.appIDs = appIDs
+    self.volumeTable = volumeTable
+    volumes = storage
+    self.changeHandler = changeHandler
+    self.changeLogCapacity = max(changeLogCapacity, 1)
+    changeLog = Array(repeating: nil, count: self.changeLogCapacity)
+
+    // one copy of the stored volumes, then never again: lock-free readers need an immutable
+    // version, and the mapped file can be remapped under them by a growing or compacting write
+    // a 10k-entry file takes a few milliseconds (VolumeFileTests.storeStartup)
+    let stored = storage.allVolumes
+    latest = VolumeSnapshot(generation: 0, volumes: stored)
+    published = SnapshotCell(latest)
+
+    // the table still holds the last helper's values - stored volumes and the unity reset of
+    // everything else go out as one batch, so no app passes through unity on the way
+    // only apps that already have an entry: a stored app is numbered once a client or host names
+    // it (register), so old volumes don't use up the table
+    if let volumeTable {
+      var restored: [AppID: Float] = [:]
+      for appID in 0 ..< AppID(appIDs.count) {
+        if let bundleID = appIDs.bundleID(for: appID), let volume = stored[bundleID] {
+          restored[appID] = volume
+        }
+      }
+      volumeTable.restore(restored)
+    }
+    os_log(.info, log: log, "VolumeStore initialized with %d stored volumes", stored.count)
+  }
+
+  /// generation of the latest change, 0 for an untouched store
+  var currentGeneration: UInt64 {
+    published.load().generation
+  }
+
+  /// the current version of the store - O(1), never waits for a writer
+  var snapshot: VolumeSnapshot {
+    published.load()
+  }
+
+  /// caller holds the lock - publishes the next version with the given changes applied
+  /// the new version shares every chunk the changes don't touch
+  private func publishSnapshot(_ changes: [VolumeChange]) {
+    guard !changes.isEmpty else { return }
+    latest = latest.applying(changes, generation: generation)
+    published.publish(latest)
+  }
+
+  /// app ID for a bundle ID, numbering the app if it has none yet
+  /// every caller that hands IDs out goes through here rather than AppIDRegistry.intern: a new
+  /// table entry starts at unity, and an app with a stored volume must not play at unity
+  /// - Returns: nil if the bundle ID is invalid or the registry is full
+  func register(_ bundleID: String) -> AppID? {
+    lock.lock()
+    defer { lock.unlock() }
+    return intern(bundleID)
+  }
+
+  /// caller holds the lock - a new entry gets the app's stored volume before anyone sees the ID
+  private func intern(_ bundleID: String) -> AppID? {
+    if let appID = appIDs.appID(for: bundleID) {
+      return appID
+    }
+    guard let appID = appIDs.intern(bundleID) else { return nil }
+    if let volumeTable, let volume = latest.volume(for: bundleID) {
+      volumeTable.publish(appID: appID, volume: volume)
+    }
+    return appID
+  }
+
+  /// caller holds the lock - the app ID is interned here unless the caller already has it
+  private func record(_ bundleID: String, appID: AppID? = nil, volume: Float?) -> VolumeChange {
+    generation += 1
+    let change = VolumeChange(
+      generation: generation,
+      bundleID: bundleID,
+      appID: appID ?? intern(bundleID),
+      volume: volume
+    )
+    changeLog[Int((generation - 1) % UInt64(changeLogCapacity))] = change
+    return change
+  }
 
-  private init() {
-    os_log(.info, log: log, "VolumeStore initialized")
+  /// caller holds the lock
+  private func publish(_ change: VolumeChange, volume: Float) {
+    guard let volumeTable, let appID = change.appID else { return }
+    volumeTable.publish(appID: appID, volume: volume)
   }
 
   /// Set volume for a specific application
@@ -21,37 +280,200 @@ final class VolumeStore: @unchecked Sendable {
   func setVolume(for bundleID: String, volume: Float) {
     let clampedVolume = max(0.0, min(1.0, volume))
 
+    // published under the lock so the table and subscribers see changes in generation order
     lock.lock()
-    volumes[bundleID] = clampedVolume
+    if volumes.volume(for: bundleID) != clampedVolume,
+       volumes.setVolume(clampedVolume, for: bundleID) {
+      let change = record(bundleID, volume: clampedVolume)
+      publishSnapshot([change])
+      publish(change, volume: clampedVolume)
+      changeHandler?([change])
+    }
     lock.unlock()
 
     os_log(.info, log: log, "Volume set for %{public}@: %.2f", bundleID, clampedVolume)
   }
 
+  /// Set many volumes as one update - one table batch and one change notification
+  /// - Parameters:
+  ///   - newVolumes: bundleID to volume level (0.0 to 1.0), clamped like setVolume
+  ///   - rampMilliseconds: how long the driver ramps every app of the batch, 0 for its default
+  /// - Returns: number of volumes that actually changed
+  @discardableResult
+  func setVolumes(_ newVolumes: [String: Float], rampMilliseconds: UInt32 = 0) -> Int {
+    let entries = newVolumes.map { bundleID, volume in
+      VolumeScene.Entry(appID: nil, bundleID: bundleID, volume: max(0.0, min(1.0, volume)))
+    }
+    let changed = applyBatch(entries, rampMilliseconds: rampMilliseconds)
+    os_log(.info, log: log, "Volumes set: %d of %d changed", changed, newVolumes.count)
+    return changed
+  }
+
+  /// Compile volumes into a scene - bundle IDs are interned and volumes clamped once, up front
+  /// - Parameters:
+  ///   - name: scene name
+  ///   - volumes: bundleID to volume level (0.0 to 1.0)
+  func scene(named name: String, from volumes: [String: Float]) -> VolumeScene {
+    let entries = volumes.keys.sorted().map { bundleID in
+      VolumeScene.Entry(
+        appID: register(bundleID),
+        bundleID: bundleID,
+        volume: max(0.0, min(1.0, volumes[bundleID] ?? 1.0))
+      )
+    }
+    return VolumeScene(name: name, entries: entries)
+  }
+
+  /// Apply a compiled scene as one update - one table batch and one change notification
+  /// - Parameters:
+  ///   - scene: scene from scene(named:from:) on this store
+  ///   - rampMilliseconds: how long the driver ramps every app of the scene, 0 for its default
+  /// - Returns: number of volumes that actually changed
+  @discardableResult
+  func recall(_ scene: VolumeScene, rampMilliseconds: UInt32 = 0) -> Int {
+    let changed = applyBatch(scene.entries, rampMilliseconds: rampMilliseconds)
+    os_log(
+      .info,
+      log: log,
+      "Scene %{public}@ recalled: %d of %d changed",
+      scene.name,
+      changed,
+      scene.entries.count
+    )
+    return changed
+  }
+
+  /// entries carry clamped volumes; a missing app ID is interned here
+  private func applyBatch(_ entries: [VolumeScene.Entry], rampMilliseconds: UInt32) -> Int {
+    var changes: [VolumeChange] = []
+    var tableEntries: [(appID: AppID, volume: Float)] = []
+
+    lock.lock()
+    for entry in entries {
+      guard volumes.volume(for: entry.bundleID) != entry.volume,
+            volumes.setVolume(entry.volume, for: entry.bundleID) else { continue }
+      let change = record(entry.bundleID, appID: entry.appID, volume: entry.volume)
+      changes.append(change)
+      if volumeTable != nil, let appID = change.appID {
+        tableEntries.append((appID, entry.volume))
+      }
+    }
+    publishSnapshot(changes)
+    volumeTable?.publish(tableEntries, rampMilliseconds: rampMilliseconds)
+    if !changes.isEmpty {
+      changeHandler?(changes)
+    }
+    lock.unlock()
+
+    return changes.count
+  }
+
   /// Get volume for a specific application
   /// - Parameter bundleID: application bundle identifier
   /// - Returns: volume level (defaults to 1.0 if unknown)
   func getVolume(for bundleID: String) -> Float {
-    lock.lock()
-    let volume = volumes[bundleID] ?? 1.0
-    lock.unlock()
-    return volume
+    published.load().volume(for: bundleID) ?? 1.0
   }
 
-  /// Get all stored volumes
+  /// Get volumes for several applications in one call
+  /// - Parameter bundleIDs: application bundle identifiers
+  /// - Returns: bundleID to volume level (1.0 for unknown apps)
+  func getVolumes(for bundleIDs: [String]) -> [String: Float] {
+    // one snapshot, so the answer is consistent across apps
+    let snapshot = published.load()
+    var result: [String: Float] = [:]
+    for bundleID in bundleIDs {
+      result[bundleID] = snapshot.volume(for: bundleID) ?? 1.0
+    }
+    return result
+  }
+
+  /// Get all stored volumes - O(n) without the lock: the current snapshot's chunks are merged
   /// - Returns: dictionary of bundleID to volume
   func getAllVolumes() -> [String: Float] {
+    published.load().volumes
+  }
+
+  /// Changes since a generation the caller has already applied
+  /// cost scales with the number of changes, not the size of the store
+  /// - Parameter since: generation from the caller's last delta, 0 for a first sync
+  /// - Returns: a merged delta, or a full snapshot if the log no longer reaches back that far
+  func changes(since: UInt64) -> VolumeDelta {
     lock.lock()
-    let copy = volumes
-    lock.unlock()
-    return copy
+    defer { lock.unlock() }
+
+    // a first sync, a generation from before a helper restart, or a log that has wrapped
+    guard since != 0, since <= generation, generation - since <= UInt64(changeLogCapacity) else {
+      var volumes: [AppID: Float] = [:]
+      var names: [AppID: String] = [:]
+      var volumesByBundleID: [String: Float] = [:]
+      latest.forEach { bundleID, volume in
+        guard let appID = appIDs.appID(for: bundleID) else {
+          volumesByBundleID[bundleID] = volume
+          return
+        }
+        volumes[appID] = volume
+        names[appID] = bundleID
+      }
+      return VolumeDelta(
+        generation: generation,
+        volumes: volumes,
+        removed: [],
+        names: names,
+        volumesByBundleID: volumesByBundleID,
+        isSnapshot: true
+      )
+    }
+
+    var changed: [AppID: Float] = [:]
+    var removed = Set<AppID>()
+    var names: [AppID: String] = [:]
+    var changedByBundleID: [String: Float] = [:]
+    var removedBundleIDs = Set<String>()
+    var next = since
+    while next < generation {
+      next += 1
+      guard let change = changeLog[Int((next - 1) % UInt64(changeLogCapacity))] else { continue }
+      guard let appID = change.appID else {
+        if let volume = change.volume {
+          changedByBundleID[change.bundleID] = volume
+          removedBundleIDs.remove(change.bundleID)
+        } else {
+          changedByBundleID.removeValue(forKey: change.bundleID)
+          removedBundleIDs.insert(change.bundleID)
+        }
+        continue
+      }
+      names[appID] = change.bundleID
+      if let volume = change.volume {
+        changed[appID] = volume
+        removed.remove(appID)
+      } else {
+        changed.removeValue(forKey: appID)
+        removed.insert(appID)
+      }
+    }
+    return VolumeDelta(
+      generation: generation,
+      volumes: changed,
+      removed: removed.sorted(),
+      names: names,
+      volumesByBundleID: changedByBundleID,
+      removedBundleIDs: removedBundleIDs.sorted(),
+      isSnapshot: false
+    )
   }
 
   /// Remove volume setting for an application
   /// - Parameter bundleID: application bundle identifier
   func removeVolume(for bundleID: String) {
     lock.lock()
-    volumes.removeValue(forKey: bundleID)
+    if volumes.removeVolume(for: bundleID) {
+      let change = record(bundleID, volume: nil)
+      publishSnapshot([change])
+      publish(change, volume: 1.0)
+      changeHandler?([change])
+    }
     lock.unlock()
 
     os_log(.info, log: log, "Volume removed for %{public}@", bundleID)
@@ -0,0 +1,263 @@
+import Foundation
+import os.log
+
+private let log = OSLog(
+  subsystem: "com.fbreidenbach.appfaders.helper",
+  category: "VolumeSubscriptions"
+)
+
+// MARK: - Volume Subscription
+
+/// pushes coalesced volume changes to one subscriber
+/// at most one batch is in flight; changes that arrive meanwhile collapse to the latest value
+/// per app, so a slow subscriber sees fewer, larger batches instead of an unbounded backlog
+/// batches are keyed by app ID; each bundle ID is named to the subscriber once, and apps the
+/// full registry couldn't number go by bundle ID
+final class VolumeSubscription: @unchecked Sendable {
+  /// hands a batch to the subscriber - call the acknowledgement once it has been applied
+  typealias Deliver = @Sendable (VolumeDelta, @escaping @Sendable () -> Void) -> Void
+
+  private let lock = NSLock()
+  private let deliver: Deliver
+
+  // pending batch - latest change per app, plus a snapshot to send first if the seed was one
+  // keyed by bundle ID, which every change has, numbered or not
+  private var pending: [String: VolumeChange] = [:]
+  private var pendingSnapshot: VolumeDelta?
+  private var inFlight = false
+  /// registered but not seeded yet - live changes wait so the seed always goes out first
+  private var awaitingSeed: Bool
+  /// app IDs whose bundle ID went out in an earlier batch
+  private var named = Set<AppID>()
+
+  // stats - changes offered vs batches actually sent
+  private var received = 0
+  private var delivered = 0
+
+  /// - Parameter awaitingSeed: hold live changes until start(with:) has sent the seed
+  init(deliver: @escaping Deliver, awaitingSeed: Bool = false) {
+    self.deliver = deliver
+    self.awaitingSeed = awaitingSeed
+  }
+
+  var changesReceived: Int {
+    lock.lock()
+    defer { lock.unlock() }
+    return received
+  }
+
+  var batchesDelivered: Int {
+    lock.lock()
+    defer { lock.unlock() }
+    return delivered
+  }
+
+  /// seed with what the subscriber missed before subscribing
+  /// live changes held since registration go out with it - older ones are already in the seed
+  func start(with delta: VolumeDelta) {
+    lock.lock()
+    awaitingSeed = false
+    if delta.isSnapshot {
+      pendingSnapshot = delta
+    } else {
+      for (appID, volume) in delta.volumes {
+        merge(seed(appID, volume: volume, in: delta))
+      }
+      for appID in delta.removed {
+        merge(seed(appID, volume: nil, in: delta))
+      }
+      for (bundleID, volume) in delta.volumesByBundleID {
+        merge(seed(bundleID, volume: volume, in: delta))
+      }
+      for bundleID in delta.removedBundleIDs {
+        merge(seed(bundleID, volume: nil, in: delta))
+      }
+    }
+    let batch = takeBatch()
+    lock.unlock()
+
+    send(batch)
+  }
+
+  /// offer one store update - sent now if nothing is in flight, else coalesced
+  func enqueue(_ changes: [VolumeChange]) {
+    lock.lock()
+    received += changes.count
+    for change in changes {
+      merge(change)
+    }
+    let batch = takeBatch()
+    lock.unlock()
+
+    send(batch)
+  }
+
+  func enqueue(_ change: VolumeChange) {
+    enqueue([change])
+  }
+
+  /// the subscriber applied the last batch - send whatever piled up meanwhile
+  func acknowledge() {
+    lock.lock()
+    inFlight = false
+    let batch = takeBatch()
+    lock.unlock()
+
+    send(batch)
+  }
+
+  /// a seed entry as a change, so it coalesces with the live stream
+  private func seed(_ appID: AppID, volume: Float?, in delta: VolumeDelta) -> VolumeChange {
+    VolumeChange(
+      generation: delta.generation,
+      bundleID: delta.names[appID] ?? "",
+      appID: appID,
+      volume: volume
+    )
+  }
+
+  /// a seed entry for an app without an app ID
+  private func seed(_ bundleID: String, volume: Float?, in delta: VolumeDelta) -> VolumeChange {
+    VolumeChange(generation: delta.generation, bundleID: bundleID, appID: nil, volume: volume)
+  }
+
+  /// caller holds the lock
+  /// the seed and the live stream can overlap - the newest generation wins
+  private func merge(_ change: VolumeChange) {
+    if let existing = pending[change.bundleID], existing.generation >= change.generation {
+      return
+    }
+    pending[change.bundleID] = change
+  }
+
+  /// caller holds the lock - the next batch if one can be sent, marking it in flight
+  private func takeBatch() -> VolumeDelta? {
+    guard !inFlight, !awaitingSeed, pendingSnapshot != nil || !pending.isEmpty else { return nil }
+
+    var generation: UInt64 = 0
+    var volumes: [AppID: Float] = [:]
+    var removed = Set<AppID>()
+    var names: [AppID: String] = [:]
+    var volumesByBundleID: [String: Float] = [:]
+    var removedBundleIDs = Set<String>()
+    if let snapshot = pendingSnapshot {
+      // the subscriber replaces its names along with its volumes
+      generation = snapshot.generation
+      volumes = snapshot.volumes
+      names = snapshot.names
+      volumesByBundleID = snapshot.volumesByBundleID
+      named = Set(snapshot.names.keys)
+    }
+    for change in pending.values {
+      // already part of the snapshot
+      if let snapshot = pendingSnapshot, change.generation <= snapshot.generation { continue }
+      generation = max(generation, change.generation)
+      guard let appID = change.appID else {
+        if let volume = change.volume {
+          volumesByBundleID[change.bundleID] = volume
+          removedBundleIDs.remove(change.bundleID)
+        } else {
+          volumesByBundleID.removeValue(forKey: change.bundleID)
+          if pendingSnapshot == nil {
+            removedBundleIDs.insert(change.bundleID)
+          }
+        }
+        continue
+      }
+      if named.insert(appID).inserted {
+        names[appID] = change.bundleID
+      }
+      if let volume = change.volume {
+        volumes[appID] = volume
+        removed.remove(appID)
+      } else {
+        volumes.removeValue(forKey: appID)
+        // a snapshot replaces the subscriber's state, so it never needs removals
+        if pendingSnapshot == nil {
+          removed.insert(appID)
+        }
+      }
+    }
+
+    let batch = VolumeDelta(
+      generation: generation,
+      volumes: volumes,
+      removed: removed.sorted(),
+      names: names,
+      volumesByBundleID: volumesByBundleID,
+      removedBundleIDs: removedBundleIDs.sorted(),
+      isSnapshot: pendingSnapshot != nil
+    )
+    pending.removeAll(keepingCapacity: true)
+    pendingSnapshot = nil
+    inFlight = true
+    delivered += 1
+    return batch
+  }
+
+  private func send(_ batch: VolumeDelta?) {
+    guard let batch else { return }
+    deliver(batch) { [weak self] in
+      self?.acknowledge()
+    }
+  }
+}
+
+// MARK: - Volume Subscriptions
+
+/// every subscribed driver connection, fed from VolumeStore's change stream
+final class VolumeSubscriptions: @unchecked Sendable {
+  static let shared = VolumeSubscriptions()
+
+  private let lock = NSLock()
+  private var subscribers: [ObjectIdentifier: VolumeSubscription] = [:]
+
+  /// register a subscriber and seed it with the changes since its generation
+  /// registration comes first so no change can fall between the seed and the stream; changes
+  /// published before the seed is sent are held, or the seed would arrive behind a newer delta
+  /// and the driver would drop it as stale
+  @discardableResult
+  func subscribe(
+    _ subscriber: ObjectIdentifier,
+    since generation: UInt64,
+    store: VolumeStore,
+    deliver: @escaping VolumeSubscription.Deliver
+  ) -> VolumeSubscription {
+    let subscription = VolumeSubscription(deliver: deliver, awaitingSeed: true)
+    lock.lock()
+    subscribers[subscriber] = subscription
+    let count = subscribers.count
+    lock.unlock()
+
+    subscription.start(with: store.changes(since: generation))
+    os_log(.info, log: log, "subscriber added since generation %llu (%d total)", generation, count)
+    return subscription
+  }
+
+  func unsubscribe(_ subscriber: ObjectIdentifier) {
+    lock.lock()
+    let removed = subscribers.removeValue(forKey: subscriber)
+    lock.unlock()
+
+    if let removed {
+      os_log(
+        .info,
+        log: log,
+        "subscriber removed: %d changes in %d batches",
+        removed.changesReceived,
+        removed.batchesDelivered
+      )
+    }
+  }
+
+  /// fan one store update out to every subscriber
+  func publish(_ changes: [VolumeChange]) {
+    lock.lock()
+    let current = Array(subscribers.values)
+    lock.unlock()
+
+    for subscription in current {
+      subscription.enqueue(changes)
+    }
+  }
+}
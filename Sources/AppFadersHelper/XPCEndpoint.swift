@@ -0,0 +1,88 @@
+import AppFadersIPC
+import Foundation
+import os.log
+
+private let log = OSLog(subsystem: "com.fbreidenbach.appfaders.helper", category: "XPCEndpoint")
+
+/// exported object of one XPC connection - decodes each message and hands it to the same
+/// HelperRequestHandler the socket listener uses
+final class XPCEndpoint: NSObject, AppFadersHostProtocol, @unchecked Sendable {
+  private let peer: XPCPeer
+  private let handler: HelperRequestHandler
+
+  init(connection: NSXPCConnection, handler: HelperRequestHandler) {
+    peer = XPCPeer(connection: connection)
+    self.handler = handler
+  }
+
+  func send(message: Data, reply: @escaping (Data) -> Void) {
+    let reply = Reply(send: reply)
+    let request: HelperRequest
+    do {
+      request = try MessageCodec.decodeRequest(message)
+    } catch {
+      os_log(.error, log: log, "undecodable message: %{public}@", "\(error)")
+      reply.send(Data(MessageCodec.encode(.failure(code: -1, message: "\(error)"))))
+      return
+    }
+    handler.handle(request, from: peer) { response in
+      reply.send(Data(MessageCodec.encode(response)))
+    }
+  }
+
+  /// ends the connection's subscription, if it has one
+  func invalidated() {
+    handler.peerDisconnected(peer)
+  }
+}
+
+/// an XPC client as the handler sees it - pushes go to the observer the client exported
+private final class XPCPeer: HelperPeer, @unchecked Sendable {
+  private weak var connection: NSXPCConnection?
+
+  init(connection: NSXPCConnection) {
+    self.connection = connection
+  }
+
+  func push(_ changes: HelperChanges, acknowledged: @escaping @Sendable () -> Void) {
+    // every path acknowledges exactly once - an unacknowledged push stalls the subscription
+    let acknowledge = AcknowledgeOnce(acknowledged)
+    guard let connection else {
+      acknowledge.run()
+      return
+    }
+    guard let observer = connection.remoteObjectProxyWithErrorHandler({ error in
+      os_log(.error, log: log, "volume push failed: %{public}@", error.localizedDescription)
+      acknowledge.run()
+    }) as? AppFadersVolumeObserverProtocol else {
+      os_log(.error, log: log, "connection exports no volume observer")
+      acknowledge.run()
+      return
+    }
+    observer.volumesChanged(message: Data(MessageCodec.encode(changes))) { acknowledge.run() }
+  }
+}
+
+/// XPC may call both the reply and the proxy error handler - the first one wins
+private final class AcknowledgeOnce: @unchecked Sendable {
+  private let lock = NSLock()
+  private var acknowledged: (@Sendable () -> Void)?
+
+  init(_ acknowledged: @escaping @Sendable () -> Void) {
+    self.acknowledged = acknowledged
+  }
+
+  func run() {
+    let acknowledged = lock.withLock {
+      let acknowledged = self.acknowledged
+      self.acknowledged = nil
+      return acknowledged
+    }
+    acknowledged?()
+  }
+}
+
+/// XPC reply blocks may be called from any thread
+private struct Reply: @unchecked Sendable {
+  let send: (Data) -> Void
+}
@@ -1,11 +1,19 @@
+import AppFadersIPC
 import Foundation
 import os.log
 
 private let log = OSLog(subsystem: "com.fbreidenbach.appfaders.helper", category: "Main")
-private let machServiceName = "com.fbreidenbach.appfaders.helper"
+private let machServiceName = XPCHelperTransport.defaultServiceName
+
+/// set to a path to also serve the helper protocol on a Unix domain socket - for load tests
+/// and benchmarks, launchd never sets it
+private let socketPathVariable = "APPFADERS_HELPER_SOCKET"
 
 /// Delegate for accepting XPC connections
 final class ListenerDelegate: NSObject, NSXPCListenerDelegate, @unchecked Sendable {
+  /// shared by XPC and socket connections
+  let messageHandler = HelperMessageHandler()
+
   func listener(
     _ listener: NSXPCListener,
     shouldAcceptNewConnection newConnection: NSXPCConnection
@@ -13,14 +21,19 @@ final class ListenerDelegate: NSObject, NSXPCListenerDelegate, @unchecked Sendab
     os_log(.info, log: log, "Accepting new XPC connection")
 
     // Configure the connection's exported interface
-    // Both host and driver use AppFadersHostProtocol for now
-    // (driver only calls the read methods)
+    // Both host and driver use AppFadersHostProtocol (driver only sends read requests)
+    let endpoint = XPCEndpoint(connection: newConnection, handler: messageHandler)
     newConnection.exportedInterface = NSXPCInterface(with: AppFadersHostProtocol.self)
-    newConnection.exportedObject = HelperService.shared
+    newConnection.exportedObject = endpoint
+    // Drivers that subscribe to volume changes export the observer side
+    newConnection.remoteObjectInterface = NSXPCInterface(
+      with: AppFadersVolumeObserverProtocol.self
+    )
 
     // Handle connection lifecycle
     newConnection.invalidationHandler = {
       os_log(.info, log: log, "XPC connection invalidated")
+      endpoint.invalidated()
     }
     newConnection.interruptionHandler = {
       os_log(.info, log: log, "XPC connection interrupted")
@@ -31,14 +44,38 @@ final class ListenerDelegate: NSObject, NSXPCListenerDelegate, @unchecked Sendab
   }
 }
 
+/// serve the helper protocol on the socket named by APPFADERS_HELPER_SOCKET, if set
+private func startSocketListener(handler: HelperRequestHandler) -> SocketHelperListener? {
+  guard let path = ProcessInfo.processInfo.environment[socketPathVariable], !path.isEmpty else {
+    return nil
+  }
+  let server = SocketHelperListener(path: path, handler: handler)
+  do {
+    try server.start()
+  } catch {
+    os_log(.error, log: log, "Socket listener failed: %{public}@", "\(error)")
+    return nil
+  }
+  os_log(.info, log: log, "Socket listener started: %{public}@", path)
+  return server
+}
+
 // MARK: - Entry Point
 
 os_log(.info, log: log, "AppFadersHelper starting with service: %{public}@", machServiceName)
 
+// create the shared volume table before the driver can connect and look for it, then
+// republish the volumes kept from the last run
+_ = SharedVolumeTable.shared
+_ = VolumeStore.shared
+
 let delegate = ListenerDelegate()
 let listener = NSXPCListener(machServiceName: machServiceName)
 listener.delegate = delegate
 listener.resume()
 
+// kept for the life of the process
+let socketListener = startSocketListener(handler: delegate.messageHandler)
+
 os_log(.info, log: log, "XPC listener started, entering run loop")
 RunLoop.main.run()
@@ -0,0 +1,100 @@
+import Foundation
+
+// MARK: - App Activity
+
+/// one app's audio as the driver sees it - every HAL client the app owns, folded together
+public struct AppActivity: Equatable, Sendable {
+  /// volume table key of the owning app's bundle ID (AFVolumeTable_Key)
+  public let key: UInt64
+  /// some client of the app sent non-silent audio within the driver's silence hold
+  public let isProducing: Bool
+  /// largest absolute sample over the driver's last peak window, before gain
+  public let peak: Float
+
+  public init(key: UInt64, isProducing: Bool, peak: Float) {
+    self.key = key
+    self.isProducing = isProducing
+    self.peak = peak
+  }
+}
+
+// MARK: - Activity Feed
+
+/// driver -> host encoding of per-app activity, carried as CFData in the device's custom property
+/// the host polls it at a low rate instead of asking about each app
+///
+/// layout, integers little-endian:
+///   version (UInt8), count (UInt32)
+///   producing bitmap - (count + 7) / 8 bytes, bit i of byte i / 8 is app i
+///   count entries of key (UInt64) and peak (Float), sorted by key
+/// keys stand in for bundle IDs - the host hashes the bundle IDs it knows and matches them
+public enum ActivityFeed {
+  /// format written by this build - readers reject other versions
+  public static let version: UInt8 = 1
+
+  /// 'afpa' - device custom property selector the feed is read through
+  public static let propertySelector: UInt32 = 0x6166_7061
+
+  private static let entrySize = 12
+
+  public static func encode(_ activity: [AppActivity]) -> [UInt8] {
+    let sorted = activity.sorted { $0.key < $1.key }
+    var writer = WireWriter(capacity: 5 + (sorted.count + 7) / 8 + sorted.count * entrySize)
+    writer.write(version)
+    writer.write(UInt32(sorted.count))
+
+    var bitmap = [UInt8](repeating: 0, count: (sorted.count + 7) / 8)
+    for (index, app) in sorted.enumerated() where app.isProducing {
+      bitmap[index / 8] |= 1 << UInt8(index % 8)
+    }
+    writer.write(bytes: bitmap)
+
+    for app in sorted {
+      writer.write(app.key)
+      writer.write(app.peak)
+    }
+    return writer.bytes
+  }
+
+  /// throws HelperTransportError for another version or a malformed feed
+  public static func decode(_ payload: some ContiguousBytes) throws -> [AppActivity] {
+    try payload.withUnsafeBytes { bytes in
+      var reader = WireReader(bytes)
+      let found = try reader.readUInt8()
+      guard found == version else {
+        throw HelperTransportError.unsupportedVersion(found)
+      }
+
+      let count = Int(try reader.readUInt32())
+      let bitmapSize = (count + 7) / 8
+      // checked before anything is allocated - the whole feed has a known size
+      guard count <= reader.remaining / entrySize,
+            reader.remaining == bitmapSize + count * entrySize else {
+        throw HelperTransportError.malformedMessage("\(count) apps in \(reader.remaining) bytes")
+      }
+
+      var bitmap: [UInt8] = []
+      bitmap.reserveCapacity(bitmapSize)
+      for _ in 0 ..< bitmapSize {
+        bitmap.append(try reader.readUInt8())
+      }
+
+      var activity: [AppActivity] = []
+      activity.reserveCapacity(count)
+      for index in 0 ..< count {
+        let key = try reader.readUInt64()
+        let peak = try reader.readFloat()
+        guard peak.isFinite, peak >= 0 else {
+          throw HelperTransportError.malformedMessage("peak \(peak)")
+        }
+        activity.append(AppActivity(
+          key: key,
+          isProducing: bitmap[index / 8] & (1 << UInt8(index % 8)) != 0,
+          peak: peak
+        ))
+      }
+      try reader.finish()
+      return activity
+    }
+  }
+}
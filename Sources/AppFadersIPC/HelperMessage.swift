@@ -0,0 +1,95 @@
+import Foundation
+
+/// changes since a generation - pulled with getVolumeChanges or pushed to subscribers
+/// apps are keyed by the app IDs registerApp hands out; a bundle ID travels once, in names
+/// apps the helper has no app ID for (its table is full) are keyed by bundle ID instead
+public struct HelperChanges: Equatable, Sendable {
+  /// helper store generation the changes bring the client up to
+  public let generation: UInt64
+  /// new or changed volumes by app ID (every volume for a snapshot)
+  public let volumes: [UInt32: Float]
+  /// app IDs whose volume was removed (always empty for a snapshot)
+  public let removed: [UInt32]
+  /// bundle IDs of the app IDs the client may not know yet (every app ID for a snapshot)
+  public let names: [UInt32: String]
+  /// new or changed volumes of apps without an app ID, by bundle ID
+  public let volumesByBundleID: [String: Float]
+  /// apps without an app ID whose volume was removed
+  public let removedBundleIDs: [String]
+  /// the client must replace its state instead of merging
+  public let isSnapshot: Bool
+
+  public init(
+    generation: UInt64,
+    volumes: [UInt32: Float],
+    removed: [UInt32],
+    names: [UInt32: String],
+    volumesByBundleID: [String: Float] = [:],
+    removedBundleIDs: [String] = [],
+    isSnapshot: Bool
+  ) {
+    self.generation = generation
+    self.volumes = volumes
+    self.removed = removed
+    self.names = names
+    self.volumesByBundleID = volumesByBundleID
+    self.removedBundleIDs = removedBundleIDs
+    self.isSnapshot = isSnapshot
+  }
+}
+
+/// one call on the helper - host and driver protocols share the set, drivers only read
+public enum HelperRequest: Equatable, Sendable {
+  case registerApp(bundleID: String)
+  case setVolume(bundleID: String, volume: Float)
+  case setAppVolume(appID: UInt32, volume: Float)
+  case getVolume(bundleID: String)
+  /// batches carry app IDs; apps the client has no ID for go in named, by bundle ID - the helper
+  /// numbers them and answers .registered, so a cold batch is still one round trip
+  case setAppVolumes([UInt32: Float], named: [String: Float])
+  case getAppVolumes(appIDs: [UInt32])
+  case getAllVolumes
+  case getVolumeChanges(since: UInt64)
+  /// the helper pushes changes after the generation until the connection closes
+  case subscribe(since: UInt64)
+  case saveScene(name: String, volumes: [String: Float])
+  case recallScene(name: String, rampMilliseconds: UInt32)
+  case removeScene(name: String)
+  case getSceneNames
+}
+
+/// the helper's answer to one request
+public enum HelperResponse: Equatable, Sendable {
+  case done
+  case appID(UInt32)
+  case volume(Float)
+  case volumes([String: Float])
+  case appVolumes([UInt32: Float])
+  /// app IDs the helper assigned to named apps of setAppVolumes - an app left out has none
+  case registered([UInt32: String])
+  case changes(HelperChanges)
+  case names([String])
+  /// the helper rejected the request - codes match the helper's NSError codes
+  case failure(code: Int, message: String)
+}
+
+public extension HelperResponse {
+  /// failure code of registerApp once every app ID is assigned - the app isn't refused, it
+  /// keeps working through the bundle-ID requests
+  static let appIDsExhausted = 8
+}
+
+/// errors raised by a transport, or a helper failure surfaced by send
+public enum HelperTransportError: Error, Equatable, Sendable {
+  case notConnected
+  case connectionFailed(String)
+  /// the connection was lost before the reply arrived
+  case disconnected
+  /// bytes that don't decode to a message
+  case malformedMessage(String)
+  /// a message in a wire format version this build doesn't read
+  case unsupportedVersion(UInt8)
+  /// the reply doesn't fit the request
+  case unexpectedResponse
+  case remote(code: Int, message: String)
+}
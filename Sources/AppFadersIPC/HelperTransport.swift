@@ -0,0 +1,83 @@
+import Foundation
+
+/// a change batch the helper pushed after subscribe - call the acknowledgement once applied,
+/// the helper holds the next batch until then
+public typealias HelperChangeHandler =
+  @Sendable (HelperChanges, @escaping @Sendable () -> Void) -> Void
+
+/// client end of a connection to the helper - XPC in production, a Unix socket for tests and
+/// load runs; host and driver talk to the helper only through this
+public protocol HelperTransport: AnyObject, Sendable {
+  /// open the connection
+  /// - Parameters:
+  ///   - onChanges: receives pushed change batches, in order
+  ///   - onDisconnect: called once if the connection is lost - not after close()
+  func start(
+    onChanges: @escaping HelperChangeHandler,
+    onDisconnect: @escaping @Sendable () -> Void
+  ) throws
+
+  /// send one request - reply is called exactly once, on an arbitrary thread
+  func send(
+    _ request: HelperRequest,
+    reply: @escaping @Sendable (Result<HelperResponse, HelperTransportError>) -> Void
+  )
+
+  /// close the connection - pending replies fail with .disconnected
+  func close()
+}
+
+public extension HelperTransport {
+  /// send one request and wait for the reply
+  /// - Throws: HelperTransportError, .remote if the helper answered with a failure
+  func send(_ request: HelperRequest) async throws -> HelperResponse {
+    let response = try await withCheckedThrowingContinuation { continuation in
+      send(request) { result in
+        continuation.resume(with: result)
+      }
+    }
+    if case let .failure(code, message) = response {
+      throw HelperTransportError.remote(code: code, message: message)
+    }
+    return response
+  }
+}
+
+extension HelperTransport {
+  /// recover from a pushed batch that couldn't be read - pull a snapshot and hand it to
+  /// onChanges, then run done
+  /// transports call this before acknowledging the lost batch: the helper holds the next push
+  /// until then, so nothing newer can overtake the snapshot
+  func resync(
+    _ onChanges: @escaping HelperChangeHandler,
+    then done: @escaping @Sendable () -> Void
+  ) {
+    send(.getVolumeChanges(since: 0)) { result in
+      guard case let .success(.changes(snapshot)) = result else {
+        done()
+        return
+      }
+      onChanges(snapshot, done)
+    }
+  }
+}
+
+/// one connected client, as seen by the helper
+public protocol HelperPeer: AnyObject, Sendable {
+  /// push a change batch to the client - acknowledged runs once the client applied it, or
+  /// once the push is known to have failed; it must always run, the next batch waits for it
+  func push(_ changes: HelperChanges, acknowledged: @escaping @Sendable () -> Void)
+}
+
+/// helper side of every transport - answers requests, whichever backend carried them
+public protocol HelperRequestHandler: Sendable {
+  /// reply is called exactly once, from any thread
+  func handle(
+    _ request: HelperRequest,
+    from peer: HelperPeer,
+    reply: @escaping @Sendable (HelperResponse) -> Void
+  )
+
+  /// the peer's connection closed - drop its subscription
+  func peerDisconnected(_ peer: HelperPeer)
+}
@@ -0,0 +1,509 @@
+import Foundation
+
+// MARK: - Wire Primitives
+
+/// appends little-endian integers, floats and length-prefixed strings
+public struct WireWriter: Sendable {
+  public private(set) var bytes: [UInt8] = []
+
+  public init(capacity: Int = 64) {
+    bytes.reserveCapacity(capacity)
+  }
+
+  public mutating func write(_ value: UInt8) {
+    bytes.append(value)
+  }
+
+  public mutating func write(_ value: UInt32) {
+    withUnsafeBytes(of: value.littleEndian) { bytes.append(contentsOf: $0) }
+  }
+
+  public mutating func write(_ value: UInt64) {
+    withUnsafeBytes(of: value.littleEndian) { bytes.append(contentsOf: $0) }
+  }
+
+  public mutating func write(_ value: Float) {
+    write(value.bitPattern)
+  }
+
+  public mutating func write(_ value: Bool) {
+    write(UInt8(value ? 1 : 0))
+  }
+
+  public mutating func write(_ value: String) {
+    let utf8 = Array(value.utf8)
+    write(UInt32(utf8.count))
+    bytes.append(contentsOf: utf8)
+  }
+
+  public mutating func write(_ values: [String]) {
+    write(UInt32(values.count))
+    for value in values {
+      write(value)
+    }
+  }
+
+  /// sorted by key, so equal dictionaries encode to equal bytes
+  public mutating func write(_ volumes: [String: Float]) {
+    write(UInt32(volumes.count))
+    for bundleID in volumes.keys.sorted() {
+      write(bundleID)
+      write(volumes[bundleID] ?? 1.0)
+    }
+  }
+
+  public mutating func write(_ values: [UInt32]) {
+    write(UInt32(values.count))
+    for value in values {
+      write(value)
+    }
+  }
+
+  /// sorted by app ID, like the bundle-ID map
+  public mutating func write(_ volumes: [UInt32: Float]) {
+    write(UInt32(volumes.count))
+    for appID in volumes.keys.sorted() {
+      write(appID)
+      write(volumes[appID] ?? 1.0)
+    }
+  }
+
+  /// sorted by app ID
+  public mutating func write(_ names: [UInt32: String]) {
+    write(UInt32(names.count))
+    for appID in names.keys.sorted() {
+      write(appID)
+      write(names[appID] ?? "")
+    }
+  }
+
+  public mutating func write(bytes more: some Sequence<UInt8>) {
+    bytes.append(contentsOf: more)
+  }
+}
+
+/// reads what WireWriter wrote, in place - no bytes are copied until a field is materialized
+/// every read is bounds-checked and throws on short or hostile input; only valid inside the
+/// withUnsafeBytes call that produced the buffer
+public struct WireReader {
+  /// longest string a message may carry - bundle IDs are at most 255 bytes, scene names short
+  public static let maxStringLength = 4096
+
+  private let bytes: UnsafeRawBufferPointer
+  private var offset = 0
+
+  public init(_ bytes: UnsafeRawBufferPointer) {
+    self.bytes = bytes
+  }
+
+  public var remaining: Int {
+    bytes.count - offset
+  }
+
+  private mutating func take(_ count: Int) throws -> UnsafeRawBufferPointer {
+    guard count >= 0, count <= remaining else {
+      throw HelperTransportError.malformedMessage("needs \(count) bytes, has \(remaining)")
+    }
+    defer { offset += count }
+    return UnsafeRawBufferPointer(rebasing: bytes[offset ..< offset + count])
+  }
+
+  public mutating func readUInt8() throws -> UInt8 {
+    try take(1)[0]
+  }
+
+  public mutating func readUInt32() throws -> UInt32 {
+    UInt32(littleEndian: try take(4).loadUnaligned(as: UInt32.self))
+  }
+
+  public mutating func readUInt64() throws -> UInt64 {
+    UInt64(littleEndian: try take(8).loadUnaligned(as: UInt64.self))
+  }
+
+  public mutating func readFloat() throws -> Float {
+    Float(bitPattern: try readUInt32())
+  }
+
+  /// a volume must at least be a number - range checks are the helper's business
+  public mutating func readVolume() throws -> Float {
+    let volume = try readFloat()
+    guard volume.isFinite else {
+      throw HelperTransportError.malformedMessage("volume \(volume)")
+    }
+    return volume
+  }
+
+  public mutating func readBool() throws -> Bool {
+    switch try readUInt8() {
+    case 0: return false
+    case 1: return true
+    case let other: throw HelperTransportError.malformedMessage("bool \(other)")
+    }
+  }
+
+  public mutating func readString() throws -> String {
+    let length = Int(try readUInt32())
+    guard length <= Self.maxStringLength else {
+      throw HelperTransportError.malformedMessage("string of \(length) bytes")
+    }
+    guard let string = String(validating: try take(length), as: UTF8.self) else {
+      throw HelperTransportError.malformedMessage("invalid UTF-8")
+    }
+    return string
+  }
+
+  /// a count of elements at least minimumSize bytes each - checked before anything is allocated
+  private mutating func readCount(minimumSize: Int) throws -> Int {
+    let count = Int(try readUInt32())
+    guard count <= remaining / minimumSize else {
+      throw HelperTransportError.malformedMessage("\(count) elements in \(remaining) bytes")
+    }
+    return count
+  }
+
+  public mutating func readStrings() throws -> [String] {
+    let count = try readCount(minimumSize: 4)
+    var values: [String] = []
+    values.reserveCapacity(count)
+    for _ in 0 ..< count {
+      values.append(try readString())
+    }
+    return values
+  }
+
+  /// duplicate keys are rejected - a writer never produces them
+  public mutating func readVolumes() throws -> [String: Float] {
+    let count = try readCount(minimumSize: 8)
+    var volumes: [String: Float] = [:]
+    volumes.reserveCapacity(count)
+    for _ in 0 ..< count {
+      let bundleID = try readString()
+      guard volumes.updateValue(try readVolume(), forKey: bundleID) == nil else {
+        throw HelperTransportError.malformedMessage("duplicate key")
+      }
+    }
+    return volumes
+  }
+
+  public mutating func readAppIDs() throws -> [UInt32] {
+    let count = try readCount(minimumSize: 4)
+    var values: [UInt32] = []
+    values.reserveCapacity(count)
+    for _ in 0 ..< count {
+      values.append(try readUInt32())
+    }
+    return values
+  }
+
+  /// duplicate app IDs are rejected, like duplicate bundle IDs
+  public mutating func readAppVolumes() throws -> [UInt32: Float] {
+    let count = try readCount(minimumSize: 8)
+    var volumes: [UInt32: Float] = [:]
+    volumes.reserveCapacity(count)
+    for _ in 0 ..< count {
+      let appID = try readUInt32()
+      guard volumes.updateValue(try readVolume(), forKey: appID) == nil else {
+        throw HelperTransportError.malformedMessage("duplicate key")
+      }
+    }
+    return volumes
+  }
+
+  public mutating func readNames() throws -> [UInt32: String] {
+    let count = try readCount(minimumSize: 8)
+    var names: [UInt32: String] = [:]
+    names.reserveCapacity(count)
+    for _ in 0 ..< count {
+      let appID = try readUInt32()
+      guard names.updateValue(try readString(), forKey: appID) == nil else {
+        throw HelperTransportError.malformedMessage("duplicate key")
+      }
+    }
+    return names
+  }
+
+  /// nothing may follow the last field
+  public func finish() throws {
+    guard remaining == 0 else {
+      throw HelperTransportError.malformedMessage("\(remaining) trailing bytes")
+    }
+  }
+}
+
+// MARK: - Message Codec
+
+/// payload encoding of requests, responses and pushed changes - the same bytes travel in socket
+/// frames and as the Data of an XPC message
+///
+/// layout, integers little-endian:
+///   version (UInt8), tag (UInt8), then the message's fields in declaration order
+///   integers and floats are fixed width; a Bool is one byte, 0 or 1
+///   a string is its UTF-8 length (UInt32) and bytes, a list its count (UInt32) and elements
+///   a volume map is a count and (bundle ID, Float) entries, sorted by bundle ID; an app volume
+///   map the same with (UInt32 app ID, Float) entries and a name map with (app ID, string)
+///   entries, both sorted by app ID
+/// decoding reads straight from the received buffer; a message with an unknown version, an
+/// unknown tag, a short or overlong field or trailing bytes is rejected as a whole
+public enum MessageCodec {
+  /// format written by this build - bump for any layout change, readers reject other versions
+  public static let version: UInt8 = 5
+
+  private enum RequestTag: UInt8 {
+    case registerApp = 1
+    case setVolume
+    case setAppVolume
+    case getVolume
+    case setAppVolumes
+    case getAppVolumes
+    case getAllVolumes
+    case getVolumeChanges
+    case subscribe
+    case saveScene
+    case recallScene
+    case removeScene
+    case getSceneNames
+  }
+
+  private enum ResponseTag: UInt8 {
+    case done = 1
+    case appID
+    case volume
+    case volumes
+    case appVolumes
+    case changes
+    case names
+    case failure
+    case registered
+  }
+
+  public static func encode(_ request: HelperRequest) -> [UInt8] {
+    var writer = WireWriter()
+    writer.write(version)
+    switch request {
+    case let .registerApp(bundleID):
+      writer.write(RequestTag.registerApp.rawValue)
+      writer.write(bundleID)
+    case let .setVolume(bundleID, volume):
+      writer.write(RequestTag.setVolume.rawValue)
+      writer.write(bundleID)
+      writer.write(volume)
+    case let .setAppVolume(appID, volume):
+      writer.write(RequestTag.setAppVolume.rawValue)
+      writer.write(appID)
+      writer.write(volume)
+    case let .getVolume(bundleID):
+      writer.write(RequestTag.getVolume.rawValue)
+      writer.write(bundleID)
+    case let .setAppVolumes(volumes, named):
+      writer.write(RequestTag.setAppVolumes.rawValue)
+      writer.write(volumes)
+      writer.write(named)
+    case let .getAppVolumes(appIDs):
+      writer.write(RequestTag.getAppVolumes.rawValue)
+      writer.write(appIDs)
+    case .getAllVolumes:
+      writer.write(RequestTag.getAllVolumes.rawValue)
+    case let .getVolumeChanges(since):
+      writer.write(RequestTag.getVolumeChanges.rawValue)
+      writer.write(since)
+    case let .subscribe(since):
+      writer.write(RequestTag.subscribe.rawValue)
+      writer.write(since)
+    case let .saveScene(name, volumes):
+      writer.write(RequestTag.saveScene.rawValue)
+      writer.write(name)
+      writer.write(volumes)
+    case let .recallScene(name, rampMilliseconds):
+      writer.write(RequestTag.recallScene.rawValue)
+      writer.write(name)
+      writer.write(rampMilliseconds)
+    case let .removeScene(name):
+      writer.write(RequestTag.removeScene.rawValue)
+      writer.write(name)
+    case .getSceneNames:
+      writer.write(RequestTag.getSceneNames.rawValue)
+    }
+    return writer.bytes
+  }
+
+  public static func decodeRequest(_ payload: some ContiguousBytes) throws -> HelperRequest {
+    try payload.withUnsafeBytes { bytes in
+      var reader = WireReader(bytes)
+      try readVersion(from: &reader)
+      return try readRequest(from: &reader)
+    }
+  }
+
+  private static func readRequest(from reader: inout WireReader) throws -> HelperRequest {
+    let rawTag = try reader.readUInt8()
+    guard let tag = RequestTag(rawValue: rawTag) else {
+      throw HelperTransportError.malformedMessage("request tag \(rawTag)")
+    }
+
+    let request: HelperRequest
+    switch tag {
+    case .registerApp:
+      request = .registerApp(bundleID: try reader.readString())
+    case .setVolume:
+      request = .setVolume(bundleID: try reader.readString(), volume: try reader.readVolume())
+    case .setAppVolume:
+      request = .setAppVolume(appID: try reader.readUInt32(), volume: try reader.readVolume())
+    case .getVolume:
+      request = .getVolume(bundleID: try reader.readString())
+    case .setAppVolumes:
+      request = .setAppVolumes(try reader.readAppVolumes(), named: try reader.readVolumes())
+    case .getAppVolumes:
+      request = .getAppVolumes(appIDs: try reader.readAppIDs())
+    case .getAllVolumes:
+      request = .getAllVolumes
+    case .getVolumeChanges:
+      request = .getVolumeChanges(since: try reader.readUInt64())
+    case .subscribe:
+      request = .subscribe(since: try reader.readUInt64())
+    case .saveScene:
+      request = .saveScene(name: try reader.readString(), volumes: try reader.readVolumes())
+    case .recallScene:
+      request = .recallScene(
+        name: try reader.readString(),
+        rampMilliseconds: try reader.readUInt32()
+      )
+    case .removeScene:
+      request = .removeScene(name: try reader.readString())
+    case .getSceneNames:
+      request = .getSceneNames
+    }
+    try reader.finish()
+    return request
+  }
+
+  public static func encode(_ response: HelperResponse) -> [UInt8] {
+    var writer = WireWriter()
+    writer.write(version)
+    switch response {
+    case .done:
+      writer.write(ResponseTag.done.rawValue)
+    case let .appID(appID):
+      writer.write(ResponseTag.appID.rawValue)
+      writer.write(appID)
+    case let .volume(volume):
+      writer.write(ResponseTag.volume.rawValue)
+      writer.write(volume)
+    case let .volumes(volumes):
+      writer.write(ResponseTag.volumes.rawValue)
+      writer.write(volumes)
+    case let .appVolumes(volumes):
+      writer.write(ResponseTag.appVolumes.rawValue)
+      writer.write(volumes)
+    case let .changes(changes):
+      writer.write(ResponseTag.changes.rawValue)
+      write(changes, to: &writer)
+    case let .names(names):
+      writer.write(ResponseTag.names.rawValue)
+      writer.write(names)
+    case let .registered(names):
+      writer.write(ResponseTag.registered.rawValue)
+      writer.write(names)
+    case let .failure(code, message):
+      writer.write(ResponseTag.failure.rawValue)
+      writer.write(UInt32(truncatingIfNeeded: code))
+      writer.write(message)
+    }
+    return writer.bytes
+  }
+
+  public static func decodeResponse(_ payload: some ContiguousBytes) throws -> HelperResponse {
+    try payload.withUnsafeBytes { bytes in
+      var reader = WireReader(bytes)
+      try readVersion(from: &reader)
+      return try readResponse(from: &reader)
+    }
+  }
+
+  private static func readResponse(from reader: inout WireReader) throws -> HelperResponse {
+    let rawTag = try reader.readUInt8()
+    guard let tag = ResponseTag(rawValue: rawTag) else {
+      throw HelperTransportError.malformedMessage("response tag \(rawTag)")
+    }
+
+    let response: HelperResponse
+    switch tag {
+    case .done:
+      response = .done
+    case .appID:
+      response = .appID(try reader.readUInt32())
+    case .volume:
+      response = .volume(try reader.readVolume())
+    case .volumes:
+      response = .volumes(try reader.readVolumes())
+    case .appVolumes:
+      response = .appVolumes(try reader.readAppVolumes())
+    case .changes:
+      response = .changes(try readChanges(from: &reader))
+    case .names:
+      response = .names(try reader.readStrings())
+    case .registered:
+      response = .registered(try reader.readNames())
+    case .failure:
+      response = .failure(
+        code: Int(Int32(bitPattern: try reader.readUInt32())),
+        message: try reader.readString()
+      )
+    }
+    try reader.finish()
+    return response
+  }
+
+  /// payload of a push frame
+  public static func encode(_ changes: HelperChanges) -> [UInt8] {
+    var writer = WireWriter()
+    writer.write(version)
+    write(changes, to: &writer)
+    return writer.bytes
+  }
+
+  public static func decodeChanges(_ payload: some ContiguousBytes) throws -> HelperChanges {
+    try payload.withUnsafeBytes { bytes in
+      var reader = WireReader(bytes)
+      try readVersion(from: &reader)
+      let changes = try readChanges(from: &reader)
+      try reader.finish()
+      return changes
+    }
+  }
+
+  private static func readVersion(from reader: inout WireReader) throws {
+    let found = try reader.readUInt8()
+    guard found == version else {
+      throw HelperTransportError.unsupportedVersion(found)
+    }
+  }
+
+  private static func write(_ changes: HelperChanges, to writer: inout WireWriter) {
+    writer.write(changes.generation)
+    writer.write(changes.isSnapshot)
+    writer.write(changes.volumes)
+    writer.write(changes.removed)
+    writer.write(changes.names)
+    writer.write(changes.volumesByBundleID)
+    writer.write(changes.removedBundleIDs)
+  }
+
+  private static func readChanges(from reader: inout WireReader) throws -> HelperChanges {
+    let generation = try reader.readUInt64()
+    let isSnapshot = try reader.readBool()
+    let volumes = try reader.readAppVolumes()
+    let removed = try reader.readAppIDs()
+    let names = try reader.readNames()
+    let volumesByBundleID = try reader.readVolumes()
+    let removedBundleIDs = try reader.readStrings()
+    return HelperChanges(
+      generation: generation,
+      volumes: volumes,
+      removed: removed,
+      names: names,
+      volumesByBundleID: volumesByBundleID,
+      removedBundleIDs: removedBundleIDs,
+      isSnapshot: isSnapshot
+    )
+  }
+}
@@ -0,0 +1,106 @@
+import Foundation
+
+/// one message on a stream transport
+/// layout: payload length (UInt32), kind (UInt8), ID (UInt32), payload - integers little-endian
+public struct MessageFrame: Equatable, Sendable {
+  public enum Kind: UInt8, Sendable {
+    /// client call - the reply carries the same ID
+    case request = 1
+    case response = 2
+    /// helper-initiated change batch - the client acknowledges with the same ID
+    case push = 3
+    case acknowledge = 4
+  }
+
+  /// bytes before the payload
+  public static let headerLength = 9
+
+  /// largest payload a peer may announce - a whole store of long bundle IDs fits many times
+  public static let maxPayloadLength = 1 << 20
+
+  public let kind: Kind
+  public let id: UInt32
+  /// a decoded frame's payload shares the decoder's buffer rather than copying out of it
+  public let payload: ArraySlice<UInt8>
+
+  public init(kind: Kind, id: UInt32, payload: ArraySlice<UInt8> = []) {
+    self.kind = kind
+    self.id = id
+    self.payload = payload
+  }
+
+  public init(kind: Kind, id: UInt32, payload: [UInt8]) {
+    self.init(kind: kind, id: id, payload: payload[...])
+  }
+
+  /// header and payload, ready to write
+  public var bytes: [UInt8] {
+    var writer = WireWriter(capacity: Self.headerLength + payload.count)
+    writer.write(UInt32(payload.count))
+    writer.write(kind.rawValue)
+    writer.write(id)
+    writer.write(bytes: payload)
+    return writer.bytes
+  }
+}
+
+/// splits a byte stream into frames - feed it whatever a read returned
+public struct FrameDecoder: Sendable {
+  private var buffer: [UInt8] = []
+  private var start = 0
+
+  public init() {}
+
+  public mutating func append(_ bytes: UnsafeRawBufferPointer) {
+    buffer.append(contentsOf: bytes)
+  }
+
+  public mutating func append(_ bytes: [UInt8]) {
+    buffer.append(contentsOf: bytes)
+  }
+
+  /// the next complete frame, nil if more bytes are needed
+  /// - Throws: malformedMessage for an unknown kind or an oversized length - the stream can't
+  ///   be resynchronized after that, so the connection should be closed
+  public mutating func next() throws -> MessageFrame? {
+    let available = buffer.count - start
+    guard available >= MessageFrame.headerLength else {
+      compact()
+      return nil
+    }
+
+    let (length, rawKind, id) = try buffer.withUnsafeBytes { bytes in
+      var header = WireReader(UnsafeRawBufferPointer(
+        rebasing: bytes[start ..< start + MessageFrame.headerLength]
+      ))
+      return (Int(try header.readUInt32()), try header.readUInt8(), try header.readUInt32())
+    }
+
+    guard length <= MessageFrame.maxPayloadLength else {
+      throw HelperTransportError.malformedMessage("frame of \(length) bytes")
+    }
+    guard let kind = MessageFrame.Kind(rawValue: rawKind) else {
+      throw HelperTransportError.malformedMessage("frame kind \(rawKind)")
+    }
+    guard available >= MessageFrame.headerLength + length else {
+      compact()
+      return nil
+    }
+
+    let payloadStart = start + MessageFrame.headerLength
+    let frame = MessageFrame(
+      kind: kind,
+      id: id,
+      payload: buffer[payloadStart ..< payloadStart + length]
+    )
+    start = payloadStart + length
+    return frame
+  }
+
+  /// drop consumed bytes once they make up most of the buffer
+  private mutating func compact() {
+    guard start > 0, start * 2 >= buffer.count else { return }
+    buffer.removeFirst(start)
+    start = 0
+  }
+}
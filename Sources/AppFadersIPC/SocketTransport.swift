@@ -0,0 +1,436 @@
+import Foundation
+#if canImport(Darwin)
+  import Darwin
+#else
+  import Glibc
+#endif
+
+// MARK: - Socket Primitives
+
+enum UnixSocket {
+  static func make() -> Int32 {
+    #if canImport(Darwin)
+      let fd = socket(AF_UNIX, SOCK_STREAM, 0)
+      if fd >= 0 {
+        // a peer that went away must fail the write, not kill the process
+        var on: Int32 = 1
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, socklen_t(MemoryLayout<Int32>.size))
+      }
+      return fd
+    #else
+      return socket(AF_UNIX, Int32(SOCK_STREAM.rawValue), 0)
+    #endif
+  }
+
+  /// run body with the address for path
+  static func withAddress<T>(
+    _ path: String,
+    _ body: (UnsafePointer<sockaddr>, socklen_t) -> T
+  ) throws -> T {
+    var address = sockaddr_un()
+    address.sun_family = sa_family_t(AF_UNIX)
+    let utf8 = Array(path.utf8)
+    let capacity = MemoryLayout.size(ofValue: address.sun_path)
+    guard utf8.count < capacity else {
+      throw HelperTransportError.connectionFailed("socket path too long: \(path)")
+    }
+    withUnsafeMutableBytes(of: &address.sun_path) { raw in
+      raw.copyBytes(from: utf8)
+      raw[utf8.count] = 0
+    }
+    return withUnsafePointer(to: &address) {
+      $0.withMemoryRebound(to: sockaddr.self, capacity: 1) {
+        body($0, socklen_t(MemoryLayout<sockaddr_un>.size))
+      }
+    }
+  }
+
+  /// write all of bytes - false once the peer is gone
+  static func writeAll(_ fd: Int32, _ bytes: [UInt8]) -> Bool {
+    #if canImport(Darwin)
+      let flags: Int32 = 0
+    #else
+      let flags = Int32(MSG_NOSIGNAL)
+    #endif
+    return bytes.withUnsafeBytes { raw in
+      var sent = 0
+      while sent < raw.count {
+        let result = send(fd, raw.baseAddress! + sent, raw.count - sent, flags)
+        if result < 0, errno == EINTR { continue }
+        guard result > 0 else { return false }
+        sent += result
+      }
+      return true
+    }
+  }
+
+  static func close(_ fd: Int32) {
+    #if canImport(Darwin)
+      _ = Darwin.close(fd)
+    #else
+      _ = Glibc.close(fd)
+    #endif
+  }
+
+  static func errorDescription() -> String {
+    String(cString: strerror(errno))
+  }
+}
+
+// MARK: - Socket Connection
+
+/// one stream socket carrying frames - a reader thread decodes, a serial queue writes
+/// write() only queues the frame: a peer that stops reading stalls its own queue, never the
+/// caller - the helper pushes from under VolumeStore's lock. Frames leave in write() order; the
+/// queue stays short because a subscriber has one push in flight and a client waits for replies
+/// the reader thread owns the descriptor: close() only shuts the socket down, the reader has it
+/// closed once it sees the end of the stream - behind any queued write, so a descriptor number
+/// is never reused under either of them
+final class SocketConnection: @unchecked Sendable {
+  private let fd: Int32
+  private let writeQueue = DispatchQueue(label: "AppFadersIPC.SocketConnection.write")
+  /// write queue only - set once the descriptor is closed
+  private var isClosed = false
+  private let onFrame: @Sendable (MessageFrame) -> Void
+  private let onClose: @Sendable () -> Void
+
+  init(
+    fd: Int32,
+    onFrame: @escaping @Sendable (MessageFrame) -> Void,
+    onClose: @escaping @Sendable () -> Void
+  ) {
+    self.fd = fd
+    self.onFrame = onFrame
+    self.onClose = onClose
+  }
+
+  func start() {
+    let thread = Thread { [self] in readLoop() }
+    thread.name = "AppFadersIPC.SocketConnection"
+    thread.start()
+  }
+
+  /// queue a frame - never blocks
+  /// - Parameter sent: called on the write queue, with false if the peer is gone
+  func write(_ frame: MessageFrame, sent: (@Sendable (Bool) -> Void)? = nil) {
+    writeQueue.async { [self] in
+      let written = !isClosed && UnixSocket.writeAll(fd, frame.bytes)
+      sent?(written)
+    }
+  }
+
+  func close() {
+    shutdown(fd, Int32(SHUT_RDWR))
+  }
+
+  private func readLoop() {
+    var decoder = FrameDecoder()
+    var buffer = [UInt8](repeating: 0, count: 64 * 1024)
+    reading: while true {
+      let count = buffer.withUnsafeMutableBytes { read(fd, $0.baseAddress, $0.count) }
+      if count < 0, errno == EINTR { continue }
+      guard count > 0 else { break }
+
+      buffer.withUnsafeBytes { decoder.append(UnsafeRawBufferPointer(rebasing: $0[..<count])) }
+      do {
+        while let frame = try decoder.next() {
+          onFrame(frame)
+        }
+      } catch {
+        // a stream that lost framing can't be trusted past this point
+        break reading
+      }
+    }
+    shutdown(fd, Int32(SHUT_RDWR))
+    // queued writes fail fast on the shut-down socket, then the descriptor goes
+    writeQueue.async { [self] in
+      isClosed = true
+      UnixSocket.close(fd)
+      onClose()
+    }
+  }
+}
+
+// MARK: - Client
+
+/// HelperTransport over a Unix domain socket - needs no launchd or XPC, so the protocol can be
+/// exercised and load-tested in-process
+public final class SocketHelperTransport: HelperTransport, @unchecked Sendable {
+  private typealias Reply = @Sendable (Result<HelperResponse, HelperTransportError>) -> Void
+
+  private let path: String
+  private let lock = NSLock()
+  private var connection: SocketConnection?
+  private var nextID: UInt32 = 1
+  private var pending: [UInt32: Reply] = [:]
+  private var onChanges: HelperChangeHandler?
+  private var onDisconnect: (@Sendable () -> Void)?
+  private var closing = false
+
+  public init(path: String) {
+    self.path = path
+  }
+
+  public func start(
+    onChanges: @escaping HelperChangeHandler,
+    onDisconnect: @escaping @Sendable () -> Void
+  ) throws {
+    let fd = UnixSocket.make()
+    guard fd >= 0 else {
+      throw HelperTransportError.connectionFailed(UnixSocket.errorDescription())
+    }
+    let connected = try UnixSocket.withAddress(path) { connect(fd, $0, $1) == 0 }
+    guard connected else {
+      let reason = UnixSocket.errorDescription()
+      UnixSocket.close(fd)
+      throw HelperTransportError.connectionFailed(reason)
+    }
+
+    let connection = SocketConnection(
+      fd: fd,
+      onFrame: { [weak self] frame in self?.receive(frame) },
+      onClose: { [weak self] in self?.connectionClosed() }
+    )
+    lock.withLock {
+      self.connection = connection
+      self.onChanges = onChanges
+      self.onDisconnect = onDisconnect
+      closing = false
+    }
+    connection.start()
+  }
+
+  public func send(
+    _ request: HelperRequest,
+    reply: @escaping @Sendable (Result<HelperResponse, HelperTransportError>) -> Void
+  ) {
+    let (connection, id): (SocketConnection?, UInt32) = lock.withLock {
+      guard let connection else { return (nil, 0) }
+      let id = nextID
+      nextID = nextID == UInt32.max ? 1 : nextID + 1
+      pending[id] = reply
+      return (connection, id)
+    }
+    guard let connection else {
+      reply(.failure(.notConnected))
+      return
+    }
+
+    let frame = MessageFrame(kind: .request, id: id, payload: MessageCodec.encode(request))
+    connection.write(frame) { [weak self] sent in
+      guard !sent, let self,
+            let reply = lock.withLock({ pending.removeValue(forKey: id) }) else { return }
+      reply(.failure(.disconnected))
+    }
+  }
+
+  public func close() {
+    let connection = lock.withLock {
+      closing = true
+      return self.connection
+    }
+    connection?.close()
+  }
+
+  private func receive(_ frame: MessageFrame) {
+    switch frame.kind {
+    case .response:
+      guard let reply = lock.withLock({ pending.removeValue(forKey: frame.id) }) else { return }
+      do {
+        reply(.success(try MessageCodec.decodeResponse(frame.payload)))
+      } catch let error as HelperTransportError {
+        reply(.failure(error))
+      } catch {
+        reply(.failure(.malformedMessage("\(error)")))
+      }
+    case .push:
+      let (handler, connection) = lock.withLock { (onChanges, self.connection) }
+      guard let handler, let connection else { return }
+      let acknowledge: @Sendable () -> Void = {
+        connection.write(MessageFrame(kind: .acknowledge, id: frame.id))
+      }
+      guard let changes = try? MessageCodec.decodeChanges(frame.payload) else {
+        // the batch is lost - replace the whole state, then let the helper carry on
+        resync(handler, then: acknowledge)
+        return
+      }
+      handler(changes, acknowledge)
+    case .request, .acknowledge:
+      // helper-bound frames - a confused peer, ignore
+      break
+    }
+  }
+
+  private func connectionClosed() {
+    let (replies, onDisconnect) = lock.withLock {
+      let replies = Array(pending.values)
+      pending.removeAll()
+      connection = nil
+      let handler = closing ? nil : self.onDisconnect
+      self.onDisconnect = nil
+      onChanges = nil
+      return (replies, handler)
+    }
+    for reply in replies {
+      reply(.failure(.disconnected))
+    }
+    onDisconnect?()
+  }
+}
+
+// MARK: - Listener
+
+/// serves a HelperRequestHandler on a Unix domain socket - one reader thread per client
+public final class SocketHelperListener: @unchecked Sendable {
+  private let path: String
+  private let handler: HelperRequestHandler
+  private let lock = NSLock()
+  private var listenFD: Int32 = -1
+  private var peers: [ObjectIdentifier: SocketPeer] = [:]
+
+  public init(path: String, handler: HelperRequestHandler) {
+    self.path = path
+    self.handler = handler
+  }
+
+  /// number of connected clients
+  public var peerCount: Int {
+    lock.withLock { peers.count }
+  }
+
+  /// bind the socket (replacing a stale one) and start accepting
+  public func start() throws {
+    unlink(path)
+    let fd = UnixSocket.make()
+    guard fd >= 0 else {
+      throw HelperTransportError.connectionFailed(UnixSocket.errorDescription())
+    }
+    let bound = try UnixSocket.withAddress(path) { bind(fd, $0, $1) == 0 }
+    guard bound, listen(fd, SOMAXCONN) == 0 else {
+      let reason = UnixSocket.errorDescription()
+      UnixSocket.close(fd)
+      throw HelperTransportError.connectionFailed(reason)
+    }
+
+    lock.withLock { listenFD = fd }
+    let thread = Thread { [self] in acceptLoop(fd) }
+    thread.name = "AppFadersIPC.SocketHelperListener"
+    thread.start()
+  }
+
+  /// stop accepting, disconnect every client and remove the socket file
+  public func stop() {
+    let (fd, current) = lock.withLock {
+      let fd = listenFD
+      listenFD = -1
+      return (fd, Array(peers.values))
+    }
+    if fd >= 0 {
+      shutdown(fd, Int32(SHUT_RDWR))
+      UnixSocket.close(fd)
+      unlink(path)
+    }
+    for peer in current {
+      peer.connection?.close()
+    }
+  }
+
+  private func acceptLoop(_ fd: Int32) {
+    while true {
+      let client = accept(fd, nil, nil)
+      if client < 0 {
+        if errno == EINTR { continue }
+        // stop() closed the socket
+        return
+      }
+
+      let peer = SocketPeer()
+      let id = ObjectIdentifier(peer)
+      let connection = SocketConnection(
+        fd: client,
+        onFrame: { [weak self, weak peer] frame in
+          guard let self, let peer else { return }
+          receive(frame, from: peer)
+        },
+        onClose: { [weak self] in
+          guard let self, let peer = lock.withLock({ peers.removeValue(forKey: id) }) else {
+            return
+          }
+          handler.peerDisconnected(peer)
+        }
+      )
+      peer.attach(connection)
+      lock.withLock { peers[id] = peer }
+      connection.start()
+    }
+  }
+
+  private func receive(_ frame: MessageFrame, from peer: SocketPeer) {
+    switch frame.kind {
+    case .request:
+      let request: HelperRequest
+      do {
+        request = try MessageCodec.decodeRequest(frame.payload)
+      } catch {
+        peer.connection?.write(MessageFrame(
+          kind: .response,
+          id: frame.id,
+          payload: MessageCodec.encode(.failure(code: -1, message: "\(error)"))
+        ))
+        return
+      }
+      handler.handle(request, from: peer) { [weak peer] response in
+        peer?.connection?.write(MessageFrame(
+          kind: .response,
+          id: frame.id,
+          payload: MessageCodec.encode(response)
+        ))
+      }
+    case .acknowledge:
+      peer.acknowledge(frame.id)
+    case .response, .push:
+      break
+    }
+  }
+}
+
+/// a socket client as the handler sees it
+private final class SocketPeer: HelperPeer, @unchecked Sendable {
+  private let lock = NSLock()
+  private var nextPushID: UInt32 = 1
+  private var acknowledgements: [UInt32: @Sendable () -> Void] = [:]
+  private var socket: SocketConnection?
+
+  var connection: SocketConnection? {
+    lock.withLock { socket }
+  }
+
+  func attach(_ connection: SocketConnection) {
+    lock.withLock { socket = connection }
+  }
+
+  /// runs under VolumeStore's lock - the frame is only queued, a stalled client can't block it
+  func push(_ changes: HelperChanges, acknowledged: @escaping @Sendable () -> Void) {
+    let (connection, id): (SocketConnection?, UInt32) = lock.withLock {
+      let id = nextPushID
+      nextPushID = nextPushID == UInt32.max ? 1 : nextPushID + 1
+      acknowledgements[id] = acknowledged
+      return (socket, id)
+    }
+    guard let connection else {
+      acknowledge(id)
+      return
+    }
+    let frame = MessageFrame(kind: .push, id: id, payload: MessageCodec.encode(changes))
+    // a push that never left can't be acknowledged by the client - release it here
+    connection.write(frame) { [weak self] sent in
+      if !sent {
+        self?.acknowledge(id)
+      }
+    }
+  }
+
+  func acknowledge(_ id: UInt32) {
+    lock.withLock { acknowledgements.removeValue(forKey: id) }?()
+  }
+}
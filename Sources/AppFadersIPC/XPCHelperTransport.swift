@@ -0,0 +1,165 @@
+#if canImport(Darwin)
+  import Foundation
+
+  /// Protocol for helper connections - every call is one MessageCodec-encoded HelperRequest,
+  /// carried as raw bytes so XPC never archives a dictionary or an NSError
+  @objc public protocol AppFadersHostProtocol {
+    /// the reply is the encoded HelperResponse, a failure response for a request that
+    /// doesn't decode
+    func send(message: Data, reply: @escaping (Data) -> Void)
+  }
+
+  /// Exported by subscribed connections - the helper pushes change batches through it
+  @objc public protocol AppFadersVolumeObserverProtocol {
+    /// one MessageCodec-encoded HelperChanges batch - reply once applied; the next batch waits
+    /// for it
+    func volumesChanged(message: Data, reply: @escaping () -> Void)
+  }
+
+  /// HelperTransport over the helper's mach service
+  public final class XPCHelperTransport: HelperTransport, @unchecked Sendable {
+    public static let defaultServiceName = "com.fbreidenbach.appfaders.helper"
+
+    private let serviceName: String
+    private let lock = NSLock()
+    private var connection: NSXPCConnection?
+    private var closing = false
+
+    public init(serviceName: String = XPCHelperTransport.defaultServiceName) {
+      self.serviceName = serviceName
+    }
+
+    public func start(
+      onChanges: @escaping HelperChangeHandler,
+      onDisconnect: @escaping @Sendable () -> Void
+    ) throws {
+      let conn = NSXPCConnection(machServiceName: serviceName)
+      conn.remoteObjectInterface = NSXPCInterface(with: AppFadersHostProtocol.self)
+      conn.exportedInterface = NSXPCInterface(with: AppFadersVolumeObserverProtocol.self)
+      conn.exportedObject = VolumeObserver(onChanges: onChanges) { [weak self] done in
+        guard let self else {
+          done()
+          return
+        }
+        resync(onChanges, then: done)
+      }
+
+      // an interrupted connection would come back by itself - callers get a fresh one instead;
+      // handlers of a replaced connection must not tear down its successor
+      let connectionID = ObjectIdentifier(conn)
+      let lost: @Sendable () -> Void = { [weak self] in
+        guard let self, disconnected(connectionID) else { return }
+        onDisconnect()
+      }
+      conn.invalidationHandler = lost
+      conn.interruptionHandler = lost
+
+      lock.withLock {
+        connection = conn
+        closing = false
+      }
+      conn.resume()
+    }
+
+    public func close() {
+      let conn = lock.withLock {
+        closing = true
+        let conn = connection
+        connection = nil
+        return conn
+      }
+      conn?.invalidate()
+    }
+
+    /// - Returns: true if the connection was current and not closed on purpose
+    private func disconnected(_ connectionID: ObjectIdentifier) -> Bool {
+      let conn: NSXPCConnection? = lock.withLock {
+        guard let connection, ObjectIdentifier(connection) == connectionID else { return nil }
+        self.connection = nil
+        return connection
+      }
+      guard let conn else { return false }
+      conn.invalidate()
+      return !lock.withLock { closing }
+    }
+
+    public func send(
+      _ request: HelperRequest,
+      reply: @escaping @Sendable (Result<HelperResponse, HelperTransportError>) -> Void
+    ) {
+      // exactly once, whether the call answers or the proxy fails
+      let once = ReplyOnce(reply)
+      guard let conn = lock.withLock({ connection }) else {
+        reply(.failure(.notConnected))
+        return
+      }
+      guard let proxy = conn.remoteObjectProxyWithErrorHandler({ error in
+        once.resume(.failure(.connectionFailed(error.localizedDescription)))
+      }) as? AppFadersHostProtocol else {
+        reply(.failure(.connectionFailed("Failed to get remote object proxy")))
+        return
+      }
+
+      proxy.send(message: Data(MessageCodec.encode(request))) { message in
+        do {
+          once.resume(.success(try MessageCodec.decodeResponse(message)))
+        } catch let error as HelperTransportError {
+          once.resume(.failure(error))
+        } catch {
+          once.resume(.failure(.malformedMessage("\(error)")))
+        }
+      }
+    }
+  }
+
+  /// first result wins - XPC may call both the reply and the proxy error handler
+  private final class ReplyOnce: @unchecked Sendable {
+    private let lock = NSLock()
+    private var reply: (@Sendable (Result<HelperResponse, HelperTransportError>) -> Void)?
+
+    init(_ reply: @escaping @Sendable (Result<HelperResponse, HelperTransportError>) -> Void) {
+      self.reply = reply
+    }
+
+    func resume(_ result: Result<HelperResponse, HelperTransportError>) {
+      let reply = lock.withLock {
+        let reply = self.reply
+        self.reply = nil
+        return reply
+      }
+      reply?(result)
+    }
+  }
+
+  /// receives the helper's pushed change batches
+  private final class VolumeObserver: NSObject, AppFadersVolumeObserverProtocol,
+  @unchecked Sendable {
+    private let onChanges: HelperChangeHandler
+    private let resync: @Sendable (@escaping @Sendable () -> Void) -> Void
+
+    /// - Parameter resync: pulls a snapshot into onChanges, then calls its argument
+    init(
+      onChanges: @escaping HelperChangeHandler,
+      resync: @escaping @Sendable (@escaping @Sendable () -> Void) -> Void
+    ) {
+      self.onChanges = onChanges
+      self.resync = resync
+    }
+
+    func volumesChanged(message: Data, reply: @escaping () -> Void) {
+      // acknowledging releases the helper's next batch
+      let acknowledge = Acknowledgement(reply: reply)
+      guard let changes = try? MessageCodec.decodeChanges(message) else {
+        // the batch is lost - replace the whole state before the helper sends anything newer
+        resync { acknowledge.reply() }
+        return
+      }
+      onChanges(changes) { acknowledge.reply() }
+    }
+  }
+
+  /// XPC reply blocks may be called from any thread
+  private struct Acknowledgement: @unchecked Sendable {
+    let reply: () -> Void
+  }
+#endif
@@ -0,0 +1,532 @@
+// VolumeFile.c
+// mapped hash table + journal - single writer, the helper's VolumeStore
+
+#include "VolumeFile.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// MARK: - Layout
+
+// 'AFVS'
+#define AF_VOLUME_FILE_MAGIC 0x41465653u
+#define AF_VOLUME_FILE_VERSION 1u
+
+// live records plus tombstones stay under 3/4 of the capacity; a rewrite leaves it under 1/2
+#define AF_VOLUME_FILE_LOAD_NUMERATOR 3u
+#define AF_VOLUME_FILE_LOAD_DENOMINATOR 4u
+
+#define AF_VOLUME_FILE_COUNTS_UNKNOWN UINT32_MAX
+
+enum
+{
+  RecordEmpty = 0,
+  RecordLive = 1,
+  RecordRemoved = 2,
+};
+
+enum
+{
+  JournalSet = 1,
+  JournalRemove = 2,
+};
+
+typedef struct FileHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t capacity;
+  uint32_t journalCapacity;
+  uint32_t recordSize;
+  uint32_t journalEntrySize;
+  // entries in the journal - bumped after the entry is complete
+  uint32_t journalLength;
+  uint32_t reserved[9];
+} FileHeader;
+
+typedef struct Record
+{
+  uint64_t key;
+  // written last on insert - a record is only used once it reads RecordLive
+  uint32_t state;
+  float volume;
+  char bundleID[AF_VOLUME_FILE_ID_LENGTH];
+} Record;
+
+typedef struct JournalEntry
+{
+  uint64_t key;
+  uint32_t op;
+  float volume;
+  // over every other byte of the entry - an entry torn by a crash ends the replay
+  uint32_t checksum;
+  uint32_t reserved;
+  char bundleID[AF_VOLUME_FILE_ID_LENGTH];
+} JournalEntry;
+
+struct AFVolumeFile
+{
+  char *path;
+  int fd;
+  size_t size;
+  FileHeader *header;
+  Record *records;
+  JournalEntry *journal;
+  // not stored in the file so a crash can't leave them wrong - counted on first use
+  uint32_t live;
+  uint32_t used;
+};
+
+static size_t FileSize(uint32_t capacity)
+{
+  return sizeof(FileHeader) + (size_t)capacity * sizeof(Record) +
+         (size_t)AF_VOLUME_FILE_JOURNAL_CAPACITY * sizeof(JournalEntry);
+}
+
+static uint32_t RoundCapacity(uint32_t capacity)
+{
+  uint32_t rounded = AF_VOLUME_FILE_MIN_CAPACITY;
+  while (rounded < capacity && rounded < (1u << 30))
+  {
+    rounded <<= 1;
+  }
+  return rounded;
+}
+
+/// smallest capacity that holds count records at no more than half load
+static uint32_t CapacityFor(uint32_t count)
+{
+  return RoundCapacity(count * 2);
+}
+
+static bool HeaderIsValid(const FileHeader *header, off_t size)
+{
+  return header->magic == AF_VOLUME_FILE_MAGIC && header->version == AF_VOLUME_FILE_VERSION &&
+         header->recordSize == sizeof(Record) && header->journalEntrySize == sizeof(JournalEntry) &&
+         header->journalCapacity == AF_VOLUME_FILE_JOURNAL_CAPACITY &&
+         header->capacity >= AF_VOLUME_FILE_MIN_CAPACITY &&
+         (header->capacity & (header->capacity - 1)) == 0 &&
+         header->journalLength <= AF_VOLUME_FILE_JOURNAL_CAPACITY &&
+         size == (off_t)FileSize(header->capacity);
+}
+
+// MARK: - Hashing
+
+static uint64_t Key(const char *bundleID)
+{
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (const unsigned char *byte = (const unsigned char *)bundleID; *byte != 0; byte++)
+  {
+    hash ^= *byte;
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+static uint32_t Checksum(const JournalEntry *entry)
+{
+  JournalEntry copy = *entry;
+  copy.checksum = 0;
+  uint32_t hash = 0x811c9dc5u;
+  const unsigned char *bytes = (const unsigned char *)&copy;
+  for (size_t index = 0; index < sizeof(copy); index++)
+  {
+    hash ^= bytes[index];
+    hash *= 0x01000193u;
+  }
+  // a zeroed entry never checks out
+  return hash == 0 ? 1 : hash;
+}
+
+// MARK: - Mapping
+
+static bool Initialize(int fd, uint32_t capacity)
+{
+  FileHeader header = {
+      .magic = AF_VOLUME_FILE_MAGIC,
+      .version = AF_VOLUME_FILE_VERSION,
+      .capacity = capacity,
+      .journalCapacity = AF_VOLUME_FILE_JOURNAL_CAPACITY,
+      .recordSize = sizeof(Record),
+      .journalEntrySize = sizeof(JournalEntry),
+  };
+  // truncating first zeroes every record and journal entry
+  return ftruncate(fd, 0) == 0 && ftruncate(fd, (off_t)FileSize(capacity)) == 0 &&
+         pwrite(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header);
+}
+
+static bool Map(AFVolumeFile *file, uint32_t capacity)
+{
+  size_t size = FileSize(capacity);
+  void *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, 0);
+  if (mapping == MAP_FAILED)
+  {
+    return false;
+  }
+  file->size = size;
+  file->header = mapping;
+  file->records = (Record *)((char *)mapping + sizeof(FileHeader));
+  file->journal = (JournalEntry *)(file->records + capacity);
+  return true;
+}
+
+static void Unmap(AFVolumeFile *file)
+{
+  if (file->header != NULL)
+  {
+    munmap(file->header, file->size);
+    file->header = NULL;
+  }
+}
+
+// MARK: - Table
+
+/// record holding the bundle ID, or -1
+static int32_t Find(const AFVolumeFile *file, uint64_t key, const char *bundleID)
+{
+  uint32_t mask = file->header->capacity - 1;
+  for (uint32_t probe = 0, index = (uint32_t)key & mask; probe <= mask;
+       probe++, index = (index + 1) & mask)
+  {
+    const Record *record = &file->records[index];
+    if (record->state == RecordEmpty)
+    {
+      return -1;
+    }
+    if (record->state == RecordLive && record->key == key &&
+        strncmp(record->bundleID, bundleID, AF_VOLUME_FILE_ID_LENGTH) == 0)
+    {
+      return (int32_t)index;
+    }
+  }
+  return -1;
+}
+
+/// set a record without journaling it - the load limit was checked by the caller
+static void Apply(AFVolumeFile *file, uint64_t key, const char *bundleID, float volume)
+{
+  int32_t existing = Find(file, key, bundleID);
+  if (existing >= 0)
+  {
+    file->records[existing].volume = volume;
+    return;
+  }
+
+  // reuse the first tombstone on the probe path, else the empty slot that ended it
+  uint32_t mask = file->header->capacity - 1;
+  uint32_t index = (uint32_t)key & mask;
+  while (file->records[index].state == RecordLive)
+  {
+    index = (index + 1) & mask;
+  }
+
+  Record *record = &file->records[index];
+  bool reused = record->state == RecordRemoved;
+  record->key = key;
+  record->volume = volume;
+  strncpy(record->bundleID, bundleID, AF_VOLUME_FILE_ID_LENGTH - 1);
+  record->bundleID[AF_VOLUME_FILE_ID_LENGTH - 1] = 0;
+  record->state = RecordLive;
+
+  if (file->live != AF_VOLUME_FILE_COUNTS_UNKNOWN)
+  {
+    file->live++;
+    file->used += reused ? 0 : 1;
+  }
+}
+
+static bool Unapply(AFVolumeFile *file, uint64_t key, const char *bundleID)
+{
+  int32_t index = Find(file, key, bundleID);
+  if (index < 0)
+  {
+    return false;
+  }
+  file->records[index].state = RecordRemoved;
+  if (file->live != AF_VOLUME_FILE_COUNTS_UNKNOWN)
+  {
+    file->live--;
+  }
+  return true;
+}
+
+static void Count(AFVolumeFile *file)
+{
+  if (file->live != AF_VOLUME_FILE_COUNTS_UNKNOWN)
+  {
+    return;
+  }
+  file->live = 0;
+  file->used = 0;
+  for (uint32_t index = 0; index < file->header->capacity; index++)
+  {
+    uint32_t state = file->records[index].state;
+    file->live += state == RecordLive ? 1 : 0;
+    file->used += state != RecordEmpty ? 1 : 0;
+  }
+}
+
+/// rewrite every live record into a new file of the given capacity and swap it in
+static bool Rewrite(AFVolumeFile *file, uint32_t capacity)
+{
+  size_t length = strlen(file->path) + sizeof(".compact");
+  char *temporary = malloc(length);
+  if (temporary == NULL)
+  {
+    return false;
+  }
+  snprintf(temporary, length, "%s.compact", file->path);
+
+  AFVolumeFile next = {
+      .path = file->path,
+      .fd = open(temporary, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600),
+      .live = 0,
+      .used = 0,
+  };
+  bool ok = next.fd >= 0 && Initialize(next.fd, capacity) && Map(&next, capacity);
+  if (ok)
+  {
+    for (uint32_t index = 0; index < file->header->capacity; index++)
+    {
+      const Record *record = &file->records[index];
+      if (record->state == RecordLive)
+      {
+        Apply(&next, record->key, record->bundleID, record->volume);
+      }
+    }
+    // the old file's journal is already part of its table
+    ok = msync(next.header, next.size, MS_SYNC) == 0 && fsync(next.fd) == 0 &&
+         rename(temporary, file->path) == 0;
+  }
+
+  if (!ok)
+  {
+    int error = errno;
+    Unmap(&next);
+    if (next.fd >= 0)
+    {
+      close(next.fd);
+    }
+    unlink(temporary);
+    free(temporary);
+    errno = error;
+    return false;
+  }
+
+  Unmap(file);
+  close(file->fd);
+  *file = next;
+  free(temporary);
+  return true;
+}
+
+// MARK: - Journal
+
+static bool Append(
+    AFVolumeFile *file, uint32_t op, uint64_t key, const char *bundleID, float volume)
+{
+  if (file->header->journalLength == AF_VOLUME_FILE_JOURNAL_CAPACITY &&
+      !AFVolumeFile_Checkpoint(file))
+  {
+    return false;
+  }
+
+  JournalEntry entry;
+  memset(&entry, 0, sizeof(entry));
+  entry.key = key;
+  entry.op = op;
+  entry.volume = volume;
+  strncpy(entry.bundleID, bundleID, AF_VOLUME_FILE_ID_LENGTH - 1);
+  entry.checksum = Checksum(&entry);
+
+  file->journal[file->header->journalLength] = entry;
+  file->header->journalLength++;
+  return true;
+}
+
+/// finish writes the last run didn't - entries are idempotent, a bad one ends the journal
+static void Replay(AFVolumeFile *file)
+{
+  uint32_t length = file->header->journalLength;
+  for (uint32_t index = 0; index < length; index++)
+  {
+    const JournalEntry *entry = &file->journal[index];
+    if (entry->checksum != Checksum(entry) || entry->bundleID[AF_VOLUME_FILE_ID_LENGTH - 1] != 0)
+    {
+      file->header->journalLength = index;
+      return;
+    }
+    if (entry->op == JournalSet)
+    {
+      Apply(file, entry->key, entry->bundleID, entry->volume);
+    }
+    else if (entry->op == JournalRemove)
+    {
+      Unapply(file, entry->key, entry->bundleID);
+    }
+  }
+}
+
+// MARK: - API
+
+AFVolumeFile *AFVolumeFile_Open(const char *path, uint32_t capacity)
+{
+  AFVolumeFile *file = calloc(1, sizeof(AFVolumeFile));
+  if (file == NULL)
+  {
+    return NULL;
+  }
+  file->path = strdup(path);
+  file->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  file->live = AF_VOLUME_FILE_COUNTS_UNKNOWN;
+  file->used = AF_VOLUME_FILE_COUNTS_UNKNOWN;
+
+  struct stat info;
+  FileHeader header;
+  bool ok = file->path != NULL && file->fd >= 0 && fstat(file->fd, &info) == 0;
+  if (ok)
+  {
+    bool valid = info.st_size >= (off_t)sizeof(header) &&
+                 pread(file->fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+                 HeaderIsValid(&header, info.st_size);
+    if (!valid)
+    {
+      header.capacity = RoundCapacity(capacity);
+      ok = Initialize(file->fd, header.capacity);
+      file->live = 0;
+      file->used = 0;
+    }
+  }
+  ok = ok && Map(file, header.capacity);
+
+  if (!ok)
+  {
+    int error = errno;
+    if (file->fd >= 0)
+    {
+      close(file->fd);
+    }
+    free(file->path);
+    free(file);
+    errno = error;
+    return NULL;
+  }
+
+  Replay(file);
+  return file;
+}
+
+void AFVolumeFile_Close(AFVolumeFile *file)
+{
+  if (file == NULL)
+  {
+    return;
+  }
+  Unmap(file);
+  close(file->fd);
+  free(file->path);
+  free(file);
+}
+
+bool AFVolumeFile_Get(const AFVolumeFile *file, const char *bundleID, float *volume)
+{
+  int32_t index = Find(file, Key(bundleID), bundleID);
+  if (index < 0)
+  {
+    return false;
+  }
+  *volume = file->records[index].volume;
+  return true;
+}
+
+bool AFVolumeFile_Set(AFVolumeFile *file, const char *bundleID, float volume)
+{
+  size_t length = strlen(bundleID);
+  if (length == 0 || length >= AF_VOLUME_FILE_ID_LENGTH)
+  {
+    errno = EINVAL;
+    return false;
+  }
+
+  Count(file);
+  uint64_t key = Key(bundleID);
+  uint32_t limit = file->header->capacity * AF_VOLUME_FILE_LOAD_NUMERATOR;
+  if (Find(file, key, bundleID) < 0 &&
+      (file->used + 1) * AF_VOLUME_FILE_LOAD_DENOMINATOR > limit &&
+      !Rewrite(file, CapacityFor(file->live + 1)))
+  {
+    return false;
+  }
+
+  if (!Append(file, JournalSet, key, bundleID, volume))
+  {
+    return false;
+  }
+  Apply(file, key, bundleID, volume);
+  return true;
+}
+
+bool AFVolumeFile_Remove(AFVolumeFile *file, const char *bundleID)
+{
+  Count(file);
+  uint64_t key = Key(bundleID);
+  if (Find(file, key, bundleID) < 0 || !Append(file, JournalRemove, key, bundleID, 0))
+  {
+    return false;
+  }
+  return Unapply(file, key, bundleID);
+}
+
+int32_t AFVolumeFile_Next(
+    const AFVolumeFile *file, int32_t index, const char **bundleID, float *volume)
+{
+  for (uint32_t next = index < 0 ? 0 : (uint32_t)index; next < file->header->capacity; next++)
+  {
+    const Record *record = &file->records[next];
+    if (record->state == RecordLive)
+    {
+      *bundleID = record->bundleID;
+      *volume = record->volume;
+      return (int32_t)next;
+    }
+  }
+  return -1;
+}
+
+uint32_t AFVolumeFile_Count(AFVolumeFile *file)
+{
+  Count(file);
+  return file->live;
+}
+
+uint32_t AFVolumeFile_Capacity(const AFVolumeFile *file)
+{
+  return file->header->capacity;
+}
+
+uint32_t AFVolumeFile_JournalLength(const AFVolumeFile *file)
+{
+  return file->header->journalLength;
+}
+
+bool AFVolumeFile_Checkpoint(AFVolumeFile *file)
+{
+  // the table must be on disk before the journal that covers it is dropped
+  if (msync(file->header, file->size, MS_SYNC) != 0)
+  {
+    return false;
+  }
+  file->header->journalLength = 0;
+  return msync(file->header, sizeof(FileHeader), MS_SYNC) == 0;
+}
+
+bool AFVolumeFile_Compact(AFVolumeFile *file)
+{
+  Count(file);
+  return Rewrite(file, CapacityFor(file->live));
+}
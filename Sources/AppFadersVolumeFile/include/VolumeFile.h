@@ -0,0 +1,84 @@
+// VolumeFile.h
+// AppFadersVolumeFile
+//
+// On-disk per-app volume store for the helper, so volumes survive a daemon restart.
+// One mapped file holds a fixed-record hash table (open addressing, linear probing) and an
+// append-only journal. A write appends its journal entry, then updates the record in place;
+// opening replays the journal over the table, so a write cut short by a crash is finished.
+//
+// Opening maps the file and replays at most one journal's worth of entries - reads are served
+// straight from the mapping, there is no per-entry load. When the journal fills up the table is
+// flushed and the journal starts over; when live entries plus tombstones pass the load limit the
+// table is rewritten into a new file and swapped in by rename (compaction).
+//
+// Not thread-safe: the caller serializes every call on a file.
+
+#ifndef VolumeFile_h
+#define VolumeFile_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// bundle ID storage per record, including the terminator
+#define AF_VOLUME_FILE_ID_LENGTH 256
+
+/// smallest table - capacities are powers of two
+#define AF_VOLUME_FILE_MIN_CAPACITY 64
+
+/// journal entries between two flushes of the table
+#define AF_VOLUME_FILE_JOURNAL_CAPACITY 256
+
+  /// open file - layout is private to VolumeFile.c
+  typedef struct AFVolumeFile AFVolumeFile;
+
+  /// open or create the store at path
+  /// a missing, truncated or foreign file is (re)initialized empty
+  /// @param capacity initial record capacity for a new file, rounded up to a power of two
+  /// @return the open file, or NULL with errno set
+  AFVolumeFile *AFVolumeFile_Open(const char *path, uint32_t capacity);
+
+  /// unmap and close - everything written is already in the file
+  void AFVolumeFile_Close(AFVolumeFile *file);
+
+  /// volume stored for a bundle ID
+  /// @return false if there is none
+  bool AFVolumeFile_Get(const AFVolumeFile *file, const char *bundleID, float *volume);
+
+  /// store a volume, growing or compacting the table first if needed
+  /// @return false if the bundle ID is empty or too long, or the file couldn't grow
+  bool AFVolumeFile_Set(AFVolumeFile *file, const char *bundleID, float volume);
+
+  /// remove a bundle ID's volume
+  /// @return false if there was none
+  bool AFVolumeFile_Remove(AFVolumeFile *file, const char *bundleID);
+
+  /// first stored record at or after index - pass the result + 1 to continue
+  /// @return the record index, or -1 when there are no more
+  int32_t AFVolumeFile_Next(
+      const AFVolumeFile *file, int32_t index, const char **bundleID, float *volume);
+
+  /// number of stored volumes - counts the table once after opening, then O(1)
+  uint32_t AFVolumeFile_Count(AFVolumeFile *file);
+
+  /// record capacity of the current table
+  uint32_t AFVolumeFile_Capacity(const AFVolumeFile *file);
+
+  /// journal entries not yet covered by a flush
+  uint32_t AFVolumeFile_JournalLength(const AFVolumeFile *file);
+
+  /// flush the table to disk and empty the journal
+  bool AFVolumeFile_Checkpoint(AFVolumeFile *file);
+
+  /// rewrite the table without tombstones, at the smallest capacity that fits
+  bool AFVolumeFile_Compact(AFVolumeFile *file);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VolumeFile_h */
@@ -0,0 +1,396 @@
+// VolumeTable.c
+// shared-memory volume table - one writer (helper), any number of read-only mappers (driver)
+
+#include "VolumeTable.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// MARK: - Layout
+
+// 'AFVT'
+#define AF_VOLUME_TABLE_MAGIC 0x41465654u
+#define AF_VOLUME_TABLE_VERSION 3u
+
+// a reader gives up after this many torn reads and tries again next cycle
+#define AF_VOLUME_TABLE_READ_ATTEMPTS 4
+
+typedef struct AFVolumeEntry
+{
+  // odd while the writer is updating gain/mute
+  _Atomic uint32_t sequence;
+  _Atomic uint32_t gainBits;
+  _Atomic uint32_t muted;
+  uint32_t reserved;
+  // immutable once the entry is published by count
+  uint64_t key;
+  char bundleID[AF_VOLUME_TABLE_ID_LENGTH];
+} AFVolumeEntry;
+
+struct AFVolumeTable
+{
+  // written last on initialization - readers reject a region without it
+  _Atomic uint32_t magic;
+  uint32_t version;
+  uint32_t capacity;
+  uint32_t entrySize;
+  _Atomic uint32_t count;
+  // odd while a batch of writes is in progress
+  _Atomic uint32_t batch;
+  // ramp for the changes since it was set, 0 for the reader's default
+  _Atomic uint32_t rampMilliseconds;
+  uint32_t reserved;
+  _Atomic uint64_t generation;
+  AFVolumeEntry entries[AF_VOLUME_TABLE_CAPACITY];
+};
+
+static inline uint32_t FloatBits(float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static inline float BitsFloat(uint32_t bits)
+{
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static bool HeaderIsValid(const struct AFVolumeTable *table)
+{
+  return atomic_load_explicit(&table->magic, memory_order_acquire) == AF_VOLUME_TABLE_MAGIC &&
+         table->version == AF_VOLUME_TABLE_VERSION &&
+         table->capacity == AF_VOLUME_TABLE_CAPACITY &&
+         table->entrySize == sizeof(AFVolumeEntry) &&
+         atomic_load_explicit(&table->count, memory_order_acquire) <= AF_VOLUME_TABLE_CAPACITY;
+}
+
+// MARK: - Keys
+
+uint64_t AFVolumeTable_Key(const char *bundleID)
+{
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (const unsigned char *byte = (const unsigned char *)bundleID; *byte != 0; byte++)
+  {
+    hash ^= *byte;
+    hash *= 0x100000001b3ull;
+  }
+  // 0 marks an unresolved key on the reader side
+  return hash == 0 ? 1 : hash;
+}
+
+// MARK: - Writer
+
+AFVolumeTable *AFVolumeTable_Create(const char *name)
+{
+  int fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+  if (fd < 0)
+  {
+    return NULL;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0)
+  {
+    close(fd);
+    return NULL;
+  }
+
+  // a region of the wrong size is from another build - start over under the same name
+  // (macOS only lets a shared memory object be sized once)
+  // one another user created could still be written by them - never trust it, recreate
+  bool foreign = info.st_uid != geteuid();
+  if (foreign || (info.st_size != 0 && info.st_size != (off_t)sizeof(AFVolumeTable)))
+  {
+    close(fd);
+    shm_unlink(name);
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0)
+    {
+      return NULL;
+    }
+    info.st_size = 0;
+  }
+
+  // the driver runs as a different user - make sure umask didn't strip read access, and
+  // that a region left with looser permissions can't be written by anyone else
+  if (fchmod(fd, 0644) != 0 || (info.st_size == 0 && ftruncate(fd, sizeof(AFVolumeTable)) != 0))
+  {
+    int error = errno;
+    close(fd);
+    errno = error;
+    return NULL;
+  }
+
+  void *mapping = mmap(NULL, sizeof(AFVolumeTable), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+  {
+    return NULL;
+  }
+
+  AFVolumeTable *table = mapping;
+  if (!HeaderIsValid(table))
+  {
+    atomic_store_explicit(&table->magic, 0, memory_order_relaxed);
+    memset((char *)table + sizeof(table->magic), 0, sizeof(AFVolumeTable) - sizeof(table->magic));
+    table->version = AF_VOLUME_TABLE_VERSION;
+    table->capacity = AF_VOLUME_TABLE_CAPACITY;
+    table->entrySize = sizeof(AFVolumeEntry);
+    atomic_store_explicit(&table->magic, AF_VOLUME_TABLE_MAGIC, memory_order_release);
+  }
+  return table;
+}
+
+int32_t AFVolumeTable_Intern(AFVolumeTable *table, const char *bundleID)
+{
+  if (strlen(bundleID) >= AF_VOLUME_TABLE_ID_LENGTH)
+  {
+    return -1;
+  }
+
+  uint64_t key = AFVolumeTable_Key(bundleID);
+  uint32_t count = atomic_load_explicit(&table->count, memory_order_relaxed);
+  for (uint32_t index = 0; index < count; index++)
+  {
+    if (table->entries[index].key == key &&
+        strncmp(table->entries[index].bundleID, bundleID, AF_VOLUME_TABLE_ID_LENGTH) == 0)
+    {
+      return (int32_t)index;
+    }
+  }
+
+  if (count == AF_VOLUME_TABLE_CAPACITY)
+  {
+    return -1;
+  }
+
+  // fill the entry, then publish it by bumping count
+  AFVolumeEntry *entry = &table->entries[count];
+  entry->key = key;
+  strncpy(entry->bundleID, bundleID, AF_VOLUME_TABLE_ID_LENGTH - 1);
+  entry->bundleID[AF_VOLUME_TABLE_ID_LENGTH - 1] = 0;
+  atomic_store_explicit(&entry->gainBits, FloatBits(1.0f), memory_order_relaxed);
+  atomic_store_explicit(&entry->muted, 0, memory_order_relaxed);
+  atomic_store_explicit(&table->count, count + 1, memory_order_release);
+  atomic_fetch_add_explicit(&table->generation, 1, memory_order_release);
+  return (int32_t)count;
+}
+
+bool AFVolumeTable_Write(AFVolumeTable *table, int32_t index, float gain, bool muted)
+{
+  if (index < 0 || (uint32_t)index >= atomic_load_explicit(&table->count, memory_order_relaxed))
+  {
+    return false;
+  }
+
+  AFVolumeEntry *entry = &table->entries[index];
+  uint32_t sequence = atomic_load_explicit(&entry->sequence, memory_order_relaxed);
+  atomic_store_explicit(&entry->sequence, sequence + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&entry->gainBits, FloatBits(gain), memory_order_relaxed);
+  atomic_store_explicit(&entry->muted, muted ? 1u : 0u, memory_order_relaxed);
+  atomic_store_explicit(&entry->sequence, sequence + 2, memory_order_release);
+  atomic_fetch_add_explicit(&table->generation, 1, memory_order_release);
+  return true;
+}
+
+void AFVolumeTable_BeginBatch(AFVolumeTable *table)
+{
+  uint32_t batch = atomic_load_explicit(&table->batch, memory_order_relaxed);
+  atomic_store_explicit(&table->batch, batch + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+void AFVolumeTable_EndBatch(AFVolumeTable *table)
+{
+  uint32_t batch = atomic_load_explicit(&table->batch, memory_order_relaxed);
+  atomic_store_explicit(&table->batch, batch + 1, memory_order_release);
+}
+
+void AFVolumeTable_SetRamp(AFVolumeTable *table, uint32_t milliseconds)
+{
+  atomic_store_explicit(&table->rampMilliseconds, milliseconds, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+void AFVolumeTable_ResetAll(AFVolumeTable *table)
+{
+  uint32_t count = atomic_load_explicit(&table->count, memory_order_relaxed);
+  AFVolumeTable_BeginBatch(table);
+  AFVolumeTable_SetRamp(table, 0);
+  for (uint32_t index = 0; index < count; index++)
+  {
+    AFVolumeTable_Write(table, (int32_t)index, 1.0f, false);
+  }
+  AFVolumeTable_EndBatch(table);
+}
+
+int AFVolumeTable_WriteSnapshot(const AFVolumeTable *table, const char *path)
+{
+  size_t length = strlen(path) + sizeof(".tmp");
+  char *temporary = malloc(length);
+  if (temporary == NULL)
+  {
+    return -1;
+  }
+  snprintf(temporary, length, "%s.tmp", path);
+
+  // a reader that mapped the old file keeps it; a new reader gets a complete new one
+  // no fsync - the writer holds its lock here, and a file cut short by a power loss fails
+  // the header check, so the reader just starts at unity
+  int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  bool ok = fd >= 0 && fchmod(fd, 0644) == 0 &&
+            write(fd, table, sizeof(AFVolumeTable)) == (ssize_t)sizeof(AFVolumeTable);
+  int error = errno;
+  if (fd >= 0)
+  {
+    close(fd);
+  }
+  ok = ok && rename(temporary, path) == 0;
+  if (!ok)
+  {
+    error = errno;
+    unlink(temporary);
+  }
+  free(temporary);
+  errno = error;
+  return ok ? 0 : -1;
+}
+
+int AFVolumeTable_Unlink(const char *name)
+{
+  return shm_unlink(name);
+}
+
+// MARK: - Reader
+
+static const AFVolumeTable *MapReadOnly(int fd)
+{
+  struct stat info;
+  if (fd < 0)
+  {
+    return NULL;
+  }
+  if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(AFVolumeTable))
+  {
+    close(fd);
+    return NULL;
+  }
+
+  void *mapping = mmap(NULL, sizeof(AFVolumeTable), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+  {
+    return NULL;
+  }
+
+  const AFVolumeTable *table = mapping;
+  if (!HeaderIsValid(table))
+  {
+    munmap(mapping, sizeof(AFVolumeTable));
+    return NULL;
+  }
+  return table;
+}
+
+const AFVolumeTable *AFVolumeTable_Open(const char *name)
+{
+  return MapReadOnly(shm_open(name, O_RDONLY, 0));
+}
+
+const AFVolumeTable *AFVolumeTable_OpenSnapshot(const char *path)
+{
+  return MapReadOnly(open(path, O_RDONLY | O_CLOEXEC));
+}
+
+uint64_t AFVolumeTable_Generation(const AFVolumeTable *table)
+{
+  return atomic_load_explicit(&table->generation, memory_order_acquire);
+}
+
+uint32_t AFVolumeTable_BatchSequence(const AFVolumeTable *table)
+{
+  // AFVolumeTable_Read ends with an acquire fence, so a recheck after reading entries can't be
+  // reordered ahead of those reads
+  return atomic_load_explicit(&table->batch, memory_order_acquire);
+}
+
+uint32_t AFVolumeTable_Ramp(const AFVolumeTable *table)
+{
+  return atomic_load_explicit(&table->rampMilliseconds, memory_order_acquire);
+}
+
+uint32_t AFVolumeTable_Count(const AFVolumeTable *table)
+{
+  uint32_t count = atomic_load_explicit(&table->count, memory_order_acquire);
+  return count < AF_VOLUME_TABLE_CAPACITY ? count : AF_VOLUME_TABLE_CAPACITY;
+}
+
+const char *AFVolumeTable_BundleID(const AFVolumeTable *table, int32_t index)
+{
+  if (index < 0 || (uint32_t)index >= AFVolumeTable_Count(table))
+  {
+    return NULL;
+  }
+  return table->entries[index].bundleID;
+}
+
+int32_t AFVolumeTable_Find(const AFVolumeTable *table, uint64_t key)
+{
+  uint32_t count = AFVolumeTable_Count(table);
+  for (uint32_t index = 0; index < count; index++)
+  {
+    if (table->entries[index].key == key)
+    {
+      return (int32_t)index;
+    }
+  }
+  return -1;
+}
+
+bool AFVolumeTable_Read(const AFVolumeTable *table, int32_t index, AFVolumeValue *value)
+{
+  if (index < 0 || (uint32_t)index >= AFVolumeTable_Count(table))
+  {
+    return false;
+  }
+
+  const AFVolumeEntry *entry = &table->entries[index];
+  for (int attempt = 0; attempt < AF_VOLUME_TABLE_READ_ATTEMPTS; attempt++)
+  {
+    uint32_t before = atomic_load_explicit(&entry->sequence, memory_order_acquire);
+    if (before & 1u)
+    {
+      continue;
+    }
+    uint32_t gainBits = atomic_load_explicit(&entry->gainBits, memory_order_relaxed);
+    uint32_t muted = atomic_load_explicit(&entry->muted, memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&entry->sequence, memory_order_relaxed) == before)
+    {
+      value->gain = BitsFloat(gainBits);
+      value->muted = muted != 0;
+      return true;
+    }
+  }
+  return false;
+}
+
+// MARK: - Both
+
+void AFVolumeTable_Close(const AFVolumeTable *table)
+{
+  if (table != NULL)
+  {
+    munmap((void *)table, sizeof(AFVolumeTable));
+  }
+}
@@ -0,0 +1,126 @@
+// VolumeTable.h
+// AppFadersVolumeTable
+//
+// Fixed-layout per-app volume table in POSIX shared memory.
+// The helper owns and writes the region; the driver maps it read-only so a volume change is
+// visible to the IO thread at its next cycle without any IPC message.
+//
+// Each entry is (app key -> gain, mute). Entries are appended once and never move, so an
+// entry index is a stable interned app ID for the lifetime of the region. Gain and mute are
+// guarded by a per-entry seqlock; a table-wide generation tells readers something changed.
+
+#ifndef VolumeTable_h
+#define VolumeTable_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// shm_open name of the helper's table (macOS limits names to 31 characters)
+#define AF_VOLUME_TABLE_NAME "/appfaders.volumes"
+
+/// copy of the table the helper keeps on disk, for a driver that loads before the helper runs
+#define AF_VOLUME_TABLE_SNAPSHOT_PATH "/Library/Application Support/AppFaders/volumes.snapshot"
+
+/// number of entries - apps ever seen by the helper, not apps running now
+#define AF_VOLUME_TABLE_CAPACITY 256
+
+/// bundle ID storage per entry, including the terminator
+#define AF_VOLUME_TABLE_ID_LENGTH 256
+
+  /// mapped region - layout is private to VolumeTable.c
+  typedef struct AFVolumeTable AFVolumeTable;
+
+  /// one entry's value as read through the seqlock
+  typedef struct AFVolumeValue
+  {
+    float gain;
+    bool muted;
+  } AFVolumeValue;
+
+  /// stable 64-bit key for a bundle ID (FNV-1a over the UTF-8 bytes, never 0)
+  /// readers compare keys instead of strings so lookups on the IO thread stay bounded
+  uint64_t AFVolumeTable_Key(const char *bundleID);
+
+  // MARK: - Writer (helper)
+
+  /// open the named region read-write, creating and sizing it if needed
+  /// an existing region with a valid header is reused so mapped readers stay valid
+  /// @return the mapping, or NULL with errno set
+  AFVolumeTable *AFVolumeTable_Create(const char *name);
+
+  /// entry index for a bundle ID, appending it at unity gain if new
+  /// @return the index, or -1 if the table is full or the ID is too long
+  int32_t AFVolumeTable_Intern(AFVolumeTable *table, const char *bundleID);
+
+  /// publish gain and mute for an entry - single writer only
+  bool AFVolumeTable_Write(AFVolumeTable *table, int32_t index, float gain, bool muted);
+
+  /// bracket several writes so readers apply them together - single writer only
+  /// readers that see the batch sequence odd, or changed across their reads, retry later
+  void AFVolumeTable_BeginBatch(AFVolumeTable *table);
+  void AFVolumeTable_EndBatch(AFVolumeTable *table);
+
+  /// ramp the reader should use for the writes that follow - set inside a batch so every entry
+  /// of the batch moves together over the same time; 0 restores the reader's default
+  void AFVolumeTable_SetRamp(AFVolumeTable *table, uint32_t milliseconds);
+
+  /// set every entry back to unity, unmuted - for a writer that starts without saved state
+  void AFVolumeTable_ResetAll(AFVolumeTable *table);
+
+  /// write the region to a file readers can map with OpenSnapshot - single writer only, with no
+  /// write in flight; the file is replaced atomically and readable by every user
+  /// @return 0, or -1 with errno set
+  int AFVolumeTable_WriteSnapshot(const AFVolumeTable *table, const char *path);
+
+  /// remove the name - existing mappings keep working until they are closed
+  int AFVolumeTable_Unlink(const char *name);
+
+  // MARK: - Reader (driver)
+
+  /// map an existing region read-only
+  /// @return the mapping, or NULL if it doesn't exist or has a foreign layout
+  const AFVolumeTable *AFVolumeTable_Open(const char *name);
+
+  /// map a snapshot file read-only - same layout and accessors as the live region, but frozen
+  /// @return the mapping, or NULL if it doesn't exist or has a foreign layout
+  const AFVolumeTable *AFVolumeTable_OpenSnapshot(const char *path);
+
+  /// bumped after every published write - real-time safe
+  uint64_t AFVolumeTable_Generation(const AFVolumeTable *table);
+
+  /// batch sequence - odd while a batch is being written; compare before and after reading
+  /// several entries to know they came from one batch - real-time safe
+  uint32_t AFVolumeTable_BatchSequence(const AFVolumeTable *table);
+
+  /// ramp in milliseconds for the latest writes, 0 for the reader's default - read it between
+  /// two equal batch sequences to get the ramp that belongs to that batch - real-time safe
+  uint32_t AFVolumeTable_Ramp(const AFVolumeTable *table);
+
+  /// number of published entries - real-time safe
+  uint32_t AFVolumeTable_Count(const AFVolumeTable *table);
+
+  /// bundle ID of a published entry, or NULL - entries never change once published
+  const char *AFVolumeTable_BundleID(const AFVolumeTable *table, int32_t index);
+
+  /// index of the entry with this key, or -1 - bounded linear scan, real-time safe
+  int32_t AFVolumeTable_Find(const AFVolumeTable *table, uint64_t key);
+
+  /// consistent read of one entry, retrying a bounded number of times if a write is in flight
+  /// @return false if the entry doesn't exist or stayed busy - real-time safe
+  bool AFVolumeTable_Read(const AFVolumeTable *table, int32_t index, AFVolumeValue *value);
+
+  // MARK: - Both
+
+  /// unmap a region returned by Create, Open or OpenSnapshot
+  void AFVolumeTable_Close(const AFVolumeTable *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VolumeTable_h */
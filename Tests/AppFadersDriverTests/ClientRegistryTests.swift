@@ -0,0 +1,350 @@
+// ClientRegistryTests.swift
+// Unit tests and a 64-client mix benchmark for per-client gain classification and processing
+//
+// uses Swift Testing framework (@Test, #expect)
+
+@testable import AppFadersDriver
+import AppFadersIPC
+import AppFadersTestSupport
+import AppFadersVolumeTable
+import Testing
+
+// MARK: - Classification Tests
+
+@Suite("ClientProcessing")
+struct ClientProcessingTests {
+  @Test("unity gain bypasses, zero gain mutes, everything else processes")
+  func classify() {
+    #expect(ClientProcessing.classify(gain: 1.0) == .bypass)
+    #expect(ClientProcessing.classify(gain: 0.0) == .mute)
+    #expect(ClientProcessing.classify(gain: 0.5) == .process)
+    #expect(ClientProcessing.classify(gain: 0.999) == .process)
+  }
+}
+
+// MARK: - Registry Tests
+
+@Suite("ClientRegistry")
+struct ClientRegistryTests {
+  @Test("bypass leaves samples untouched")
+  func bypassTouchesNothing() {
+    let registry = ClientRegistry()
+    registry.addClient(clientID: 7, processID: 100, bundleID: "com.test.app", gain: 1.0)
+
+    var samples: [Float] = [0.25, -0.5, 0.75, Float.nan]
+    let processing = samples.withUnsafeMutableBufferPointer { ptr in
+      registry.process(clientID: 7, buffer: ptr.baseAddress!, frameCount: 2, channelCount: 2)
+    }
+
+    #expect(processing == .bypass)
+    #expect(samples[0] == 0.25)
+    #expect(samples[1] == -0.5)
+    #expect(samples[2] == 0.75)
+    // a kernel would have touched this - NaN stays NaN either way, bit pattern must match
+    #expect(samples[3].isNaN)
+  }
+
+  @Test("mute clears the buffer")
+  func muteClears() {
+    let registry = ClientRegistry()
+    registry.addClient(clientID: 7, processID: 100, bundleID: "com.test.app", gain: 0.0)
+
+    var samples = [Float](repeating: 0.8, count: 64)
+    let processing = samples.withUnsafeMutableBufferPointer { ptr in
+      registry.process(clientID: 7, buffer: ptr.baseAddress!, frameCount: 32, channelCount: 2)
+    }
+
+    #expect(processing == .mute)
+    #expect(samples.allSatisfy { $0 == 0 })
+  }
+
+  @Test("non-trivial gain scales samples")
+  func processScales() {
+    let registry = ClientRegistry()
+    registry.addClient(clientID: 7, processID: 100, bundleID: "com.test.app", gain: 0.5)
+
+    var samples = [Float](repeating: 0.8, count: 64)
+    let processing = samples.withUnsafeMutableBufferPointer { ptr in
+      registry.process(clientID: 7, buffer: ptr.baseAddress!, frameCount: 32, channelCount: 2)
+    }
+
+    #expect(processing == .process)
+    #expect(samples.allSatisfy { $0 == 0.4 })
+  }
+
+  @Test("unknown clients pass through at unity")
+  func unknownClient() {
+    let registry = ClientRegistry()
+
+    var samples: [Float] = [0.3, 0.3]
+    let processing = samples.withUnsafeMutableBufferPointer { ptr in
+      registry.process(clientID: 99, buffer: ptr.baseAddress!, frameCount: 1, channelCount: 2)
+    }
+
+    #expect(processing == .bypass)
+    #expect(samples == [0.3, 0.3])
+  }
+
+  @Test("silent buffers skip processing at any gain")
+  func silentSkipsProcessing() {
+    let registry = ClientRegistry()
+    registry.addClient(clientID: 7, processID: 100, bundleID: "com.test.app", gain: 0.5)
+
+    var samples = [Float](repeating: 0, count: 64)
+    samples[3] = -0.0
+    let processing = samples.withUnsafeMutableBufferPointer { ptr in
+      registry.process(clientID: 7, buffer: ptr.baseAddress!, frameCount: 32, channelCount: 2)
+    }
+
+    #expect(processing == .silent)
+  }
+
+  @Test("producing flag follows audio with hysteresis")
+  func producingHysteresis() {
+    let registry = ClientRegistry()
+    registry.addClient(clientID: 7, processID: 100, bundleID: "com.test.app", gain: 1.0)
+    let slot = registry.activeSlot(for: 7)!
+
+    // new clients start idle
+    #expect(!slot.isProducingAudio)
+    #expect(registry.activity().map(\.isProducing) == [false])
+
+    var loud = [Float](repeating: 0.5, count: 64)
+    var quiet = [Float](repeating: 0, count: 64)
+    func run(_ samples: inout [Float]) {
+      samples.withUnsafeMutableBufferPointer { ptr in
+        registry.process(clientID: 7, buffer: ptr.baseAddress!, frameCount: 32, channelCount: 2)
+      }
+    }
+
+    run(&loud)
+    #expect(slot.isProducingAudio)
+    #expect(registry.activity().map(\.isProducing) == [true])
+
+    // stays active through a short gap
+    for _ in 0 ..< (ClientSlot.silenceHoldCycles - 1) {
+      run(&quiet)
+    }
+    #expect(slot.isProducingAudio)
+
+    // goes idle once the hold expires
+    run(&quiet)
+    #expect(!slot.isProducingAudio)
+    #expect(registry.activity().map(\.isProducing) == [false])
+  }
+
+  @Test("a bypassed client's samples are only read once per measurement interval")
+  func bypassMeasuresDecimated() {
+    let registry = ClientRegistry()
+    registry.addClient(clientID: 7, processID: 100, bundleID: "com.test.app", gain: 1.0)
+    let slot = registry.activeSlot(for: 7)!
+
+    func run(_ level: Float) {
+      var samples = [Float](repeating: level, count: 64)
+      samples.withUnsafeMutableBufferPointer { ptr in
+        registry.process(clientID: 7, buffer: ptr.baseAddress!, frameCount: 32, channelCount: 2)
+      }
+    }
+
+    // the first cycle is read, the ones up to the next interval are not
+    run(0)
+    for _ in 1 ..< ClientSlot.bypassMeasureInterval {
+      run(0.5)
+    }
+    #expect(!slot.isProducingAudio)
+    #expect(slot.recentPeak == 0)
+
+    run(0.5)
+    #expect(slot.isProducingAudio)
+    #expect(slot.recentPeak == 0.5)
+  }
+
+  @Test("recent peak rises at once and falls when its window ends")
+  func peakWindow() {
+    let registry = ClientRegistry()
+    registry.addClient(clientID: 7, processID: 100, bundleID: "com.test.app", gain: 0.0)
+    let slot = registry.activeSlot(for: 7)!
+
+    func run(_ level: Float) {
+      var samples = [Float](repeating: 0, count: 64)
+      samples[5] = -level
+      samples.withUnsafeMutableBufferPointer { ptr in
+        registry.process(clientID: 7, buffer: ptr.baseAddress!, frameCount: 32, channelCount: 2)
+      }
+    }
+
+    // measured before gain - a muted app still peaks
+    run(0.8)
+    #expect(slot.recentPeak == 0.8)
+
+    // a quieter window takes over only once the loud one is over
+    for _ in 1 ..< ClientSlot.peakWindowCycles {
+      run(0.2)
+    }
+    #expect(slot.recentPeak == 0.8)
+    for _ in 0 ..< ClientSlot.peakWindowCycles {
+      run(0.2)
+    }
+    #expect(slot.recentPeak == 0.2)
+
+    // cycles the client sent nothing in count as silence
+    for counter in 1 ... UInt64(ClientSlot.peakWindowCycles) {
+      registry.finishCycle(counter: counter)
+    }
+    #expect(slot.recentPeak == 0)
+  }
+
+  @Test("activity folds an app's clients together and leaves out unnamed ones")
+  func activityPerApp() {
+    let registry = ClientRegistry()
+    registry.addClient(clientID: 1, processID: 10, bundleID: "com.test.browser", gain: 1.0)
+    registry.addClient(clientID: 2, processID: 11, bundleID: "com.test.browser.helper", gain: 1.0)
+    registry.addClient(clientID: 3, processID: 20, bundleID: "com.test.other", gain: 1.0)
+    registry.addClient(clientID: 4, processID: 30, bundleID: "", gain: 1.0)
+    registry.setOwner(clientID: 2, bundleID: "com.test.browser")
+
+    var samples = [Float](repeating: 0.5, count: 64)
+    for clientID: UInt32 in [2, 4] {
+      samples.withUnsafeMutableBufferPointer { ptr in
+        registry.process(
+          clientID: clientID,
+          buffer: ptr.baseAddress!,
+          frameCount: 32,
+          channelCount: 2
+        )
+      }
+    }
+
+    let activity = registry.activity()
+    let browser = AFVolumeTable_Key("com.test.browser")
+    let other = AFVolumeTable_Key("com.test.other")
+    #expect(activity == [
+      AppActivity(key: browser, isProducing: true, peak: 0.5),
+      AppActivity(key: other, isProducing: false, peak: 0)
+    ].sorted { $0.key < $1.key })
+  }
+
+  @Test("applyVolumes retargets registered clients and resets missing ones to unity")
+  func applyVolumes() {
+    let registry = ClientRegistry()
+    registry.addClient(clientID: 1, processID: 10, bundleID: "com.test.a", gain: 1.0)
+    registry.addClient(clientID: 2, processID: 20, bundleID: "com.test.b", gain: 0.2)
+
+    registry.applyVolumes(["com.test.a": 0.0], sampleRate: 48000)
+
+    // targets move now, applied gain follows on the IO thread
+    #expect(registry.activeSlot(for: 1)?.targetGain == 0.0)
+    #expect(registry.activeSlot(for: 2)?.targetGain == 1.0)
+    #expect(registry.activeSlot(for: 1)?.gain == 1.0)
+  }
+
+  @Test("a reused slot's measurement starts over when the IO thread first sees the new client")
+  func reusedSlotMeasurement() {
+    let registry = ClientRegistry()
+    registry.addClient(clientID: 7, processID: 100, bundleID: "com.test.app", gain: 0.5)
+    let slot = registry.activeSlot(for: 7)!
+
+    var samples = [Float](repeating: 0.8, count: 64)
+    samples.withUnsafeMutableBufferPointer { ptr in
+      registry.process(clientID: 7, buffer: ptr.baseAddress!, frameCount: 32, channelCount: 2)
+    }
+    #expect(slot.windowPeak == 0.8)
+
+    // registration leaves the IO thread's state alone
+    registry.removeClient(clientID: 7)
+    registry.addClient(clientID: 8, processID: 101, bundleID: "com.test.app", gain: 0.5)
+    #expect(registry.activeSlot(for: 8) === slot)
+    #expect(slot.windowPeak == 0.8)
+
+    samples = [Float](repeating: 0.2, count: 64)
+    samples.withUnsafeMutableBufferPointer { ptr in
+      registry.process(clientID: 8, buffer: ptr.baseAddress!, frameCount: 32, channelCount: 2)
+    }
+    #expect(slot.windowPeak == 0.2)
+    #expect(slot.windowCycles == 1)
+  }
+
+  @Test("registry holds capacity clients and frees slots on removal")
+  func capacity() {
+    let registry = ClientRegistry()
+
+    for id in 1 ... UInt32(ClientRegistry.capacity) {
+      #expect(registry.addClient(clientID: id, processID: 1, bundleID: "com.test.\(id)", gain: 1))
+    }
+    #expect(!registry.addClient(clientID: 1000, processID: 1, bundleID: "com.test.x", gain: 1))
+
+    registry.removeClient(clientID: 5)
+    #expect(registry.activeSlot(for: 5) == nil)
+    #expect(registry.addClient(clientID: 1000, processID: 1, bundleID: "com.test.x", gain: 1))
+  }
+}
+
+// MARK: - Mix Benchmark
+
+/// nanoseconds per IO cycle: every one of a full registry's clients processed once
+/// the first `active` clients run at `gain`, the rest sit at unity
+/// active clients get fresh audio every cycle, as the HAL hands it over; bypassed buffers are
+/// never written, so they keep the audio they were filled with
+private func mixCycleTime(active: Int, gain: Float = 0.5, cycles: Int) -> UInt64 {
+  let frames = 512
+  let clients = ClientRegistry.capacity
+  let registry = ClientRegistry()
+  for id in 1 ... UInt32(clients) {
+    let clientGain = Int(id) <= active ? gain : 1.0
+    registry.addClient(clientID: id, processID: 1, bundleID: "com.test.\(id)", gain: clientGain)
+  }
+
+  let source = (0 ..< frames * 2).map { Float($0 % 200) / 200 - 0.5 }
+  var buffers = (0 ..< clients).flatMap { _ in source }
+  let elapsed = buffers.withUnsafeMutableBufferPointer { all in
+    source.withUnsafeBufferPointer { src in
+      Benchmark.measure {
+        for cycle in 0 ..< cycles {
+          for client in 0 ..< clients {
+            let buffer = all.baseAddress! + client * frames * 2
+            if client < active {
+              buffer.update(from: src.baseAddress!, count: frames * 2)
+            }
+            registry.process(
+              clientID: UInt32(client + 1),
+              buffer: buffer,
+              frameCount: frames,
+              channelCount: 2,
+              sampleTime: Float64(cycle * frames),
+              cycleCounter: UInt64(cycle + 1)
+            )
+          }
+          registry.finishCycle(counter: UInt64(cycle + 1))
+        }
+      }
+    }
+  }
+  return elapsed / UInt64(cycles)
+}
+
+@Suite("ClientRegistry mix benchmark", .enabled(if: Benchmark.isEnabled))
+struct ClientRegistryMixBenchmarkTests {
+  @Test("64 clients per cycle: cost scales with the clients that aren't bypassed")
+  func sixtyFourClients() {
+    let cycles = 500
+    _ = mixCycleTime(active: 64, cycles: cycles / 10)
+    let none = mixCycleTime(active: 0, cycles: cycles)
+    let quarter = mixCycleTime(active: 16, cycles: cycles)
+    let half = mixCycleTime(active: 32, cycles: cycles)
+    let all = mixCycleTime(active: 64, cycles: cycles)
+    let mute = mixCycleTime(active: 64, gain: 0.0, cycles: cycles)
+
+    let report = "64 clients, 512 frames, active 0/16/32/64: \(none)/\(quarter)/\(half)/\(all) ns, "
+      + "all muted \(mute) ns per cycle"
+    Benchmark.report("ClientRegistry mix", report)
+    // bypassed clients read their samples one cycle in bypassMeasureInterval - close to free
+    #expect(none * 4 < all, "\(report)")
+    // the rest is linear in the active clients, with slack for timer noise
+    #expect(quarter < all / 2, "\(report)")
+    #expect(half < all * 3 / 4, "\(report)")
+    #expect(quarter < half, "\(report)")
+    #expect(mute <= all + all / 2, "\(report)")
+    // a 512-frame cycle at 48 kHz has 10.7 ms for everything
+    #expect(all < 2_000_000, "\(report)")
+  }
+}
@@ -0,0 +1,196 @@
+// ConfigurationChangeTests.swift
+// Unit tests for preallocated rate profiles and the configuration-change path
+//
+// uses Swift Testing framework (@Test, #expect)
+
+@testable import AppFadersDriver
+import AppFadersDriverBridge
+import CoreAudio
+import Foundation
+import Testing
+
+// MARK: - Rate Profile Tests
+
+@Suite("RateProfile")
+struct RateProfileTests {
+  @Test("ring depth keeps buffered time constant across rates")
+  func ringSizing() {
+    let counters = IOPathCounters()
+    let profiles = [44100.0, 48000.0, 96000.0].map {
+      RateProfile(sampleRate: $0, counters: counters)
+    }
+
+    #expect(profiles.map(\.ringBuffer.capacity) == [8192, 8192, 16384])
+    #expect(profiles.map(\.ringBuffer.maxLatencyFrames) == [4096, 4096, 8192])
+    #expect(profiles.map(\.maxFillFrames) == [1764, 1920, 3840])
+    // one set of counters for the whole path, whichever profile is active
+    #expect(profiles.allSatisfy { $0.ringBuffer.counters === counters })
+  }
+
+  @Test("large output buffers get a deeper ring, small ones keep the duration-based depth")
+  func ringFitsBufferSize() {
+    #expect(RateProfile.ringCapacity(sampleRate: 48000, bufferFrames: 512) == 8192)
+    #expect(RateProfile.ringCapacity(sampleRate: 48000, bufferFrames: 2048) == 8192)
+    #expect(RateProfile.ringCapacity(sampleRate: 48000, bufferFrames: 4096) == 16384)
+    #expect(RateProfile.ringCapacity(sampleRate: 96000, bufferFrames: 4096) == 16384)
+  }
+}
+
+// MARK: - Configuration Change Tests
+
+/// uses the shared stream/engine/device - serialized and restored to the starting rate
+@Suite("ConfigurationChange", .serialized)
+struct ConfigurationChangeTests {
+  private func format(at rate: Float64) -> AudioStreamBasicDescription {
+    var format = VirtualStream.shared.currentFormat()
+    format.mSampleRate = rate
+    return format
+  }
+
+  @Test("a rate change swaps to the preallocated profile and records timing")
+  func rateChangeRoundTrip() {
+    let engine = PassthroughEngine.shared
+    let originalRate = VirtualStream.shared.getSampleRate()
+    defer { _ = ConfigurationChange.shared.requestFormat(format(at: originalRate)) }
+
+    // no host in tests, so the request applies straight through Perform
+    #expect(ConfigurationChange.shared.requestFormat(format(at: 96000)) == noErr)
+    #expect(engine.profile.sampleRate == 96000)
+    #expect(VirtualStream.shared.getSampleRate() == 96000)
+    let ring96 = engine.profile.ringBuffer
+
+    let timing = ConfigurationChange.shared.lastChangeTiming
+    #expect(timing.requestToApply != nil)
+    #expect(timing.requestToAudio == nil)
+
+    // first IO cycle at the new rate completes the measurement
+    ConfigurationChange.shared.noteCycle(hostTime: mach_absolute_time())
+    #expect(ConfigurationChange.shared.lastChangeTiming.requestToAudio != nil)
+
+    // switching away and back reuses the same preallocated ring
+    #expect(ConfigurationChange.shared.requestFormat(format(at: 44100)) == noErr)
+    #expect(engine.profile.ringBuffer !== ring96)
+    #expect(ConfigurationChange.shared.requestFormat(format(at: 96000)) == noErr)
+    #expect(engine.profile.ringBuffer === ring96)
+  }
+
+  @Test("perform without a matching request changes nothing")
+  func unmatchedPerform() {
+    let rate = VirtualStream.shared.getSampleRate()
+    #expect(ConfigurationChange.shared.perform(action: 12345) == noErr)
+    #expect(VirtualStream.shared.getSampleRate() == rate)
+    #expect(PassthroughEngine.shared.profile.sampleRate == rate)
+  }
+
+  @Test("a format without a kernel leaves the engine's profile and the stream alone")
+  func rejectedFormatSwapsNothing() {
+    let rate = VirtualStream.shared.getSampleRate()
+    let otherRate: Float64 = rate == 96000 ? 44100 : 96000
+    let profile = PassthroughEngine.shared.profile
+
+    // a rate with a profile, in a layout no kernel reads
+    var surround = format(at: otherRate)
+    surround.mChannelsPerFrame = 6
+    surround.mBytesPerFrame = 24
+    surround.mBytesPerPacket = 24
+    #expect(PassthroughEngine.shared.hasProfile(sampleRate: otherRate))
+    let status = ConfigurationChange.shared.requestFormat(surround)
+    #expect(status == kAudioDeviceUnsupportedFormatError)
+
+    #expect(PassthroughEngine.shared.profile === profile)
+    #expect(VirtualStream.shared.getSampleRate() == rate)
+  }
+
+  private func set(
+    _ selector: AudioObjectPropertySelector,
+    _ format: AudioStreamBasicDescription
+  ) -> OSStatus {
+    var format = format
+    return withUnsafeBytes(of: &format) { raw in
+      VirtualStream.shared.setPropertyData(
+        address: AudioObjectPropertyAddress(
+          mSelector: selector,
+          mScope: kAudioObjectPropertyScopeGlobal,
+          mElement: kAudioObjectPropertyElementMain
+        ),
+        data: raw.baseAddress!,
+        size: UInt32(MemoryLayout<AudioStreamBasicDescription>.size)
+      )
+    }
+  }
+
+  @Test("the virtual format stays interleaved stereo float whatever the physical format")
+  func virtualFormatIsCanonical() {
+    let stream = VirtualStream.shared
+    let original = stream.currentFormat()
+    defer { _ = set(kAudioStreamPropertyPhysicalFormat, original) }
+
+    let int16 = IOKernels.format(
+      of: AFIOKernels_Select(AFSampleFormatInt16, 2, false)!.pointee,
+      sampleRate: stream.getSampleRate()
+    )
+    #expect(set(kAudioStreamPropertyVirtualFormat, int16) == kAudioDeviceUnsupportedFormatError)
+
+    #expect(set(kAudioStreamPropertyPhysicalFormat, int16) == noErr)
+    #expect(stream.currentFormat().mFormatFlags == int16.mFormatFlags)
+    #expect(IOKernels.kernel(for: stream.virtualFormat()) == IOKernels.canonical)
+    #expect(PassthroughEngine.shared.currentInputKernel == UnsafeRawPointer(
+      AFIOKernels_Select(AFSampleFormatInt16, 2, false)!
+    ))
+
+    // ProcessOutput still gets the virtual layout
+    let coordinator = IOCycleCoordinator(registry: ClientRegistry())
+    coordinator.beginOperation(
+      kAudioServerPlugInIOOperationProcessOutput,
+      counter: 1,
+      outputSampleTime: 0,
+      outputHostTime: 0,
+      frameCount: 512
+    )
+    #expect(coordinator.current.channelCount == 2)
+
+    // a virtual format only moves the rate, the physical layout stays
+    let canonical = stream.virtualFormat()
+    #expect(set(kAudioStreamPropertyVirtualFormat, canonical) == noErr)
+    #expect(stream.currentFormat().mFormatFlags == int16.mFormatFlags)
+  }
+
+  @Test("a same-rate layout change goes through the request path too")
+  func layoutChangeIsRequested() {
+    let stream = VirtualStream.shared
+    let original = stream.currentFormat()
+    defer { _ = set(kAudioStreamPropertyPhysicalFormat, original) }
+
+    let before = ConfigurationChange.shared.lastChangeTiming.requested
+    let mono = IOKernels.format(
+      of: AFIOKernels_Select(AFSampleFormatFloat32, 1, true)!.pointee,
+      sampleRate: stream.getSampleRate()
+    )
+    #expect(set(kAudioStreamPropertyPhysicalFormat, mono) == noErr)
+    #expect(stream.currentFormat().mChannelsPerFrame == 1)
+    let timing = ConfigurationChange.shared.lastChangeTiming
+    #expect(timing.requested > before)
+    #expect(timing.requestToApply != nil)
+
+    // setting the format it already has is not a change
+    #expect(set(kAudioStreamPropertyPhysicalFormat, mono) == noErr)
+    #expect(ConfigurationChange.shared.lastChangeTiming.requested == timing.requested)
+  }
+
+  @Test("unsupported rates are rejected before any request")
+  func unsupportedRate() {
+    var bad = format(at: 22050)
+    let status = withUnsafeBytes(of: &bad) { raw in
+      VirtualStream.shared.setPropertyData(
+        address: AudioObjectPropertyAddress(
+          mSelector: kAudioStreamPropertyVirtualFormat,
+          mScope: kAudioObjectPropertyScopeGlobal,
+          mElement: kAudioObjectPropertyElementMain
+        ),
+        data: raw.baseAddress!,
+        size: UInt32(MemoryLayout<AudioStreamBasicDescription>.size)
+      )
+    }
+    #expect(status == kAudioDeviceUnsupportedFormatError)
+  }
+}
@@ -0,0 +1,286 @@
+// DSPKernelsTests.swift
+// Cross-checks every compiled-in kernel variant against the scalar reference, and benchmarks
+// them against it
+//
+// uses Swift Testing framework (@Test, #expect)
+
+@testable import AppFadersDriver
+import AppFadersDriverBridge
+import AppFadersTestSupport
+import Testing
+
+// MARK: - Helpers
+
+/// every variant this machine can run, scalar included
+private func availableVariants() -> [UnsafePointer<AFKernelTable>] {
+  (0 ..< AFKernelISACount.rawValue).compactMap { raw in
+    AFKernels_Variant(AFKernelISA(rawValue: raw))
+  }
+}
+
+/// deterministic pseudo-random samples in [-1, 1]
+private func makeSamples(count: Int, seed: UInt32) -> [Float] {
+  var state = seed
+  return (0 ..< count).map { _ in
+    state = state &* 1_664_525 &+ 1_013_904_223
+    return Float(state >> 8) / Float(1 << 24) * 2.0 - 1.0
+  }
+}
+
+// odd lengths exercise the scalar tails of every vector width
+private let lengths = [0, 1, 2, 3, 7, 15, 16, 17, 31, 33, 63, 64, 65, 511, 512, 1023]
+
+// MARK: - Registry Tests
+
+@Suite("DSPKernels registry")
+struct DSPKernelRegistryTests {
+  @Test("scalar reference is always available")
+  func referenceAvailable() {
+    let reference = AFKernels_Reference()!
+    #expect(reference.pointee.isa == AFKernelISAScalar)
+    #expect(AFKernels_Variant(AFKernelISAScalar) == reference)
+  }
+
+  @Test("initialize binds a supported variant")
+  func initializeBindsSupportedVariant() {
+    AFKernels_Initialize()
+    let active = AFKernels_Active()!
+    #expect(AFKernels_Variant(active.pointee.isa) == active)
+    #expect(!DSPKernels.activeVariant.isEmpty)
+  }
+}
+
+// MARK: - Variant Cross-Checks
+
+@Suite("DSPKernels variants")
+struct DSPKernelVariantTests {
+  @Test("applyGain matches reference for every variant")
+  func applyGainMatchesReference() {
+    let reference = AFKernels_Reference()!.pointee
+
+    for table in availableVariants() {
+      for length in lengths {
+        var expected = makeSamples(count: length, seed: UInt32(length) + 1)
+        var actual = expected
+
+        expected.withUnsafeMutableBufferPointer { ptr in
+          reference.applyGain!(ptr.baseAddress, UInt32(length), 0.37)
+        }
+        actual.withUnsafeMutableBufferPointer { ptr in
+          table.pointee.applyGain!(ptr.baseAddress, UInt32(length), 0.37)
+        }
+
+        let name = String(cString: table.pointee.name)
+        #expect(actual == expected, "\(name) applyGain mismatch at length \(length)")
+      }
+    }
+  }
+
+  @Test("applyGainRamp matches reference for every variant")
+  func applyGainRampMatchesReference() {
+    let reference = AFKernels_Reference()!.pointee
+
+    for table in availableVariants() {
+      for channels in [1, 2, 6] {
+        for frames in lengths {
+          let count = frames * channels
+          var expected = makeSamples(count: count, seed: UInt32(count) + 7)
+          var actual = expected
+
+          expected.withUnsafeMutableBufferPointer { ptr in
+            reference.applyGainRamp!(ptr.baseAddress, UInt32(frames), UInt32(channels), 0.2, 0.001)
+          }
+          actual.withUnsafeMutableBufferPointer { ptr in
+            table.pointee.applyGainRamp!(
+              ptr.baseAddress,
+              UInt32(frames),
+              UInt32(channels),
+              0.2,
+              0.001
+            )
+          }
+
+          // fused multiply-add in wider variants can differ in the last bit
+          let name = String(cString: table.pointee.name)
+          for i in 0 ..< count {
+            #expect(
+              abs(actual[i] - expected[i]) <= 1e-6,
+              "\(name) ramp mismatch: \(channels)ch \(frames) frames, index \(i)"
+            )
+          }
+        }
+      }
+    }
+  }
+
+  @Test("peak matches reference for every variant")
+  func peakMatchesReference() {
+    let reference = AFKernels_Reference()!.pointee
+
+    for table in availableVariants() {
+      for length in lengths {
+        var samples = makeSamples(count: length, seed: UInt32(length) + 13)
+        // put the loudest sample in the tail so vector remainders are covered
+        if length > 0 {
+          samples[length - 1] = -1.5
+        }
+
+        let expected = samples.withUnsafeBufferPointer { ptr in
+          reference.peak!(ptr.baseAddress, UInt32(length))
+        }
+        let actual = samples.withUnsafeBufferPointer { ptr in
+          table.pointee.peak!(ptr.baseAddress, UInt32(length))
+        }
+
+        let name = String(cString: table.pointee.name)
+        #expect(actual == expected, "\(name) peak mismatch at length \(length)")
+      }
+    }
+  }
+}
+
+// MARK: - Silence Detection
+
+@Suite("DSPKernels silence detection")
+struct DSPKernelSilenceTests {
+  @Test("isSilent matches reference for every variant")
+  func isSilentMatchesReference() {
+    let reference = AFKernels_Reference()!.pointee
+
+    for table in availableVariants() {
+      let name = String(cString: table.pointee.name)
+
+      for length in lengths {
+        // signed zeros count as silence
+        var samples = (0 ..< length).map { $0 % 2 == 0 ? Float(0) : Float(-0.0) }
+        let silent = samples.withUnsafeBufferPointer { ptr in
+          table.pointee.isSilent!(ptr.baseAddress, UInt32(length))
+        }
+        #expect(silent, "\(name) reported sound in zeros at length \(length)")
+
+        // a single tiny sample anywhere breaks silence, tails included
+        for position in [0, length / 2, length - 1] where position >= 0 && position < length {
+          samples[position] = Float.leastNonzeroMagnitude
+          let (expected, actual) = samples.withUnsafeBufferPointer { ptr in
+            (
+              reference.isSilent!(ptr.baseAddress, UInt32(length)),
+              table.pointee.isSilent!(ptr.baseAddress, UInt32(length))
+            )
+          }
+          #expect(!expected)
+          #expect(actual == expected, "\(name) missed sample at \(position) of \(length)")
+          samples[position] = 0
+        }
+      }
+    }
+  }
+}
+
+// MARK: - Benchmark
+
+/// nanoseconds per IO cycle for the kernels a process pass runs: silence check, peak, gain
+/// ramp - on one 512-frame stereo buffer
+private func cycleTime(_ table: AFKernelTable, rounds: Int) -> UInt64 {
+  var samples = makeSamples(count: 1024, seed: 7)
+  var sink: Float = 0
+  let elapsed = samples.withUnsafeMutableBufferPointer { ptr in
+    Benchmark.measure(rounds: rounds) {
+      if !table.isSilent!(ptr.baseAddress, 1024) {
+        sink += table.peak!(ptr.baseAddress, 1024)
+      }
+      // a ramp that ends where it starts keeps the samples in range across rounds
+      table.applyGainRamp!(ptr.baseAddress, 512, 2, 1.0, 0)
+      table.applyGain!(ptr.baseAddress, 1024, 1.0)
+    }
+  }
+  #expect(sink > 0)
+  return elapsed / UInt64(rounds)
+}
+
+@Suite("DSPKernels benchmark", .enabled(if: Benchmark.isEnabled))
+struct DSPKernelBenchmarkTests {
+  @Test("every variant runs a 512-frame cycle at least about as fast as the scalar reference")
+  func variantsAgainstReference() {
+    let rounds = 20000
+    let reference = AFKernels_Reference()!.pointee
+    // warm up caches and clocks before the first measurement
+    _ = cycleTime(reference, rounds: rounds / 10)
+    let referenceTime = cycleTime(reference, rounds: rounds)
+
+    for table in availableVariants() {
+      let time = cycleTime(table.pointee, rounds: rounds)
+      let report = "\(String(cString: table.pointee.name)) \(time) ns per cycle, "
+        + "scalar \(referenceTime) ns"
+      Benchmark.report("DSPKernels cycle", report)
+      // generous - the compiler may vectorize the scalar loops too
+      #expect(time <= referenceTime * 2 + 200, "\(report)")
+      // a 512-frame cycle at 48 kHz has 10.7 ms; the kernels should use a sliver of it
+      #expect(time < 100_000, "\(report)")
+    }
+  }
+}
+
+// MARK: - Denormal Protection
+
+@Suite("Denormal protection")
+struct DenormalProtectionTests {
+  @Test("subnormal results flush to zero while disabled and come back after restore")
+  func flushToZeroScope() {
+    let reference = AFKernels_Reference()!.pointee
+    var samples: [Float] = [Float.leastNormalMagnitude]
+
+    // go through the C kernel so the multiply happens at runtime
+    let state = AFDenormals_Disable()
+    samples.withUnsafeMutableBufferPointer { ptr in
+      reference.applyGain!(ptr.baseAddress, 1, 0.5)
+    }
+    AFDenormals_Restore(state)
+    #expect(samples[0] == 0)
+
+    samples[0] = Float.leastNormalMagnitude
+    samples.withUnsafeMutableBufferPointer { ptr in
+      reference.applyGain!(ptr.baseAddress, 1, 0.5)
+    }
+    #expect(samples[0].isSubnormal)
+  }
+
+  @Test(
+    "with flush-to-zero a cycle of subnormals costs what a normal cycle does",
+    .enabled(if: Benchmark.isEnabled)
+  )
+  func subnormalCycleCost() {
+    let reference = AFKernels_Reference()!.pointee
+    let rounds = 20000
+    // a fading tail - every product stays subnormal unless the thread flushes
+    let subnormal = [Float](repeating: Float.leastNormalMagnitude / 4, count: 1024)
+    let normal = [Float](repeating: 0.25, count: 1024)
+
+    /// nanoseconds per 512-frame stereo gain pass, refilled from input every round
+    func cycleTime(_ input: [Float]) -> UInt64 {
+      var buffer = input
+      let elapsed = buffer.withUnsafeMutableBufferPointer { ptr in
+        input.withUnsafeBufferPointer { src in
+          Benchmark.measure(rounds: rounds) {
+            ptr.baseAddress!.update(from: src.baseAddress!, count: 1024)
+            reference.applyGain!(ptr.baseAddress, 1024, 0.999)
+          }
+        }
+      }
+      return elapsed / UInt64(rounds)
+    }
+
+    _ = cycleTime(normal)
+    let normalTime = cycleTime(normal)
+    let unflushed = cycleTime(subnormal)
+    let state = AFDenormals_Disable()
+    let flushed = cycleTime(subnormal)
+    AFDenormals_Restore(state)
+
+    let report = "subnormal \(unflushed) ns per cycle unflushed, \(flushed) ns flushed, "
+      + "normal \(normalTime) ns"
+    Benchmark.report("subnormal cycle", report)
+    // generous - CPUs that handle subnormals in hardware show no difference at all
+    #expect(flushed <= normalTime * 2 + 500, "\(report)")
+    #expect(flushed <= unflushed + unflushed / 2 + 500, "\(report)")
+  }
+}
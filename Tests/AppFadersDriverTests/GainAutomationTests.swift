@@ -0,0 +1,202 @@
+// GainAutomationTests.swift
+// Unit tests for the control-plane command queue and sample-accurate gain ramps
+//
+// uses Swift Testing framework (@Test, #expect)
+
+@testable import AppFadersDriver
+import Dispatch
+import Synchronization
+import Testing
+
+// MARK: - Helpers
+
+/// run one mono ProcessOutput cycle of constant 1.0 samples and return what came out
+private func renderCycle(
+  _ registry: ClientRegistry,
+  clientID: UInt32,
+  frameCount: Int,
+  sampleTime: Float64
+) -> [Float] {
+  var samples = [Float](repeating: 1.0, count: frameCount)
+  registry.drainCommands(sampleTime: sampleTime)
+  samples.withUnsafeMutableBufferPointer { ptr in
+    registry.process(
+      clientID: clientID,
+      buffer: ptr.baseAddress!,
+      frameCount: frameCount,
+      channelCount: 1,
+      sampleTime: sampleTime
+    )
+  }
+  return samples
+}
+
+// MARK: - Command Queue Tests
+
+@Suite("CommandQueue")
+struct CommandQueueTests {
+  @Test("delivers in order and rejects when full")
+  func fifoAndFull() {
+    let queue = CommandQueue<Int>(capacity: 4)
+    #expect(queue.capacity == 4)
+
+    for value in 0 ..< 4 {
+      #expect(queue.enqueue(value))
+    }
+    #expect(!queue.enqueue(99))
+
+    #expect(queue.dequeue() == 0)
+    #expect(queue.enqueue(4))
+    #expect(queue.dequeue() == 1)
+    #expect(queue.dequeue() == 2)
+    #expect(queue.dequeue() == 3)
+    #expect(queue.dequeue() == 4)
+    #expect(queue.dequeue() == nil)
+  }
+
+  @Test("concurrent producers lose nothing and keep per-producer order")
+  func concurrentProducers() {
+    let producers = 4
+    let perProducer = 5000
+    let queue = CommandQueue<(producer: Int, sequence: Int)>(capacity: 64)
+    let failures = Atomic<Int>(0)
+
+    // iteration 0 is the single consumer, the rest produce into a queue much smaller than the load
+    DispatchQueue.concurrentPerform(iterations: producers + 1) { iteration in
+      if iteration == 0 {
+        var next = [Int](repeating: 0, count: producers)
+        var received = 0
+        while received < producers * perProducer {
+          guard let item = queue.dequeue() else { continue }
+          if item.sequence != next[item.producer] {
+            failures.add(1, ordering: .relaxed)
+          }
+          next[item.producer] = item.sequence + 1
+          received += 1
+        }
+      } else {
+        let producer = iteration - 1
+        for sequence in 0 ..< perProducer {
+          while !queue.enqueue((producer, sequence)) {}
+        }
+      }
+    }
+
+    #expect(failures.load(ordering: .relaxed) == 0)
+    #expect(queue.dequeue() == nil)
+  }
+}
+
+// MARK: - Automation Tests
+
+@Suite("GainAutomation")
+struct GainAutomationTests {
+  @Test("a jump lands on its exact frame inside the buffer")
+  func jumpAtSampleOffset() {
+    let registry = ClientRegistry()
+    registry.addClient(clientID: 7, processID: 100, bundleID: "com.test.app", gain: 1.0)
+
+    #expect(registry.scheduleRamp(bundleID: "com.test.app", to: 0.0, rampFrames: 0, at: 1010) == 1)
+    let output = renderCycle(registry, clientID: 7, frameCount: 32, sampleTime: 1000)
+
+    #expect(output[0 ..< 10].allSatisfy { $0 == 1.0 })
+    #expect(output[10...].allSatisfy { $0 == 0.0 })
+    #expect(registry.activeSlot(for: 7)?.gain == 0.0)
+  }
+
+  @Test("a ramp runs linearly across buffer boundaries and ends on target")
+  func rampAcrossBuffers() {
+    let registry = ClientRegistry()
+    registry.addClient(clientID: 7, processID: 100, bundleID: "com.test.app", gain: 1.0)
+    registry.scheduleRamp(bundleID: "com.test.app", to: 0.0, rampFrames: 64, at: 16)
+
+    let first = renderCycle(registry, clientID: 7, frameCount: 48, sampleTime: 0)
+    let second = renderCycle(registry, clientID: 7, frameCount: 48, sampleTime: 48)
+    let output = first + second
+
+    for frame in 0 ..< output.count {
+      let expected: Float = frame < 16 ? 1.0 : max(0, 1.0 - Float(frame - 16) / 64)
+      #expect(abs(output[frame] - expected) <= 1e-5, "frame \(frame)")
+    }
+    #expect(output[80...].allSatisfy { $0 == 0.0 })
+  }
+
+  @Test("fades scheduled at the same sample time line up across apps")
+  func synchronizedAcrossApps() {
+    let registry = ClientRegistry()
+    registry.addClient(clientID: 1, processID: 10, bundleID: "com.test.a", gain: 1.0)
+    registry.addClient(clientID: 2, processID: 20, bundleID: "com.test.b", gain: 0.5)
+
+    registry.scheduleRamp(bundleID: "com.test.a", to: 0.0, rampFrames: 8, at: 520)
+    registry.scheduleRamp(bundleID: "com.test.b", to: 0.0, rampFrames: 8, at: 520)
+
+    let a = renderCycle(registry, clientID: 1, frameCount: 32, sampleTime: 512)
+    let b = renderCycle(registry, clientID: 2, frameCount: 32, sampleTime: 512)
+
+    // both start moving at frame 8 and are silent from frame 16
+    #expect(a[7] == 1.0 && b[7] == 0.5)
+    #expect(a[9] < 1.0 && b[9] < 0.5)
+    #expect(a[16...].allSatisfy { $0 == 0 } && b[16...].allSatisfy { $0 == 0 })
+  }
+
+  @Test("later commands queue behind earlier ones")
+  func fadeOutThenIn() {
+    let registry = ClientRegistry()
+    registry.addClient(clientID: 7, processID: 100, bundleID: "com.test.app", gain: 1.0)
+    registry.scheduleRamp(bundleID: "com.test.app", to: 1.0, rampFrames: 0, at: 24)
+    registry.scheduleRamp(bundleID: "com.test.app", to: 0.0, rampFrames: 0, at: 8)
+
+    let output = renderCycle(registry, clientID: 7, frameCount: 32, sampleTime: 0)
+
+    #expect(output[0 ..< 8].allSatisfy { $0 == 1.0 })
+    #expect(output[8 ..< 24].allSatisfy { $0 == 0.0 })
+    #expect(output[24...].allSatisfy { $0 == 1.0 })
+  }
+
+  @Test("commands for a client that left are dropped")
+  func staleCommandDropped() {
+    let registry = ClientRegistry()
+    registry.addClient(clientID: 7, processID: 100, bundleID: "com.test.app", gain: 1.0)
+    registry.scheduleRamp(bundleID: "com.test.app", to: 0.0, rampFrames: 0)
+
+    // same slot, new client
+    registry.removeClient(clientID: 7)
+    registry.addClient(clientID: 8, processID: 101, bundleID: "com.test.app", gain: 1.0)
+
+    let output = renderCycle(registry, clientID: 8, frameCount: 16, sampleTime: 0)
+    #expect(output.allSatisfy { $0 == 1.0 })
+  }
+
+  @Test("silent cycles still advance a ramp")
+  func silenceAdvancesRamp() {
+    let registry = ClientRegistry()
+    registry.addClient(clientID: 7, processID: 100, bundleID: "com.test.app", gain: 1.0)
+    registry.scheduleRamp(bundleID: "com.test.app", to: 0.0, rampFrames: 32)
+
+    var quiet = [Float](repeating: 0, count: 32)
+    registry.drainCommands(sampleTime: 0)
+    let processing = quiet.withUnsafeMutableBufferPointer { ptr in
+      registry.process(clientID: 7, buffer: ptr.baseAddress!, frameCount: 32, channelCount: 1)
+    }
+
+    #expect(processing == .silent)
+    #expect(registry.activeSlot(for: 7)?.gain == 0.0)
+  }
+
+  @Test("a gain target without a command is reached by the fallback ramp")
+  func droppedCommandFallback() {
+    let registry = ClientRegistry()
+    registry.addClient(clientID: 7, processID: 100, bundleID: "com.test.app", gain: 1.0)
+    let slot = registry.activeSlot(for: 7)!
+
+    // as if the queue had been full when this was set
+    slot.setTargetGain(0.5)
+
+    let frames = GainAutomation.fallbackRampFrames
+    let output = renderCycle(registry, clientID: 7, frameCount: frames + 4, sampleTime: 0)
+
+    #expect(output[0] == 1.0)
+    #expect(output[frames...].allSatisfy { $0 == 0.5 })
+    #expect(slot.gain == 0.5)
+  }
+}
@@ -0,0 +1,23 @@
+// HelperBridgeTests.swift
+// Unit tests for the driver's helper connection policy
+//
+// uses Swift Testing framework (@Test, #expect)
+
+@testable import AppFadersDriver
+import Testing
+
+@Suite("HelperBridge")
+struct HelperBridgeTests {
+  @Test("reconnect delays double from the first attempt and stop at the cap")
+  func reconnectBackoff() {
+    let delays = (0 ..< 12).map { HelperBridge.reconnectDelay(attempt: $0) }
+
+    #expect(delays[0] == HelperBridge.initialReconnectDelay)
+    #expect(delays[1] == HelperBridge.initialReconnectDelay * 2)
+    #expect(delays[3] == HelperBridge.initialReconnectDelay * 8)
+    #expect(zip(delays, delays.dropFirst()).allSatisfy { $0 <= $1 })
+    #expect(delays.last == HelperBridge.maxReconnectDelay)
+    // very long outages neither overflow nor exceed the cap
+    #expect(HelperBridge.reconnectDelay(attempt: 10000) == HelperBridge.maxReconnectDelay)
+  }
+}
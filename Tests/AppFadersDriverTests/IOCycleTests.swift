@@ -0,0 +1,128 @@
+// IOCycleTests.swift
+// Unit tests for once-per-cycle work driven by Begin/EndIOOperation
+//
+// uses Swift Testing framework (@Test, #expect)
+
+@testable import AppFadersDriver
+import Testing
+
+// MARK: - Helpers
+
+private let processOutput = kAudioServerPlugInIOOperationProcessOutput
+private let writeMix = kAudioServerPlugInIOOperationWriteMix
+
+private func begin(_ coordinator: IOCycleCoordinator, _ operationID: UInt32, counter: UInt64) {
+  coordinator.beginOperation(
+    operationID,
+    counter: counter,
+    outputSampleTime: Float64(counter) * 512,
+    outputHostTime: counter * 1000,
+    frameCount: 512
+  )
+}
+
+/// one ProcessOutput for a client inside the coordinator's current cycle
+private func processClient(
+  _ registry: ClientRegistry,
+  _ coordinator: IOCycleCoordinator,
+  clientID: UInt32,
+  value: Float
+) -> [Float] {
+  var samples = [Float](repeating: value, count: 16)
+  samples.withUnsafeMutableBufferPointer { ptr in
+    registry.process(
+      clientID: clientID,
+      buffer: ptr.baseAddress!,
+      frameCount: 16,
+      channelCount: 1,
+      sampleTime: coordinator.current.outputSampleTime,
+      cycleCounter: coordinator.current.counter
+    )
+  }
+  return samples
+}
+
+// MARK: - Coordinator Tests
+
+@Suite("IOCycleCoordinator")
+struct IOCycleCoordinatorTests {
+  @Test("cycle info is captured on the first Begin and held until WriteMix ends")
+  func cycleLifetime() {
+    let coordinator = IOCycleCoordinator(registry: ClientRegistry())
+
+    begin(coordinator, processOutput, counter: 3)
+    #expect(coordinator.isInCycle)
+    #expect(coordinator.current.counter == 3)
+    #expect(coordinator.current.outputSampleTime == 1536)
+    #expect(coordinator.current.outputHostTime == 3000)
+    #expect(coordinator.current.frameCount == 512)
+
+    // ending a client operation keeps the cycle open
+    coordinator.endOperation(processOutput)
+    #expect(coordinator.isInCycle)
+
+    begin(coordinator, writeMix, counter: 3)
+    coordinator.endOperation(writeMix)
+    #expect(!coordinator.isInCycle)
+  }
+
+  @Test("commands drain once per cycle, not per operation")
+  func drainOncePerCycle() {
+    let registry = ClientRegistry()
+    let coordinator = IOCycleCoordinator(registry: registry)
+    registry.addClient(clientID: 7, processID: 100, bundleID: "com.test.app", gain: 1.0)
+
+    begin(coordinator, processOutput, counter: 1)
+    registry.scheduleRamp(bundleID: "com.test.app", to: 0.0, rampFrames: 0)
+
+    // a second operation in the same cycle must not pick the command up
+    begin(coordinator, processOutput, counter: 1)
+    #expect(processClient(registry, coordinator, clientID: 7, value: 1.0).allSatisfy { $0 == 1 })
+    coordinator.endOperation(writeMix)
+
+    begin(coordinator, processOutput, counter: 2)
+    #expect(processClient(registry, coordinator, clientID: 7, value: 1.0).allSatisfy { $0 == 0 })
+  }
+
+  @Test("a cycle without WriteMix is closed by the next cycle")
+  func cycleWithoutMix() {
+    let registry = ClientRegistry()
+    let coordinator = IOCycleCoordinator(registry: registry)
+    registry.addClient(clientID: 7, processID: 100, bundleID: "com.test.app", gain: 1.0)
+
+    begin(coordinator, processOutput, counter: 1)
+    _ = processClient(registry, coordinator, clientID: 7, value: 0.5)
+    #expect(registry.activeSlot(for: 7)!.isProducingAudio)
+
+    begin(coordinator, processOutput, counter: 2)
+    #expect(coordinator.isInCycle)
+    #expect(coordinator.current.counter == 2)
+  }
+
+  @Test("clients that stop sending audio age out of the producing set")
+  func absentClientsGoIdle() {
+    let registry = ClientRegistry()
+    let coordinator = IOCycleCoordinator(registry: registry)
+    registry.addClient(clientID: 1, processID: 10, bundleID: "com.test.a", gain: 1.0)
+    registry.addClient(clientID: 2, processID: 20, bundleID: "com.test.b", gain: 1.0)
+
+    var counter: UInt64 = 1
+    begin(coordinator, processOutput, counter: counter)
+    _ = processClient(registry, coordinator, clientID: 1, value: 0.5)
+    _ = processClient(registry, coordinator, clientID: 2, value: 0.5)
+    coordinator.endOperation(writeMix)
+    #expect(registry.activeSlot(for: 1)!.isProducingAudio)
+    #expect(registry.activeSlot(for: 2)!.isProducingAudio)
+
+    // client 2 keeps playing, client 1 stops calling ProcessOutput without leaving
+    for _ in 0 ..< ClientSlot.silenceHoldCycles {
+      counter += 1
+      begin(coordinator, processOutput, counter: counter)
+      _ = processClient(registry, coordinator, clientID: 2, value: 0.5)
+      coordinator.endOperation(writeMix)
+    }
+
+    #expect(!registry.activeSlot(for: 1)!.isProducingAudio)
+    #expect(registry.activeSlot(for: 2)!.isProducingAudio)
+  }
+}
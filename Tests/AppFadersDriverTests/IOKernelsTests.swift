@@ -0,0 +1,218 @@
+// IOKernelsTests.swift
+// Unit tests and a conversion benchmark for the format-specialized IO kernels
+//
+// uses Swift Testing framework (@Test, #expect)
+
+@testable import AppFadersDriver
+import AppFadersDriverBridge
+import AppFadersTestSupport
+import CoreAudio
+import Testing
+
+// MARK: - Helpers
+
+/// raw source buffer with recognizable values for the kernel's sample format
+private func makeSource(for kernel: AFIOKernel, frames: Int) -> [UInt8] {
+  let samples = frames * Int(kernel.channelCount)
+  if kernel.sampleFormat == AFSampleFormatFloat32 {
+    let values = (0 ..< samples).map { Float($0) * 0.001 - 0.5 }
+    return values.withUnsafeBytes { Array($0) }
+  }
+  let values = (0 ..< samples).map { Int16(truncatingIfNeeded: $0 &* 97 &- 16000) }
+  return values.withUnsafeBytes { Array($0) }
+}
+
+// MARK: - Kernel Tests
+
+@Suite("IOKernels")
+struct IOKernelsTests {
+  @Test("every specialization matches the generic loop")
+  func specializationsMatchGeneric() {
+    let frames = 97
+
+    for index in 0 ..< AFIOKernels_Count() {
+      let kernel = AFIOKernels_At(index)!.pointee
+      let source = makeSource(for: kernel, frames: frames)
+
+      // convert from an offset so the planar stride and frame offset both matter
+      var specialized = [Float](repeating: -1, count: 60 * 2)
+      var generic = [Float](repeating: -2, count: 60 * 2)
+
+      source.withUnsafeBytes { src in
+        specialized.withUnsafeMutableBufferPointer { dst in
+          kernel.toCanonical!(src.baseAddress, UInt32(frames), 17, dst.baseAddress, 60)
+        }
+        generic.withUnsafeMutableBufferPointer { dst in
+          AFIOKernels_ConvertGeneric(
+            kernel.sampleFormat,
+            kernel.channelCount,
+            kernel.interleaved,
+            src.baseAddress,
+            UInt32(frames),
+            17,
+            dst.baseAddress,
+            60
+          )
+        }
+      }
+
+      let name = String(cString: kernel.name)
+      #expect(specialized == generic, "\(name) differs from generic conversion")
+    }
+  }
+
+  @Test("default stream format selects the canonical kernel")
+  func defaultFormatSelection() {
+    let kernel = IOKernels.kernel(for: StreamFormat.default.toASBD())
+    #expect(kernel == IOKernels.canonical)
+    #expect(kernel?.pointee.bytesPerFrame == 8)
+  }
+
+  @Test("unsupported formats have no kernel")
+  func unsupportedFormats() {
+    var format = StreamFormat.default.toASBD()
+    format.mChannelsPerFrame = 6
+    #expect(IOKernels.kernel(for: format) == nil)
+
+    format = StreamFormat.default.toASBD()
+    format.mFormatID = kAudioFormatAppleLossless
+    #expect(IOKernels.kernel(for: format) == nil)
+  }
+
+  @Test("every advertised format selects the kernel it was built from")
+  func advertisedFormats() {
+    for index in 0 ..< AFIOKernels_Count() {
+      let kernel = AFIOKernels_At(index)!
+      let format = IOKernels.format(of: kernel.pointee, sampleRate: 48000)
+      #expect(IOKernels.kernel(for: format) == kernel, "\(String(cString: kernel.pointee.name))")
+    }
+    let advertised = VirtualStream.shared.availableFormats()
+    #expect(advertised.count == Int(AFIOKernels_Count()) * 3)
+    #expect(advertised.allSatisfy { IOKernels.kernel(for: $0.mFormat) != nil })
+  }
+
+  @Test("a format is only accepted if every field matches a kernel")
+  func strictValidation() {
+    let int16 = IOKernels.format(
+      of: AFIOKernels_Select(AFSampleFormatInt16, 2, true)!.pointee,
+      sampleRate: 48000
+    )
+    #expect(IOKernels.kernel(for: int16) != nil)
+
+    var format = int16
+    format.mFormatFlags |= kAudioFormatFlagIsBigEndian
+    #expect(IOKernels.kernel(for: format) == nil)
+
+    format = int16
+    format.mBytesPerFrame = 8
+    format.mBytesPerPacket = 8
+    #expect(IOKernels.kernel(for: format) == nil)
+
+    format = int16
+    format.mBitsPerChannel = 24
+    #expect(IOKernels.kernel(for: format) == nil)
+
+    format = int16
+    format.mFormatFlags &= ~kAudioFormatFlagIsPacked
+    #expect(IOKernels.kernel(for: format) == nil)
+
+    format = int16
+    format.mFramesPerPacket = 2
+    #expect(IOKernels.kernel(for: format) == nil)
+
+    format = StreamFormat.default.toASBD()
+    format.mFormatFlags |= kAudioFormatFlagIsSignedInteger
+    #expect(IOKernels.kernel(for: format) == nil)
+  }
+
+  @Test("ring write through mono kernel duplicates channels across wrap")
+  func monoKernelRingWrite() {
+    let buffer = AudioRingBuffer()
+    let mono = AFIOKernels_Select(AFSampleFormatFloat32, 1, true)!
+
+    // move the indices close to the end of storage so the write wraps
+    let filler = [Float](repeating: 0, count: 8100 * 2)
+    var scratch = [Float](repeating: 0, count: 8100 * 2)
+    _ = filler.withUnsafeBufferPointer { ptr in
+      buffer.write(frames: ptr.baseAddress!, frameCount: 8100)
+    }
+    _ = scratch.withUnsafeMutableBufferPointer { ptr in
+      buffer.read(into: ptr.baseAddress!, frameCount: 8100)
+    }
+
+    let input: [Float] = (0 ..< 200).map { Float($0) }
+    let written = input.withUnsafeBytes { src in
+      buffer.write(from: src.baseAddress!, frameCount: 200, kernel: mono)
+    }
+    #expect(written == 200)
+
+    var output = [Float](repeating: -1, count: 400)
+    let read = output.withUnsafeMutableBufferPointer { ptr in
+      buffer.read(into: ptr.baseAddress!, frameCount: 200)
+    }
+    #expect(read == 200)
+
+    for frame in 0 ..< 200 {
+      #expect(output[frame * 2] == Float(frame))
+      #expect(output[frame * 2 + 1] == Float(frame))
+    }
+  }
+}
+
+// MARK: - Benchmark
+
+@Suite("IOKernels benchmark", .enabled(if: Benchmark.isEnabled))
+struct IOKernelsBenchmarkTests {
+  @Test("every specialization converts a 512-frame cycle no slower than the generic loop")
+  func specializedAgainstGeneric() {
+    let frames = 512
+    let rounds = 2000
+    // alternating trials, best of each - scheduler hiccups only ever make a trial slower
+    let trials = 7
+
+    for index in 0 ..< AFIOKernels_Count() {
+      let kernel = AFIOKernels_At(index)!.pointee
+      let source = makeSource(for: kernel, frames: frames)
+      var destination = [Float](repeating: 0, count: frames * 2)
+
+      let (specialized, generic) = source.withUnsafeBytes { src in
+        destination.withUnsafeMutableBufferPointer { dst in
+          let convert = kernel.toCanonical!
+          let runSpecialized = {
+            convert(src.baseAddress, UInt32(frames), 0, dst.baseAddress, UInt32(frames))
+          }
+          let runGeneric = {
+            AFIOKernels_ConvertGeneric(
+              kernel.sampleFormat,
+              kernel.channelCount,
+              kernel.interleaved,
+              src.baseAddress,
+              UInt32(frames),
+              0,
+              dst.baseAddress,
+              UInt32(frames)
+            )
+          }
+          // warm up caches and clocks before the first measurement
+          _ = Benchmark.measure(rounds: rounds / 10, runSpecialized)
+          _ = Benchmark.measure(rounds: rounds / 10, runGeneric)
+
+          var specialized = UInt64.max
+          var generic = UInt64.max
+          for _ in 0 ..< trials {
+            specialized = min(specialized, Benchmark.measure(rounds: rounds, runSpecialized))
+            generic = min(generic, Benchmark.measure(rounds: rounds, runGeneric))
+          }
+          return (specialized / UInt64(rounds), generic / UInt64(rounds))
+        }
+      }
+
+      let report = "\(String(cString: kernel.name)) \(specialized) ns per cycle, "
+        + "generic \(generic) ns"
+      Benchmark.report("IOKernels cycle", report)
+      // no slower than the generic loop - 5% covers timer resolution at these durations
+      #expect(specialized <= generic + generic / 20, "\(report)")
+      #expect(specialized < 50000, "\(report)")
+    }
+  }
+}
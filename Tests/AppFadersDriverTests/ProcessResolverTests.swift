@@ -0,0 +1,364 @@
+// ProcessResolverTests.swift
+// Unit tests and a churn benchmark for pid-to-owning-app resolution
+//
+// uses Swift Testing framework (@Test, #expect)
+
+@testable import AppFadersDriver
+import AppFadersTestSupport
+import AppFadersVolumeTable
+import Foundation
+import Synchronization
+import Testing
+
+// MARK: - Helpers
+
+/// in-memory process table that counts executable lookups - the expensive part on macOS
+private final class FakeProcessTable: ProcessTable, @unchecked Sendable {
+  private struct Process {
+    let identity: ProcessIdentity
+    let path: String?
+  }
+
+  private let lock = NSLock()
+  private var processes: [pid_t: Process] = [:]
+  private var reads = 0
+
+  var pathReads: Int {
+    lock.withLock { reads }
+  }
+
+  func spawn(_ pid: pid_t, parent: pid_t, startTime: UInt64, path: String?) {
+    lock.withLock {
+      processes[pid] = Process(
+        identity: ProcessIdentity(parent: parent, startTime: startTime),
+        path: path
+      )
+    }
+  }
+
+  func exit(_ pid: pid_t) {
+    lock.withLock { _ = processes.removeValue(forKey: pid) }
+  }
+
+  func identity(of pid: pid_t) -> ProcessIdentity? {
+    lock.withLock { processes[pid]?.identity }
+  }
+
+  func executablePath(of pid: pid_t) -> String? {
+    lock.withLock {
+      reads += 1
+      return processes[pid]?.path
+    }
+  }
+}
+
+private let browser = "/Applications/Browser.app/Contents/MacOS/Browser"
+private let browserHelper = "/Applications/Browser.app/Contents/Frameworks/Browser Framework"
+  + ".framework/Helpers/Browser Helper.app/Contents/MacOS/Browser Helper"
+private let player = "/Applications/Player.app/Contents/MacOS/Player"
+
+/// bundle IDs by app path, like Info.plist would give them
+private let bundleIDs: [String: String] = [
+  "/Applications/Browser.app": "com.test.browser",
+  "/Applications/Player.app": "com.test.player"
+]
+
+private func resolver(
+  _ table: FakeProcessTable,
+  capacity: Int = 512,
+  negativeLifetime: TimeInterval = 5.0
+) -> ProcessResolver {
+  ProcessResolver(table: table, capacity: capacity, negativeLifetime: negativeLifetime) {
+    bundleIDs[$0]
+  }
+}
+
+// MARK: - LRU Tests
+
+@Suite("LRUCache")
+struct LRUCacheTests {
+  @Test("the least recently used key goes first, and a read counts as use")
+  func evictionOrder() {
+    var cache = LRUCache<Int, String>(capacity: 3)
+    cache.set("a", for: 1)
+    cache.set("b", for: 2)
+    cache.set("c", for: 3)
+    #expect(cache.value(for: 1) == "a")
+
+    cache.set("d", for: 4)
+    #expect(cache.count == 3)
+    #expect(cache.value(for: 2) == nil)
+    #expect(cache.value(for: 1) == "a")
+    #expect(cache.value(for: 3) == "c")
+    #expect(cache.value(for: 4) == "d")
+  }
+
+  @Test("replacing a value keeps one entry and refreshes it")
+  func replace() {
+    var cache = LRUCache<Int, Int>(capacity: 2)
+    cache.set(1, for: 1)
+    cache.set(2, for: 2)
+    cache.set(10, for: 1)
+    cache.set(3, for: 3)
+    #expect(cache.count == 2)
+    #expect(cache.value(for: 1) == 10)
+    #expect(cache.value(for: 2) == nil)
+  }
+
+  @Test("a capacity of one holds the latest key")
+  func capacityOne() {
+    var cache = LRUCache<Int, Int>(capacity: 1)
+    cache.set(1, for: 1)
+    cache.set(2, for: 2)
+    #expect(cache.value(for: 1) == nil)
+    #expect(cache.value(for: 2) == 2)
+  }
+}
+
+// MARK: - Resolver Tests
+
+@Suite("ProcessResolver")
+struct ProcessResolverTests {
+  @Test("the outermost app in a path owns everything nested inside it")
+  func outermostApp() {
+    #expect(ProcessResolver.outermostApp(in: browserHelper) == "/Applications/Browser.app")
+    #expect(ProcessResolver.outermostApp(in: player) == "/Applications/Player.app")
+    #expect(ProcessResolver.outermostApp(in: "/usr/bin/afplay") == nil)
+    #expect(ProcessResolver.outermostApp(in: "/opt/my.appliance/bin/tool") == nil)
+  }
+
+  @Test("a nested helper app resolves to the app around it")
+  func nestedHelper() {
+    let table = FakeProcessTable()
+    table.spawn(500, parent: 1, startTime: 1, path: browser)
+    table.spawn(501, parent: 500, startTime: 2, path: browserHelper)
+
+    #expect(resolver(table).owner(of: 501) == "com.test.browser")
+  }
+
+  @Test("a process outside any bundle resolves to its nearest ancestor in one")
+  func bundlelessChild() {
+    let table = FakeProcessTable()
+    table.spawn(600, parent: 1, startTime: 1, path: player)
+    table.spawn(601, parent: 600, startTime: 2, path: "/usr/local/bin/decoder")
+    table.spawn(602, parent: 601, startTime: 3, path: "/usr/local/bin/worker")
+
+    let resolver = resolver(table)
+    #expect(resolver.owner(of: 602) == "com.test.player")
+
+    // the walk cached the ancestors too - the sibling stops at its parent
+    table.spawn(603, parent: 601, startTime: 4, path: "/usr/local/bin/worker")
+    let reads = table.pathReads
+    #expect(resolver.owner(of: 603) == "com.test.player")
+    #expect(table.pathReads == reads + 1)
+  }
+
+  @Test("no owner is cached until it expires")
+  func negativeCaching() {
+    let table = FakeProcessTable()
+    table.spawn(700, parent: 1, startTime: 1, path: "/usr/sbin/daemon")
+
+    let cached = resolver(table)
+    #expect(cached.owner(of: 700) == nil)
+    let reads = table.pathReads
+    #expect(cached.owner(of: 700) == nil)
+    #expect(table.pathReads == reads)
+
+    let expiring = resolver(table, negativeLifetime: 0)
+    #expect(expiring.owner(of: 700) == nil)
+    let before = table.pathReads
+    #expect(expiring.owner(of: 700) == nil)
+    #expect(table.pathReads == before + 1)
+  }
+
+  @Test("a reused pid never inherits the previous process's owner")
+  func pidReuse() {
+    let table = FakeProcessTable()
+    table.spawn(500, parent: 1, startTime: 1, path: browser)
+    table.spawn(800, parent: 500, startTime: 2, path: browserHelper)
+
+    let resolver = resolver(table)
+    #expect(resolver.owner(of: 800) == "com.test.browser")
+
+    table.exit(800)
+    table.spawn(800, parent: 1, startTime: 3, path: player)
+    #expect(resolver.owner(of: 800) == "com.test.player")
+  }
+
+  @Test("a process that is gone has no owner")
+  func goneProcess() {
+    #expect(resolver(FakeProcessTable()).owner(of: 4242) == nil)
+  }
+
+  @Test("resolve answers off the caller's thread")
+  func resolveAsync() async {
+    let table = FakeProcessTable()
+    table.spawn(500, parent: 1, startTime: 1, path: browser)
+    table.spawn(501, parent: 500, startTime: 2, path: browserHelper)
+
+    let resolver = resolver(table)
+    let owner = await withCheckedContinuation { continuation in
+      resolver.resolve(501) { continuation.resume(returning: $0) }
+    }
+    #expect(owner == "com.test.browser")
+  }
+}
+
+// MARK: - /proc Stand-in Tests
+
+/// a fake /proc and app tree under a temporary directory, removed when the test ends
+private final class FakeProcRoot {
+  let directory = NSTemporaryDirectory() + "afproc.\(getpid()).\(UInt32.random(in: 0 ... .max))"
+
+  var proc: String {
+    directory + "/proc"
+  }
+
+  deinit {
+    try? FileManager.default.removeItem(atPath: directory)
+  }
+
+  /// an app bundle with an Info.plist - returns its directory
+  func app(_ name: String, bundleID: String) throws -> String {
+    let app = directory + "/Applications/\(name).app"
+    try FileManager.default.createDirectory(
+      atPath: app + "/Contents/MacOS",
+      withIntermediateDirectories: true
+    )
+    let plist = try PropertyListSerialization.data(
+      fromPropertyList: ["CFBundleIdentifier": bundleID],
+      format: .xml,
+      options: 0
+    )
+    try plist.write(to: URL(fileURLWithPath: app + "/Contents/Info.plist"))
+    return app
+  }
+
+  /// /proc/<pid>/stat and exe as the kernel writes them
+  func process(_ pid: pid_t, parent: pid_t, startTime: UInt64, executable: String) throws {
+    let entry = proc + "/\(pid)"
+    try FileManager.default.createDirectory(atPath: entry, withIntermediateDirectories: true)
+    // comm with a space and a parenthesis, as real ones may have
+    let fields = ["S", "\(parent)"] + Array(repeating: "0", count: 17) + ["\(startTime)", "0"]
+    try "\(pid) (Web Content (1)) \(fields.joined(separator: " "))\n"
+      .write(toFile: entry + "/stat", atomically: true, encoding: .utf8)
+    try FileManager.default.createSymbolicLink(
+      atPath: entry + "/exe",
+      withDestinationPath: executable
+    )
+  }
+}
+
+@Suite("ProcFSProcessTable")
+struct ProcFSProcessTableTests {
+  @Test("parent and start time come from stat, the executable from the exe link")
+  func readsFakeProc() throws {
+    let root = FakeProcRoot()
+    try root.process(42, parent: 7, startTime: 123_456, executable: "/usr/bin/worker")
+
+    let table = ProcFSProcessTable(root: root.proc)
+    #expect(table.identity(of: 42) == ProcessIdentity(parent: 7, startTime: 123_456))
+    #expect(table.executablePath(of: 42) == "/usr/bin/worker")
+    #expect(table.identity(of: 43) == nil)
+  }
+
+  @Test("a helper in a fake /proc resolves through real Info.plist files")
+  func resolvesThroughFakeProc() throws {
+    let root = FakeProcRoot()
+    let app = try root.app("Browser", bundleID: "com.test.browser")
+    try root.process(10, parent: 1, startTime: 1, executable: app + "/Contents/MacOS/Browser")
+    try root.process(
+      11,
+      parent: 10,
+      startTime: 2,
+      executable: app + "/Contents/Frameworks/Helper.app/Contents/MacOS/Helper"
+    )
+    try root.process(12, parent: 11, startTime: 3, executable: "/usr/bin/worker")
+
+    let resolver = ProcessResolver(table: ProcFSProcessTable(root: root.proc))
+    #expect(resolver.owner(of: 11) == "com.test.browser")
+    #expect(resolver.owner(of: 12) == "com.test.browser")
+  }
+
+  @Test(
+    "this process reads back from the real /proc",
+    .enabled(if: FileManager.default.fileExists(atPath: "/proc/self/stat"))
+  )
+  func realProc() {
+    let identity = ProcFSProcessTable().identity(of: getpid())
+    #expect(identity?.parent == getppid())
+    #expect(ProcFSProcessTable().executablePath(of: getpid()) != nil)
+  }
+}
+
+// MARK: - Registry Hand-off
+
+@Suite("ClientRegistry owner")
+struct ClientRegistryOwnerTests {
+  @Test("setOwner moves the client to the owner's table key")
+  func setOwner() {
+    let registry = ClientRegistry()
+    registry.addClient(clientID: 7, processID: 501, bundleID: "com.test.browser.helper", gain: 1)
+
+    registry.setOwner(clientID: 7, bundleID: "com.test.browser")
+    let slot = registry.activeSlot(for: 7)
+    #expect(slot?.bundleID == "com.test.browser")
+    #expect(slot?.volumeKey.load(ordering: .relaxed) == AFVolumeTable_Key("com.test.browser"))
+
+    // a client that already left is ignored
+    registry.removeClient(clientID: 7)
+    registry.setOwner(clientID: 7, bundleID: "com.test.other")
+    #expect(registry.activeSlot(for: 7) == nil)
+  }
+}
+
+// MARK: - Churn Benchmark
+
+@Suite("ProcessResolver churn")
+struct ProcessResolverChurnTests {
+  @Test("rapid helper churn with pid reuse: every answer right, each process read once")
+  func churn() {
+    let table = FakeProcessTable()
+    table.spawn(500, parent: 1, startTime: 1, path: browser)
+    table.spawn(600, parent: 1, startTime: 2, path: player)
+    table.spawn(700, parent: 1, startTime: 3, path: "/usr/sbin/daemon")
+    let resolver = resolver(table, capacity: 256)
+
+    // helpers come and go in a pid range much smaller than their number, so pids get reused
+    // while the cache still holds the previous owner; each is looked up several times, as
+    // AddDeviceClient and later refreshes would
+    let spawns = 20000
+    let lookupsPerProcess = 4
+    var wrong = 0
+    var startTime: UInt64 = 10
+    let start = Benchmark.now
+    for spawn in 0 ..< spawns {
+      let pid = pid_t(1000 + spawn % 300)
+      startTime += 1
+      let (parent, path, expected): (pid_t, String?, String?) = switch spawn % 4 {
+      case 0: (500, browserHelper, "com.test.browser")
+      case 1: (500, "/usr/local/bin/renderer", "com.test.browser")
+      case 2: (600, "/usr/local/bin/decoder", "com.test.player")
+      default: (700, "/usr/local/bin/plugin", nil)
+      }
+      table.exit(pid)
+      table.spawn(pid, parent: parent, startTime: startTime, path: path)
+      for _ in 0 ..< lookupsPerProcess where resolver.owner(of: pid) != expected {
+        wrong += 1
+      }
+    }
+    let elapsed = Benchmark.now - start
+
+    let lookups = spawns * lookupsPerProcess
+    let perLookup = elapsed / UInt64(lookups)
+    let report = "\(lookups) lookups, \(perLookup) ns each, \(table.pathReads) path reads"
+    #expect(wrong == 0, "\(report)")
+    // one read per process, plus the three parents once each - repeats hit the cache
+    #expect(table.pathReads <= spawns + 3, "\(report)")
+    Benchmark.report("ProcessResolver churn", report)
+    // generous bound, on request only - the cached path is a dictionary probe and an identity read
+    if Benchmark.isEnabled {
+      #expect(perLookup < 50000, "\(report)")
+    }
+  }
+}
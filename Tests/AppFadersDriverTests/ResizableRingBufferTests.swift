@@ -0,0 +1,245 @@
+// ResizableRingBufferTests.swift
+// Unit and stress tests, and a cycle benchmark, for resizing the passthrough ring while IO runs
+//
+// uses Swift Testing framework (@Test, #expect)
+
+@testable import AppFadersDriver
+import AppFadersTestSupport
+import Dispatch
+import Foundation
+import Synchronization
+import Testing
+
+// MARK: - Helpers
+
+/// stereo frames whose left and right samples both carry the frame's sequence number
+private func sequenceFrames(from start: Int, count: Int) -> [Float] {
+  (0 ..< count * 2).map { Float(start + $0 / 2) }
+}
+
+@discardableResult
+private func write(_ ring: ResizableRingBuffer, _ samples: [Float]) -> Int {
+  samples.withUnsafeBytes { src in
+    ring.write(from: src.baseAddress!, frameCount: samples.count / 2, kernel: IOKernels.canonical)
+  }
+}
+
+private func read(_ ring: ResizableRingBuffer, frames: Int) -> (Int, [Float]) {
+  var output = [Float](repeating: -1, count: frames * 2)
+  let count = output.withUnsafeMutableBufferPointer { ptr in
+    ring.read(into: ptr.baseAddress!, frameCount: frames)
+  }
+  return (count, output)
+}
+
+/// counters shared by the stress test's threads
+private final class StressState: Sendable {
+  let produced = Atomic<Int>(0)
+  let consumed = Atomic<Int>(0)
+  let errors = Atomic<Int>(0)
+  let done = Atomic<Bool>(false)
+  /// set if the test gives up waiting, so every spinning thread exits
+  let abandoned = Atomic<Bool>(false)
+}
+
+// MARK: - Resizable Ring Tests
+
+@Suite("ResizableRingBuffer")
+struct ResizableRingBufferTests {
+  @Test("a resize switches at the next write and drains the old ring first")
+  func resizePreservesOrder() {
+    let ring = ResizableRingBuffer(capacity: 1024)
+
+    write(ring, sequenceFrames(from: 0, count: 100))
+    ring.resize(capacity: 4096)
+    #expect(ring.capacity == 1024)
+    #expect(ring.isResizing)
+
+    write(ring, sequenceFrames(from: 100, count: 100))
+    #expect(ring.capacity == 4096)
+    #expect(ring.counters.resizes.load(ordering: .relaxed) == 1)
+
+    // one read spans the end of the old ring and the start of the new one
+    let (count, output) = read(ring, frames: 150)
+    #expect(count == 150)
+    #expect(output == sequenceFrames(from: 0, count: 150))
+    #expect(!ring.isResizing)
+
+    let (rest, tail) = read(ring, frames: 50)
+    #expect(rest == 50)
+    #expect(tail == sequenceFrames(from: 150, count: 50))
+    ring.collect()
+  }
+
+  @Test("a resize queued while the old ring drains is taken once the drain finishes")
+  func resizeWaitsForDrain() {
+    let ring = ResizableRingBuffer(capacity: 1024)
+
+    ring.resize(capacity: 2048)
+    write(ring, sequenceFrames(from: 0, count: 10))
+    ring.resize(capacity: 4096)
+
+    // the 1024 ring hasn't been drained by a read yet, so the producer stays on 2048
+    write(ring, sequenceFrames(from: 10, count: 10))
+    #expect(ring.capacity == 2048)
+
+    // no collect() in between - the drained ring waits in a retired slot
+    _ = read(ring, frames: 20)
+    write(ring, sequenceFrames(from: 20, count: 10))
+    #expect(ring.capacity == 4096)
+
+    // the next resize collects both retired rings and switches as usual
+    _ = read(ring, frames: 10)
+    ring.resize(capacity: 1024)
+    write(ring, sequenceFrames(from: 30, count: 10))
+    #expect(ring.capacity == 1024)
+    #expect(ring.counters.resizes.load(ordering: .relaxed) == 3)
+  }
+
+  @Test("continuous resizing under simulated IO loses and reorders nothing")
+  func stressResize() {
+    let ring = ResizableRingBuffer(capacity: 2048)
+    let cycleFrames = 256
+    let totalCycles = 4000
+    let state = StressState()
+
+    // one thread per role, so the spinning sides can't starve each other of a worker
+    let finished = DispatchGroup()
+    func spawn(_ body: @escaping @Sendable () -> Void) {
+      finished.enter()
+      Thread {
+        body()
+        finished.leave()
+      }.start()
+    }
+
+    // producer (virtual device IO)
+    spawn {
+      for cycle in 0 ..< totalCycles {
+        // keep the backlog below the smallest ring's latency limit so trimming never kicks in
+        while state.produced.load(ordering: .acquiring)
+          - state.consumed.load(ordering: .acquiring) > cycleFrames
+        {
+          if state.abandoned.load(ordering: .relaxed) { return }
+        }
+        let written = write(ring, sequenceFrames(from: cycle * cycleFrames, count: cycleFrames))
+        if written != cycleFrames {
+          state.errors.add(1, ordering: .relaxed)
+        }
+        state.produced.add(cycleFrames, ordering: .releasing)
+      }
+    }
+
+    // consumer (output IOProc)
+    spawn {
+      var expected = 0
+      while expected < totalCycles * cycleFrames, !state.abandoned.load(ordering: .relaxed) {
+        guard state.produced.load(ordering: .acquiring) - expected >= cycleFrames else { continue }
+        let (count, output) = read(ring, frames: cycleFrames)
+        if count != cycleFrames || output != sequenceFrames(from: expected, count: cycleFrames) {
+          state.errors.add(1, ordering: .relaxed)
+        }
+        expected += count
+        state.consumed.store(expected, ordering: .releasing)
+      }
+      state.done.store(true, ordering: .releasing)
+    }
+
+    // control thread
+    spawn {
+      let depths = [1024, 4096, 2048, 8192]
+      var index = 0
+      while !state.done.load(ordering: .acquiring), !state.abandoned.load(ordering: .relaxed) {
+        ring.resize(capacity: depths[index % depths.count])
+        index += 1
+      }
+    }
+
+    let result = finished.wait(timeout: .now() + 60)
+    if result == .timedOut {
+      state.abandoned.store(true, ordering: .relaxed)
+      finished.wait()
+    }
+    ring.collect()
+
+    #expect(result == .success, "IO threads stalled")
+    #expect(state.errors.load(ordering: .relaxed) == 0)
+    #expect(ring.counters.resizes.load(ordering: .relaxed) > 0)
+    #expect(ring.counters.latencyTrims.load(ordering: .relaxed) == 0)
+  }
+}
+
+// MARK: - Benchmark
+
+/// nanoseconds per IO cycle: one 256-frame write and one 256-frame read
+/// resizeEvery > 0 also requests a new depth (and collects) every that many cycles
+private func ringCycleTime(
+  cycles: Int,
+  resizeEvery: Int = 0,
+  write: (UnsafeRawPointer) -> Void,
+  read: (UnsafeMutablePointer<Float>) -> Void,
+  resize: (Int) -> Void = { _ in }
+) -> UInt64 {
+  let input = sequenceFrames(from: 0, count: 256)
+  var output = [Float](repeating: 0, count: 512)
+  let depths = [1024, 4096, 2048, 8192]
+  let elapsed = input.withUnsafeBytes { src in
+    output.withUnsafeMutableBufferPointer { dst in
+      Benchmark.measure {
+        for cycle in 0 ..< cycles {
+          if resizeEvery > 0, cycle % resizeEvery == 0 {
+            resize(depths[(cycle / resizeEvery) % depths.count])
+          }
+          write(src.baseAddress!)
+          read(dst.baseAddress!)
+        }
+      }
+    }
+  }
+  return elapsed / UInt64(cycles)
+}
+
+@Suite("ResizableRingBuffer benchmark", .enabled(if: Benchmark.isEnabled))
+struct ResizableRingBufferBenchmarkTests {
+  @Test("the resizable ring costs about what a fixed ring does, even while resizing")
+  func againstFixedRing() {
+    let cycles = 50000
+    let kernel = IOKernels.canonical
+
+    let fixed = AudioRingBuffer(capacity: 2048, maxLatencyFrames: 1024)
+    let fixedTime = ringCycleTime(
+      cycles: cycles,
+      write: { _ = fixed.write(from: $0, frameCount: 256, kernel: kernel) },
+      read: { _ = fixed.read(into: $0, frameCount: 256) }
+    )
+
+    let steady = ResizableRingBuffer(capacity: 2048)
+    let steadyTime = ringCycleTime(
+      cycles: cycles,
+      write: { _ = steady.write(from: $0, frameCount: 256, kernel: kernel) },
+      read: { _ = steady.read(into: $0, frameCount: 256) }
+    )
+
+    let resizing = ResizableRingBuffer(capacity: 2048)
+    let resizingTime = ringCycleTime(
+      cycles: cycles,
+      resizeEvery: 64,
+      write: { _ = resizing.write(from: $0, frameCount: 256, kernel: kernel) },
+      read: { _ = resizing.read(into: $0, frameCount: 256) },
+      resize: { depth in
+        resizing.collect()
+        resizing.resize(capacity: depth)
+      }
+    )
+
+    let report = "fixed \(fixedTime) ns, resizable \(steadyTime) ns, "
+      + "resizing every 64 cycles \(resizingTime) ns per cycle, "
+      + "\(resizing.counters.resizes.load(ordering: .relaxed)) resizes"
+    Benchmark.report("ResizableRingBuffer cycle", report)
+    #expect(resizing.counters.resizes.load(ordering: .relaxed) > 0, "\(report)")
+    // generous - the resizable ring adds one atomic load per side when nothing is pending
+    #expect(steadyTime <= fixedTime * 2 + 500, "\(report)")
+    // resizing includes the control-thread allocation, amortized over 64 cycles
+    #expect(resizingTime < 50000, "\(report)")
+  }
+}
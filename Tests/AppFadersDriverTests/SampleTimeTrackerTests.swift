@@ -0,0 +1,163 @@
+// SampleTimeTrackerTests.swift
+// Unit tests for sample-time discontinuity detection and ring resync
+//
+// uses Swift Testing framework (@Test, #expect)
+
+@testable import AppFadersDriver
+import Testing
+
+// MARK: - Helpers
+
+/// write one stereo cycle of a constant value at a sample time
+@discardableResult
+private func writeCycle(
+  _ ring: AudioRingBuffer,
+  _ tracker: inout SampleTimeTracker,
+  at sampleTime: Float64,
+  frames: Int,
+  value: Float
+) -> SampleTimeEvent {
+  let samples = [Float](repeating: value, count: frames * 2)
+  return samples.withUnsafeBytes { src in
+    ring.write(
+      from: src.baseAddress!,
+      frameCount: frames,
+      sampleTime: sampleTime,
+      kernel: IOKernels.canonical,
+      tracker: &tracker
+    )
+  }
+}
+
+/// read frames and return the left channel
+private func readLeft(_ ring: AudioRingBuffer, frames: Int) -> [Float] {
+  var output = [Float](repeating: -1, count: frames * 2)
+  _ = output.withUnsafeMutableBufferPointer { ptr in
+    ring.read(into: ptr.baseAddress!, frameCount: frames)
+  }
+  return stride(from: 0, to: output.count, by: 2).map { output[$0] }
+}
+
+// MARK: - Tracker Tests
+
+@Suite("SampleTimeTracker")
+struct SampleTimeTrackerTests {
+  @Test("classifies continuation, gaps, overlaps and jumps")
+  func classify() {
+    var tracker = SampleTimeTracker(maxFillFrames: 1024)
+
+    #expect(tracker.classify(sampleTime: 1000, frameCount: 512) == .first)
+    #expect(tracker.classify(sampleTime: 1512, frameCount: 512) == .continuous)
+    // one dropped cycle
+    #expect(tracker.classify(sampleTime: 2536, frameCount: 512) == .gap(frames: 512))
+    // cycle restarted 100 frames back
+    #expect(tracker.classify(sampleTime: 2948, frameCount: 512) == .overlap(frames: 100))
+    // exact replay of the last cycle
+    #expect(tracker.classify(sampleTime: 2948, frameCount: 512) == .overlap(frames: 512))
+    // float noise on the timestamp is not a discontinuity
+    #expect(tracker.classify(sampleTime: 3460.0001, frameCount: 512) == .continuous)
+  }
+
+  @Test("jumps beyond the fill limit or the cycle length resync")
+  func largeJumps() {
+    var tracker = SampleTimeTracker(maxFillFrames: 1024)
+    tracker.classify(sampleTime: 0, frameCount: 512)
+
+    #expect(tracker.classify(sampleTime: 512 + 1025, frameCount: 512) == .discontinuity)
+    // HAL restart back to zero
+    #expect(tracker.classify(sampleTime: 0, frameCount: 512) == .discontinuity)
+    #expect(tracker.classify(sampleTime: 512, frameCount: 512) == .continuous)
+  }
+
+  @Test("reset re-anchors the timeline")
+  func reset() {
+    var tracker = SampleTimeTracker()
+    tracker.classify(sampleTime: 0, frameCount: 512)
+    tracker.reset()
+    #expect(tracker.expectedSampleTime == nil)
+    #expect(tracker.classify(sampleTime: 1_000_000, frameCount: 512) == .first)
+  }
+}
+
+// MARK: - Ring Repair Tests
+
+@Suite("AudioRingBuffer timeline repair")
+struct RingTimelineRepairTests {
+  @Test("gaps are zero-filled in place")
+  func gapZeroFill() {
+    let ring = AudioRingBuffer()
+    var tracker = SampleTimeTracker()
+
+    writeCycle(ring, &tracker, at: 0, frames: 16, value: 1)
+    #expect(writeCycle(ring, &tracker, at: 20, frames: 16, value: 2) == .gap(frames: 4))
+
+    let left = readLeft(ring, frames: 36)
+    #expect(left[0 ..< 16].allSatisfy { $0 == 1 })
+    #expect(left[16 ..< 20].allSatisfy { $0 == 0 })
+    #expect(left[20 ..< 36].allSatisfy { $0 == 2 })
+    #expect(ring.counters.gaps.load(ordering: .relaxed) == 1)
+    #expect(ring.counters.gapFrames.load(ordering: .relaxed) == 4)
+  }
+
+  @Test("overlapping frames are dropped, not repeated")
+  func overlapTrim() {
+    let ring = AudioRingBuffer()
+    var tracker = SampleTimeTracker()
+
+    writeCycle(ring, &tracker, at: 0, frames: 16, value: 1)
+    #expect(writeCycle(ring, &tracker, at: 12, frames: 16, value: 2) == .overlap(frames: 4))
+
+    let left = readLeft(ring, frames: 28)
+    #expect(left[0 ..< 16].allSatisfy { $0 == 1 })
+    #expect(left[16 ..< 28].allSatisfy { $0 == 2 })
+    #expect(ring.counters.droppedFrames.load(ordering: .relaxed) == 4)
+  }
+
+  @Test("sleep/wake replay drops stale audio and stays at bounded latency")
+  func sleepWakeReplay() {
+    let ring = AudioRingBuffer()
+    var tracker = SampleTimeTracker()
+
+    // steady playback with the reader lagging a few cycles behind
+    var sampleTime: Float64 = 0
+    for _ in 0 ..< 8 {
+      writeCycle(ring, &tracker, at: sampleTime, frames: 512, value: 1)
+      sampleTime += 512
+    }
+    _ = readLeft(ring, frames: 512 * 4)
+
+    // system sleeps for ten minutes, then the HAL resumes far ahead
+    sampleTime += 48000 * 600
+    #expect(writeCycle(ring, &tracker, at: sampleTime, frames: 512, value: 2) == .discontinuity)
+    sampleTime += 512
+    #expect(writeCycle(ring, &tracker, at: sampleTime, frames: 512, value: 2) == .continuous)
+
+    // reader skips the four stale pre-sleep cycles and plays only post-wake audio
+    let left = readLeft(ring, frames: 1024)
+    #expect(left.allSatisfy { $0 == 2 })
+    #expect(ring.counters.resyncs.load(ordering: .relaxed) == 1)
+
+    // and the device restarting its clock from zero resyncs the same way
+    #expect(writeCycle(ring, &tracker, at: 0, frames: 512, value: 3) == .discontinuity)
+    #expect(readLeft(ring, frames: 512).allSatisfy { $0 == 3 })
+  }
+
+  @Test("backlog beyond the latency limit is trimmed on read")
+  func latencyTrim() {
+    let ring = AudioRingBuffer(maxLatencyFrames: 64)
+    var tracker = SampleTimeTracker()
+
+    // producer runs ahead by 200 frames, oldest first
+    for cycle in 0 ..< 10 {
+      writeCycle(ring, &tracker, at: Float64(cycle * 20), frames: 20, value: Float(cycle))
+    }
+
+    // after a 16-frame read, half the limit (32 frames) must remain - reading starts at frame 152
+    let left = readLeft(ring, frames: 16)
+    #expect(ring.counters.latencyTrims.load(ordering: .relaxed) == 1)
+    #expect(left == [Float](repeating: 7, count: 8) + [Float](repeating: 8, count: 8))
+
+    let rest = readLeft(ring, frames: 32)
+    #expect(rest == [Float](repeating: 8, count: 12) + [Float](repeating: 9, count: 20))
+  }
+}
@@ -0,0 +1,304 @@
+// SharedVolumeTableTests.swift
+// Unit tests for the shared-memory volume table between helper and driver
+//
+// uses Swift Testing framework (@Test, #expect)
+
+@testable import AppFadersDriver
+import AppFadersTestSupport
+import AppFadersVolumeTable
+import Dispatch
+import Foundation
+import Synchronization
+import Testing
+
+// MARK: - Helpers
+
+/// unique region name per test so parallel runs never share a table (31 character limit)
+private func regionName() -> String {
+  "/aft.\(getpid()).\(UInt32.random(in: 0 ... UInt32.max))"
+}
+
+/// unique snapshot file per test
+private func snapshotFileName() -> String {
+  NSTemporaryDirectory() + "aft.\(getpid()).\(UInt32.random(in: 0 ... UInt32.max)).snapshot"
+}
+
+/// helper side of a table, removed again when the test ends
+private final class TestWriter {
+  let name = regionName()
+  let table: OpaquePointer
+
+  init() {
+    table = AFVolumeTable_Create(name)
+  }
+
+  deinit {
+    AFVolumeTable_Close(table)
+    AFVolumeTable_Unlink(name)
+  }
+
+  func set(_ bundleID: String, _ gain: Float, muted: Bool = false) {
+    AFVolumeTable_Write(table, AFVolumeTable_Intern(table, bundleID), gain, muted)
+  }
+}
+
+// MARK: - Table Tests
+
+@Suite("SharedVolumeTable")
+struct SharedVolumeTableTests {
+  @Test("entries are interned once and read back through the read-only mapping")
+  func internAndRead() {
+    let writer = TestWriter()
+    let first = AFVolumeTable_Intern(writer.table, "com.test.a")
+    let second = AFVolumeTable_Intern(writer.table, "com.test.b")
+    #expect(first == 0 && second == 1)
+    #expect(AFVolumeTable_Intern(writer.table, "com.test.a") == first)
+
+    let reader = SharedVolumeTable(name: writer.name)
+    #expect(reader.open())
+    #expect(reader.volume(for: "com.test.a") == 1.0)
+    #expect(reader.volume(for: "com.test.missing") == nil)
+
+    let before = AFVolumeTable_Generation(reader.table)
+    writer.set("com.test.b", 0.25)
+    #expect(AFVolumeTable_Generation(reader.table) > before)
+    #expect(reader.volume(for: "com.test.b") == 0.25)
+
+    writer.set("com.test.b", 0.25, muted: true)
+    #expect(reader.volume(for: "com.test.b") == 0.0)
+  }
+
+  @Test("a missing region is reported, not mapped")
+  func missingRegion() {
+    let reader = SharedVolumeTable(name: regionName())
+    #expect(!reader.open())
+    #expect(!reader.isMapped)
+    #expect(reader.volume(for: "com.test.a") == nil)
+  }
+
+  @Test("before the helper runs, the snapshot supplies gains from the first cycle")
+  func snapshotBeforeHelper() throws {
+    let snapshotPath = snapshotFileName()
+    defer { unlink(snapshotPath) }
+
+    // last run: the helper wrote a snapshot, then went away with its region
+    do {
+      let previous = TestWriter()
+      previous.set("com.test.pad", 0.9)
+      previous.set("com.test.a", 0.4)
+      #expect(AFVolumeTable_WriteSnapshot(previous.table, snapshotPath) == 0)
+    }
+
+    let name = regionName()
+    let reader = SharedVolumeTable(name: name, snapshotPath: snapshotPath)
+    #expect(!reader.open())
+    #expect(reader.isMapped && !reader.isLive)
+    #expect(reader.volume(for: "com.test.a") == 0.4)
+
+    let registry = ClientRegistry()
+    registry.addClient(clientID: 1, processID: 10, bundleID: "com.test.a", gain: 1.0)
+    registry.applyVolumeTable(reader, rampFrames: 0, sampleRate: 48000)
+    #expect(registry.activeSlot(for: 1)?.targetGain == 0.4)
+
+    // the helper comes up with its own entry order - the registry looks entries up again
+    let helper = try #require(AFVolumeTable_Create(name))
+    defer {
+      AFVolumeTable_Close(helper)
+      AFVolumeTable_Unlink(name)
+    }
+    AFVolumeTable_Write(helper, AFVolumeTable_Intern(helper, "com.test.a"), 0.6, false)
+    #expect(reader.open())
+    #expect(reader.isLive)
+    registry.applyVolumeTable(reader, rampFrames: 0, sampleRate: 48000)
+    #expect(registry.activeSlot(for: 1)?.targetGain == 0.6)
+  }
+
+  @Test("a missing or foreign snapshot leaves the driver unmapped")
+  func missingSnapshot() throws {
+    let snapshotPath = snapshotFileName()
+    defer { unlink(snapshotPath) }
+
+    let reader = SharedVolumeTable(name: regionName(), snapshotPath: snapshotPath)
+    #expect(!reader.open())
+    #expect(!reader.isMapped)
+
+    try Data("not a volume table".utf8).write(to: URL(fileURLWithPath: snapshotPath))
+    #expect(!reader.open())
+    #expect(!reader.isMapped)
+  }
+
+  @Test("a restarted writer reuses the region so existing mappings keep working")
+  func writerRestart() {
+    let writer = TestWriter()
+    writer.set("com.test.a", 0.5)
+
+    let reader = SharedVolumeTable(name: writer.name)
+    #expect(reader.open())
+
+    let restarted = AFVolumeTable_Create(writer.name)!
+    defer { AFVolumeTable_Close(restarted) }
+    AFVolumeTable_ResetAll(restarted)
+    #expect(reader.volume(for: "com.test.a") == 1.0)
+
+    AFVolumeTable_Write(restarted, AFVolumeTable_Intern(restarted, "com.test.a"), 0.75, false)
+    #expect(reader.volume(for: "com.test.a") == 0.75)
+  }
+
+  @Test("a published volume reaches the client's gain at the next cycle")
+  func registryPicksUpTable() {
+    let writer = TestWriter()
+    let reader = SharedVolumeTable(name: writer.name)
+    #expect(reader.open())
+
+    let registry = ClientRegistry()
+    registry.addClient(clientID: 7, processID: 100, bundleID: "com.test.app", gain: 1.0)
+    writer.set("com.test.app", 0.5)
+
+    registry.applyVolumeTable(reader, rampFrames: 0, sampleRate: 48000)
+    var samples = [Float](repeating: 1.0, count: 16)
+    samples.withUnsafeMutableBufferPointer { ptr in
+      registry.process(clientID: 7, buffer: ptr.baseAddress!, frameCount: 16, channelCount: 1)
+    }
+    #expect(samples.allSatisfy { $0 == 0.5 })
+    #expect(registry.activeSlot(for: 7)?.targetGain == 0.5)
+
+    // apps the helper has never seen keep their gain
+    registry.addClient(clientID: 8, processID: 101, bundleID: "com.test.other", gain: 0.8)
+    registry.applyVolumeTable(reader, rampFrames: 0, sampleRate: 48000)
+    #expect(registry.activeSlot(for: 8)?.targetGain == 0.8)
+  }
+
+  @Test("a batch reaches every client in the same cycle or not at all")
+  func batchIsAtomic() {
+    let writer = TestWriter()
+    let reader = SharedVolumeTable(name: writer.name)
+    #expect(reader.open())
+
+    let registry = ClientRegistry()
+    registry.addClient(clientID: 1, processID: 10, bundleID: "com.test.a", gain: 1.0)
+    registry.addClient(clientID: 2, processID: 20, bundleID: "com.test.b", gain: 1.0)
+    writer.set("com.test.a", 1.0)
+    writer.set("com.test.b", 1.0)
+    registry.applyVolumeTable(reader, rampFrames: 0, sampleRate: 48000)
+
+    // half-written batch - the IO thread must not apply either value
+    AFVolumeTable_BeginBatch(writer.table)
+    writer.set("com.test.a", 0.5)
+    registry.applyVolumeTable(reader, rampFrames: 0, sampleRate: 48000)
+    #expect(registry.activeSlot(for: 1)?.targetGain == 1.0)
+
+    writer.set("com.test.b", 0.25)
+    AFVolumeTable_EndBatch(writer.table)
+    registry.applyVolumeTable(reader, rampFrames: 0, sampleRate: 48000)
+    #expect(registry.activeSlot(for: 1)?.targetGain == 0.5)
+    #expect(registry.activeSlot(for: 2)?.targetGain == 0.25)
+  }
+
+  @Test("a batch ramp moves every client over the same frames")
+  func batchRampIsShared() {
+    let writer = TestWriter()
+    let reader = SharedVolumeTable(name: writer.name)
+    #expect(reader.open())
+
+    let registry = ClientRegistry()
+    registry.addClient(clientID: 1, processID: 10, bundleID: "com.test.a", gain: 1.0)
+    registry.addClient(clientID: 2, processID: 20, bundleID: "com.test.b", gain: 1.0)
+
+    AFVolumeTable_BeginBatch(writer.table)
+    AFVolumeTable_SetRamp(writer.table, 250)
+    writer.set("com.test.a", 0.2)
+    writer.set("com.test.b", 0.8)
+    AFVolumeTable_EndBatch(writer.table)
+    registry.applyVolumeTable(reader, rampFrames: 480, sampleRate: 48000)
+
+    #expect(registry.activeSlot(for: 1)?.automation.nextCommand?.rampFrames == 12000)
+    #expect(registry.activeSlot(for: 2)?.automation.nextCommand?.rampFrames == 12000)
+  }
+
+  @Test("a pushed scene recall leaves the batch ramp to the table")
+  func pushDefersToTableRamp() {
+    let writer = TestWriter()
+    let reader = SharedVolumeTable(name: writer.name)
+    #expect(reader.open())
+
+    let registry = ClientRegistry()
+    registry.addClient(clientID: 1, processID: 10, bundleID: "com.test.a", gain: 1.0)
+    registry.addClient(clientID: 2, processID: 20, bundleID: "com.test.b", gain: 1.0)
+    registry.addClient(clientID: 3, processID: 30, bundleID: "com.test.untabled", gain: 1.0)
+    writer.set("com.test.a", 1.0)
+    writer.set("com.test.b", 1.0)
+    registry.applyVolumeTable(reader, rampFrames: 480, sampleRate: 48000)
+
+    // the helper writes the ramped batch, then pushes the same volumes
+    AFVolumeTable_BeginBatch(writer.table)
+    AFVolumeTable_SetRamp(writer.table, 250)
+    writer.set("com.test.a", 0.2)
+    writer.set("com.test.b", 0.8)
+    AFVolumeTable_EndBatch(writer.table)
+    let pushed: [String: Float] = ["com.test.a": 0.2, "com.test.b": 0.8, "com.test.untabled": 0.5]
+
+    // push before the next cycle: tabled apps wait for the table, the rest follow the push
+    registry.applyVolumes(pushed, sampleRate: 48000, deferringTo: reader)
+    #expect(registry.activeSlot(for: 1)?.targetGain == 1.0)
+    #expect(registry.activeSlot(for: 3)?.targetGain == 0.5)
+    registry.drainCommands(sampleTime: 0)
+    #expect(registry.activeSlot(for: 3)?.automation.nextCommand?.rampFrames == 480)
+    registry.applyVolumeTable(reader, rampFrames: 480, sampleRate: 48000)
+    #expect(registry.activeSlot(for: 1)?.automation.nextCommand?.rampFrames == 12000)
+    #expect(registry.activeSlot(for: 2)?.automation.nextCommand?.rampFrames == 12000)
+
+    // push after the cycle: nothing left to retarget, the table's ramp stays scheduled
+    registry.applyVolumes(pushed, sampleRate: 48000, deferringTo: reader)
+    registry.drainCommands(sampleTime: 0)
+    #expect(registry.activeSlot(for: 1)?.automation.scheduledCount == 1)
+    #expect(registry.activeSlot(for: 1)?.automation.nextCommand?.rampFrames == 12000)
+  }
+
+  @Test(
+    "update-to-visibility latency stays well under one IO cycle",
+    .enabled(if: Benchmark.isEnabled)
+  )
+  func visibilityLatency() {
+    let writer = TestWriter()
+    let reader = SharedVolumeTable(name: writer.name)
+    #expect(reader.open())
+    let index = AFVolumeTable_Intern(writer.table, "com.test.app")
+    let table = reader.table!
+
+    let updates = 1000
+    let stamp = Atomic<UInt64>(0)
+    let acknowledged = Atomic<Int>(-1)
+    let median = Atomic<UInt64>(0)
+
+    // 0: helper publishing slider moves, 1: IO thread polling the table
+    DispatchQueue.concurrentPerform(iterations: 2) { role in
+      if role == 0 {
+        for update in 0 ..< updates {
+          while acknowledged.load(ordering: .acquiring) != update - 1 {}
+          stamp.store(Benchmark.now, ordering: .releasing)
+          AFVolumeTable_Write(writer.table, index, Float(update) / Float(updates), false)
+        }
+      } else {
+        var latencies = [UInt64](repeating: 0, count: updates)
+        var generation = AFVolumeTable_Generation(table)
+        var update = 0
+        while update < updates {
+          let current = AFVolumeTable_Generation(table)
+          guard current != generation,
+                reader.volume(at: index, in: table) == Float(update) / Float(updates)
+          else { continue }
+          latencies[update] = Benchmark.now - stamp.load(ordering: .acquiring)
+          generation = current
+          acknowledged.store(update, ordering: .releasing)
+          update += 1
+        }
+        median.store(latencies.sorted()[updates / 2], ordering: .relaxed)
+      }
+    }
+
+    // one cycle is ~10ms at 512 frames / 48kHz; a mapped read is orders of magnitude faster
+    let nanoseconds = median.load(ordering: .relaxed)
+    Benchmark.report("SharedVolumeTable visibility", "median \(nanoseconds) ns")
+    #expect(nanoseconds < 1_000_000, "median \(nanoseconds) ns")
+  }
+}
@@ -0,0 +1,193 @@
+// AppIDRegistryTests.swift
+// Unit tests for bundle ID interning
+//
+// uses Swift Testing framework (@Test, #expect)
+
+@testable import AppFadersHelper
+import AppFadersVolumeTable
+import Foundation
+import Testing
+
+@Suite("AppIDRegistry")
+struct AppIDRegistryTests {
+  @Test("each bundle ID gets one compact ID that maps back")
+  func internRoundTrip() {
+    let registry = AppIDRegistry()
+    let a = registry.intern("com.test.a")
+    let b = registry.intern("com.test.b")
+
+    #expect(a == 0 && b == 1)
+    #expect(registry.intern("com.test.a") == a)
+    #expect(registry.appID(for: "com.test.b") == b)
+    #expect(registry.bundleID(for: 1) == "com.test.b")
+    #expect(registry.bundleID(for: 2) == nil)
+    #expect(registry.appID(for: "com.test.unknown") == nil)
+    #expect(registry.count == 2)
+  }
+
+  @Test("invalid bundle IDs are refused and not assigned")
+  func rejectsInvalid() {
+    let registry = AppIDRegistry()
+    #expect(registry.intern("") == nil)
+    #expect(registry.intern(String(repeating: "x", count: 256)) == nil)
+    #expect(registry.intern(String(repeating: "x", count: 255)) == 0)
+    // multibyte characters count by their UTF-8 length
+    #expect(registry.intern(String(repeating: "é", count: 128)) == nil)
+    #expect(registry.count == 1)
+  }
+
+  @Test("IDs match volume table entries and survive a helper restart")
+  func stableAcrossRestart() {
+    let name = "/aft.\(getpid()).\(UInt32.random(in: 0 ... UInt32.max))"
+    defer { AFVolumeTable_Unlink(name) }
+
+    let table = SharedVolumeTable(name: name)
+    let registry = AppIDRegistry(volumeTable: table)
+    let a = registry.intern("com.test.a")
+    let b = registry.intern("com.test.b")
+    #expect(table.bundleIDs() == ["com.test.a", "com.test.b"])
+
+    // a new helper process maps the same region and seeds from it
+    let restarted = AppIDRegistry(volumeTable: SharedVolumeTable(name: name))
+    #expect(restarted.appID(for: "com.test.a") == a)
+    #expect(restarted.appID(for: "com.test.b") == b)
+    #expect(restarted.intern("com.test.c") == 2)
+  }
+
+  @Test("a full registry hands out no new IDs and keeps the ones it has")
+  func overflow() {
+    let registry = AppIDRegistry(capacity: 2)
+    #expect(registry.intern("com.test.a") == 0)
+    #expect(registry.intern("com.test.b") == 1)
+    #expect(registry.isFull)
+
+    #expect(registry.intern("com.test.c") == nil)
+    #expect(registry.appID(for: "com.test.c") == nil)
+    #expect(registry.intern("com.test.a") == 0)
+    #expect(registry.count == 2)
+  }
+
+  @Test("app 257 gets no ID without a table entry, and still works by bundle ID")
+  func tableOverflow() {
+    let name = "/aft.\(getpid()).\(UInt32.random(in: 0 ... UInt32.max))"
+    defer { AFVolumeTable_Unlink(name) }
+
+    let table = SharedVolumeTable(name: name)
+    let registry = AppIDRegistry(volumeTable: table, capacity: .max)
+    for app in 0 ..< AppIDRegistry.capacity {
+      #expect(registry.intern("com.test.app\(app)") == AppID(app))
+    }
+    #expect(registry.isFull)
+    #expect(table.bundleIDs().count == AppIDRegistry.capacity)
+
+    let store = VolumeStore(appIDs: registry, volumeTable: table)
+    let service = HelperService(
+      appIDs: registry,
+      store: store,
+      scenes: SceneStore(volumeStore: store)
+    )
+    var refused: NSError?
+    service.registerApp(bundleID: "com.test.overflow") { _, error in refused = error }
+    #expect(refused?.code == 8)
+    service.registerApp(bundleID: "") { _, error in refused = error }
+    #expect(refused?.code == 2)
+    #expect(registry.count == AppIDRegistry.capacity)
+
+    // the client falls back to bundle IDs - the store keeps the volume, drivers hear of it by
+    // bundle ID, and the table stays as it was
+    let synced = store.currentGeneration
+    var failure: NSError?
+    var registered: [UInt32: String] = [0: "?"]
+    service.setVolumes(appVolumes: [0: 0.25], named: ["com.test.overflow": 0.5]) {
+      registered = $0
+      failure = $1
+    }
+    #expect(failure == nil)
+    #expect(registered.isEmpty)
+    #expect(store.getVolume(for: "com.test.overflow") == 0.5)
+    let delta = store.changes(since: synced)
+    #expect(delta.volumes == [0: 0.25])
+    #expect(delta.volumesByBundleID == ["com.test.overflow": 0.5])
+    #expect(table.bundleIDs().count == AppIDRegistry.capacity)
+
+    service.setVolumes(appVolumes: [:], named: ["": 0.5]) { failure = $1 }
+    #expect(failure?.code == 2)
+  }
+
+  @Test("the registry never hands out an ID the table doesn't hold")
+  func tableStaysInStep() {
+    let name = "/aft.\(getpid()).\(UInt32.random(in: 0 ... UInt32.max))"
+    defer { AFVolumeTable_Unlink(name) }
+
+    let table = SharedVolumeTable(name: name)
+    let registry = AppIDRegistry(volumeTable: table)
+    #expect(registry.intern("com.test.a") == 0)
+    // only the next index can be added
+    #expect(!table.add("com.test.b", as: 5))
+    #expect(registry.intern("com.test.b") == 1)
+    #expect(table.bundleIDs() == ["com.test.a", "com.test.b"])
+  }
+
+  @Test("the store publishes by app ID without re-interning strings")
+  func storePublishesByID() {
+    let name = "/aft.\(getpid()).\(UInt32.random(in: 0 ... UInt32.max))"
+    defer { AFVolumeTable_Unlink(name) }
+
+    let table = SharedVolumeTable(name: name)
+    let registry = AppIDRegistry(volumeTable: table)
+    let store = VolumeStore(appIDs: registry, volumeTable: table)
+    store.setVolume(for: "com.test.a", volume: 0.5)
+
+    let reader = AFVolumeTable_Open(name)!
+    defer { AFVolumeTable_Close(reader) }
+    var value = AFVolumeValue()
+    let appID = registry.appID(for: "com.test.a")!
+    #expect(AFVolumeTable_Read(reader, Int32(appID), &value))
+    #expect(value.gain == 0.5)
+  }
+
+  @Test("batch requests resolve app IDs through the registry, unknown IDs reject the batch")
+  func batchesByID() {
+    let registry = AppIDRegistry()
+    let store = VolumeStore(appIDs: registry)
+    let service = HelperService(
+      appIDs: registry,
+      store: store,
+      scenes: SceneStore(volumeStore: store)
+    )
+    let a = registry.intern("com.test.a")!
+    let b = registry.intern("com.test.b")!
+
+    var failure: NSError?
+    service.setVolumes(appVolumes: [a: 0.25, b: 0.75]) { failure = $1 }
+    #expect(failure == nil)
+    #expect(store.getAllVolumes() == ["com.test.a": 0.25, "com.test.b": 0.75])
+
+    service.setVolumes(appVolumes: [a: 0.5, 99: 0.5]) { failure = $1 }
+    #expect(failure?.code == 5)
+    #expect(store.getVolume(for: "com.test.a") == 0.25)
+
+    // apps the client hasn't numbered yet get their IDs in the same call
+    var registered: [UInt32: String] = [:]
+    service.setVolumes(appVolumes: [a: 0.5], named: ["com.test.c": 0.1]) {
+      registered = $0
+      failure = $1
+    }
+    #expect(failure == nil)
+    #expect(registered == [2: "com.test.c"])
+    #expect(store.changes(since: 0).volumes == [a: 0.5, b: 0.75, 2: 0.1])
+
+    // a rejected batch numbers nothing
+    service.setVolumes(appVolumes: [:], named: ["com.test.d": 0.1, "com.test.e": 2]) {
+      failure = $1
+    }
+    #expect(failure?.code == 3)
+    #expect(registry.appID(for: "com.test.d") == nil)
+
+    var volumes: [UInt32: Float] = [:]
+    service.getVolumes(appIDs: [b, a]) { result, _ in volumes = result }
+    #expect(volumes == [a: 0.5, b: 0.75])
+    service.getVolumes(appIDs: [99]) { _, error in failure = error }
+    #expect(failure?.code == 5)
+  }
+}
@@ -0,0 +1,144 @@
+// SceneStoreTests.swift
+// Unit tests for scene save and atomic recall
+//
+// uses Swift Testing framework (@Test, #expect)
+
+@testable import AppFadersHelper
+import AppFadersTestSupport
+import AppFadersVolumeTable
+import Foundation
+import Testing
+
+/// store updates seen by a change handler
+private final class UpdateLog: @unchecked Sendable {
+  private let lock = NSLock()
+  private var updates: [[VolumeChange]] = []
+
+  func record(_ changes: [VolumeChange]) {
+    lock.lock()
+    updates.append(changes)
+    lock.unlock()
+  }
+
+  var count: Int {
+    lock.lock()
+    defer { lock.unlock() }
+    return updates.count
+  }
+}
+
+private func tableName() -> String {
+  "/aft.\(getpid()).\(UInt32.random(in: 0 ... UInt32.max))"
+}
+
+@Suite("SceneStore")
+struct SceneStoreTests {
+  @Test("a saved scene is compiled to sorted, clamped entries with app IDs")
+  func saveCompiles() {
+    let registry = AppIDRegistry()
+    let scenes = SceneStore(volumeStore: VolumeStore(appIDs: registry))
+    scenes.saveScene(named: "meeting", volumes: ["com.test.b": 1.5, "com.test.a": 0.25])
+
+    let scene = scenes.scene(named: "meeting")
+    #expect(scene?.entries.map(\.bundleID) == ["com.test.a", "com.test.b"])
+    #expect(scene?.entries.map(\.volume) == [0.25, 1.0])
+    #expect(scene?.entries.map(\.appID) == [
+      registry.appID(for: "com.test.a"),
+      registry.appID(for: "com.test.b"),
+    ])
+    #expect(scenes.sceneNames == ["meeting"])
+  }
+
+  @Test("recall is one store update and returns the scene's volumes")
+  func recallIsOneUpdate() {
+    let updates = UpdateLog()
+    let store = VolumeStore { changes in updates.record(changes) }
+    let scenes = SceneStore(volumeStore: store)
+    scenes.saveScene(named: "focus", volumes: ["com.test.a": 0.0, "com.test.b": 0.5])
+    store.setVolume(for: "com.test.c", volume: 0.7)
+    let before = updates.count
+
+    #expect(scenes.recallScene(named: "focus") == ["com.test.a": 0.0, "com.test.b": 0.5])
+    #expect(updates.count == before + 1)
+    // apps outside the scene keep their volume
+    #expect(store.getAllVolumes() == ["com.test.a": 0.0, "com.test.b": 0.5, "com.test.c": 0.7])
+
+    // nothing changes on a second recall - no notification
+    scenes.recallScene(named: "focus")
+    #expect(updates.count == before + 1)
+
+    #expect(scenes.recallScene(named: "missing") == nil)
+    #expect(scenes.removeScene(named: "focus"))
+    #expect(!scenes.removeScene(named: "focus"))
+  }
+
+  @Test("recall publishes one table batch carrying the ramp")
+  func recallPublishesBatch() throws {
+    let name = tableName()
+    defer { AFVolumeTable_Unlink(name) }
+
+    let table = SharedVolumeTable(name: name)
+    let registry = AppIDRegistry(volumeTable: table)
+    let scenes = SceneStore(volumeStore: VolumeStore(appIDs: registry, volumeTable: table))
+    scenes.saveScene(named: "media", volumes: ["com.test.a": 0.3, "com.test.b": 0.9])
+
+    let reader = try #require(AFVolumeTable_Open(name))
+    defer { AFVolumeTable_Close(reader) }
+    let batch = AFVolumeTable_BatchSequence(reader)
+
+    scenes.recallScene(named: "media", rampMilliseconds: 500)
+    #expect(AFVolumeTable_BatchSequence(reader) == batch + 2)
+    #expect(AFVolumeTable_Ramp(reader) == 500)
+
+    var value = AFVolumeValue()
+    #expect(AFVolumeTable_Read(reader, Int32(registry.appID(for: "com.test.a")!), &value))
+    #expect(value.gain == 0.3)
+    #expect(AFVolumeTable_Read(reader, Int32(registry.appID(for: "com.test.b")!), &value))
+    #expect(value.gain == 0.9)
+
+    // ramps are capped
+    scenes.saveScene(named: "quiet", volumes: ["com.test.a": 0.1])
+    scenes.recallScene(named: "quiet", rampMilliseconds: .max)
+    #expect(AFVolumeTable_Ramp(reader) == SceneStore.maxRampMilliseconds)
+  }
+
+  @Test(
+    "recalling a 200-app scene fits well inside one IO cycle",
+    .enabled(if: Benchmark.isEnabled)
+  )
+  func recallLatency() {
+    let name = tableName()
+    defer { AFVolumeTable_Unlink(name) }
+
+    let table = SharedVolumeTable(name: name)
+    let updates = UpdateLog()
+    let registry = AppIDRegistry(volumeTable: table)
+    let store = VolumeStore(appIDs: registry, volumeTable: table) { updates.record($0) }
+    let scenes = SceneStore(volumeStore: store)
+
+    var loud: [String: Float] = [:]
+    var quiet: [String: Float] = [:]
+    for app in 0 ..< 200 {
+      loud["com.test.app\(app)"] = 1.0 - Float(app) / 1000
+      quiet["com.test.app\(app)"] = Float(app) / 1000
+    }
+    scenes.saveScene(named: "loud", volumes: loud)
+    scenes.saveScene(named: "quiet", volumes: quiet)
+
+    let recalls = 100
+    var latencies: [UInt64] = []
+    for recall in 0 ..< recalls {
+      latencies.append(Benchmark.measure {
+        scenes.recallScene(named: recall % 2 == 0 ? "loud" : "quiet", rampMilliseconds: 50)
+      })
+    }
+    latencies.sort()
+
+    let median = latencies[recalls / 2]
+    Benchmark.report("scene recall", "median \(median) ns for 200 apps")
+    #expect(updates.count == recalls)
+    #expect(store.getAllVolumes() == quiet)
+    // one cycle at 48 kHz / 512 frames is ~10.7 ms - a recall must fit easily
+    #expect(median < 2_000_000, "median recall \(median) ns for 200 apps")
+  }
+}
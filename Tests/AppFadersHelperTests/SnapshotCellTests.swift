@@ -0,0 +1,259 @@
+// SnapshotCellTests.swift
+// Unit tests for SnapshotCell and lock-free VolumeStore reads
+//
+// uses Swift Testing framework (@Test, #expect)
+
+@testable import AppFadersHelper
+import AppFadersTestSupport
+import Dispatch
+import Foundation
+import Synchronization
+import Testing
+
+private final class Version: Sendable {
+  let number: Int
+
+  init(_ number: Int) {
+    self.number = number
+  }
+}
+
+private final class Tally: Sendable {
+  let count = Atomic<Int>(0)
+}
+
+@Suite("SnapshotCell")
+struct SnapshotCellTests {
+  @Test("load returns the latest published version")
+  func loadsLatest() {
+    let cell = SnapshotCell(Version(0))
+    #expect(cell.load().number == 0)
+
+    cell.publish(Version(1))
+    cell.publish(Version(2))
+    #expect(cell.load().number == 2)
+  }
+
+  @Test("a replaced version is released once nobody holds it")
+  func releasesReplaced() {
+    let cell = SnapshotCell(Version(0))
+    weak var first: Version?
+    do {
+      let version = Version(1)
+      first = version
+      cell.publish(version)
+    }
+    #expect(first != nil)
+
+    var held: Version? = cell.load()
+    cell.publish(Version(2))
+    // a reader's reference outlives the publish
+    #expect(first != nil && held?.number == 1)
+
+    held = nil
+    #expect(first == nil)
+  }
+
+  @Test("concurrent readers never see a version go backwards")
+  func concurrentReaders() {
+    let cell = SnapshotCell(Version(0))
+    let writes = 2000
+    let backwards = Tally()
+
+    DispatchQueue.concurrentPerform(iterations: 9) { worker in
+      if worker == 0 {
+        for number in 1 ... writes {
+          cell.publish(Version(number))
+        }
+        return
+      }
+      var last = 0
+      for _ in 0 ..< 20000 {
+        let number = cell.load().number
+        if number < last {
+          backwards.count.wrappingAdd(1, ordering: .relaxed)
+        }
+        last = number
+      }
+    }
+
+    #expect(backwards.count.load(ordering: .relaxed) == 0)
+    #expect(cell.load().number == writes)
+  }
+}
+
+// MARK: - Volume Snapshot Tests
+
+@Suite("VolumeSnapshot")
+struct VolumeSnapshotTests {
+  private static func change(_ bundleID: String, _ volume: Float?) -> VolumeChange {
+    VolumeChange(generation: 0, bundleID: bundleID, appID: nil, volume: volume)
+  }
+
+  @Test("applying changes matches a dictionary and shares the chunks it didn't touch")
+  func appliesAndShares() {
+    let initial = Dictionary(uniqueKeysWithValues: (0 ..< 1000).map {
+      ("com.test.app\($0)", Float($0 % 100) / 100)
+    })
+    let first = VolumeSnapshot(generation: 1, volumes: initial)
+    #expect(first.count == 1000)
+    #expect(first.volumes == initial)
+
+    let next = first.applying([
+      Self.change("com.test.app1", 0.5),
+      Self.change("com.test.app1", 0.75),
+      Self.change("com.test.app2", nil),
+      Self.change("com.test.new", 0.25)
+    ], generation: 2)
+    var expected = initial
+    expected["com.test.app1"] = 0.75
+    expected["com.test.app2"] = nil
+    expected["com.test.new"] = 0.25
+    #expect(next.generation == 2)
+    #expect(next.count == expected.count)
+    #expect(next.volumes == expected)
+    #expect(next.volume(for: "com.test.app1") == 0.75)
+    #expect(next.volume(for: "com.test.app2") == nil)
+
+    // the old version is untouched, and at most three chunks were copied
+    #expect(first.volumes == initial)
+    let copied = zip(first.chunks, next.chunks).filter { $0 !== $1 }.count
+    #expect(copied >= 1 && copied <= 3)
+  }
+}
+
+// MARK: - Contention Benchmark
+
+/// the store's previous read path - every getter takes the writers' lock and copies
+private final class LockedVolumes: @unchecked Sendable {
+  private let lock = NSLock()
+  private var volumes: [String: Float]
+
+  init(_ volumes: [String: Float]) {
+    self.volumes = volumes
+  }
+
+  func setVolume(for bundleID: String, volume: Float) {
+    lock.lock()
+    volumes[bundleID] = volume
+    lock.unlock()
+  }
+
+  func getVolume(for bundleID: String) -> Float {
+    lock.lock()
+    defer { lock.unlock() }
+    return volumes[bundleID] ?? 1.0
+  }
+
+  func getAllVolumes() -> [String: Float] {
+    lock.lock()
+    defer { lock.unlock() }
+    // the storage handed out a fresh dictionary per call
+    return Dictionary(uniqueKeysWithValues: volumes.map { ($0.key, $0.value) })
+  }
+}
+
+@Suite("VolumeStore read contention", .enabled(if: Benchmark.isEnabled))
+struct VolumeStoreContentionTests {
+  private static let apps = 200
+  private static let readers = 8
+  private static let readsPerReader = 2000
+  private static let writes = 200
+
+  /// readers on every worker but the first, which writes - returns elapsed nanoseconds
+  private static func contend(
+    write: @Sendable (Int) -> Void,
+    read: @Sendable (Int) -> Int
+  ) -> UInt64 {
+    Benchmark.measure {
+      DispatchQueue.concurrentPerform(iterations: readers + 1) { worker in
+        if worker == 0 {
+          for step in 0 ..< writes {
+            write(step)
+          }
+          return
+        }
+        var seen = 0
+        for step in 0 ..< readsPerReader {
+          seen &+= read(step)
+        }
+        precondition(seen != 0)
+      }
+    }
+  }
+
+  @Test("snapshot reads beat locked reads with many concurrent readers")
+  func snapshotVersusLock() {
+    let initial = Dictionary(uniqueKeysWithValues: (0 ..< Self.apps).map {
+      ("com.test.app\($0)", Float($0 % 100) / 100)
+    })
+
+    let locked = LockedVolumes(initial)
+    let lockedTime = Self.contend(
+      write: { locked.setVolume(for: "com.test.app\($0 % Self.apps)", volume: 0.5) },
+      read: { step in
+        step % 10 == 0
+          ? locked.getAllVolumes().count
+          : Int(locked.getVolume(for: "com.test.app\(step % Self.apps)") * 100) + 1
+      }
+    )
+
+    let store = VolumeStore()
+    store.setVolumes(initial)
+    let snapshotTime = Self.contend(
+      write: { store.setVolume(for: "com.test.app\($0 % Self.apps)", volume: 0.5) },
+      read: { step in
+        step % 10 == 0
+          ? store.getAllVolumes().count
+          : Int(store.getVolume(for: "com.test.app\(step % Self.apps)") * 100) + 1
+      }
+    )
+
+    #expect(store.getAllVolumes() == locked.getAllVolumes())
+    // generous bound - the point is that readers don't serialize behind each other
+    let report = "snapshot \(snapshotTime) ns vs locked \(lockedTime) ns"
+    Benchmark.report("VolumeStore read contention", report)
+    #expect(snapshotTime <= lockedTime * 2, "\(report)")
+  }
+}
+
+// MARK: - Write Benchmark
+
+@Suite("VolumeStore write benchmark", .enabled(if: Benchmark.isEnabled))
+struct VolumeStoreWriteBenchmarkTests {
+  @Test("a write to a 10k-entry store copies a chunk, not the store")
+  func tenThousandEntries() {
+    let entries = 10000
+    let writes = 2000
+    let initial = Dictionary(uniqueKeysWithValues: (0 ..< entries).map {
+      ("com.test.app\($0)", Float($0 % 100) / 100)
+    })
+    let storage = InMemoryVolumes()
+    for (bundleID, volume) in initial {
+      storage.setVolume(volume, for: bundleID)
+    }
+    let store = VolumeStore(storage: storage)
+
+    let storeTime = Benchmark.measure {
+      for step in 0 ..< writes {
+        store.setVolume(for: "com.test.app\(step * 7 % entries)", volume: Float(step % 50) / 100)
+      }
+    }
+
+    // what every write cost before: a copy of the whole dictionary
+    var volumes = initial
+    let copyTime = Benchmark.measure {
+      for step in 0 ..< writes {
+        var next = volumes
+        next["com.test.app\(step * 7 % entries)"] = Float(step % 50) / 100
+        volumes = next
+      }
+    }
+
+    #expect(store.getAllVolumes() == volumes)
+    let report = "\(storeTime / UInt64(writes)) ns per store write, "
+      + "\(copyTime / UInt64(writes)) ns per full copy"
+    Benchmark.report("VolumeStore 10k write", report)
+    #expect(storeTime < copyTime, "\(report)")
+  }
+}
@@ -0,0 +1,287 @@
+// VolumeFileTests.swift
+// Unit tests for the mapped on-disk volume store
+//
+// uses Swift Testing framework (@Test, #expect)
+
+@testable import AppFadersHelper
+import AppFadersTestSupport
+import AppFadersVolumeFile
+import AppFadersVolumeTable
+import Foundation
+import Testing
+
+/// unique file per test, removed again when the test ends
+private final class TemporaryPath {
+  let path = NSTemporaryDirectory() + "aft.\(getpid()).\(UInt32.random(in: 0 ... UInt32.max)).db"
+
+  deinit {
+    unlink(path)
+    unlink(path + ".compact")
+  }
+}
+
+@Suite("VolumeFile")
+struct VolumeFileTests {
+  @Test("volumes survive closing and reopening the file")
+  func persistsAcrossReopen() throws {
+    let temporary = TemporaryPath()
+    do {
+      let file = try #require(VolumeFile(path: temporary.path))
+      file.setVolume(0.25, for: "com.test.a")
+      file.setVolume(0.75, for: "com.test.b")
+      file.setVolume(0.5, for: "com.test.a")
+      #expect(file.removeVolume(for: "com.test.b"))
+      #expect(!file.removeVolume(for: "com.test.b"))
+    }
+
+    let reopened = try #require(VolumeFile(path: temporary.path))
+    #expect(reopened.volume(for: "com.test.a") == 0.5)
+    #expect(reopened.volume(for: "com.test.b") == nil)
+    #expect(reopened.allVolumes == ["com.test.a": 0.5])
+    #expect(reopened.count == 1)
+  }
+
+  @Test("a write the last run left half done is finished from the journal")
+  func replaysJournal() throws {
+    let temporary = TemporaryPath()
+    do {
+      let file = try #require(VolumeFile(path: temporary.path))
+      file.setVolume(0.3, for: "com.test.a")
+      #expect(file.journalLength == 1)
+    }
+
+    // drop the record's state byte - as if the process died between journal and table
+    let handle = try #require(FileHandle(forUpdatingAtPath: temporary.path))
+    let data = try #require(try handle.readToEnd())
+    let marker = Data("com.test.a".utf8)
+    let nameOffset = try #require(data.range(of: marker)?.lowerBound)
+    // the first match is the table record: key (8), state (4), volume (4), name
+    try handle.seek(toOffset: UInt64(nameOffset - 8))
+    try handle.write(contentsOf: Data(count: 4))
+    try handle.close()
+
+    let reopened = try #require(VolumeFile(path: temporary.path))
+    #expect(reopened.volume(for: "com.test.a") == 0.3)
+  }
+
+  @Test("a torn journal entry ends the replay instead of corrupting the table")
+  func tornJournalEntry() throws {
+    let temporary = TemporaryPath()
+    do {
+      let file = try #require(VolumeFile(path: temporary.path))
+      file.checkpoint()
+      file.setVolume(0.3, for: "com.test.a")
+    }
+
+    // damage the journal entry's volume - its checksum no longer matches
+    let handle = try #require(FileHandle(forUpdatingAtPath: temporary.path))
+    let data = try #require(try handle.readToEnd())
+    let marker = Data("com.test.a".utf8)
+    let journalName = try #require(data.range(of: marker, options: .backwards)?.lowerBound)
+    try handle.seek(toOffset: UInt64(journalName - 16))
+    try handle.write(contentsOf: Data([0xff, 0xff, 0xff, 0x7f]))
+    try handle.close()
+
+    let reopened = try #require(VolumeFile(path: temporary.path))
+    #expect(reopened.journalLength == 0)
+    // the record itself was written before the process went away
+    #expect(reopened.volume(for: "com.test.a") == 0.3)
+  }
+
+  @Test("a foreign file is replaced by an empty store")
+  func foreignFile() throws {
+    let temporary = TemporaryPath()
+    try Data("not a volume store".utf8).write(to: URL(fileURLWithPath: temporary.path))
+
+    let file = try #require(VolumeFile(path: temporary.path))
+    #expect(file.allVolumes.isEmpty)
+    file.setVolume(0.5, for: "com.test.a")
+    #expect(file.volume(for: "com.test.a") == 0.5)
+  }
+
+  @Test("the table grows with its entries and compaction drops removed ones")
+  func growAndCompact() throws {
+    let temporary = TemporaryPath()
+    let file = try #require(VolumeFile(path: temporary.path, capacity: 64))
+    for app in 0 ..< 1000 {
+      file.setVolume(Float(app) / 1000, for: "com.test.app\(app)")
+    }
+    #expect(file.count == 1000)
+    #expect(file.capacity >= 1024)
+
+    for app in 0 ..< 990 {
+      file.removeVolume(for: "com.test.app\(app)")
+    }
+    #expect(file.compact())
+    #expect(file.count == 10)
+    #expect(file.capacity == Int(AF_VOLUME_FILE_MIN_CAPACITY))
+    #expect(file.volume(for: "com.test.app995") == 0.995)
+    #expect(file.volume(for: "com.test.app5") == nil)
+  }
+
+  @Test("10k entries: write throughput and cold start")
+  func tenThousandEntries() throws {
+    let temporary = TemporaryPath()
+    let entries = 10000
+
+    let writeStart = Benchmark.now
+    do {
+      let file = try #require(VolumeFile(path: temporary.path))
+      for app in 0 ..< entries {
+        #expect(file.setVolume(Float(app % 100) / 100, for: "com.test.app\(app)"))
+      }
+    }
+    let writeTime = Benchmark.now - writeStart
+
+    // cold start: map and replay - no per-entry load, then a first read from the mapping
+    let openStart = Benchmark.now
+    let reopened = try #require(VolumeFile(path: temporary.path))
+    let volume = reopened.volume(for: "com.test.app4242")
+    let openTime = Benchmark.now - openStart
+
+    #expect(volume == 0.42)
+    #expect(reopened.count == entries)
+    let report = "\(writeTime / UInt64(entries)) ns per write, "
+      + "cold start \(openTime) ns for \(entries) entries"
+    Benchmark.report("VolumeFile 10k entries", report)
+    if Benchmark.isEnabled {
+      #expect(writeTime / UInt64(entries) < 200_000, "\(report)")
+      #expect(openTime < 20_000_000, "\(report)")
+    }
+  }
+
+  @Test("10k entries: store startup copies the file once")
+  func storeStartup() throws {
+    let temporary = TemporaryPath()
+    let entries = 10000
+    do {
+      let file = try #require(VolumeFile(path: temporary.path))
+      for app in 0 ..< entries {
+        file.setVolume(Float(app % 100) / 100, for: "com.test.app\(app)")
+      }
+    }
+
+    let openStart = Benchmark.now
+    let file = try #require(VolumeFile(path: temporary.path))
+    let openTime = Benchmark.now - openStart
+
+    // the copy into the first snapshot - no volume table, so nothing is interned
+    let initStart = Benchmark.now
+    let store = VolumeStore(storage: file)
+    let initTime = Benchmark.now - initStart
+
+    #expect(store.getVolume(for: "com.test.app4242") == 0.42)
+    #expect(store.getAllVolumes().count == entries)
+    let perEntry = initTime / UInt64(entries)
+    let report = "store init \(initTime) ns (\(perEntry) ns per entry), file open \(openTime) ns"
+    Benchmark.report("VolumeStore 10k startup", report)
+    if Benchmark.isEnabled {
+      #expect(initTime < 100_000_000, "\(report)")
+    }
+  }
+
+  @Test("a store on a volume file comes back after a restart and republishes to the table")
+  func storeSurvivesRestart() throws {
+    let temporary = TemporaryPath()
+    let tableName = "/aft.\(getpid()).\(UInt32.random(in: 0 ... UInt32.max))"
+    defer { AFVolumeTable_Unlink(tableName) }
+
+    do {
+      let table = SharedVolumeTable(name: tableName)
+      let store = VolumeStore(
+        appIDs: AppIDRegistry(volumeTable: table),
+        volumeTable: table,
+        storage: try #require(VolumeFile(path: temporary.path))
+      )
+      store.setVolumes(["com.test.a": 0.2, "com.test.b": 0.6])
+      store.removeVolume(for: "com.test.b")
+    }
+
+    // a new helper process: the table keeps the old values until the store restores its own
+    let table = SharedVolumeTable(name: tableName)
+    let registry = AppIDRegistry(volumeTable: table)
+    let reader = try #require(AFVolumeTable_Open(tableName))
+    defer { AFVolumeTable_Close(reader) }
+    // an entry the store doesn't know goes back to unity with the rest
+    let stray = try #require(registry.intern("com.test.stray"))
+    table.publish(appID: stray, volume: 0.3)
+    let batch = AFVolumeTable_BatchSequence(reader)
+
+    let store = VolumeStore(
+      appIDs: registry,
+      volumeTable: table,
+      storage: try #require(VolumeFile(path: temporary.path))
+    )
+    #expect(store.getAllVolumes() == ["com.test.a": 0.2])
+
+    // one batch: the driver never sees com.test.a at unity between reset and restore
+    #expect(AFVolumeTable_BatchSequence(reader) == batch &+ 2)
+    var value = AFVolumeValue()
+    #expect(AFVolumeTable_Read(reader, Int32(registry.appID(for: "com.test.a")!), &value))
+    #expect(value.gain == 0.2)
+    #expect(AFVolumeTable_Read(reader, Int32(stray), &value))
+    #expect(value.gain == 1.0)
+  }
+
+  @Test("stored apps are numbered when a client names them, not at startup")
+  func lazyNumbering() throws {
+    let temporary = TemporaryPath()
+    let tableName = "/aft.\(getpid()).\(UInt32.random(in: 0 ... UInt32.max))"
+    defer { AFVolumeTable_Unlink(tableName) }
+
+    // more stored apps than app IDs, kept by a helper whose table is gone (a reboot)
+    let volumes = Dictionary(uniqueKeysWithValues: (0 ..< 300).map {
+      ("com.test.app\($0)", Float($0 % 100) / 100)
+    })
+    do {
+      let store = VolumeStore(storage: try #require(VolumeFile(path: temporary.path)))
+      store.setVolumes(volumes)
+    }
+
+    let table = SharedVolumeTable(name: tableName)
+    let registry = AppIDRegistry(volumeTable: table)
+    let store = VolumeStore(
+      appIDs: registry,
+      volumeTable: table,
+      storage: try #require(VolumeFile(path: temporary.path))
+    )
+    #expect(registry.count == 0)
+    #expect(table.bundleIDs().isEmpty)
+    // drivers still get every volume, by bundle ID until the app is numbered
+    #expect(store.changes(since: 0).volumesByBundleID == volumes)
+
+    // the entry carries the stored volume before the ID is handed out
+    let appID = try #require(store.register("com.test.app42"))
+    #expect(appID == 0)
+    let reader = try #require(AFVolumeTable_Open(tableName))
+    defer { AFVolumeTable_Close(reader) }
+    var value = AFVolumeValue()
+    #expect(AFVolumeTable_Read(reader, Int32(appID), &value))
+    #expect(value.gain == 0.42)
+    #expect(store.changes(since: 0).volumes == [appID: 0.42])
+  }
+
+  @Test("the table snapshot the driver loads before the helper runs carries the volumes")
+  func tableSnapshot() throws {
+    let temporary = TemporaryPath()
+    let snapshotPath = temporary.path + ".snapshot"
+    let tableName = "/aft.\(getpid()).\(UInt32.random(in: 0 ... UInt32.max))"
+    defer {
+      AFVolumeTable_Unlink(tableName)
+      unlink(snapshotPath)
+    }
+
+    let table = SharedVolumeTable(name: tableName, snapshotPath: snapshotPath)
+    let registry = AppIDRegistry(volumeTable: table)
+    let store = VolumeStore(appIDs: registry, volumeTable: table)
+    store.setVolume(for: "com.test.a", volume: 0.35)
+    #expect(table.writeSnapshot())
+
+    let snapshot = try #require(AFVolumeTable_OpenSnapshot(snapshotPath))
+    defer { AFVolumeTable_Close(snapshot) }
+    var value = AFVolumeValue()
+    let entry = AFVolumeTable_Find(snapshot, AFVolumeTable_Key("com.test.a"))
+    #expect(AFVolumeTable_Read(snapshot, entry, &value))
+    #expect(value.gain == 0.35)
+  }
+}
@@ -0,0 +1,238 @@
+// VolumeStoreTests.swift
+// Unit tests for VolumeStore generations, delta sync and batch updates
+//
+// uses Swift Testing framework (@Test, #expect)
+
+@testable import AppFadersHelper
+import AppFadersTestSupport
+import Foundation
+import Testing
+
+/// a delta's volumes by bundle ID - for batches, whose apps are interned in no fixed order
+private func named(_ delta: VolumeDelta) -> [String: Float] {
+  Dictionary(uniqueKeysWithValues: delta.volumes.map { appID, volume in
+    (delta.names[appID] ?? "?", volume)
+  })
+}
+
+@Suite("VolumeStore")
+struct VolumeStoreTests {
+  @Test("every real change bumps the generation, no-ops don't")
+  func generationCounts() {
+    let store = VolumeStore()
+    #expect(store.currentGeneration == 0)
+
+    store.setVolume(for: "com.test.a", volume: 0.5)
+    store.setVolume(for: "com.test.a", volume: 0.5)
+    #expect(store.currentGeneration == 1)
+
+    store.removeVolume(for: "com.test.a")
+    store.removeVolume(for: "com.test.a")
+    #expect(store.currentGeneration == 2)
+  }
+
+  @Test("a first sync gets the whole store as a snapshot")
+  func firstSyncIsSnapshot() {
+    let store = VolumeStore()
+    store.setVolume(for: "com.test.a", volume: 0.5)
+    store.setVolume(for: "com.test.b", volume: 0.25)
+
+    let delta = store.changes(since: 0)
+    #expect(delta.isSnapshot)
+    #expect(delta.generation == 2)
+    #expect(delta.volumes == [0: 0.5, 1: 0.25])
+    #expect(delta.names == [0: "com.test.a", 1: "com.test.b"])
+  }
+
+  @Test("deltas merge repeated changes and report removals")
+  func mergedDelta() {
+    let store = VolumeStore()
+    store.setVolume(for: "com.test.a", volume: 0.5)
+    store.setVolume(for: "com.test.b", volume: 0.5)
+    let synced = store.currentGeneration
+
+    store.setVolume(for: "com.test.a", volume: 0.1)
+    store.setVolume(for: "com.test.a", volume: 0.2)
+    store.removeVolume(for: "com.test.b")
+    store.setVolume(for: "com.test.c", volume: 0.3)
+
+    let delta = store.changes(since: synced)
+    #expect(!delta.isSnapshot)
+    #expect(delta.generation == synced + 4)
+    #expect(delta.volumes == [0: 0.2, 2: 0.3])
+    #expect(delta.removed == [1])
+    #expect(delta.names == [0: "com.test.a", 1: "com.test.b", 2: "com.test.c"])
+
+    // up to date - nothing to send
+    let empty = store.changes(since: delta.generation)
+    #expect(!empty.isSnapshot && empty.volumes.isEmpty && empty.removed.isEmpty)
+  }
+
+  @Test("a removed then re-added app is a change, not a removal")
+  func removeThenReadd() {
+    let store = VolumeStore()
+    store.setVolume(for: "com.test.a", volume: 0.5)
+    let synced = store.currentGeneration
+
+    store.removeVolume(for: "com.test.a")
+    store.setVolume(for: "com.test.a", volume: 0.7)
+
+    let delta = store.changes(since: synced)
+    #expect(delta.volumes == [0: 0.7])
+    #expect(delta.removed.isEmpty)
+  }
+
+  @Test("a client behind a wrapped log or from another helper run gets a snapshot")
+  func snapshotFallback() {
+    let store = VolumeStore(changeLogCapacity: 4)
+    store.setVolume(for: "com.test.a", volume: 0.1)
+    let synced = store.currentGeneration
+
+    for step in 1 ... 4 {
+      store.setVolume(for: "com.test.b", volume: Float(step) / 10)
+    }
+    #expect(store.changes(since: synced).isSnapshot)
+    #expect(!store.changes(since: synced + 1).isSnapshot)
+
+    // generation newer than anything this store handed out
+    #expect(store.changes(since: store.currentGeneration + 1).isSnapshot)
+  }
+
+  @Test("delta size follows the number of changes, not the store size")
+  func scalesWithChanges() {
+    // far more apps than app IDs - the ones past the registry's capacity go by bundle ID
+    let store = VolumeStore()
+    for index in 0 ..< 5000 {
+      store.setVolume(for: "com.test.app\(index)", volume: 0.5)
+    }
+    let synced = store.currentGeneration
+
+    store.setVolume(for: "com.test.app42", volume: 0.1)
+    store.setVolume(for: "com.test.app4242", volume: 0.2)
+
+    let delta = store.changes(since: synced)
+    #expect(!delta.isSnapshot)
+    #expect(delta.volumes == [42: 0.1])
+    #expect(delta.names == [42: "com.test.app42"])
+    #expect(delta.volumesByBundleID == ["com.test.app4242": 0.2])
+
+    let snapshot = store.changes(since: 0)
+    #expect(snapshot.volumes.count == AppIDRegistry.capacity)
+    #expect(snapshot.volumes.count + snapshot.volumesByBundleID.count == 5000)
+  }
+
+  @Test("an app the full registry couldn't number travels by bundle ID")
+  func unnumberedApp() {
+    let store = VolumeStore(appIDs: AppIDRegistry(capacity: 1))
+    store.setVolume(for: "com.test.a", volume: 0.5)
+    let synced = store.currentGeneration
+    store.setVolume(for: "com.test.b", volume: 0.25)
+
+    #expect(store.getVolume(for: "com.test.b") == 0.25)
+    let snapshot = store.changes(since: 0)
+    #expect(snapshot.volumes == [0: 0.5])
+    #expect(snapshot.volumesByBundleID == ["com.test.b": 0.25])
+
+    let delta = store.changes(since: synced)
+    #expect(delta.generation == synced + 1)
+    #expect(delta.volumes.isEmpty && delta.names.isEmpty)
+    #expect(delta.volumesByBundleID == ["com.test.b": 0.25])
+
+    store.removeVolume(for: "com.test.b")
+    let removal = store.changes(since: synced)
+    #expect(removal.volumesByBundleID.isEmpty)
+    #expect(removal.removedBundleIDs == ["com.test.b"])
+  }
+}
+
+// MARK: - Batch Tests
+
+/// counts store notifications
+private final class NotificationCounter: @unchecked Sendable {
+  private let lock = NSLock()
+  private var updates: [[VolumeChange]] = []
+
+  func record(_ changes: [VolumeChange]) {
+    lock.lock()
+    updates.append(changes)
+    lock.unlock()
+  }
+
+  var count: Int {
+    lock.lock()
+    defer { lock.unlock() }
+    return updates.count
+  }
+
+  var last: [VolumeChange]? {
+    lock.lock()
+    defer { lock.unlock() }
+    return updates.last
+  }
+}
+
+@Suite("VolumeStore batches")
+struct VolumeStoreBatchTests {
+  @Test("a batch is one notification carrying every real change")
+  func batchNotifiesOnce() {
+    let counter = NotificationCounter()
+    let store = VolumeStore { changes in counter.record(changes) }
+    store.setVolume(for: "com.test.a", volume: 0.5)
+
+    let changed = store.setVolumes(["com.test.a": 0.5, "com.test.b": 0.25, "com.test.c": 2.0])
+    #expect(changed == 2)
+    #expect(counter.count == 2)
+    #expect(counter.last?.count == 2)
+    #expect(store.getVolume(for: "com.test.c") == 1.0)
+
+    // each change still gets its own generation, so deltas stay exact
+    let delta = store.changes(since: 1)
+    #expect(delta.generation == 3)
+    #expect(named(delta) == ["com.test.b": 0.25, "com.test.c": 1.0])
+  }
+
+  @Test("getVolumes answers for known and unknown apps")
+  func getVolumesBatch() {
+    let store = VolumeStore()
+    store.setVolumes(["com.test.a": 0.5, "com.test.b": 0.25])
+    #expect(
+      store.getVolumes(for: ["com.test.a", "com.test.unknown"])
+        == ["com.test.a": 0.5, "com.test.unknown": 1.0]
+    )
+  }
+
+  @Test("restoring 500 apps: one batch instead of 500 updates")
+  func restoreFiveHundred() {
+    let volumes = Dictionary(uniqueKeysWithValues: (0 ..< 500).map {
+      ("com.test.app\($0)", Float($0 % 100) / 100)
+    })
+
+    let perApp = NotificationCounter()
+    let sequential = VolumeStore { changes in
+      perApp.record(changes)
+    }
+    let sequentialTime = Benchmark.measure {
+      for (bundleID, volume) in volumes {
+        sequential.setVolume(for: bundleID, volume: volume)
+      }
+    }
+
+    let batched = NotificationCounter()
+    let batch = VolumeStore { changes in
+      batched.record(changes)
+    }
+    let batchTime = Benchmark.measure {
+      batch.setVolumes(volumes)
+    }
+
+    // each notification is a driver push (and each host call an XPC round trip before this)
+    #expect(perApp.count == 500)
+    #expect(batched.count == 1)
+    #expect(batch.getAllVolumes() == sequential.getAllVolumes())
+    let report = "batch \(batchTime) ns vs \(sequentialTime) ns"
+    Benchmark.report("500-app restore", report)
+    if Benchmark.isEnabled {
+      #expect(batchTime <= sequentialTime * 2, "\(report)")
+    }
+  }
+}
@@ -0,0 +1,340 @@
+// VolumeSubscriptionTests.swift
+// Unit tests for pushed, coalesced volume change batches
+//
+// uses Swift Testing framework (@Test, #expect)
+
+@testable import AppFadersHelper
+import AppFadersTestSupport
+import Dispatch
+import Foundation
+import Testing
+
+// MARK: - Helpers
+
+/// stands in for a driver connection - applies batches like HelperBridge does
+private final class TestSubscriber: @unchecked Sendable {
+  private let lock = NSLock()
+  private var state: [String: Float] = [:]
+  private var names: [AppID: String] = [:]
+  private var batches: [VolumeDelta] = []
+  private var acknowledgements: [@Sendable () -> Void] = []
+  private var lastApplied = DispatchTime(uptimeNanoseconds: 0)
+
+  /// hold acknowledgements until acknowledge() instead of replying straight away
+  let holdAcknowledgements: Bool
+  /// simulated per-batch cost of an XPC round trip and cache merge
+  let ackDelay: DispatchTimeInterval?
+  private let ackQueue = DispatchQueue(label: "test.subscriber.ack")
+
+  init(holdAcknowledgements: Bool = false, ackDelay: DispatchTimeInterval? = nil) {
+    self.holdAcknowledgements = holdAcknowledgements
+    self.ackDelay = ackDelay
+  }
+
+  var deliver: VolumeSubscription.Deliver {
+    { [self] batch, acknowledge in receive(batch, acknowledge) }
+  }
+
+  private func receive(_ batch: VolumeDelta, _ acknowledge: @escaping @Sendable () -> Void) {
+    lock.lock()
+    if batch.isSnapshot {
+      names = batch.names
+      state.removeAll()
+    } else {
+      names.merge(batch.names) { _, new in new }
+    }
+    for (appID, volume) in batch.volumes {
+      state[names[appID] ?? "unnamed \(appID)"] = volume
+    }
+    for appID in batch.removed {
+      state.removeValue(forKey: names[appID] ?? "unnamed \(appID)")
+    }
+    state.merge(batch.volumesByBundleID) { _, new in new }
+    for bundleID in batch.removedBundleIDs {
+      state.removeValue(forKey: bundleID)
+    }
+    batches.append(batch)
+    lastApplied = DispatchTime.now()
+    if holdAcknowledgements {
+      acknowledgements.append(acknowledge)
+      lock.unlock()
+      return
+    }
+    lock.unlock()
+
+    if let ackDelay {
+      ackQueue.asyncAfter(deadline: .now() + ackDelay, execute: acknowledge)
+    } else {
+      ackQueue.async(execute: acknowledge)
+    }
+  }
+
+  func acknowledge() {
+    lock.lock()
+    let pending = acknowledgements
+    acknowledgements.removeAll()
+    lock.unlock()
+    pending.forEach { $0() }
+  }
+
+  var received: [VolumeDelta] {
+    lock.lock()
+    defer { lock.unlock() }
+    return batches
+  }
+
+  var volumes: [String: Float] {
+    lock.lock()
+    defer { lock.unlock() }
+    return state
+  }
+
+  var generation: UInt64 {
+    lock.lock()
+    defer { lock.unlock() }
+    return batches.last?.generation ?? 0
+  }
+
+  var lastAppliedTime: DispatchTime {
+    lock.lock()
+    defer { lock.unlock() }
+    return lastApplied
+  }
+}
+
+/// spin until the condition holds or the timeout passes
+private func waitUntil(timeout: TimeInterval = 5, _ condition: () -> Bool) -> Bool {
+  let deadline = Date().addingTimeInterval(timeout)
+  while !condition() {
+    if Date() > deadline {
+      return false
+    }
+    usleep(100)
+  }
+  return true
+}
+
+// MARK: - Subscription Tests
+
+@Suite("VolumeSubscription")
+struct VolumeSubscriptionTests {
+  @Test("changes arriving while a batch is in flight collapse to the latest value per app")
+  func coalescesWhileInFlight() {
+    let subscriber = TestSubscriber(holdAcknowledgements: true)
+    let subscription = VolumeSubscription(deliver: subscriber.deliver)
+
+    let appIDs: [String: AppID] = ["com.test.a": 0, "com.test.b": 1, "com.test.c": 2]
+    var generation: UInt64 = 0
+    func change(_ bundleID: String, _ volume: Float?) {
+      generation += 1
+      subscription.enqueue(VolumeChange(
+        generation: generation,
+        bundleID: bundleID,
+        appID: appIDs[bundleID],
+        volume: volume
+      ))
+    }
+
+    change("com.test.a", 0.1)
+    #expect(subscriber.received.count == 1)
+
+    for step in 0 ..< 100 {
+      change("com.test.a", Float(step) / 100)
+      change("com.test.b", Float(step) / 200)
+    }
+    change("com.test.c", 0.5)
+    change("com.test.c", nil)
+    #expect(subscriber.received.count == 1)
+
+    subscriber.acknowledge()
+    let batches = subscriber.received
+    #expect(batches.count == 2)
+    #expect(batches[1].generation == generation)
+    #expect(batches[1].volumes == [0: 0.99, 1: 0.495])
+    #expect(batches[1].removed == [2])
+    // com.test.a was named in the first batch
+    #expect(batches[1].names == [1: "com.test.b", 2: "com.test.c"])
+    #expect(subscriber.volumes == ["com.test.a": 0.99, "com.test.b": 0.495])
+    #expect(subscription.changesReceived == 203)
+    #expect(subscription.batchesDelivered == 2)
+
+    // nothing pending - acknowledging again sends nothing
+    subscriber.acknowledge()
+    #expect(subscriber.received.count == 2)
+  }
+
+  @Test("a new subscriber is seeded with a snapshot, then receives deltas")
+  func seedThenStream() {
+    let subscriptions = VolumeSubscriptions()
+    let store = VolumeStore { change in subscriptions.publish(change) }
+    store.setVolume(for: "com.test.a", volume: 0.5)
+    store.setVolume(for: "com.test.b", volume: 0.25)
+
+    let subscriber = TestSubscriber(holdAcknowledgements: true)
+    subscriptions.subscribe(
+      ObjectIdentifier(subscriber),
+      since: 0,
+      store: store,
+      deliver: subscriber.deliver
+    )
+    #expect(subscriber.received.first?.isSnapshot == true)
+    #expect(subscriber.volumes == ["com.test.a": 0.5, "com.test.b": 0.25])
+
+    store.removeVolume(for: "com.test.b")
+    store.setVolume(for: "com.test.c", volume: 0.75)
+    subscriber.acknowledge()
+
+    let delta = subscriber.received.last
+    #expect(delta?.isSnapshot == false)
+    #expect(delta?.generation == store.currentGeneration)
+    #expect(subscriber.volumes == store.getAllVolumes())
+  }
+
+  @Test("a resubscribing driver only gets what it missed")
+  func resubscribeSince() {
+    let subscriptions = VolumeSubscriptions()
+    let store = VolumeStore { change in subscriptions.publish(change) }
+    store.setVolume(for: "com.test.a", volume: 0.5)
+    let synced = store.currentGeneration
+    store.setVolume(for: "com.test.b", volume: 0.25)
+
+    let subscriber = TestSubscriber(holdAcknowledgements: true)
+    subscriptions.subscribe(
+      ObjectIdentifier(subscriber),
+      since: synced,
+      store: store,
+      deliver: subscriber.deliver
+    )
+
+    let seed = subscriber.received.first
+    #expect(seed?.isSnapshot == false)
+    #expect(seed?.volumes == [1: 0.25])
+    #expect(seed?.names == [1: "com.test.b"])
+  }
+
+  @Test("a change landing between registration and the seed goes out after the seed")
+  func changeBeforeSeed() {
+    let subscriber = TestSubscriber(holdAcknowledgements: true)
+    // registered the way subscribe() does it, seed not computed yet
+    let subscription = VolumeSubscription(deliver: subscriber.deliver, awaitingSeed: true)
+
+    subscription.enqueue(VolumeChange(
+      generation: 3,
+      bundleID: "com.test.b",
+      appID: 1,
+      volume: 0.25
+    ))
+    #expect(subscriber.received.isEmpty)
+
+    // the seed, computed after that change, already includes it
+    subscription.start(with: VolumeDelta(
+      generation: 3,
+      volumes: [0: 0.5, 1: 0.25],
+      removed: [],
+      names: [0: "com.test.a", 1: "com.test.b"],
+      isSnapshot: false
+    ))
+    subscription.enqueue(VolumeChange(
+      generation: 4,
+      bundleID: "com.test.a",
+      appID: 0,
+      volume: 0.75
+    ))
+    subscriber.acknowledge()
+
+    // seed first, then only what is newer - a driver requiring rising generations keeps both
+    let batches = subscriber.received
+    #expect(batches.map(\.generation) == [3, 4])
+    #expect(batches.first?.volumes == [0: 0.5, 1: 0.25])
+    #expect(subscriber.volumes == ["com.test.a": 0.75, "com.test.b": 0.25])
+  }
+
+  @Test("apps the full registry couldn't number are seeded and pushed by bundle ID")
+  func unnumberedApps() {
+    let subscriptions = VolumeSubscriptions()
+    let store = VolumeStore(appIDs: AppIDRegistry(capacity: 1)) { change in
+      subscriptions.publish(change)
+    }
+    store.setVolume(for: "com.test.a", volume: 0.5)
+    store.setVolume(for: "com.test.b", volume: 0.25)
+
+    let subscriber = TestSubscriber(holdAcknowledgements: true)
+    subscriptions.subscribe(
+      ObjectIdentifier(subscriber),
+      since: 0,
+      store: store,
+      deliver: subscriber.deliver
+    )
+    #expect(subscriber.volumes == ["com.test.a": 0.5, "com.test.b": 0.25])
+
+    store.setVolume(for: "com.test.c", volume: 0.75)
+    store.removeVolume(for: "com.test.b")
+    subscriber.acknowledge()
+
+    let delta = subscriber.received.last
+    #expect(delta?.volumesByBundleID == ["com.test.c": 0.75])
+    #expect(delta?.removedBundleIDs == ["com.test.b"])
+    #expect(subscriber.volumes == store.getAllVolumes())
+  }
+
+  @Test("unsubscribed connections stop receiving")
+  func unsubscribe() {
+    let subscriptions = VolumeSubscriptions()
+    let store = VolumeStore { change in subscriptions.publish(change) }
+    let subscriber = TestSubscriber()
+    let key = ObjectIdentifier(subscriber)
+    subscriptions.subscribe(key, since: 0, store: store, deliver: subscriber.deliver)
+    #expect(waitUntil { subscriber.received.count == 1 })
+
+    subscriptions.unsubscribe(key)
+    store.setVolume(for: "com.test.a", volume: 0.5)
+    usleep(10000)
+    #expect(subscriber.received.count == 1)
+  }
+
+  @Test("a slider flood converges with bounded batches and latency")
+  func sliderFlood() {
+    let subscriptions = VolumeSubscriptions()
+    let store = VolumeStore { change in subscriptions.publish(change) }
+    // ~1ms per batch - much slower than the sliders move
+    let subscriber = TestSubscriber(ackDelay: .milliseconds(1))
+    subscriptions.subscribe(
+      ObjectIdentifier(subscriber),
+      since: 0,
+      store: store,
+      deliver: subscriber.deliver
+    )
+
+    let sliders = 8
+    let eventsPerSlider = 2500
+    let start = DispatchTime.now()
+    DispatchQueue.concurrentPerform(iterations: sliders) { slider in
+      for event in 0 ..< eventsPerSlider {
+        store.setVolume(for: "com.test.app\(slider)", volume: Float(event % 100) / 100)
+      }
+    }
+    let lastEvent = DispatchTime.now()
+
+    #expect(waitUntil { subscriber.generation == store.currentGeneration })
+    #expect(subscriber.volumes == store.getAllVolumes())
+
+    // coalescing keeps batches far below the event count
+    let events = sliders * eventsPerSlider
+    let batches = subscriber.received.count
+    #expect(batches < events / 10, "\(batches) batches for \(events) events")
+
+    let applied = subscriber.lastAppliedTime.uptimeNanoseconds
+    let latency = applied > lastEvent.uptimeNanoseconds ? applied - lastEvent.uptimeNanoseconds : 0
+    let elapsed = Double(lastEvent.uptimeNanoseconds - start.uptimeNanoseconds) / 1e9
+    Benchmark.report(
+      "slider flood",
+      "\(batches) batches, \(Double(events) / elapsed) events/s, last change applied \(latency) ns"
+    )
+    // wall-clock bounds only on request
+    if Benchmark.isEnabled {
+      // the final value lands within a few batch round trips of the last slider move
+      #expect(latency < 50_000_000, "last change applied \(latency) ns after the flood")
+      #expect(Double(events) / elapsed > 1000, "\(Double(events) / elapsed) events/s")
+    }
+  }
+}
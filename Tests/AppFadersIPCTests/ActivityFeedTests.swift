@@ -0,0 +1,68 @@
+// ActivityFeedTests.swift
+// Unit tests for the driver -> host activity feed encoding
+//
+// uses Swift Testing framework (@Test, #expect)
+
+@testable import AppFadersIPC
+import Foundation
+import Testing
+
+@Suite("ActivityFeed")
+struct ActivityFeedTests {
+  /// more than a byte of bitmap, producing and silent apps interleaved
+  static let apps = (1 ... 11).map { index in
+    AppActivity(
+      key: UInt64(index) &* 0x9E37_79B9_7F4A_7C15,
+      isProducing: index % 3 != 0,
+      peak: Float(index) / 16
+    )
+  }
+
+  @Test("activity survives a round trip, in key order")
+  func roundTrip() throws {
+    let decoded = try ActivityFeed.decode(ActivityFeed.encode(Self.apps.reversed()))
+    #expect(decoded == Self.apps.sorted { $0.key < $1.key })
+    #expect(try ActivityFeed.decode(ActivityFeed.encode([])).isEmpty)
+  }
+
+  @Test("each app costs twelve bytes and a bit")
+  func size() {
+    #expect(ActivityFeed.encode(Self.apps).count == 1 + 4 + 2 + 11 * 12)
+  }
+
+  @Test("truncated feeds throw instead of reading past the end")
+  func truncated() {
+    let bytes = ActivityFeed.encode(Self.apps)
+    for length in 0 ..< bytes.count {
+      #expect(throws: HelperTransportError.self) {
+        try ActivityFeed.decode(Array(bytes[..<length]))
+      }
+    }
+  }
+
+  @Test("other versions, trailing bytes, absurd counts and bad peaks are rejected")
+  func malformed() {
+    var other = ActivityFeed.encode(Self.apps)
+    other[0] = ActivityFeed.version &+ 1
+    #expect(throws: HelperTransportError.unsupportedVersion(ActivityFeed.version &+ 1)) {
+      try ActivityFeed.decode(other)
+    }
+    #expect(throws: HelperTransportError.self) {
+      try ActivityFeed.decode(ActivityFeed.encode(Self.apps) + [0])
+    }
+
+    var writer = WireWriter()
+    writer.write(ActivityFeed.version)
+    writer.write(UInt32.max)
+    #expect(throws: HelperTransportError.self) {
+      try ActivityFeed.decode(writer.bytes)
+    }
+
+    for peak in [Float.nan, .infinity, -0.5] {
+      let bytes = ActivityFeed.encode([AppActivity(key: 1, isProducing: true, peak: peak)])
+      #expect(throws: HelperTransportError.self) {
+        try ActivityFeed.decode(bytes)
+      }
+    }
+  }
+}
@@ -0,0 +1,343 @@
+// MessageCodecTests.swift
+// Unit tests, fuzzing and a size/time benchmark for helper message encoding and stream framing
+//
+// uses Swift Testing framework (@Test, #expect)
+
+@testable import AppFadersIPC
+import AppFadersTestSupport
+import Foundation
+import Testing
+
+@Suite("MessageCodec")
+struct MessageCodecTests {
+  static let requests: [HelperRequest] = [
+    .registerApp(bundleID: "com.test.app"),
+    .setVolume(bundleID: "com.test.app", volume: 0.5),
+    .setAppVolume(appID: 42, volume: 0.25),
+    .getVolume(bundleID: "com.test.äpp"),
+    .setAppVolumes([1: 0.1, 2: 0.9], named: ["com.test.unnumbered": 0.5]),
+    .getAppVolumes(appIDs: [1, 2]),
+    .getAllVolumes,
+    .getVolumeChanges(since: UInt64.max - 1),
+    .subscribe(since: 7),
+    .saveScene(name: "meeting", volumes: ["com.test.a": 0.2]),
+    .recallScene(name: "meeting", rampMilliseconds: 250),
+    .removeScene(name: "meeting"),
+    .getSceneNames
+  ]
+
+  static let responses: [HelperResponse] = [
+    .done,
+    .appID(3),
+    .volume(0.75),
+    .volumes(["com.test.a": 0.5]),
+    .appVolumes([1: 0.5, 2: 1.0]),
+    .changes(HelperChanges(
+      generation: 12,
+      volumes: [1: 0.5],
+      removed: [2],
+      names: [1: "com.test.a"],
+      volumesByBundleID: ["com.test.unnumbered": 0.25],
+      removedBundleIDs: ["com.test.gone"],
+      isSnapshot: false
+    )),
+    .names(["focus", "media"]),
+    .registered([4: "com.test.d", 5: "com.test.e"]),
+    .failure(code: 7, message: "No scene named focus")
+  ]
+
+  @Test("every request survives a round trip")
+  func requestRoundTrip() throws {
+    for request in Self.requests {
+      #expect(try MessageCodec.decodeRequest(MessageCodec.encode(request)) == request)
+    }
+  }
+
+  @Test("every response survives a round trip")
+  func responseRoundTrip() throws {
+    for response in Self.responses {
+      #expect(try MessageCodec.decodeResponse(MessageCodec.encode(response)) == response)
+    }
+  }
+
+  @Test("truncated payloads throw instead of reading past the end")
+  func truncated() {
+    for request in Self.requests {
+      let bytes = MessageCodec.encode(request)
+      for length in 0 ..< bytes.count {
+        #expect(throws: HelperTransportError.self) {
+          try MessageCodec.decodeRequest(Array(bytes[..<length]))
+        }
+      }
+    }
+  }
+
+  @Test("unknown tags, trailing bytes and absurd counts are rejected")
+  func malformed() {
+    #expect(throws: HelperTransportError.self) {
+      try MessageCodec.decodeRequest([MessageCodec.version, 0xFF] as [UInt8])
+    }
+    #expect(throws: HelperTransportError.self) {
+      try MessageCodec.decodeRequest(MessageCodec.encode(.getAllVolumes) + [0])
+    }
+    // a volumes count far beyond the bytes that follow must fail before allocating
+    var writer = WireWriter()
+    writer.write(MessageCodec.version)
+    writer.write(UInt8(5))
+    writer.write(UInt32.max)
+    #expect(throws: HelperTransportError.self) {
+      try MessageCodec.decodeRequest(writer.bytes)
+    }
+  }
+}
+
+// MARK: - Fuzzing
+
+/// deterministic, so a failing input can be reproduced from its seed
+private struct SplitMix64: RandomNumberGenerator {
+  var state: UInt64
+
+  mutating func next() -> UInt64 {
+    state &+= 0x9E37_79B9_7F4A_7C15
+    var mixed = state
+    mixed = (mixed ^ (mixed >> 30)) &* 0xBF58_476D_1CE4_E5B9
+    mixed = (mixed ^ (mixed >> 27)) &* 0x94D0_49BB_1331_11EB
+    return mixed ^ (mixed >> 31)
+  }
+}
+
+/// one to four random edits - flipped, inserted and dropped bytes, and counts and lengths
+/// overwritten with edge values
+private func mutate(_ bytes: [UInt8], using random: inout SplitMix64) -> [UInt8] {
+  var bytes = bytes
+  for _ in 0 ..< Int.random(in: 1 ... 4, using: &random) {
+    let position = bytes.isEmpty ? 0 : Int.random(in: 0 ..< bytes.count, using: &random)
+    switch Int.random(in: 0 ..< 4, using: &random) {
+    case 0 where !bytes.isEmpty:
+      bytes[position] ^= UInt8.random(in: 1 ... 255, using: &random)
+    case 1:
+      bytes.insert(UInt8.random(in: 0 ... 255, using: &random), at: position)
+    case 2 where !bytes.isEmpty:
+      bytes.remove(at: position)
+    default:
+      let edge: [UInt32] = [0, 1, 0x7F, 0xFF, 0xFFFF, 0x7FFF_FFFF, UInt32.max]
+      let value = edge[Int.random(in: 0 ..< edge.count, using: &random)]
+      for (index, byte) in withUnsafeBytes(of: value.littleEndian, Array.init).enumerated()
+        where position + index < bytes.count {
+        bytes[position + index] = byte
+      }
+    }
+  }
+  return bytes
+}
+
+@Suite("MessageCodec fuzzing")
+struct MessageCodecFuzzTests {
+  static let changes = HelperChanges(
+    generation: 99,
+    volumes: [1: 0.5, 2: 0],
+    removed: [3],
+    names: [1: "com.test.a", 3: "com.test.c"],
+    volumesByBundleID: ["com.test.d": 0.75],
+    removedBundleIDs: ["com.test.e"],
+    isSnapshot: false
+  )
+
+  @Test("mutated messages either throw or decode to something that re-encodes faithfully")
+  func mutatedMessages() throws {
+    var random = SplitMix64(state: 0x5EED)
+    for _ in 0 ..< 500 {
+      for request in MessageCodecTests.requests {
+        let bytes = mutate(MessageCodec.encode(request), using: &random)
+        if let decoded = try? MessageCodec.decodeRequest(bytes) {
+          #expect(try MessageCodec.decodeRequest(MessageCodec.encode(decoded)) == decoded)
+        }
+      }
+      for response in MessageCodecTests.responses {
+        let bytes = mutate(MessageCodec.encode(response), using: &random)
+        if let decoded = try? MessageCodec.decodeResponse(bytes) {
+          #expect(try MessageCodec.decodeResponse(MessageCodec.encode(decoded)) == decoded)
+        }
+      }
+      let bytes = mutate(MessageCodec.encode(Self.changes), using: &random)
+      if let decoded = try? MessageCodec.decodeChanges(bytes) {
+        #expect(try MessageCodec.decodeChanges(MessageCodec.encode(decoded)) == decoded)
+      }
+    }
+  }
+
+  @Test("random bytes never crash the decoders")
+  func randomBytes() {
+    var random = SplitMix64(state: 0xF022)
+    for round in 0 ..< 20000 {
+      var bytes = (0 ..< Int.random(in: 0 ... 48, using: &random)).map { _ in
+        UInt8.random(in: 0 ... 255, using: &random)
+      }
+      // past the version check most of the time, so the tag and field readers get exercised
+      if round % 4 != 0, !bytes.isEmpty {
+        bytes[0] = MessageCodec.version
+      }
+      _ = try? MessageCodec.decodeRequest(bytes)
+      _ = try? MessageCodec.decodeResponse(bytes)
+      _ = try? MessageCodec.decodeChanges(bytes)
+    }
+  }
+
+  @Test("another version, a non-finite volume and a duplicate key are rejected")
+  func invariants() {
+    var newer = MessageCodec.encode(.getAllVolumes)
+    newer[0] = MessageCodec.version + 1
+    #expect(throws: HelperTransportError.unsupportedVersion(MessageCodec.version + 1)) {
+      try MessageCodec.decodeRequest(newer)
+    }
+
+    #expect(throws: HelperTransportError.self) {
+      try MessageCodec.decodeRequest(MessageCodec.encode(.setAppVolume(appID: 1, volume: .nan)))
+    }
+
+    var duplicate = WireWriter()
+    duplicate.write(MessageCodec.version)
+    duplicate.write(UInt8(5))
+    duplicate.write(UInt32(2))
+    for _ in 0 ..< 2 {
+      duplicate.write(UInt32(7))
+      duplicate.write(Float(0.5))
+    }
+    #expect(throws: HelperTransportError.self) {
+      try MessageCodec.decodeRequest(duplicate.bytes)
+    }
+
+    var duplicateName = WireWriter()
+    duplicateName.write(MessageCodec.version)
+    duplicateName.write(UInt64(1))
+    duplicateName.write(false)
+    duplicateName.write([UInt32: Float]())
+    duplicateName.write([UInt32]())
+    duplicateName.write(UInt32(2))
+    for name in ["com.test.a", "com.test.b"] {
+      duplicateName.write(UInt32(7))
+      duplicateName.write(name)
+    }
+    #expect(throws: HelperTransportError.self) {
+      try MessageCodec.decodeChanges(duplicateName.bytes)
+    }
+  }
+}
+
+// MARK: - Benchmark
+
+/// the same volumes as a keyed archive - how NSXPC carried dictionaries before
+private func keyedArchive(_ volumes: [String: Float]) throws -> Data {
+  let dictionary = NSMutableDictionary()
+  for (bundleID, volume) in volumes {
+    dictionary.setObject(NSNumber(value: volume), forKey: NSString(string: bundleID))
+  }
+  return try NSKeyedArchiver.archivedData(
+    withRootObject: dictionary,
+    requiringSecureCoding: true
+  )
+}
+
+private func keyedUnarchive(_ data: Data) throws -> [String: Float] {
+  let object = try NSKeyedUnarchiver.unarchivedObject(
+    ofClasses: [NSDictionary.self, NSString.self, NSNumber.self],
+    from: data
+  )
+  var volumes: [String: Float] = [:]
+  (object as? NSDictionary)?.enumerateKeysAndObjects { key, value, _ in
+    if let bundleID = key as? String, let volume = value as? NSNumber {
+      volumes[bundleID] = volume.floatValue
+    }
+  }
+  return volumes
+}
+
+@Suite("MessageCodec benchmark")
+struct MessageCodecBenchmarkTests {
+  @Test("a 500-app batch is smaller and faster to round-trip than a keyed archive")
+  func againstKeyedArchiver() throws {
+    let volumes = Dictionary(uniqueKeysWithValues: (0 ..< 500).map {
+      ("com.test.app\($0)", Float($0 % 101) / 100)
+    })
+    let appVolumes = Dictionary(uniqueKeysWithValues: (0 ..< 500).map {
+      (UInt32($0), Float($0 % 101) / 100)
+    })
+    let rounds = 50
+
+    let request = HelperRequest.setAppVolumes(appVolumes, named: [:])
+    let binary = MessageCodec.encode(request)
+    // the same batch keyed by bundle ID, the way a scene still carries it
+    let named = MessageCodec.encode(.saveScene(name: "batch", volumes: volumes))
+    let archive = try keyedArchive(volumes)
+    #expect(try MessageCodec.decodeRequest(binary) == request)
+    #expect(try keyedUnarchive(archive) == volumes)
+
+    let binaryTime = try Benchmark.measure(rounds: rounds) {
+      _ = try MessageCodec.decodeRequest(Data(MessageCodec.encode(request)))
+    }
+    let archiveTime = try Benchmark.measure(rounds: rounds) {
+      _ = try keyedUnarchive(keyedArchive(volumes))
+    }
+
+    let report = "binary \(binary.count) B, \(binaryTime / UInt64(rounds) / 1000) µs; "
+      + "by bundle ID \(named.count) B; "
+      + "keyed archive \(archive.count) B, \(archiveTime / UInt64(rounds) / 1000) µs"
+    #expect(binary.count < named.count / 2, "\(report)")
+    #expect(binary.count < archive.count, "\(report)")
+    Benchmark.report("MessageCodec 500-app batch", report)
+    // sizes are exact, times only checked on request
+    if Benchmark.isEnabled {
+      #expect(binaryTime < archiveTime, "\(report)")
+    }
+  }
+}
+
+@Suite("FrameDecoder")
+struct FrameDecoderTests {
+  @Test("frames split across reads and packed into one read both decode")
+  func splitAndPacked() throws {
+    let frames = [
+      MessageFrame(kind: .request, id: 1, payload: MessageCodec.encode(.getAllVolumes)),
+      MessageFrame(kind: .push, id: 2, payload: Array(repeating: 7, count: 1000)),
+      MessageFrame(kind: .acknowledge, id: 2)
+    ]
+    let stream = frames.flatMap(\.bytes)
+
+    // one byte at a time
+    var decoder = FrameDecoder()
+    var decoded: [MessageFrame] = []
+    for byte in stream {
+      decoder.append([byte])
+      while let frame = try decoder.next() {
+        decoded.append(frame)
+      }
+    }
+    #expect(decoded == frames)
+
+    // everything at once
+    var packed = FrameDecoder()
+    packed.append(stream)
+    decoded = []
+    while let frame = try packed.next() {
+      decoded.append(frame)
+    }
+    #expect(decoded == frames)
+  }
+
+  @Test("an oversized or unknown frame header fails the stream")
+  func badHeader() {
+    var oversized = WireWriter()
+    oversized.write(UInt32(MessageFrame.maxPayloadLength + 1))
+    oversized.write(MessageFrame.Kind.request.rawValue)
+    oversized.write(UInt32(1))
+    var decoder = FrameDecoder()
+    decoder.append(oversized.bytes)
+    #expect(throws: HelperTransportError.self) { try decoder.next() }
+
+    var unknown = MessageFrame(kind: .request, id: 1).bytes
+    unknown[4] = 99
+    var second = FrameDecoder()
+    second.append(unknown)
+    #expect(throws: HelperTransportError.self) { try second.next() }
+  }
+}
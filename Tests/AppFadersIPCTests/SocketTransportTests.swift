@@ -0,0 +1,425 @@
+// SocketTransportTests.swift
+// Unit tests and a load benchmark for the Unix domain socket transport
+//
+// uses Swift Testing framework (@Test, #expect)
+
+@testable import AppFadersIPC
+import AppFadersTestSupport
+import Foundation
+import Testing
+
+/// in-memory stand-in for the helper - volumes only, pushes on subscribe
+private final class FakeHelper: HelperRequestHandler, @unchecked Sendable {
+  private let lock = NSLock()
+  private var volumes: [String: Float] = [:]
+  private var acknowledged = 0
+  private var disconnected = 0
+  private var subscriber: HelperPeer?
+
+  var acknowledgedCount: Int {
+    lock.withLock { acknowledged }
+  }
+
+  var disconnectedCount: Int {
+    lock.withLock { disconnected }
+  }
+
+  var hasSubscriber: Bool {
+    lock.withLock { subscriber != nil }
+  }
+
+  /// every volume as a snapshot - app IDs are the sorted bundle IDs' positions
+  private func snapshot(generation: UInt64) -> HelperChanges {
+    let current = lock.withLock { volumes }
+    var byAppID: [UInt32: Float] = [:]
+    var names: [UInt32: String] = [:]
+    for (index, bundleID) in current.keys.sorted().enumerated() {
+      byAppID[UInt32(index)] = current[bundleID]
+      names[UInt32(index)] = bundleID
+    }
+    return HelperChanges(
+      generation: generation,
+      volumes: byAppID,
+      removed: [],
+      names: names,
+      isSnapshot: true
+    )
+  }
+
+  /// push to the last subscriber again, whether or not it is still connected
+  func pushAgain(_ changes: HelperChanges = HelperChanges(
+    generation: 99,
+    volumes: [:],
+    removed: [],
+    names: [:],
+    isSnapshot: false
+  )) {
+    let peer = lock.withLock { subscriber }
+    peer?.push(changes) { [self] in
+      lock.withLock { acknowledged += 1 }
+    }
+  }
+
+  func handle(
+    _ request: HelperRequest,
+    from peer: HelperPeer,
+    reply: @escaping @Sendable (HelperResponse) -> Void
+  ) {
+    switch request {
+    case let .setVolume(bundleID, volume):
+      guard volume >= 0, volume <= 1 else {
+        reply(.failure(code: 3, message: "Volume must be between 0.0 and 1.0"))
+        return
+      }
+      lock.withLock { volumes[bundleID] = volume }
+      reply(.done)
+    case let .getVolume(bundleID):
+      reply(.volume(lock.withLock { volumes[bundleID] } ?? 1.0))
+    case .getAllVolumes:
+      reply(.volumes(lock.withLock { volumes }))
+    case let .getVolumeChanges(since):
+      reply(.changes(snapshot(generation: since + 7)))
+    case let .subscribe(since):
+      reply(.done)
+      lock.withLock { subscriber = peer }
+      peer.push(snapshot(generation: since + 1)) { [self] in
+        lock.withLock { acknowledged += 1 }
+      }
+    default:
+      reply(.failure(code: -1, message: "unsupported"))
+    }
+  }
+
+  func peerDisconnected(_ peer: HelperPeer) {
+    lock.withLock { disconnected += 1 }
+  }
+}
+
+/// collects pushes and disconnects seen by a client
+private final class ClientEvents: @unchecked Sendable {
+  private let lock = NSLock()
+  private var changes: [HelperChanges] = []
+  private var disconnects = 0
+  private var receivedWhenDone: Int?
+
+  var received: [HelperChanges] {
+    lock.withLock { changes }
+  }
+
+  var disconnectCount: Int {
+    lock.withLock { disconnects }
+  }
+
+  func record(_ batch: HelperChanges) {
+    lock.withLock { changes.append(batch) }
+  }
+
+  func recordDisconnect() {
+    lock.withLock { disconnects += 1 }
+  }
+
+  /// batches received by the time a resync finished, nil until it has
+  var batchesBeforeDone: Int? {
+    lock.withLock { receivedWhenDone }
+  }
+
+  func recordDone() {
+    lock.withLock { receivedWhenDone = changes.count }
+  }
+}
+
+/// short enough for sun_path on every platform
+private func socketPath() -> String {
+  "/tmp/appfaders-test-\(UUID().uuidString.prefix(8)).sock"
+}
+
+/// poll until condition holds or a second has passed
+private func eventually(_ condition: () -> Bool) async -> Bool {
+  for _ in 0 ..< 100 {
+    if condition() { return true }
+    try? await Task.sleep(for: .milliseconds(10))
+  }
+  return condition()
+}
+
+@Suite("SocketTransport")
+struct SocketTransportTests {
+  @Test("requests round-trip through the socket")
+  func roundTrip() async throws {
+    let path = socketPath()
+    let listener = SocketHelperListener(path: path, handler: FakeHelper())
+    try listener.start()
+    defer { listener.stop() }
+
+    let client = SocketHelperTransport(path: path)
+    try client.start(onChanges: { _, acknowledge in acknowledge() }, onDisconnect: {})
+    defer { client.close() }
+
+    #expect(try await client.send(.setVolume(bundleID: "com.test.a", volume: 0.5)) == .done)
+    #expect(try await client.send(.getVolume(bundleID: "com.test.a")) == .volume(0.5))
+    #expect(try await client.send(.getAllVolumes) == .volumes(["com.test.a": 0.5]))
+  }
+
+  @Test("a helper failure surfaces as a remote error")
+  func remoteFailure() async throws {
+    let path = socketPath()
+    let listener = SocketHelperListener(path: path, handler: FakeHelper())
+    try listener.start()
+    defer { listener.stop() }
+
+    let client = SocketHelperTransport(path: path)
+    try client.start(onChanges: { _, acknowledge in acknowledge() }, onDisconnect: {})
+    defer { client.close() }
+
+    await #expect(
+      throws: HelperTransportError.remote(code: 3, message: "Volume must be between 0.0 and 1.0")
+    ) {
+      try await client.send(.setVolume(bundleID: "com.test.a", volume: 2))
+    }
+  }
+
+  @Test("pushed changes reach the client and its acknowledgement reaches the helper")
+  func pushAndAcknowledge() async throws {
+    let path = socketPath()
+    let helper = FakeHelper()
+    let listener = SocketHelperListener(path: path, handler: helper)
+    try listener.start()
+    defer { listener.stop() }
+
+    let events = ClientEvents()
+    let client = SocketHelperTransport(path: path)
+    try client.start(
+      onChanges: { changes, acknowledge in
+        events.record(changes)
+        acknowledge()
+      },
+      onDisconnect: {}
+    )
+    defer { client.close() }
+
+    _ = try await client.send(.setVolume(bundleID: "com.test.a", volume: 0.3))
+    #expect(try await client.send(.subscribe(since: 4)) == .done)
+
+    #expect(await eventually { helper.acknowledgedCount == 1 })
+    #expect(events.received.first?.generation == 5)
+    #expect(events.received.first?.volumes == [0: 0.3])
+    #expect(events.received.first?.names == [0: "com.test.a"])
+  }
+
+  @Test("a push that can't reach its client is acknowledged anyway")
+  func pushToClosedClient() async throws {
+    let path = socketPath()
+    let helper = FakeHelper()
+    let listener = SocketHelperListener(path: path, handler: helper)
+    try listener.start()
+    defer { listener.stop() }
+
+    let client = SocketHelperTransport(path: path)
+    try client.start(onChanges: { _, acknowledge in acknowledge() }, onDisconnect: {})
+    #expect(try await client.send(.subscribe(since: 0)) == .done)
+    #expect(await eventually { helper.acknowledgedCount == 1 })
+
+    client.close()
+    #expect(await eventually { helper.disconnectedCount == 1 })
+    // the subscription would wait for this batch forever
+    helper.pushAgain()
+    #expect(await eventually { helper.acknowledgedCount == 2 })
+  }
+
+  @Test("a client that stops reading doesn't block pushes to it")
+  func stalledReader() async throws {
+    let path = socketPath()
+    let helper = FakeHelper()
+    let listener = SocketHelperListener(path: path, handler: helper)
+    try listener.start()
+    defer { listener.stop() }
+
+    // a raw client: subscribes, then never reads a byte
+    let fd = UnixSocket.make()
+    #expect(try UnixSocket.withAddress(path) { connect(fd, $0, $1) } == 0)
+    defer { UnixSocket.close(fd) }
+    let subscribe = MessageFrame(
+      kind: .request,
+      id: 1,
+      payload: MessageCodec.encode(.subscribe(since: 0))
+    )
+    #expect(UnixSocket.writeAll(fd, subscribe.bytes))
+    #expect(await eventually { helper.hasSubscriber })
+
+    // far more than the socket buffers hold - a blocking write would stop partway
+    let names = Dictionary(uniqueKeysWithValues: (0 ..< 1000).map {
+      (UInt32($0), "com.test.app\($0)")
+    })
+    let batch = HelperChanges(
+      generation: 100,
+      volumes: [:],
+      removed: [],
+      names: names,
+      isSnapshot: false
+    )
+    let pushed = ClientEvents()
+    let thread = Thread {
+      for _ in 0 ..< 100 {
+        helper.pushAgain(batch)
+        pushed.record(batch)
+      }
+    }
+    thread.start()
+    #expect(await eventually { pushed.received.count == 100 })
+  }
+
+  @Test("a lost batch is replaced by a snapshot before it is acknowledged")
+  func resyncBeforeAcknowledge() async throws {
+    let path = socketPath()
+    let listener = SocketHelperListener(path: path, handler: FakeHelper())
+    try listener.start()
+    defer { listener.stop() }
+
+    let events = ClientEvents()
+    let client = SocketHelperTransport(path: path)
+    try client.start(onChanges: { _, acknowledge in acknowledge() }, onDisconnect: {})
+    defer { client.close() }
+    _ = try await client.send(.setVolume(bundleID: "com.test.a", volume: 0.4))
+
+    client.resync({ changes, applied in
+      events.record(changes)
+      applied()
+    }, then: { events.recordDone() })
+
+    // the snapshot is in before the acknowledgement lets the helper send anything newer
+    #expect(await eventually { events.batchesBeforeDone != nil })
+    #expect(events.batchesBeforeDone == 1)
+    #expect(events.received == [
+      HelperChanges(
+        generation: 7,
+        volumes: [0: 0.4],
+        removed: [],
+        names: [0: "com.test.a"],
+        isSnapshot: true
+      )
+    ])
+  }
+
+  @Test("a lost helper fails pending calls and reports the disconnect once")
+  func disconnect() async throws {
+    let path = socketPath()
+    let helper = FakeHelper()
+    let listener = SocketHelperListener(path: path, handler: helper)
+    try listener.start()
+
+    let events = ClientEvents()
+    let client = SocketHelperTransport(path: path)
+    try client.start(
+      onChanges: { _, acknowledge in acknowledge() },
+      onDisconnect: { events.recordDisconnect() }
+    )
+    _ = try await client.send(.getAllVolumes)
+
+    listener.stop()
+    #expect(await eventually { events.disconnectCount == 1 })
+    #expect(await eventually { helper.disconnectedCount == 1 })
+
+    await #expect(throws: HelperTransportError.notConnected) {
+      try await client.send(.getAllVolumes)
+    }
+  }
+
+  @Test("close() doesn't report a disconnect")
+  func closeIsQuiet() async throws {
+    let path = socketPath()
+    let helper = FakeHelper()
+    let listener = SocketHelperListener(path: path, handler: helper)
+    try listener.start()
+    defer { listener.stop() }
+
+    let events = ClientEvents()
+    let client = SocketHelperTransport(path: path)
+    try client.start(
+      onChanges: { _, acknowledge in acknowledge() },
+      onDisconnect: { events.recordDisconnect() }
+    )
+    client.close()
+
+    #expect(await eventually { helper.disconnectedCount == 1 })
+    #expect(events.disconnectCount == 0)
+  }
+
+  @Test("connecting to a missing socket fails")
+  func missingSocket() {
+    let client = SocketHelperTransport(path: socketPath())
+    #expect(throws: HelperTransportError.self) {
+      try client.start(onChanges: { _, acknowledge in acknowledge() }, onDisconnect: {})
+    }
+  }
+}
+
+// MARK: - Load Benchmark
+
+/// round-trip times of one client, in nanoseconds
+private func runClient(
+  _ transport: SocketHelperTransport,
+  index: Int,
+  requests: Int
+) async throws -> [UInt64] {
+  var times: [UInt64] = []
+  times.reserveCapacity(requests)
+  for step in 0 ..< requests {
+    let request: HelperRequest = step % 2 == 0
+      ? .setVolume(bundleID: "com.test.app\(index)", volume: Float(step % 100) / 100)
+      : .getVolume(bundleID: "com.test.app\(index)")
+    let start = Benchmark.now
+    _ = try await transport.send(request)
+    times.append(Benchmark.now - start)
+  }
+  return times
+}
+
+@Suite("SocketTransport load", .enabled(if: Benchmark.isEnabled))
+struct SocketTransportLoadTests {
+  @Test("hundreds of clients: throughput and p99 round trip")
+  func manyClients() async throws {
+    let clients = 200
+    let requestsPerClient = 50
+
+    let path = socketPath()
+    let listener = SocketHelperListener(path: path, handler: FakeHelper())
+    try listener.start()
+    defer { listener.stop() }
+
+    var transports: [SocketHelperTransport] = []
+    for _ in 0 ..< clients {
+      let transport = SocketHelperTransport(path: path)
+      try transport.start(onChanges: { _, acknowledge in acknowledge() }, onDisconnect: {})
+      transports.append(transport)
+    }
+    defer {
+      for transport in transports {
+        transport.close()
+      }
+    }
+    #expect(await eventually { listener.peerCount == clients })
+
+    let start = Benchmark.now
+    let times = try await withThrowingTaskGroup(of: [UInt64].self) { group in
+      for (index, transport) in transports.enumerated() {
+        group.addTask {
+          try await runClient(transport, index: index, requests: requestsPerClient)
+        }
+      }
+      return try await group.reduce(into: []) { $0.append(contentsOf: $1) }
+    }
+    let elapsed = Benchmark.now - start
+
+    let sorted = times.sorted()
+    let p50 = sorted[sorted.count / 2]
+    let p99 = sorted[sorted.count * 99 / 100]
+    let perSecond = Double(sorted.count) / (Double(elapsed) / 1e9)
+    let report = "\(Int(perSecond)) req/s, p50 \(p50 / 1000) µs, p99 \(p99 / 1000) µs"
+    Benchmark.report("SocketTransport \(clients) clients", report)
+
+    #expect(sorted.count == clients * requestsPerClient)
+    // generous bounds - a loaded CI machine still clears them by an order of magnitude
+    #expect(p99 < 250_000_000, "\(report)")
+    #expect(perSecond > 1000, "\(report)")
+  }
+}
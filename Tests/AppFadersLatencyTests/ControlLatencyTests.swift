@@ -0,0 +1,225 @@
+// ControlLatencyTests.swift
+// End-to-end benchmark: fader move to the first processed sample at the new gain
+//
+// host DriverBridge, helper store and driver IO cycle in one process - a loopback transport
+// stands in for XPC and DriverRig's mock IO clock for the HAL
+// uses Swift Testing framework (@Test, #expect)
+
+@testable import AppFaders
+import AppFadersIPC
+import AppFadersTestSupport
+import Dispatch
+import Foundation
+import Testing
+
+// MARK: - Probe
+
+/// stages of one fader move, in pipeline order
+enum LatencyStage: Int, CaseIterable, Sendable {
+  /// DriverBridge.submitAppVolume - where AudioOrchestrator.setVolume hands a move off
+  case call
+  /// the value landed in the helper's volume storage
+  case store
+  /// the store update is in the shared table and out to subscribers
+  case publish
+  /// an IO cycle picked the new target gain up
+  case visible
+  /// a processed buffer carries the new gain
+  case firstSample
+}
+
+/// timestamps of the move in flight - the first mark of each stage wins
+final class LatencyProbe: @unchecked Sendable {
+  private let lock = NSLock()
+  private var expected: Float = .nan
+  private var times: [UInt64?] = Array(repeating: nil, count: LatencyStage.allCases.count)
+
+  static func now() -> UInt64 {
+    Benchmark.now
+  }
+
+  /// gain the move in flight is heading for
+  var target: Float {
+    lock.withLock { expected }
+  }
+
+  /// start a move toward volume - marks .call
+  func begin(target volume: Float) {
+    lock.withLock {
+      expected = volume
+      times = Array(repeating: nil, count: LatencyStage.allCases.count)
+      times[LatencyStage.call.rawValue] = Self.now()
+    }
+  }
+
+  func mark(_ stage: LatencyStage) {
+    let now = Self.now()
+    lock.withLock {
+      if times[stage.rawValue] == nil {
+        times[stage.rawValue] = now
+      }
+    }
+  }
+
+  func isMarked(_ stage: LatencyStage) -> Bool {
+    lock.withLock { times[stage.rawValue] != nil }
+  }
+
+  /// every stage's time once the move reached the first sample, nil if it didn't in time
+  func waitForCompletion(timeout: Duration = .seconds(1)) async -> [UInt64]? {
+    let deadline = ContinuousClock.now + timeout
+    while ContinuousClock.now < deadline {
+      let marked = lock.withLock { times.compactMap(\.self) }
+      if marked.count == times.count {
+        return marked
+      }
+      try? await Task.sleep(for: .microseconds(100))
+    }
+    return nil
+  }
+}
+
+// MARK: - Loopback Transport
+
+/// HelperTransport straight into a handler - requests and replies still go through
+/// MessageCodec, and the handler runs on its own queue as it would on the helper's side of
+/// a connection
+private final class LoopbackTransport: HelperTransport, @unchecked Sendable {
+  private let handler: HelperRequestHandler
+  private let peer = LoopbackPeer()
+  private let queue = DispatchQueue(label: "com.fbreidenbach.appfaders.test.loopback")
+
+  init(handler: HelperRequestHandler) {
+    self.handler = handler
+  }
+
+  func start(
+    onChanges: @escaping HelperChangeHandler,
+    onDisconnect: @escaping @Sendable () -> Void
+  ) throws {}
+
+  func send(
+    _ request: HelperRequest,
+    reply: @escaping @Sendable (Result<HelperResponse, HelperTransportError>) -> Void
+  ) {
+    let message = MessageCodec.encode(request)
+    queue.async { [handler, peer] in
+      guard let request = try? MessageCodec.decodeRequest(message) else {
+        reply(.failure(.malformedMessage("loopback")))
+        return
+      }
+      handler.handle(request, from: peer) { response in
+        let message = MessageCodec.encode(response)
+        reply(Result { try MessageCodec.decodeResponse(message) }
+          .mapError { $0 as? HelperTransportError ?? .malformedMessage("\($0)") })
+      }
+    }
+  }
+
+  func close() {}
+}
+
+/// the host never subscribes
+private final class LoopbackPeer: HelperPeer {
+  func push(_ changes: HelperChanges, acknowledged: @escaping @Sendable () -> Void) {
+    acknowledged()
+  }
+}
+
+// MARK: - Benchmark
+
+/// nanoseconds between consecutive stages of every move, plus the whole move
+private struct LatencyReport {
+  let stages: [[UInt64]]
+  let total: [UInt64]
+
+  init(_ moves: [[UInt64]]) {
+    // the store writes the table just before it notifies subscribers, so a cycle can see a
+    // value before .publish is marked - that step counts as zero, the next one takes the time
+    stages = (1 ..< LatencyStage.allCases.count).map { stage in
+      moves.map { $0[stage] - min($0[stage - 1], $0[stage]) }.sorted()
+    }
+    total = moves.map { $0[LatencyStage.firstSample.rawValue] - $0[LatencyStage.call.rawValue] }
+      .sorted()
+  }
+
+  /// p99 of the step into stage
+  func p99(_ stage: LatencyStage) -> UInt64 {
+    Self.percentile(stages[stage.rawValue - 1], 99)
+  }
+
+  var summary: String {
+    let steps = (1 ..< LatencyStage.allCases.count).map { stage in
+      let times = stages[stage - 1]
+      return "→\(LatencyStage.allCases[stage]) p50 \(Self.percentile(times, 50) / 1000) µs "
+        + "p99 \(Self.percentile(times, 99) / 1000) µs"
+    }
+    return steps.joined(separator: ", ")
+      + "; total p50 \(Self.percentile(total, 50) / 1000) µs "
+      + "p99 \(Self.percentile(total, 99) / 1000) µs max \((total.last ?? 0) / 1000) µs"
+  }
+
+  static func percentile(_ sorted: [UInt64], _ percent: Int) -> UInt64 {
+    guard !sorted.isEmpty else { return 0 }
+    return sorted[min(sorted.count - 1, sorted.count * percent / 100)]
+  }
+}
+
+/// unique region name per run so parallel runs never share a table (31 character limit)
+private func regionName() -> String {
+  "/afl.\(getpid()).\(UInt32.random(in: 0 ... UInt32.max))"
+}
+
+@Suite("Control latency", .enabled(if: Benchmark.isEnabled))
+struct ControlLatencyTests {
+  /// p99 budgets - a change that pushes a stage past its budget fails the run
+  /// in-process hops get a few milliseconds; reaching the IO thread may take a whole cycle,
+  /// since the table is read once per cycle, plus the same slack
+  static let hopBudget: UInt64 = 5_000_000
+
+  @Test("fader move to first processed sample: stage latencies stay within budget")
+  func faderToSample() async throws {
+    let bundleID = "com.test.fader"
+    let moves = 200
+
+    let probe = LatencyProbe()
+    let helper = HelperRig(regionName: regionName(), probe: probe)
+    let driver = DriverRig(regionName: helper.regionName, bundleID: bundleID, probe: probe)
+    try #require(driver.start())
+    defer { driver.stop() }
+
+    // unthrottled - the coalescer's rate cap has its own tests and would only add its interval
+    let bridge = DriverBridge(volumeUpdateInterval: nil) {
+      LoopbackTransport(handler: helper.handler)
+    }
+    try await bridge.connect()
+    defer { bridge.disconnect() }
+
+    // warm-up: registers the app, interns its table entry and lets the IO thread find it
+    probe.begin(target: 0.5)
+    try await bridge.submitAppVolume(bundleID: bundleID, volume: 0.5)
+    try #require(await probe.waitForCompletion() != nil)
+
+    var recorded: [[UInt64]] = []
+    for move in 0 ..< moves {
+      // alternating, so every move changes the gain
+      let volume: Float = move % 2 == 0 ? 0.25 : 0.75
+      probe.begin(target: volume)
+      try await bridge.submitAppVolume(bundleID: bundleID, volume: volume)
+      let times = try #require(await probe.waitForCompletion(), "move \(move) never sounded")
+      recorded.append(times)
+    }
+
+    let report = LatencyReport(recorded)
+    let cycle = driver.periodNanoseconds
+    Benchmark.report("control latency", report.summary)
+    #expect(report.p99(.store) < Self.hopBudget, "\(report.summary)")
+    #expect(report.p99(.publish) < Self.hopBudget, "\(report.summary)")
+    #expect(report.p99(.visible) < cycle + Self.hopBudget, "\(report.summary)")
+    #expect(report.p99(.firstSample) < Self.hopBudget, "\(report.summary)")
+    #expect(
+      LatencyReport.percentile(report.total, 99) < cycle + 4 * Self.hopBudget,
+      "\(report.summary)"
+    )
+  }
+}
@@ -0,0 +1,141 @@
+// DriverRig.swift
+// Driver half of the control latency rig - client registry and IO cycles on a mock IO clock
+//
+// kept apart from the helper half: both modules declare a SharedVolumeTable
+
+@testable import AppFadersDriver
+import Dispatch
+import Foundation
+import Synchronization
+
+/// one client on the driver's real cycle path, rendered by a thread that stands in for the
+/// HAL's IO thread
+/// the mock clock ticks every framesPerCycle frames of wall time and hands out sample and host
+/// times the way the HAL would; each cycle runs BeginIOOperation (which applies the shared
+/// table), one ProcessOutput of a full-scale buffer and the WriteMix that closes the cycle
+/// .visible is marked when the cycle picks up the probe's target gain, .firstSample when a
+/// processed buffer first carries it
+final class DriverRig: @unchecked Sendable {
+  static let clientID: UInt32 = 1
+  static let channelCount = 2
+
+  let framesPerCycle: Int
+  let sampleRate: Float64
+
+  private let bundleID: String
+  private let probe: LatencyProbe
+  private let registry = ClientRegistry()
+  private let volumeTable: SharedVolumeTable
+  private let coordinator: IOCycleCoordinator
+  private let running = Atomic<Bool>(false)
+  private let stopped = DispatchSemaphore(value: 0)
+
+  /// - Parameters:
+  ///   - regionName: the helper rig's table region - it must exist before start()
+  ///   - framesPerCycle: IO buffer size; the clock ticks once per buffer
+  init(regionName: String, bundleID: String, probe: LatencyProbe, framesPerCycle: Int = 128) {
+    self.bundleID = bundleID
+    self.probe = probe
+    self.framesPerCycle = framesPerCycle
+    sampleRate = PassthroughEngine.shared.profile.sampleRate
+    volumeTable = SharedVolumeTable(name: regionName)
+    coordinator = IOCycleCoordinator(registry: registry, volumeTable: volumeTable)
+  }
+
+  /// one IO cycle in nanoseconds
+  var periodNanoseconds: UInt64 {
+    UInt64(Float64(framesPerCycle) / sampleRate * 1e9)
+  }
+
+  /// map the table, register the client and start ticking
+  /// - Returns: false if the helper's region isn't there
+  func start() -> Bool {
+    guard volumeTable.open() else { return false }
+    registry.addClient(clientID: Self.clientID, processID: 100, bundleID: bundleID, gain: 1.0)
+
+    running.store(true, ordering: .releasing)
+    let thread = Thread { [self] in
+      run()
+      stopped.signal()
+    }
+    thread.qualityOfService = .userInteractive
+    thread.start()
+    return true
+  }
+
+  func stop() {
+    guard running.exchange(false, ordering: .acquiring) else { return }
+    stopped.wait()
+  }
+
+  private func run() {
+    let sampleCount = framesPerCycle * Self.channelCount
+    let buffer = UnsafeMutablePointer<Float>.allocate(capacity: sampleCount)
+    defer { buffer.deallocate() }
+
+    var counter: UInt64 = 0
+    var deadline = LatencyProbe.now()
+    while running.load(ordering: .relaxed) {
+      counter += 1
+      cycle(counter: counter, hostTime: deadline, buffer: buffer, sampleCount: sampleCount)
+
+      // sleep to the next tick - a rig that fell more than a cycle behind starts over rather
+      // than bursting to catch up, as the HAL would after an overload
+      deadline += periodNanoseconds
+      let now = LatencyProbe.now()
+      if deadline > now {
+        usleep(UInt32((deadline - now) / 1000))
+      } else if now - deadline > periodNanoseconds {
+        deadline = now
+      }
+    }
+  }
+
+  private func cycle(
+    counter: UInt64,
+    hostTime: UInt64,
+    buffer: UnsafeMutablePointer<Float>,
+    sampleCount: Int
+  ) {
+    let sampleTime = Float64(counter) * Float64(framesPerCycle)
+    coordinator.beginOperation(
+      kAudioServerPlugInIOOperationProcessOutput,
+      counter: counter,
+      outputSampleTime: sampleTime,
+      outputHostTime: hostTime,
+      frameCount: framesPerCycle
+    )
+
+    guard let slot = registry.activeSlot(for: Self.clientID) else { return }
+    let target = probe.target
+    if slot.targetGain == target {
+      probe.mark(.visible)
+    }
+
+    let gainBefore = slot.gain
+    buffer.update(repeating: 1.0, count: sampleCount)
+    registry.process(
+      clientID: Self.clientID,
+      buffer: buffer,
+      frameCount: framesPerCycle,
+      channelCount: Self.channelCount,
+      sampleTime: sampleTime,
+      cycleCounter: counter
+    )
+    // a full-scale input comes out at the gain - the last frame shows whether the ramp moved
+    // toward the target (a previous move's ramp may still be running the other way)
+    let moved = (buffer[sampleCount - 1] - gainBefore) * (target - gainBefore)
+    if moved > 0, probe.isMarked(.visible) {
+      probe.mark(.firstSample)
+    }
+
+    coordinator.beginOperation(
+      kAudioServerPlugInIOOperationWriteMix,
+      counter: counter,
+      outputSampleTime: sampleTime,
+      outputHostTime: hostTime,
+      frameCount: framesPerCycle
+    )
+    coordinator.endOperation(kAudioServerPlugInIOOperationWriteMix)
+  }
+}
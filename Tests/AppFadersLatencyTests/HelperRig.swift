@@ -0,0 +1,73 @@
+// HelperRig.swift
+// Helper half of the control latency rig - store, shared volume table and message handler
+//
+// kept apart from the driver half: both modules declare a SharedVolumeTable
+
+@testable import AppFadersHelper
+import AppFadersIPC
+import AppFadersVolumeTable
+import Foundation
+
+/// in-memory volumes that mark .store as each value lands
+private final class ProbedVolumes: VolumeStorage {
+  private let volumes = InMemoryVolumes()
+  private let probe: LatencyProbe
+
+  init(probe: LatencyProbe) {
+    self.probe = probe
+  }
+
+  func volume(for bundleID: String) -> Float? {
+    volumes.volume(for: bundleID)
+  }
+
+  @discardableResult
+  func setVolume(_ volume: Float, for bundleID: String) -> Bool {
+    defer { probe.mark(.store) }
+    return volumes.setVolume(volume, for: bundleID)
+  }
+
+  @discardableResult
+  func removeVolume(for bundleID: String) -> Bool {
+    volumes.removeVolume(for: bundleID)
+  }
+
+  var allVolumes: [String: Float] {
+    volumes.allVolumes
+  }
+}
+
+/// the helper as the transport sees it - a private table region, nothing persisted
+/// .publish is marked once the store has written the table and notified subscribers
+final class HelperRig: @unchecked Sendable {
+  let regionName: String
+  let handler: HelperRequestHandler
+  private let volumeTable: SharedVolumeTable
+
+  init(regionName: String, probe: LatencyProbe) {
+    self.regionName = regionName
+    volumeTable = SharedVolumeTable(name: regionName)
+    let appIDs = AppIDRegistry(volumeTable: volumeTable)
+    let store = VolumeStore(
+      appIDs: appIDs,
+      volumeTable: volumeTable,
+      storage: ProbedVolumes(probe: probe)
+    ) { _ in
+      probe.mark(.publish)
+    }
+    let service = HelperService(
+      appIDs: appIDs,
+      store: store,
+      scenes: SceneStore(volumeStore: store)
+    )
+    handler = HelperMessageHandler(
+      service: service,
+      subscriptions: VolumeSubscriptions(),
+      store: store
+    )
+  }
+
+  deinit {
+    AFVolumeTable_Unlink(regionName)
+  }
+}
@@ -0,0 +1,34 @@
+// Benchmark.swift
+// Shared timing helpers for the benchmark suites
+//
+// benchmarks are opt-in - wall-clock bounds are noise in debug builds and on shared CI runners,
+// so they only run with APPFADERS_BENCHMARKS set, ideally on a release build:
+//
+//   APPFADERS_BENCHMARKS=1 swift test -c release
+
+import Dispatch
+import Foundation
+
+public enum Benchmark {
+  /// true when APPFADERS_BENCHMARKS is set - gate suites with .enabled(if: Benchmark.isEnabled)
+  public static let isEnabled = ProcessInfo.processInfo.environment["APPFADERS_BENCHMARKS"] != nil
+
+  /// monotonic nanoseconds
+  public static var now: UInt64 {
+    DispatchTime.now().uptimeNanoseconds
+  }
+
+  /// nanoseconds for rounds calls of body
+  public static func measure(rounds: Int = 1, _ body: () throws -> Void) rethrows -> UInt64 {
+    let start = now
+    for _ in 0 ..< rounds {
+      try body()
+    }
+    return now - start
+  }
+
+  /// prints a result line, so a benchmark run leaves its numbers in the log
+  public static func report(_ name: String, _ result: String) {
+    print("benchmark: \(name): \(result)")
+  }
+}
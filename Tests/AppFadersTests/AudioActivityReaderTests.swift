@@ -0,0 +1,53 @@
+// AudioActivityReaderTests.swift
+// Unit tests for naming the apps in the driver's activity feed
+//
+// the feed is handed in as bytes - no driver needs to be installed
+
+@testable import AppFaders
+import AppFadersIPC
+import AppFadersVolumeTable
+import Foundation
+import Testing
+
+@Suite("AudioActivityReader")
+struct AudioActivityReaderTests {
+  private static func feed(_ apps: [(String, Bool, Float)]) -> Data {
+    Data(ActivityFeed.encode(apps.map { bundleID, producing, peak in
+      AppActivity(key: AFVolumeTable_Key(bundleID), isProducing: producing, peak: peak)
+    }))
+  }
+
+  @Test("apps in the feed are named, apps without clients are left out")
+  func namesApps() throws {
+    let feed = Self.feed([
+      ("com.test.player", true, 0.5),
+      ("com.test.quiet", false, 0),
+      ("com.test.untracked", true, 0.9)
+    ])
+    let reader = AudioActivityReader { feed }
+
+    let activity = try #require(reader.activity(of: [
+      "com.test.player",
+      "com.test.quiet",
+      "com.test.closed"
+    ]))
+    #expect(activity == [
+      "com.test.player": AppAudioActivity(isProducing: true, peak: 0.5),
+      "com.test.quiet": AppAudioActivity(isProducing: false, peak: 0)
+    ])
+  }
+
+  @Test("peaks over full scale are clipped for display")
+  func clipsPeak() {
+    let feed = Self.feed([("com.test.loud", true, 3.5)])
+    let reader = AudioActivityReader { feed }
+    #expect(reader.activity(of: ["com.test.loud"])?["com.test.loud"]?.peak == 1)
+  }
+
+  @Test("a missing or unreadable feed means unknown, not silent")
+  func unknown() {
+    #expect(AudioActivityReader { nil }.activity(of: ["com.test.app"]) == nil)
+    #expect(AudioActivityReader { Data([0xFF, 1, 2]) }.activity(of: ["com.test.app"]) == nil)
+    #expect(AudioActivityReader { Self.feed([]) }.activity(of: ["com.test.app"]) == [:])
+  }
+}
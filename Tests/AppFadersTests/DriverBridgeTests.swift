@@ -1,9 +1,11 @@
 // DriverBridgeTests.swift
 // Unit tests for DriverBridge validation logic
 //
-// Tests validation before XPC calls - helper doesn't need to be running
+// Tests validation before helper calls - helper doesn't need to be running
 
 @testable import AppFaders
+import AppFadersIPC
+import AppFadersTestSupport
 import Foundation
 import Testing
 
@@ -118,6 +120,55 @@ struct DriverBridgeTests {
     }
   }
 
+  @Test("setAppVolumes validates every entry before sending")
+  func validateBatch() async {
+    let bridge = DriverBridge()
+
+    await #expect(throws: DriverError.invalidVolumeRange(1.5)) {
+      try await bridge.setAppVolumes(["com.test.a": 0.5, "com.test.b": 1.5])
+    }
+
+    let longID = String(repeating: "a", count: 256)
+    await #expect(throws: DriverError.bundleIDTooLong(256)) {
+      try await bridge.setAppVolumes(["com.test.a": 0.5, longID: 0.5])
+    }
+
+    await #expect(throws: DriverError.bundleIDTooLong(256)) {
+      _ = try await bridge.getAppVolumes(bundleIDs: ["com.test.a", longID])
+    }
+
+    // nothing to send - no connection needed
+    await #expect(throws: Never.self) {
+      try await bridge.setAppVolumes([:])
+    }
+  }
+
+  @Test("saveScene validates every entry before sending")
+  func validateScene() async {
+    let bridge = DriverBridge()
+
+    await #expect(throws: DriverError.invalidVolumeRange(2.0)) {
+      try await bridge.saveScene(name: "media", volumes: ["com.test.a": 2.0])
+    }
+
+    await #expect(throws: DriverError.bundleIDTooLong(256)) {
+      try await bridge.saveScene(name: "media", volumes: [String(repeating: "a", count: 256): 0.5])
+    }
+  }
+
+  @Test("submitAppVolume validates before coalescing")
+  func validateSubmit() async {
+    let bridge = DriverBridge()
+
+    await #expect(throws: DriverError.invalidVolumeRange(-0.5)) {
+      try await bridge.submitAppVolume(bundleID: "com.test.app", volume: -0.5)
+    }
+
+    await #expect(throws: DriverError.bundleIDTooLong(256)) {
+      try await bridge.submitAppVolume(bundleID: String(repeating: "a", count: 256), volume: 0.5)
+    }
+  }
+
   // MARK: - Connection State Tests
 
   @Test("Methods throw helperNotRunning when disconnected")
@@ -133,6 +184,31 @@ struct DriverBridgeTests {
     await #expect(throws: DriverError.helperNotRunning) {
       _ = try await bridge.getAppVolume(bundleID: "com.test.app")
     }
+
+    await #expect(throws: DriverError.helperNotRunning) {
+      try await bridge.setAppVolumes(["com.test.app": 0.5])
+    }
+
+    await #expect(throws: DriverError.helperNotRunning) {
+      _ = try await bridge.getAppVolumes(bundleIDs: ["com.test.app"])
+    }
+
+    await #expect(throws: DriverError.helperNotRunning) {
+      try await bridge.saveScene(name: "meeting", volumes: ["com.test.app": 0.5])
+    }
+
+    await #expect(throws: DriverError.helperNotRunning) {
+      _ = try await bridge.recallScene(name: "meeting", rampMilliseconds: 200)
+    }
+
+    await #expect(throws: DriverError.helperNotRunning) {
+      _ = try await bridge.getSceneNames()
+    }
+
+    // a coalesced update that reaches the sender reports the sender's error
+    await #expect(throws: DriverError.helperNotRunning) {
+      try await bridge.submitAppVolume(bundleID: "com.test.app", volume: 0.5)
+    }
   }
 
   @Test("Connection state is managed correctly")
@@ -148,3 +224,267 @@ struct DriverBridgeTests {
     #expect(!bridge.isConnected)
   }
 }
+
+// MARK: - Transport Tests
+
+/// answers the host calls setAppVolume needs, records what it was sent
+private final class RecordingHelper: HelperRequestHandler, @unchecked Sendable {
+  private let lock = NSLock()
+  private var registered: [String] = []
+  private var volumes: [UInt32: Float] = [:]
+  private var named: [String: Float] = [:]
+  private var registrations = 0
+  private var requests = 0
+
+  /// app IDs handed out before registerApp answers appIDsExhausted
+  let appIDLimit: Int
+
+  init(appIDLimit: Int = .max) {
+    self.appIDLimit = appIDLimit
+  }
+
+  var volumesByAppID: [UInt32: Float] {
+    lock.withLock { volumes }
+  }
+
+  var volumesByBundleID: [String: Float] {
+    lock.withLock { named }
+  }
+
+  var registerCount: Int {
+    lock.withLock { registrations }
+  }
+
+  var requestCount: Int {
+    lock.withLock { requests }
+  }
+
+  /// caller holds the lock - the app's ID, a new one while any are left
+  private func register(_ bundleID: String) -> UInt32? {
+    if let index = registered.firstIndex(of: bundleID) {
+      return UInt32(index + 1)
+    }
+    guard registered.count < appIDLimit else { return nil }
+    registered.append(bundleID)
+    return UInt32(registered.count)
+  }
+
+  func handle(
+    _ request: HelperRequest,
+    from peer: HelperPeer,
+    reply: @escaping @Sendable (HelperResponse) -> Void
+  ) {
+    lock.withLock { requests += 1 }
+    switch request {
+    case let .registerApp(bundleID):
+      let appID: UInt32? = lock.withLock {
+        registrations += 1
+        return register(bundleID)
+      }
+      guard let appID else {
+        reply(.failure(code: HelperResponse.appIDsExhausted, message: "All app IDs are assigned"))
+        return
+      }
+      reply(.appID(appID))
+    case let .setVolume(bundleID, volume):
+      lock.withLock { named[bundleID] = volume }
+      reply(.done)
+    case let .getVolume(bundleID):
+      reply(.volume(lock.withLock { named[bundleID] } ?? 1.0))
+    case let .setAppVolume(appID, volume):
+      lock.withLock { volumes[appID] = volume }
+      reply(.done)
+    case let .setAppVolumes(appVolumes, byBundleID):
+      let numbered: [UInt32: String] = lock.withLock {
+        volumes.merge(appVolumes) { _, new in new }
+        var numbered: [UInt32: String] = [:]
+        for (bundleID, volume) in byBundleID {
+          if let appID = register(bundleID) {
+            volumes[appID] = volume
+            numbered[appID] = bundleID
+          } else {
+            named[bundleID] = volume
+          }
+        }
+        return numbered
+      }
+      reply(.registered(numbered))
+    case let .getAppVolumes(appIDs):
+      let current = lock.withLock { volumes }
+      reply(.appVolumes(Dictionary(uniqueKeysWithValues: appIDs.map {
+        ($0, current[$0] ?? 1.0)
+      })))
+    case let .removeScene(name):
+      reply(.failure(code: 7, message: "No scene named \(name)"))
+    default:
+      reply(.failure(code: -1, message: "unsupported"))
+    }
+  }
+
+  func peerDisconnected(_ peer: HelperPeer) {}
+}
+
+@Suite("DriverBridge over a socket transport")
+struct DriverBridgeTransportTests {
+  @Test("host calls reach the helper through an injected transport")
+  func socketTransport() async throws {
+    let path = "/tmp/appfaders-bridge-\(UUID().uuidString.prefix(8)).sock"
+    let helper = RecordingHelper()
+    let listener = SocketHelperListener(path: path, handler: helper)
+    try listener.start()
+    defer { listener.stop() }
+
+    let bridge = DriverBridge(volumeUpdateInterval: nil) { SocketHelperTransport(path: path) }
+    try await bridge.connect()
+    defer { bridge.disconnect() }
+
+    try await bridge.setAppVolume(bundleID: "com.test.a", volume: 0.25)
+    try await bridge.setAppVolume(bundleID: "com.test.b", volume: 0.5)
+    try await bridge.setAppVolume(bundleID: "com.test.a", volume: 0.75)
+    #expect(helper.volumesByAppID == [1: 0.75, 2: 0.5])
+
+    await #expect(throws: DriverError.remoteError("No scene named focus")) {
+      try await bridge.removeScene(name: "focus")
+    }
+  }
+
+  @Test("batches carry app IDs - each bundle ID is registered once per connection")
+  func batchesByAppID() async throws {
+    let path = "/tmp/appfaders-bridge-\(UUID().uuidString.prefix(8)).sock"
+    let helper = RecordingHelper()
+    let listener = SocketHelperListener(path: path, handler: helper)
+    try listener.start()
+    defer { listener.stop() }
+
+    let bridge = DriverBridge(volumeUpdateInterval: nil) { SocketHelperTransport(path: path) }
+    try await bridge.connect()
+    defer { bridge.disconnect() }
+
+    try await bridge.setAppVolume(bundleID: "com.test.a", volume: 0.25)
+    // com.test.b is numbered by the batch itself, not by a registerApp of its own
+    try await bridge.setAppVolumes(["com.test.a": 0.1, "com.test.b": 0.3])
+    try await bridge.setAppVolumes(["com.test.a": 0.2, "com.test.b": 0.4])
+    #expect(helper.registerCount == 1)
+    #expect(helper.volumesByAppID == [1: 0.2, 2: 0.4])
+
+    let volumes = try await bridge.getAppVolumes(bundleIDs: ["com.test.b", "com.test.c"])
+    #expect(volumes == ["com.test.b": 0.4, "com.test.c": 1.0])
+    #expect(helper.registerCount == 2)
+  }
+
+  @Test("a restore after a reconnect is one round trip, and apps past the cap don't fail it")
+  func restoreAfterReconnect() async throws {
+    let path = "/tmp/appfaders-bridge-\(UUID().uuidString.prefix(8)).sock"
+    // the helper's production capacity, and more apps than it has IDs for
+    let helper = RecordingHelper(appIDLimit: 256)
+    let listener = SocketHelperListener(path: path, handler: helper)
+    try listener.start()
+    defer { listener.stop() }
+
+    let volumes = Dictionary(uniqueKeysWithValues: (0 ..< 300).map {
+      ("com.test.app\($0)", Float($0 % 101) / 100)
+    })
+    let bridge = DriverBridge(volumeUpdateInterval: nil) { SocketHelperTransport(path: path) }
+    try await bridge.connect()
+    try await bridge.setAppVolumes(volumes)
+
+    // the reconnect forgets every cached ID
+    bridge.disconnect()
+    try await bridge.connect()
+    defer { bridge.disconnect() }
+    let before = helper.requestCount
+    try await bridge.setAppVolumes(volumes)
+    #expect(helper.requestCount == before + 1)
+    #expect(helper.registerCount == 0)
+    #expect(helper.volumesByAppID.count == 256)
+    #expect(helper.volumesByBundleID.count == 44)
+
+    // the batch numbered what it could - later batches carry IDs, the rest by bundle ID
+    try await bridge.setAppVolumes(volumes.mapValues { _ in 0.5 })
+    #expect(helper.registerCount == 0)
+    #expect(helper.volumesByAppID.values.allSatisfy { $0 == 0.5 })
+    #expect(helper.volumesByBundleID.values.allSatisfy { $0 == 0.5 })
+  }
+
+  @Test("apps the helper has no ID left for go by bundle ID, registered only once")
+  func appIDsExhausted() async throws {
+    let path = "/tmp/appfaders-bridge-\(UUID().uuidString.prefix(8)).sock"
+    let helper = RecordingHelper(appIDLimit: 1)
+    let listener = SocketHelperListener(path: path, handler: helper)
+    try listener.start()
+    defer { listener.stop() }
+
+    let bridge = DriverBridge(volumeUpdateInterval: nil) { SocketHelperTransport(path: path) }
+    try await bridge.connect()
+    defer { bridge.disconnect() }
+
+    try await bridge.setAppVolume(bundleID: "com.test.a", volume: 0.25)
+    try await bridge.setAppVolume(bundleID: "com.test.b", volume: 0.5)
+    try await bridge.setAppVolumes(["com.test.a": 0.1, "com.test.b": 0.3])
+    #expect(helper.volumesByAppID == [1: 0.1])
+    #expect(helper.volumesByBundleID == ["com.test.b": 0.3])
+    #expect(helper.registerCount == 2)
+
+    let volumes = try await bridge.getAppVolumes(bundleIDs: ["com.test.a", "com.test.b"])
+    #expect(volumes == ["com.test.a": 0.1, "com.test.b": 0.3])
+    #expect(helper.registerCount == 2)
+  }
+
+  @Test("a transport that can't connect fails connect()")
+  func unreachable() async {
+    let bridge = DriverBridge { SocketHelperTransport(path: "/tmp/appfaders-missing.sock") }
+    await #expect(throws: DriverError.self) {
+      try await bridge.connect()
+    }
+    #expect(!bridge.isConnected)
+  }
+}
+
+@Suite("DriverBridge restore benchmark", .enabled(if: Benchmark.isEnabled))
+struct DriverBridgeRestoreBenchmarkTests {
+  @Test("a cold restore of a full table beats registering every app first")
+  func coldRestore() async throws {
+    let path = "/tmp/appfaders-bridge-\(UUID().uuidString.prefix(8)).sock"
+    let helper = RecordingHelper(appIDLimit: 256)
+    let listener = SocketHelperListener(path: path, handler: helper)
+    try listener.start()
+    defer { listener.stop() }
+
+    // the helper's production capacity - every app of a full table, none cached on the host
+    let volumes = Dictionary(uniqueKeysWithValues: (0 ..< 256).map {
+      ("com.test.app\($0)", Float($0 % 101) / 100)
+    })
+    let rounds = 5
+
+    var restoreTime: UInt64 = .max
+    for _ in 0 ..< rounds {
+      let bridge = DriverBridge(volumeUpdateInterval: nil) { SocketHelperTransport(path: path) }
+      try await bridge.connect()
+      let start = Benchmark.now
+      try await bridge.setAppVolumes(volumes)
+      restoreTime = min(restoreTime, Benchmark.now - start)
+      bridge.disconnect()
+    }
+
+    // what a restore cost before batches numbered their own apps: a registerApp per app
+    var serialTime: UInt64 = .max
+    for _ in 0 ..< rounds {
+      let transport = SocketHelperTransport(path: path)
+      try transport.start(onChanges: { _, acknowledge in acknowledge() }, onDisconnect: {})
+      let start = Benchmark.now
+      var appVolumes: [UInt32: Float] = [:]
+      for (bundleID, volume) in volumes {
+        guard case let .appID(appID) = try await transport.send(.registerApp(bundleID: bundleID))
+        else { continue }
+        appVolumes[appID] = volume
+      }
+      _ = try await transport.send(.setAppVolumes(appVolumes, named: [:]))
+      serialTime = min(serialTime, Benchmark.now - start)
+      transport.close()
+    }
+
+    let report = "restore \(restoreTime / 1000) µs, registerApp per app \(serialTime / 1000) µs"
+    Benchmark.report("DriverBridge cold restore", report)
+    #expect(restoreTime < serialTime, "\(report)")
+  }
+}
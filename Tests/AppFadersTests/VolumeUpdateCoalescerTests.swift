@@ -0,0 +1,140 @@
+// VolumeUpdateCoalescerTests.swift
+// Unit tests for latest-wins coalescing of fader updates
+//
+// A fake sender stands in for the XPC call, so the helper doesn't need to be running
+
+@testable import AppFaders
+import Foundation
+import Testing
+
+/// records what reached the sender, with a small delay like an XPC round trip
+private final class RecordingSender: @unchecked Sendable {
+  private let lock = NSLock()
+  private var values: [String: [Float]] = [:]
+  private var times: [ContinuousClock.Instant] = []
+  private var concurrent = 0
+  private var maxConcurrentCount = 0
+  let latency: Duration
+  let failure: Error?
+
+  init(latency: Duration = .microseconds(200), failure: Error? = nil) {
+    self.latency = latency
+    self.failure = failure
+  }
+
+  var send: VolumeUpdateCoalescer.Send {
+    { [self] bundleID, volume in
+      lock.withLock {
+        concurrent += 1
+        maxConcurrentCount = max(maxConcurrentCount, concurrent)
+        values[bundleID, default: []].append(volume)
+        times.append(ContinuousClock.now)
+      }
+      try? await Task.sleep(for: latency)
+      lock.withLock { concurrent -= 1 }
+      if let failure { throw failure }
+    }
+  }
+
+  func sent(for bundleID: String) -> [Float] {
+    lock.withLock { values[bundleID] ?? [] }
+  }
+
+  var sendTimes: [ContinuousClock.Instant] {
+    lock.withLock { times }
+  }
+
+  var maxConcurrent: Int {
+    lock.withLock { maxConcurrentCount }
+  }
+}
+
+@Suite("VolumeUpdateCoalescer")
+struct VolumeUpdateCoalescerTests {
+  @Test("10k updates collapse to far fewer sends and the final value is exact")
+  func dragCollapses() async throws {
+    let sender = RecordingSender()
+    let coalescer = VolumeUpdateCoalescer(send: sender.send)
+    let apps = ["com.test.a", "com.test.b", "com.test.c", "com.test.d"]
+
+    for step in 0 ..< 10000 {
+      coalescer.enqueue(Float(step % 1000) / 1000, for: apps[step % apps.count])
+    }
+    // one last value per app, waited on - the lane is idle once it has been sent
+    for (index, bundleID) in apps.enumerated() {
+      let outcome = try await coalescer.submit(Float(index) / 4, for: bundleID)
+      #expect(outcome == .sent)
+    }
+
+    #expect(coalescer.submittedCount == 10004)
+    #expect(coalescer.sentCount < 1000, "\(coalescer.sentCount) sends for 10004 updates")
+    for (index, bundleID) in apps.enumerated() {
+      #expect(sender.sent(for: bundleID).last == Float(index) / 4)
+    }
+  }
+
+  @Test("one request per app in flight at a time")
+  func oneInFlightPerApp() async throws {
+    let sender = RecordingSender(latency: .milliseconds(2))
+    let coalescer = VolumeUpdateCoalescer(send: sender.send)
+
+    for step in 0 ..< 200 {
+      coalescer.enqueue(Float(step) / 200, for: "com.test.app")
+      if step % 20 == 0 {
+        try await Task.sleep(for: .milliseconds(1))
+      }
+    }
+    try await coalescer.submit(1.0, for: "com.test.app")
+
+    #expect(sender.maxConcurrent == 1)
+    #expect(sender.sent(for: "com.test.app").last == 1.0)
+  }
+
+  @Test("a replaced value reports superseded, the latest reports sent")
+  func supersededOutcome() async throws {
+    let sender = RecordingSender(latency: .milliseconds(20))
+    let coalescer = VolumeUpdateCoalescer(send: sender.send)
+
+    // the first value goes out at once; the next two queue behind it and the second replaces
+    // the first of them
+    coalescer.enqueue(0.1, for: "com.test.app")
+    try await Task.sleep(for: .milliseconds(5))
+    async let replaced = coalescer.submit(0.2, for: "com.test.app")
+    try await Task.sleep(for: .milliseconds(5))
+    let latest = try await coalescer.submit(0.3, for: "com.test.app")
+
+    #expect(try await replaced == .superseded)
+    #expect(latest == .sent)
+    #expect(!sender.sent(for: "com.test.app").contains(0.2))
+    #expect(sender.sent(for: "com.test.app").last == 0.3)
+  }
+
+  @Test("the rate cap spaces sends for one app")
+  func rateCap() async throws {
+    let sender = RecordingSender(latency: .zero)
+    let coalescer = VolumeUpdateCoalescer(minimumInterval: .milliseconds(10), send: sender.send)
+
+    for step in 0 ..< 50 {
+      coalescer.enqueue(Float(step) / 50, for: "com.test.app")
+      try await Task.sleep(for: .milliseconds(1))
+    }
+    try await coalescer.submit(1.0, for: "com.test.app")
+
+    let times = sender.sendTimes
+    #expect(times.count < 20)
+    for (earlier, later) in zip(times, times.dropFirst()) {
+      #expect(earlier.duration(to: later) >= .milliseconds(10))
+    }
+    #expect(sender.sent(for: "com.test.app").last == 1.0)
+  }
+
+  @Test("a failed send is reported to the value's waiter")
+  func sendFailure() async {
+    let sender = RecordingSender(failure: DriverError.helperNotRunning)
+    let coalescer = VolumeUpdateCoalescer(send: sender.send)
+
+    await #expect(throws: DriverError.helperNotRunning) {
+      try await coalescer.submit(0.5, for: "com.test.app")
+    }
+  }
+}